@@ -1,11 +1,13 @@
 #include "data_buffer.h"
 #include "esp_log.h"
-#include "cJSON.h"
+#include "json_writer.h"
+#include "num_format.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include "esp_timer.h"
 
 static const char *TAG = "DATA_BUFFER";
@@ -46,7 +48,7 @@ esp_err_t data_buffer_init(void)
     buffer.stats.dropped_samples = 0;
     buffer.stats.buffer_overflows = 0;
     buffer.stats.last_timestamp_us = 0;
-    buffer.stats.avg_processing_time_us = 0.0f;
+    buffer.stats.avg_processing_time_ns = 0;
     
     ESP_LOGI(TAG, "Data buffer initialized with size %d", DATA_BUFFER_SIZE);
     return ESP_OK;
@@ -91,8 +93,8 @@ esp_err_t data_buffer_add(const imu_data_t *data)
     buffer.stats.last_timestamp_us = data->timestamp_us;
     
     int64_t end_time = esp_timer_get_time();
-    float processing_time = (float)(end_time - start_time);
-    buffer.stats.avg_processing_time_us = (buffer.stats.avg_processing_time_us * 0.9f) + (processing_time * 0.1f);
+    uint32_t processing_ns = (uint32_t)(end_time - start_time) * 1000;
+    buffer.stats.avg_processing_time_ns = (buffer.stats.avg_processing_time_ns * 9 + processing_ns) / 10;
     
     xSemaphoreGive(buffer_mutex);
     return ESP_OK;
@@ -241,143 +243,237 @@ bool data_buffer_is_empty(void)
     return empty;
 }
 
-esp_err_t data_buffer_export_json(char *json_buffer, size_t buffer_size, uint32_t max_samples)
+// Each field takes at most NUM_FORMAT_MAX_LEN with its separator
+static char *csv_scaled(char *p, int32_t value, uint8_t scale, uint8_t decimals)
 {
-    if (json_buffer == NULL || buffer_size == 0) {
-        return ESP_ERR_INVALID_ARG;
-    }
-    
-    if (xSemaphoreTake(buffer_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
-        return ESP_ERR_TIMEOUT;
-    }
-    
-    cJSON *root = cJSON_CreateObject();
-    cJSON *samples = cJSON_CreateArray();
-    cJSON *stats = cJSON_CreateObject();
-    
-    // Add statistics
-    cJSON_AddNumberToObject(stats, "total_samples", buffer.stats.total_samples);
-    cJSON_AddNumberToObject(stats, "dropped_samples", buffer.stats.dropped_samples);
-    cJSON_AddNumberToObject(stats, "buffer_overflows", buffer.stats.buffer_overflows);
-    cJSON_AddNumberToObject(stats, "last_timestamp_us", buffer.stats.last_timestamp_us);
-    cJSON_AddNumberToObject(stats, "avg_processing_time_us", buffer.stats.avg_processing_time_us);
-    cJSON_AddItemToObject(root, "statistics", stats);
-    
-    // Add samples
-    uint32_t available_count = buffer.full ? DATA_BUFFER_SIZE : buffer.count;
-    uint32_t export_count = (max_samples > 0 && max_samples < available_count) ? 
-                           max_samples : available_count;
-    
-    for (uint32_t i = 0; i < export_count; i++) {
-        uint32_t idx = (buffer.tail + i) % DATA_BUFFER_SIZE;
-        imu_data_t *data = &buffer.data[idx];
-
-        cJSON *sample = cJSON_CreateObject();
-        cJSON_AddNumberToObject(sample, "timestamp_us", data->timestamp_us);
+    *p++ = ',';
+    return p + num_format_fixed(p, value, scale, decimals);
+}
 
-        if (data->accelerometer.valid) {
-            cJSON *accel_g = cJSON_CreateObject();
-            cJSON_AddNumberToObject(accel_g, "x_g", data->accelerometer.x_g);
-            cJSON_AddNumberToObject(accel_g, "y_g", data->accelerometer.y_g);
-            cJSON_AddNumberToObject(accel_g, "z_g", data->accelerometer.z_g);
-            cJSON_AddNumberToObject(accel_g, "magnitude_g", data->accelerometer.magnitude_g);
-            cJSON_AddItemToObject(sample, "accelerometer_g", accel_g);
+static char *csv_uint(char *p, uint32_t value)
+{
+    *p++ = ',';
+    return p + num_format_u32(p, value);
+}
 
-            const float g_to_ms2 = 9.80665f;
-            cJSON *accel_ms2 = cJSON_CreateObject();
-            cJSON_AddNumberToObject(accel_ms2, "x_ms2", data->accelerometer.x_g * g_to_ms2);
-            cJSON_AddNumberToObject(accel_ms2, "y_ms2", data->accelerometer.y_g * g_to_ms2);
-            cJSON_AddNumberToObject(accel_ms2, "z_ms2", data->accelerometer.z_g * g_to_ms2);
-            cJSON_AddNumberToObject(accel_ms2, "magnitude_ms2", data->accelerometer.magnitude_g * g_to_ms2);
-            cJSON_AddItemToObject(sample, "accelerometer_ms2", accel_ms2);
-        }
+// out has room for DATA_BUFFER_EXPORT_ROW_MAX
+static int export_row_csv(char *out, const imu_data_t *data)
+{
+    const bool valid = data->accelerometer.valid;
+    int32_t ax = valid ? data->accelerometer.x_ug : 0;
+    int32_t ay = valid ? data->accelerometer.y_ug : 0;
+    int32_t az = valid ? data->accelerometer.z_ug : 0;
+    int32_t mag = valid ? data->accelerometer.magnitude_ug : 0;
+    char *p = out;
+    
+    // µg and µm/s² printed in g and m/s², ns in µs
+    p += num_format_u64(p, data->timestamp_us);
+    p = csv_scaled(p, ax, 6, 5);
+    p = csv_scaled(p, ay, 6, 5);
+    p = csv_scaled(p, az, 6, 5);
+    p = csv_scaled(p, mag, 6, 5);
+    p = csv_scaled(p, imu_ug_to_ums2(ax), 6, 5);
+    p = csv_scaled(p, imu_ug_to_ums2(ay), 6, 5);
+    p = csv_scaled(p, imu_ug_to_ums2(az), 6, 5);
+    p = csv_scaled(p, imu_ug_to_ums2(mag), 6, 5);
+    p = csv_uint(p, data->stats.fifo_level);
+    p = csv_uint(p, data->stats.samples_read);
+    p = csv_scaled(p, data->stats.odr_hz, 0, 2);
+    p = csv_scaled(p, data->stats.batch_interval_ns, 3, 2);
+    p = csv_scaled(p, data->stats.samples_per_second, 0, 2);
+    *p++ = '\n';
+    return (int)(p - out);
+}
 
-        cJSON *stats_obj = cJSON_CreateObject();
-        cJSON_AddNumberToObject(stats_obj, "fifo_level", data->stats.fifo_level);
-        cJSON_AddNumberToObject(stats_obj, "samples_read", data->stats.samples_read);
-        cJSON_AddNumberToObject(stats_obj, "odr_hz", data->stats.odr_hz);
-        cJSON_AddNumberToObject(stats_obj, "batch_interval_us", data->stats.batch_interval_us);
-        cJSON_AddNumberToObject(stats_obj, "samples_per_second", data->stats.samples_per_second);
-        cJSON_AddItemToObject(sample, "sensor_stats", stats_obj);
+// Same objects the cJSON export produced, written compact in one pass
+static void export_row_json(json_writer_t *w, const imu_data_t *data)
+{
+    json_writer_begin_object(w, NULL);
+    json_writer_uint(w, "timestamp_us", data->timestamp_us);
+    
+    if (data->accelerometer.valid) {
+        json_writer_begin_object(w, "accelerometer_g");
+        json_writer_scaled(w, "x_g", data->accelerometer.x_ug, 6, 5);
+        json_writer_scaled(w, "y_g", data->accelerometer.y_ug, 6, 5);
+        json_writer_scaled(w, "z_g", data->accelerometer.z_ug, 6, 5);
+        json_writer_scaled(w, "magnitude_g", data->accelerometer.magnitude_ug, 6, 5);
+        json_writer_end_object(w);
+        json_writer_begin_object(w, "accelerometer_ms2");
+        json_writer_scaled(w, "x_ms2", imu_ug_to_ums2(data->accelerometer.x_ug), 6, 5);
+        json_writer_scaled(w, "y_ms2", imu_ug_to_ums2(data->accelerometer.y_ug), 6, 5);
+        json_writer_scaled(w, "z_ms2", imu_ug_to_ums2(data->accelerometer.z_ug), 6, 5);
+        json_writer_scaled(w, "magnitude_ms2", imu_ug_to_ums2(data->accelerometer.magnitude_ug), 6, 5);
+        json_writer_end_object(w);
+    }
+    
+    json_writer_begin_object(w, "sensor_stats");
+    json_writer_uint(w, "fifo_level", data->stats.fifo_level);
+    json_writer_uint(w, "samples_read", data->stats.samples_read);
+    json_writer_scaled(w, "odr_hz", data->stats.odr_hz, 0, 2);
+    json_writer_scaled(w, "batch_interval_us", data->stats.batch_interval_ns, 3, 2);
+    json_writer_scaled(w, "samples_per_second", data->stats.samples_per_second, 0, 2);
+    json_writer_end_object(w);
+    json_writer_end_object(w);
+}
 
-        cJSON_AddItemToArray(samples, sample);
+// Copies up to max records starting at *seq (a total_samples count) out of the
+// ring. Records consumed or overwritten since are skipped and counted in *lost.
+static esp_err_t export_copy(uint32_t *seq, uint32_t max, imu_data_t *out, uint32_t *copied, uint32_t *lost)
+{
+    if (xSemaphoreTake(buffer_mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
     }
     
-    cJSON_AddItemToObject(root, "samples", samples);
-    cJSON_AddNumberToObject(root, "sample_count", export_count);
+    uint32_t count = buffer.full ? DATA_BUFFER_SIZE : buffer.count;
+    uint32_t oldest = buffer.stats.total_samples - count;
+    if ((int32_t)(*seq - oldest) < 0) {
+        *lost += oldest - *seq;
+        *seq = oldest;
+    }
     
-    char *json_string = cJSON_Print(root);
-    if (json_string != NULL) {
-        strncpy(json_buffer, json_string, buffer_size - 1);
-        json_buffer[buffer_size - 1] = '\0';
-        free(json_string);
+    uint32_t offset = *seq - oldest;
+    uint32_t n = (offset < count) ? count - offset : 0;
+    if (n > max) {
+        n = max;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        out[i] = buffer.data[(buffer.tail + offset + i) % DATA_BUFFER_SIZE];
     }
+    *seq += n;
+    *copied = n;
     
-    cJSON_Delete(root);
     xSemaphoreGive(buffer_mutex);
     return ESP_OK;
 }
 
-esp_err_t data_buffer_export_csv(char *csv_buffer, size_t buffer_size, uint32_t max_samples)
+esp_err_t data_buffer_export_stream(data_buffer_export_format_t format, uint32_t max_samples,
+                                    data_buffer_write_cb_t write, void *ctx)
 {
-    if (csv_buffer == NULL || buffer_size == 0) {
+    if (write == NULL || (format != DATA_BUFFER_EXPORT_CSV && format != DATA_BUFFER_EXPORT_JSON)) {
         return ESP_ERR_INVALID_ARG;
     }
     
+    imu_data_t *batch = malloc(DATA_BUFFER_EXPORT_BATCH * sizeof(imu_data_t));
+    char *out = malloc(DATA_BUFFER_EXPORT_CHUNK);
+    if (batch == NULL || out == NULL) {
+        free(batch);
+        free(out);
+        return ESP_ERR_NO_MEM;
+    }
+    
+    // Snapshot: the records present now, oldest first, addressed by their
+    // total_samples count. Records added meanwhile are left out.
     if (xSemaphoreTake(buffer_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        free(batch);
+        free(out);
         return ESP_ERR_TIMEOUT;
     }
-    
-    // CSV header
-    int offset = snprintf(csv_buffer, buffer_size,
-        "timestamp_us,accel_x_g,accel_y_g,accel_z_g,accel_magnitude_g,"
-        "accel_x_ms2,accel_y_ms2,accel_z_ms2,accel_magnitude_ms2,"
-        "fifo_level,samples_read,odr_hz,batch_interval_us,samples_per_second\n");
-    
-    if (offset >= buffer_size) {
-        xSemaphoreGive(buffer_mutex);
-        return ESP_ERR_NO_MEM;
+    uint32_t remaining = buffer.full ? DATA_BUFFER_SIZE : buffer.count;
+    uint32_t seq = buffer.stats.total_samples - remaining;
+    xSemaphoreGive(buffer_mutex);
+    if (max_samples > 0 && remaining > max_samples) {
+        remaining = max_samples;
     }
+    uint32_t end_seq = seq + remaining;
     
-    // Add data rows
-    uint32_t available_count = buffer.full ? DATA_BUFFER_SIZE : buffer.count;
-    uint32_t export_count = (max_samples > 0 && max_samples < available_count) ? 
-                           max_samples : available_count;
+    uint32_t exported = 0;
+    uint32_t skipped = 0;
+    uint32_t busy = 0;
+    size_t bytes = 0;
+    int64_t start_time = esp_timer_get_time();
+    esp_err_t ret = ESP_OK;
+    
+    // JSON goes through the writer, which flushes the chunk by itself; CSV rows
+    // are bounded, so the chunk is flushed whenever a row might not fit
+    json_writer_t w;
+    int len = 0;
+    if (format == DATA_BUFFER_EXPORT_JSON) {
+        buffer_stats_t stats = {0};
+        data_buffer_get_stats(&stats);
+        json_writer_init(&w, out, DATA_BUFFER_EXPORT_CHUNK, write, ctx);
+        json_writer_begin_object(&w, NULL);
+        json_writer_begin_object(&w, "statistics");
+        json_writer_uint(&w, "total_samples", stats.total_samples);
+        json_writer_uint(&w, "dropped_samples", stats.dropped_samples);
+        json_writer_uint(&w, "buffer_overflows", stats.buffer_overflows);
+        json_writer_uint(&w, "last_timestamp_us", stats.last_timestamp_us);
+        json_writer_scaled(&w, "avg_processing_time_us", stats.avg_processing_time_ns, 3, 2);
+        json_writer_end_object(&w);
+        json_writer_begin_array(&w, "samples");
+    } else {
+        len = snprintf(out, DATA_BUFFER_EXPORT_CHUNK,
+            "timestamp_us,accel_x_g,accel_y_g,accel_z_g,accel_magnitude_g,"
+            "accel_x_ms2,accel_y_ms2,accel_z_ms2,accel_magnitude_ms2,"
+            "fifo_level,samples_read,odr_hz,batch_interval_us,samples_per_second\n");
+    }
     
-    for (uint32_t i = 0; i < export_count; i++) {
-        uint32_t idx = (buffer.tail + i) % DATA_BUFFER_SIZE;
-        imu_data_t *data = &buffer.data[idx];
+    while ((int32_t)(end_seq - seq) > 0) {
+        uint32_t want = end_seq - seq;
+        if (want > DATA_BUFFER_EXPORT_BATCH) {
+            want = DATA_BUFFER_EXPORT_BATCH;
+        }
         
-        float ax_g = data->accelerometer.valid ? data->accelerometer.x_g : 0.0f;
-        float ay_g = data->accelerometer.valid ? data->accelerometer.y_g : 0.0f;
-        float az_g = data->accelerometer.valid ? data->accelerometer.z_g : 0.0f;
-        float mag_g = data->accelerometer.valid ? data->accelerometer.magnitude_g : 0.0f;
-        const float g_to_ms2 = 9.80665f;
-        int row_len = snprintf(csv_buffer + offset, buffer_size - offset,
-            "%llu,%.5f,%.5f,%.5f,%.5f,"
-            "%.5f,%.5f,%.5f,%.5f,"
-            "%u,%u,%.2f,%.2f,%.2f\n",
-            (unsigned long long)data->timestamp_us,
-            ax_g,
-            ay_g,
-            az_g,
-            mag_g,
-            ax_g * g_to_ms2,
-            ay_g * g_to_ms2,
-            az_g * g_to_ms2,
-            mag_g * g_to_ms2,
-            data->stats.fifo_level,
-            data->stats.samples_read,
-            data->stats.odr_hz,
-            data->stats.batch_interval_us,
-            data->stats.samples_per_second);
+        // Copy a batch out so the mutex is not held while the sink sends
+        uint32_t n = 0;
+        ret = export_copy(&seq, want, batch, &n, &skipped);
+        if (ret == ESP_ERR_TIMEOUT && ++busy < DATA_BUFFER_EXPORT_RETRIES) {
+            vTaskDelay(1);
+            continue;
+        }
+        if (ret != ESP_OK) {
+            break;
+        }
+        busy = 0;
         
-        if (row_len >= (buffer_size - offset)) {
-            break; // Buffer full
+        // Skipping ahead may have carried the batch past the snapshot end
+        if ((int32_t)(seq - end_seq) > 0) {
+            uint32_t extra = seq - end_seq;
+            n = (extra < n) ? n - extra : 0;
+        }
+        
+        for (uint32_t i = 0; i < n; i++) {
+            if (format == DATA_BUFFER_EXPORT_JSON) {
+                export_row_json(&w, &batch[i]);
+                ret = w.err;
+            } else {
+                if (len > DATA_BUFFER_EXPORT_CHUNK - DATA_BUFFER_EXPORT_ROW_MAX) {
+                    ret = write(out, len, ctx);
+                    bytes += len;
+                    len = 0;
+                }
+                if (ret == ESP_OK) {
+                    len += export_row_csv(out + len, &batch[i]);
+                }
+            }
+            if (ret != ESP_OK) {
+                break;
+            }
+            exported++;
+        }
+        if (ret != ESP_OK || n == 0) {
+            break;
         }
-        offset += row_len;
     }
     
-    xSemaphoreGive(buffer_mutex);
-    return ESP_OK;
+    if (format == DATA_BUFFER_EXPORT_JSON) {
+        if (ret == ESP_OK) {
+            json_writer_end_array(&w);
+            json_writer_uint(&w, "sample_count", exported);
+            json_writer_uint(&w, "skipped", skipped);
+            json_writer_end_object(&w);
+            ret = json_writer_finish(&w);
+        }
+        bytes = w.total;
+    } else if (ret == ESP_OK && len > 0) {
+        ret = write(out, len, ctx);
+        bytes += len;
+    }
+    
+    ESP_LOGI(TAG, "Export: %lu records (%lu skipped), %u bytes, %lld ms",
+             (unsigned long)exported, (unsigned long)skipped, (unsigned)bytes,
+             (esp_timer_get_time() - start_time) / 1000);
+    
+    free(batch);
+    free(out);
+    return ret;
 }
@@ -4,6 +4,7 @@
 #include "esp_err.h"
 #include "imu_manager.h"
 #include <stdint.h>
+#include <stddef.h>
 #include <stdbool.h>
 
 // Buffer configuration
@@ -16,7 +17,7 @@ typedef struct {
     uint32_t dropped_samples;
     uint32_t buffer_overflows;
     uint64_t last_timestamp_us;
-    float avg_processing_time_us;
+    uint32_t avg_processing_time_ns;    // Moving average, weight 0.1
 } buffer_stats_t;
 
 // Data buffer API
@@ -31,8 +32,24 @@ uint32_t data_buffer_get_count(void);
 bool data_buffer_is_full(void);
 bool data_buffer_is_empty(void);
 
-// JSON export functions
-esp_err_t data_buffer_export_json(char *json_buffer, size_t buffer_size, uint32_t max_samples);
-esp_err_t data_buffer_export_csv(char *csv_buffer, size_t buffer_size, uint32_t max_samples);
+// Streaming export: rows are formatted into one reusable chunk and handed to
+// the sink as it fills, so memory stays constant whatever the export size
+#define DATA_BUFFER_EXPORT_CHUNK    2048    // Bytes per sink call, at most
+#define DATA_BUFFER_EXPORT_ROW_MAX  448     // Longest CSV row: 14 fields of up to NUM_FORMAT_MAX_LEN
+#define DATA_BUFFER_EXPORT_BATCH    16      // Records copied out of the ring per lock
+#define DATA_BUFFER_EXPORT_RETRIES  10      // Busy mutex attempts before giving up
+
+typedef enum {
+    DATA_BUFFER_EXPORT_CSV = 0,
+    DATA_BUFFER_EXPORT_JSON,
+} data_buffer_export_format_t;
+
+// Receives each filled chunk; anything but ESP_OK stops the export
+typedef esp_err_t (*data_buffer_write_cb_t)(const char *data, size_t len, void *ctx);
+
+// Exports the records buffered when the call starts, oldest first; max_samples
+// 0 means all. Records overwritten before they are copied are skipped.
+esp_err_t data_buffer_export_stream(data_buffer_export_format_t format, uint32_t max_samples,
+                                    data_buffer_write_cb_t write, void *ctx);
 
 #endif // DATA_BUFFER_H
@@ -2,11 +2,11 @@
 #include "sensors/iis3dwb_hal.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "esp_cpu.h"
 #include "driver/spi_master.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
-#include <math.h>
 #include <string.h>
 
 static const char *TAG = "IMU_MANAGER";
@@ -22,14 +22,30 @@ static const char *TAG = "IMU_MANAGER";
 static stmdev_ctx_t iis3dwb_ctx;
 static SemaphoreHandle_t sensor_mutex = NULL;
 static uint16_t fifo_watermark = 256;
-static float configured_odr_hz = 26670.0f;  // 26.67kHz max for IIS3DWB
+static uint32_t configured_odr_hz = 26670;  // 26.67kHz max for IIS3DWB
 static uint8_t current_full_scale = 0;  // 0=±2g, 1=±4g, 2=±8g, 3=±16g
 
-// Recent samples buffer for WebSocket
+// Sensitivity per full scale code [µg/LSB]
+static const int32_t sensitivity_ug_lsb[4] = {
+    IIS3DWB_HAL_SENS_2G_UG_LSB,
+    IIS3DWB_HAL_SENS_4G_UG_LSB,
+    IIS3DWB_HAL_SENS_8G_UG_LSB,
+    IIS3DWB_HAL_SENS_16G_UG_LSB,
+};
+static int32_t current_sensitivity_ug_lsb = IIS3DWB_HAL_SENS_2G_UG_LSB;
+// One sample period in ns as Q24.8, so the batch interval needs no division
+static uint32_t sample_period_ns_q8 = 0;
+
+// Conversion cost, see imu_convert_stats_t
+static uint64_t convert_cycles_total = 0;
+static uint32_t convert_samples = 0;
+static uint32_t convert_last_cycles = 0;
+
+// Recent samples buffer for WebSocket, raw counts at current_sensitivity_ug_lsb
 #define MAX_RECENT_SAMPLES 256
-static float recent_x[MAX_RECENT_SAMPLES];
-static float recent_y[MAX_RECENT_SAMPLES];
-static float recent_z[MAX_RECENT_SAMPLES];
+static int16_t recent_x[MAX_RECENT_SAMPLES];
+static int16_t recent_y[MAX_RECENT_SAMPLES];
+static int16_t recent_z[MAX_RECENT_SAMPLES];
 static uint16_t recent_count = 0;
 static uint64_t recent_timestamp = 0;
 static uint32_t recent_sequence = 0;
@@ -104,8 +120,10 @@ esp_err_t imu_manager_init(void)
     }
 
     current_full_scale = 1;  // Set to ±4g
-    ESP_LOGI(TAG, "IIS3DWB initialized successfully at %.2f Hz (watermark=%u, fs=±4g)",
-             configured_odr_hz, fifo_watermark);
+    current_sensitivity_ug_lsb = sensitivity_ug_lsb[current_full_scale];
+    sample_period_ns_q8 = (uint32_t)((1000000000ULL * 256 + configured_odr_hz / 2) / configured_odr_hz);
+    ESP_LOGI(TAG, "IIS3DWB initialized successfully at %lu Hz (watermark=%u, fs=±4g)",
+             (unsigned long)configured_odr_hz, fifo_watermark);
 
     return ESP_OK;
 }
@@ -142,15 +160,9 @@ esp_err_t imu_manager_read_all(imu_data_t *data)
         return ESP_OK;
     }
     
-    // Convert sensitivity based on full scale
-    float sensitivity_mg_lsb;
-    switch (current_full_scale) {
-        case 0: sensitivity_mg_lsb = 0.061f; break;  // ±2g
-        case 1: sensitivity_mg_lsb = 0.122f; break;  // ±4g
-        case 2: sensitivity_mg_lsb = 0.244f; break;  // ±8g
-        case 3: sensitivity_mg_lsb = 0.488f; break;  // ±16g
-        default: sensitivity_mg_lsb = 0.122f;
-    }
+    // Integer only from here on; the cycle counter shows what a sample costs
+    uint32_t start_cycles = esp_cpu_get_cycle_count();
+    const int32_t sens = current_sensitivity_ug_lsb;
     
     // Store all samples in recent buffer for WebSocket
     uint16_t samples_to_store = hal_data.sample_count;
@@ -158,17 +170,11 @@ esp_err_t imu_manager_read_all(imu_data_t *data)
         samples_to_store = MAX_RECENT_SAMPLES - recent_count;
     }
     
-    int16_t last_x = 0, last_y = 0, last_z = 0;
     for (uint16_t i = 0; i < samples_to_store; i++) {
         uint16_t idx = recent_count + i;
-        recent_x[idx] = hal_data.samples[i].x_raw * sensitivity_mg_lsb / 1000.0f;
-        recent_y[idx] = hal_data.samples[i].y_raw * sensitivity_mg_lsb / 1000.0f;
-        recent_z[idx] = hal_data.samples[i].z_raw * sensitivity_mg_lsb / 1000.0f;
-        
-        // Keep last sample for display
-        last_x = hal_data.samples[i].x_raw;
-        last_y = hal_data.samples[i].y_raw;
-        last_z = hal_data.samples[i].z_raw;
+        recent_x[idx] = hal_data.samples[i].x_raw;
+        recent_y[idx] = hal_data.samples[i].y_raw;
+        recent_z[idx] = hal_data.samples[i].z_raw;
     }
     
     recent_count += samples_to_store;
@@ -176,24 +182,27 @@ esp_err_t imu_manager_read_all(imu_data_t *data)
     recent_sequence++;
     recent_fifo_level = hal_data.sample_count;
     
-    // Use last sample for current reading (or average from hal_data)
-    data->accelerometer.x_g = hal_data.x_mg / 1000.0f;
-    data->accelerometer.y_g = hal_data.y_mg / 1000.0f;
-    data->accelerometer.z_g = hal_data.z_mg / 1000.0f;
-    data->accelerometer.magnitude_g = sqrtf(
-        data->accelerometer.x_g * data->accelerometer.x_g +
-        data->accelerometer.y_g * data->accelerometer.y_g +
-        data->accelerometer.z_g * data->accelerometer.z_g
-    );
+    // Current reading is the average of the batch read by the HAL
+    data->accelerometer.x_ug = hal_data.x_raw * sens;
+    data->accelerometer.y_ug = hal_data.y_raw * sens;
+    data->accelerometer.z_ug = hal_data.z_raw * sens;
+    data->accelerometer.magnitude_ug =
+        (int32_t)imu_manager_magnitude_lsb(hal_data.x_raw, hal_data.y_raw, hal_data.z_raw) * sens;
     data->accelerometer.valid = true;
 
     // Fill in stats
     data->stats.fifo_level = hal_data.sample_count;
     data->stats.samples_read = hal_data.sample_count;
     data->stats.odr_hz = configured_odr_hz;
-    data->stats.batch_interval_us = (hal_data.sample_count * 1e6f) / configured_odr_hz;
+    data->stats.batch_interval_ns =
+        (uint32_t)(((uint64_t)hal_data.sample_count * sample_period_ns_q8 + 128) >> 8);
     data->stats.samples_per_second = configured_odr_hz;
 
+    uint32_t cycles = esp_cpu_get_cycle_count() - start_cycles;
+    convert_last_cycles = cycles;
+    convert_cycles_total += cycles;
+    convert_samples += hal_data.sample_count;
+
     xSemaphoreGive(sensor_mutex);
     return ESP_OK;
 }
@@ -216,7 +225,7 @@ esp_err_t imu_manager_deinit(void)
     return ESP_OK;
 }
 
-float imu_manager_get_configured_odr(void)
+uint32_t imu_manager_get_configured_odr(void)
 {
     return configured_odr_hz;
 }
@@ -250,6 +259,9 @@ esp_err_t imu_manager_set_full_scale(uint8_t fs_code)
     esp_err_t ret = iis3dwb_xl_full_scale_set(&iis3dwb_ctx, fs);
     if (ret == ESP_OK) {
         current_full_scale = fs_code;
+        current_sensitivity_ug_lsb = sensitivity_ug_lsb[fs_code];
+        // Pending WebSocket samples were read at the old scale
+        recent_count = 0;
         ESP_LOGI(TAG, "Full scale changed to ±%dg",
                  (fs_code == 0) ? 2 : (fs_code == 1) ? 4 : (fs_code == 2) ? 8 : 16);
     }
@@ -263,11 +275,12 @@ uint8_t imu_manager_get_full_scale(void)
     return current_full_scale;
 }
 
-uint16_t imu_manager_copy_recent_samples(float *x_g, float *y_g, float *z_g,
+uint16_t imu_manager_copy_recent_samples(int16_t *x_raw, int16_t *y_raw, int16_t *z_raw,
                                          uint16_t max_samples, uint64_t *timestamp_us,
-                                         uint16_t *fifo_level, uint32_t *sequence_id)
+                                         uint16_t *fifo_level, uint32_t *sequence_id,
+                                         int32_t *sensitivity_ug_lsb)
 {
-    if (!x_g || !y_g || !z_g) {
+    if (!x_raw || !y_raw || !z_raw) {
         return 0;
     }
     
@@ -278,13 +291,14 @@ uint16_t imu_manager_copy_recent_samples(float *x_g, float *y_g, float *z_g,
     uint16_t count_to_copy = (recent_count > max_samples) ? max_samples : recent_count;
     
     if (count_to_copy > 0) {
-        memcpy(x_g, recent_x, count_to_copy * sizeof(float));
-        memcpy(y_g, recent_y, count_to_copy * sizeof(float));
-        memcpy(z_g, recent_z, count_to_copy * sizeof(float));
+        memcpy(x_raw, recent_x, count_to_copy * sizeof(int16_t));
+        memcpy(y_raw, recent_y, count_to_copy * sizeof(int16_t));
+        memcpy(z_raw, recent_z, count_to_copy * sizeof(int16_t));
         
         if (timestamp_us) *timestamp_us = recent_timestamp;
         if (fifo_level) *fifo_level = recent_fifo_level;
         if (sequence_id) *sequence_id = recent_sequence;
+        if (sensitivity_ug_lsb) *sensitivity_ug_lsb = current_sensitivity_ug_lsb;
         
         // Reset count after copy to avoid sending duplicate samples
         recent_count = 0;
@@ -293,3 +307,48 @@ uint16_t imu_manager_copy_recent_samples(float *x_g, float *y_g, float *z_g,
     xSemaphoreGive(sensor_mutex);
     return count_to_copy;
 }
+
+uint32_t imu_manager_magnitude_lsb(int16_t x, int16_t y, int16_t z)
+{
+    // At most 3 × 32768², so the sum of squares fits in 32 bits
+    uint32_t n = (uint32_t)(x * x) + (uint32_t)(y * y) + (uint32_t)(z * z);
+    
+    // Digit-by-digit square root: shifts and subtractions, no multiply or divide
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+    while (bit > n) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (n >= root + bit) {
+            n -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    // n is now the remainder n - root²; sqrt >= root + 0.5 exactly when it exceeds root
+    if (n > root) {
+        root++;
+    }
+    return root;
+}
+
+void imu_manager_get_convert_stats(imu_convert_stats_t *stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+    
+    if (xSemaphoreTake(sensor_mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
+        return;
+    }
+    stats->samples = convert_samples;
+    stats->last_cycles = convert_last_cycles;
+    if (convert_samples > 0) {
+        stats->cycles_per_sample = (uint32_t)(convert_cycles_total / convert_samples);
+    }
+    xSemaphoreGive(sensor_mutex);
+}
@@ -5,24 +5,42 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// Carried in fixed point end to end: the ESP32-C6 has no FPU, so float is
+// left to the text encoders at the presentation edge
 typedef struct {
     uint64_t timestamp_us;
     struct {
-        float x_g;
-        float y_g;
-        float z_g;
-        float magnitude_g;
+        int32_t x_ug;               // Raw counts × sensitivity [µg]
+        int32_t y_ug;
+        int32_t z_ug;
+        int32_t magnitude_ug;
         bool valid;
     } accelerometer;
     struct {
         uint16_t fifo_level;
         uint16_t samples_read;
-        float odr_hz;
-        float batch_interval_us;
-        float samples_per_second;
+        uint32_t odr_hz;
+        uint32_t batch_interval_ns;
+        uint32_t samples_per_second;
     } stats;
 } imu_data_t;
 
+// Cost of turning raw counts into imu_data_t and the WebSocket buffer,
+// measured with the CPU cycle counter in imu_manager_read_all()
+typedef struct {
+    uint32_t samples;               // Samples converted
+    uint32_t last_cycles;           // Last conversion pass
+    uint32_t cycles_per_sample;     // Average over all passes
+} imu_convert_stats_t;
+
+// Standard gravity in Q24 (9.80665 × 2^24), µg -> µm/s² within 1 µm/s²
+#define IMU_G_TO_MS2_Q24    164528285
+
+static inline int32_t imu_ug_to_ums2(int32_t ug)
+{
+    return (int32_t)(((int64_t)ug * IMU_G_TO_MS2_Q24 + (1 << 23)) >> 24);
+}
+
 #define IMU_MANAGER_MAX_SAMPLES 512  // Match IIS3DWB FIFO max size
 
 // IMU Manager API
@@ -32,10 +50,16 @@ esp_err_t imu_manager_read_accelerometer(imu_data_t *data);
 esp_err_t imu_manager_deinit(void);
 esp_err_t imu_manager_set_full_scale(uint8_t fs_code); // 0=±2g, 1=±4g, 2=±8g, 3=±16g
 uint8_t imu_manager_get_full_scale(void);
-float imu_manager_get_configured_odr(void);
+uint32_t imu_manager_get_configured_odr(void);
 uint16_t imu_manager_get_fifo_watermark(void);
-uint16_t imu_manager_copy_recent_samples(float *x_g, float *y_g, float *z_g,
+// Raw counts of the samples read since the last call; multiply by
+// *sensitivity_ug_lsb for µg. A full scale change drops the pending samples.
+uint16_t imu_manager_copy_recent_samples(int16_t *x_raw, int16_t *y_raw, int16_t *z_raw,
                                          uint16_t max_samples, uint64_t *timestamp_us,
-                                         uint16_t *fifo_level, uint32_t *sequence_id);
+                                         uint16_t *fifo_level, uint32_t *sequence_id,
+                                         int32_t *sensitivity_ug_lsb);
+// sqrt(x² + y² + z²) in LSB, rounded, with integer arithmetic only
+uint32_t imu_manager_magnitude_lsb(int16_t x, int16_t y, int16_t z);
+void imu_manager_get_convert_stats(imu_convert_stats_t *stats);
 
 #endif // IMU_MANAGER_H
@@ -0,0 +1,203 @@
+#include "json_writer.h"
+#include "num_format.h"
+#include <string.h>
+
+static void put(json_writer_t *w, const char *s, size_t n)
+{
+    while (n > 0 && w->err == ESP_OK) {
+        if (w->len == w->size) {
+            if (w->flush == NULL) {
+                w->err = ESP_ERR_NO_MEM;
+                return;
+            }
+            json_writer_flush(w);
+            continue;
+        }
+        size_t room = w->size - w->len;
+        size_t chunk = (n < room) ? n : room;
+        memcpy(w->buf + w->len, s, chunk);
+        w->len += chunk;
+        w->total += chunk;
+        s += chunk;
+        n -= chunk;
+    }
+}
+
+static inline void put_char(json_writer_t *w, char c)
+{
+    put(w, &c, 1);
+}
+
+// Comma and key in front of a value at the current level
+static void begin_value(json_writer_t *w, const char *key)
+{
+    uint32_t bit = 1UL << w->depth;
+    if (w->has_items & bit) {
+        put_char(w, ',');
+    }
+    w->has_items |= bit;
+    if (key != NULL) {
+        put_char(w, '"');
+        put(w, key, strlen(key));
+        put(w, "\":", 2);
+    }
+}
+
+void json_writer_init(json_writer_t *w, char *buf, size_t size, json_writer_flush_t flush, void *ctx)
+{
+    memset(w, 0, sizeof(*w));
+    w->buf = buf;
+    w->size = size;
+    w->flush = flush;
+    w->ctx = ctx;
+    w->err = (buf == NULL || size == 0) ? ESP_ERR_INVALID_ARG : ESP_OK;
+}
+
+static void open_container(json_writer_t *w, const char *key, char c)
+{
+    begin_value(w, key);
+    put_char(w, c);
+    if (w->depth + 1 >= JSON_WRITER_MAX_DEPTH) {
+        w->err = ESP_ERR_INVALID_SIZE;
+        return;
+    }
+    w->depth++;
+    w->has_items &= ~(1UL << w->depth);
+}
+
+static void close_container(json_writer_t *w, char c)
+{
+    if (w->depth == 0) {
+        w->err = ESP_ERR_INVALID_STATE;
+        return;
+    }
+    w->depth--;
+    put_char(w, c);
+}
+
+void json_writer_begin_object(json_writer_t *w, const char *key)
+{
+    open_container(w, key, '{');
+}
+
+void json_writer_end_object(json_writer_t *w)
+{
+    close_container(w, '}');
+}
+
+void json_writer_begin_array(json_writer_t *w, const char *key)
+{
+    open_container(w, key, '[');
+}
+
+void json_writer_end_array(json_writer_t *w)
+{
+    close_container(w, ']');
+}
+
+void json_writer_int(json_writer_t *w, const char *key, int64_t value)
+{
+    char num[NUM_FORMAT_MAX_LEN];
+    begin_value(w, key);
+    put(w, num, num_format_i64(num, value));
+}
+
+void json_writer_uint(json_writer_t *w, const char *key, uint64_t value)
+{
+    char num[NUM_FORMAT_MAX_LEN];
+    begin_value(w, key);
+    put(w, num, num_format_u64(num, value));
+}
+
+void json_writer_fixed(json_writer_t *w, const char *key, int64_t value, uint8_t decimals)
+{
+    char num[NUM_FORMAT_MAX_LEN];
+    begin_value(w, key);
+    put(w, num, num_format_fixed(num, value, decimals, decimals));
+}
+
+void json_writer_scaled(json_writer_t *w, const char *key, int64_t value, uint8_t scale, uint8_t decimals)
+{
+    char num[NUM_FORMAT_MAX_LEN];
+    begin_value(w, key);
+    put(w, num, num_format_fixed(num, value, scale, decimals));
+}
+
+void json_writer_float(json_writer_t *w, const char *key, float value, uint8_t decimals)
+{
+    char num[NUM_FORMAT_MAX_LEN];
+    size_t n = num_format_float(num, value, decimals);
+    // "nan", "inf" and "-inf" have no JSON spelling; a single digit has no num[1]
+    if (num[0] == 'n' || num[0] == 'i' || (n > 1 && num[1] == 'i')) {
+        json_writer_null(w, key);
+        return;
+    }
+    begin_value(w, key);
+    put(w, num, n);
+}
+
+void json_writer_bool(json_writer_t *w, const char *key, bool value)
+{
+    begin_value(w, key);
+    if (value) {
+        put(w, "true", 4);
+    } else {
+        put(w, "false", 5);
+    }
+}
+
+void json_writer_string(json_writer_t *w, const char *key, const char *value)
+{
+    if (value == NULL) {
+        json_writer_null(w, key);
+        return;
+    }
+    begin_value(w, key);
+    put_char(w, '"');
+    const char *run = value;
+    for (const char *p = value; *p != '\0'; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        put(w, run, p - run);
+        char esc[6] = { '\\', (char)c, 0 };
+        size_t n = 2;
+        if (c < 0x20) {
+            static const char hex[] = "0123456789abcdef";
+            esc[1] = 'u';
+            esc[2] = '0';
+            esc[3] = '0';
+            esc[4] = hex[c >> 4];
+            esc[5] = hex[c & 0xF];
+            n = 6;
+        }
+        put(w, esc, n);
+        run = p + 1;
+    }
+    put(w, run, strlen(run));
+    put_char(w, '"');
+}
+
+void json_writer_null(json_writer_t *w, const char *key)
+{
+    begin_value(w, key);
+    put(w, "null", 4);
+}
+
+esp_err_t json_writer_flush(json_writer_t *w)
+{
+    if (w->err == ESP_OK && w->len > 0 && w->flush != NULL) {
+        w->err = w->flush(w->buf, w->len, w->ctx);
+        w->len = 0;
+    }
+    return w->err;
+}
+
+esp_err_t json_writer_finish(json_writer_t *w)
+{
+    if (w->err == ESP_OK && w->depth != 0) {
+        w->err = ESP_ERR_INVALID_STATE;
+    }
+    return json_writer_flush(w);
+}
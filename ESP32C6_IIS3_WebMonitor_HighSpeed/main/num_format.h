@@ -0,0 +1,35 @@
+#ifndef NUM_FORMAT_H
+#define NUM_FORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Decimal formatting for the text encoders (JSON, CSV) without printf.
+// The ESP32-C6 has no FPU, so "%.5f" goes through soft-float doubles and
+// newlib's vfprintf. Here fixed-point values are printed with integer
+// arithmetic only, and 32-bit division is used wherever the value allows.
+//
+// Every function writes into out, returns the number of characters written
+// and does not NUL-terminate. out needs room for NUM_FORMAT_MAX_LEN characters.
+
+#define NUM_FORMAT_MAX_DECIMALS     9
+// Sign, 20 digits of uint64_t, point and 9 decimals
+#define NUM_FORMAT_MAX_LEN          32
+
+size_t num_format_u32(char *out, uint32_t value);
+size_t num_format_u64(char *out, uint64_t value);
+size_t num_format_i64(char *out, int64_t value);
+
+// value is in units of 10^-scale (e.g. micro-g with scale 6) and is printed
+// with the given number of decimals, rounded half away from zero or padded
+// with zeros. Both scale and decimals are capped at NUM_FORMAT_MAX_DECIMALS.
+// num_format_fixed(out, -1234567, 6, 3) -> "-1.235"
+size_t num_format_fixed(char *out, int64_t value, uint8_t scale, uint8_t decimals);
+
+// Same digits as "%.*f" (exact binary value, ties to even) for |value| < 1e19,
+// computed from the IEEE 754 fields without soft-float calls. A result that
+// rounds to zero has no sign. NaN prints "nan"; infinities and larger
+// magnitudes print "inf" / "-inf".
+size_t num_format_float(char *out, float value, uint8_t decimals);
+
+#endif // NUM_FORMAT_H
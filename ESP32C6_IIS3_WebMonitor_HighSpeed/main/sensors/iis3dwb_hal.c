@@ -141,8 +141,8 @@ static esp_err_t iis3dwb_hal_read_polling_data(stmdev_ctx_t *ctx, iis3dwb_hal_da
     uint8_t reg;
     int16_t data_raw_acceleration[3] = {0};
     int16_t data_raw_temperature = 0;
-    float data_accel[3] = {0};
-    float data_temp = 0;
+    int32_t data_accel[3] = {0};
+    int32_t data_temp = 0;
     
     // Store all samples (not just average) for WebSocket
     uint16_t samples_stored = 0;
@@ -174,9 +174,9 @@ static esp_err_t iis3dwb_hal_read_polling_data(stmdev_ctx_t *ctx, iis3dwb_hal_da
             samples_stored++;
         }
         
-        data_accel[0] += (float)data_raw_acceleration[0];
-        data_accel[1] += (float)data_raw_acceleration[1];
-        data_accel[2] += (float)data_raw_acceleration[2];
+        data_accel[0] += data_raw_acceleration[0];
+        data_accel[1] += data_raw_acceleration[1];
+        data_accel[2] += data_raw_acceleration[2];
 
         timeout_count = 0;
         do{
@@ -192,40 +192,19 @@ static esp_err_t iis3dwb_hal_read_polling_data(stmdev_ctx_t *ctx, iis3dwb_hal_da
 
         /* Read temperature data */
         ESP_ERROR_CHECK(iis3dwb_temperature_raw_get(ctx, &data_raw_temperature));
-        data_temp += (float)data_raw_temperature;
+        data_temp += data_raw_temperature;
     }
     
     data->sample_count = samples_stored;
 
-    // Convert acceleration data to mg (average for compatibility)
-    iis3dwb_fs_xl_t full_scale;
-    ESP_ERROR_CHECK(iis3dwb_xl_full_scale_get(ctx, &full_scale));
-    switch(full_scale){
-        case IIS3DWB_2g:
-            data->x_mg = iis3dwb_from_fs2g_to_mg((int16_t)(data_accel[0]/sample));
-            data->y_mg = iis3dwb_from_fs2g_to_mg((int16_t)(data_accel[1]/sample));
-            data->z_mg = iis3dwb_from_fs2g_to_mg((int16_t)(data_accel[2]/sample));
-            break;
-        case IIS3DWB_4g:
-            data->x_mg = iis3dwb_from_fs4g_to_mg((int16_t)(data_accel[0]/sample));
-            data->y_mg = iis3dwb_from_fs4g_to_mg((int16_t)(data_accel[1]/sample));
-            data->z_mg = iis3dwb_from_fs4g_to_mg((int16_t)(data_accel[2]/sample));
-            break;
-        case IIS3DWB_8g:
-            data->x_mg = iis3dwb_from_fs8g_to_mg((int16_t)(data_accel[0]/sample));
-            data->y_mg = iis3dwb_from_fs8g_to_mg((int16_t)(data_accel[1]/sample));
-            data->z_mg = iis3dwb_from_fs8g_to_mg((int16_t)(data_accel[2]/sample));
-            break;
-        case IIS3DWB_16g:
-            data->x_mg = iis3dwb_from_fs16g_to_mg((int16_t)(data_accel[0]/sample));
-            data->y_mg = iis3dwb_from_fs16g_to_mg((int16_t)(data_accel[1]/sample));
-            data->z_mg = iis3dwb_from_fs16g_to_mg((int16_t)(data_accel[2]/sample));
-            break;
-        default:
-            return ESP_ERR_INVALID_ARG;
+    // Raw averages; scaling to physical units is left to the caller, which
+    // knows the full scale without another register read
+    if (sample > 0) {
+        data->x_raw = (int16_t)(data_accel[0] / sample);
+        data->y_raw = (int16_t)(data_accel[1] / sample);
+        data->z_raw = (int16_t)(data_accel[2] / sample);
+        data->temperature_raw = (int16_t)(data_temp / sample);
     }
-    // Convert temperature data to degC
-    data->temperature_degC = iis3dwb_from_lsb_to_celsius((int16_t)(data_temp/sample));
 
     return ESP_OK;
 }
@@ -237,8 +216,8 @@ static esp_err_t iis3dwb_hal_read_fifo_data(stmdev_ctx_t *ctx, iis3dwb_hal_data_
     iis3dwb_fifo_status_t fifo_status;
 
     /* Variables for calculating sum and counting samples for averaging */
-    float acc_x_sum = 0.0f, acc_y_sum = 0.0f, acc_z_sum = 0.0f;
-    float temp_sum = 0.0f;
+    int32_t acc_x_sum = 0, acc_y_sum = 0, acc_z_sum = 0;
+    int32_t temp_sum = 0;
     uint16_t acc_count = 0;
     uint16_t temp_count = 0;
     uint16_t timestamp_count = 0;
@@ -288,45 +267,17 @@ static esp_err_t iis3dwb_hal_read_fifo_data(stmdev_ctx_t *ctx, iis3dwb_hal_data_
 
         /* Determine data type based on tag */
         iis3dwb_fifo_tag_t tag = (iis3dwb_fifo_tag_t)(fifo_entry.tag >> 3);
-        iis3dwb_fs_xl_t full_scale;
-        ESP_ERROR_CHECK(iis3dwb_xl_full_scale_get(ctx, &full_scale));
         switch (tag) {
             case IIS3DWB_XL_TAG: {
                 int16_t ax = (int16_t)(fifo_entry.data[1] << 8 | fifo_entry.data[0]);
                 int16_t ay = (int16_t)(fifo_entry.data[3] << 8 | fifo_entry.data[2]);
                 int16_t az = (int16_t)(fifo_entry.data[5] << 8 | fifo_entry.data[4]);
 
-                /* Accumulate values for averaging later */
-                switch(full_scale){
-                    case IIS3DWB_2g:
-                        acc_x_sum += iis3dwb_from_fs2g_to_mg(ax);
-                        acc_y_sum += iis3dwb_from_fs2g_to_mg(ay);
-                        acc_z_sum += iis3dwb_from_fs2g_to_mg(az);
-                        acc_count++;
-                        break;
-                    case IIS3DWB_4g:
-                        acc_x_sum += iis3dwb_from_fs4g_to_mg(ax);
-                        acc_y_sum += iis3dwb_from_fs4g_to_mg(ay);
-                        acc_z_sum += iis3dwb_from_fs4g_to_mg(az);
-                        acc_count++;
-                        break;
-                    case IIS3DWB_8g:
-                        acc_x_sum += iis3dwb_from_fs8g_to_mg(ax);
-                        acc_y_sum += iis3dwb_from_fs8g_to_mg(ay);
-                        acc_z_sum += iis3dwb_from_fs8g_to_mg(az);
-                        acc_count++;
-                        break;
-                    case IIS3DWB_16g:
-                        acc_x_sum += iis3dwb_from_fs16g_to_mg(ax);
-                        acc_y_sum += iis3dwb_from_fs16g_to_mg(ay);
-                        acc_z_sum += iis3dwb_from_fs16g_to_mg(az);
-                        acc_count++;
-                        break;
-                    default:
-                        ESP_LOGW(TAG, "Sample %u: Unknown full scale setting: %d", i, full_scale);
-                        break;
-                }
-                
+                /* Accumulate raw values for averaging later */
+                acc_x_sum += ax;
+                acc_y_sum += ay;
+                acc_z_sum += az;
+                acc_count++;
                 break;
             }
 
@@ -334,7 +285,7 @@ static esp_err_t iis3dwb_hal_read_fifo_data(stmdev_ctx_t *ctx, iis3dwb_hal_data_
                 int16_t temp_raw = (int16_t)(fifo_entry.data[1] << 8 | fifo_entry.data[0]);
                 
                 /* Accumulate temperature values */
-                temp_sum += iis3dwb_from_lsb_to_celsius(temp_raw);
+                temp_sum += temp_raw;
                 temp_count++;
                 break;
             }
@@ -362,18 +313,18 @@ static esp_err_t iis3dwb_hal_read_fifo_data(stmdev_ctx_t *ctx, iis3dwb_hal_data_
     
     // Process acceleration data
     if (acc_count > 0) {
-        data->x_mg = acc_x_sum / acc_count;
-        data->y_mg = acc_y_sum / acc_count;
-        data->z_mg = acc_z_sum / acc_count;
+        data->x_raw = (int16_t)(acc_x_sum / acc_count);
+        data->y_raw = (int16_t)(acc_y_sum / acc_count);
+        data->z_raw = (int16_t)(acc_z_sum / acc_count);
     } else {
-        data->x_mg = 0; data->y_mg = 0; data->z_mg = 0; // Default if no data
+        data->x_raw = 0; data->y_raw = 0; data->z_raw = 0; // Default if no data
     }
 
     // Process temperature data
     if (temp_count > 0) {
-        data->temperature_degC = temp_sum / temp_count;
+        data->temperature_raw = (int16_t)(temp_sum / temp_count);
     } else {
-        data->temperature_degC = 0; // Default if no data
+        data->temperature_raw = 0; // Default if no data
     }
 
     // Assign last timestamp
@@ -382,11 +333,11 @@ static esp_err_t iis3dwb_hal_read_fifo_data(stmdev_ctx_t *ctx, iis3dwb_hal_data_
     // ESP_LOGI(TAG, "--- Averaged FIFO Result ---");
     // ESP_LOGI(TAG, "Processed %u samples from FIFO", num_samples);
     // if (acc_count > 0) {
-    //     ESP_LOGI(TAG, "Avg Accel [mg]: X=%.2f, Y=%.2f, Z=%.2f (from %u samples)",
-    //              data->x_mg, data->y_mg, data->z_mg, acc_count);
+    //     ESP_LOGI(TAG, "Avg Accel [raw]: X=%d, Y=%d, Z=%d (from %u samples)",
+    //              data->x_raw, data->y_raw, data->z_raw, acc_count);
     // }
     // if (temp_count > 0) {
-    //     ESP_LOGI(TAG, "Avg Temp [degC]: %.2f (from %u samples)", data->temperature_degC, temp_count);
+    //     ESP_LOGI(TAG, "Avg Temp [raw]: %d (from %u samples)", data->temperature_raw, temp_count);
     // }
     // if (last_timestamp_raw != 0) {
     //     ESP_LOGI(TAG, "Timestamp count = %u, Last Timestamp [raw]: %" PRIu32, timestamp_count, last_timestamp_raw);
@@ -42,11 +42,18 @@ typedef struct {
     int16_t z_raw;
 } iis3dwb_sample_t;
 
+// Accelerometer sensitivity per full scale [µg/LSB]; the datasheet values
+// (0.061 / 0.122 / 0.244 / 0.488 mg/LSB) are exact in µg
+#define IIS3DWB_HAL_SENS_2G_UG_LSB      61
+#define IIS3DWB_HAL_SENS_4G_UG_LSB      122
+#define IIS3DWB_HAL_SENS_8G_UG_LSB      244
+#define IIS3DWB_HAL_SENS_16G_UG_LSB     488
+
 typedef struct {
-    float x_mg;                 // Vibration in X axis [mg]
-    float y_mg;                 // Vibration in Y axis [mg]
-    float z_mg;                 // Vibration in Z axis [mg]
-    float temperature_degC;     // Temperature [°C]
+    int16_t x_raw;              // Average of the samples read [LSB]
+    int16_t y_raw;
+    int16_t z_raw;
+    int16_t temperature_raw;    // [LSB], 256 LSB/°C, 0 = 25 °C
     iis3dwb_sample_t *samples;  // Array of raw samples (polling mode)
     uint16_t sample_count;      // Number of samples in array
 #if FIFO_MODE
@@ -5,10 +5,12 @@
 #include "esp_log.h"
 #include "esp_spiffs.h"
 #include "esp_timer.h"
+#include "esp_system.h"
+#include "json_writer.h"
 #include "cJSON.h"
 #include <string.h>
 #include <stdio.h>
-#include <math.h>
+#include <stdlib.h>
 
 static const char *TAG = "WEB_SERVER";
 
@@ -44,6 +46,75 @@ static esp_err_t ws_send_to_all(const char *data, size_t len);
 static void ws_broadcast_task(void *arg);
 static esp_err_t root_handler(httpd_req_t *req);
 
+// Cost of building and sending one JSON response, per endpoint
+typedef enum {
+    API_TIMING_DATA = 0,
+    API_TIMING_STATS,
+    API_TIMING_CONFIG,
+    API_TIMING_COUNT,
+} api_timing_id_t;
+
+typedef struct {
+    uint32_t requests;
+    uint32_t last_us;
+    uint32_t max_us;
+    uint32_t last_bytes;
+} api_timing_t;
+
+static api_timing_t api_timing[API_TIMING_COUNT];
+
+// JSON responses are written through a stack buffer: sent in one piece when
+// the document fits, chunked as the buffer fills otherwise
+typedef struct {
+    httpd_req_t *req;
+    api_timing_t *timing;
+    int64_t start_us;
+    bool chunked;
+} json_resp_t;
+
+static esp_err_t json_resp_flush(const char *data, size_t len, void *ctx)
+{
+    json_resp_t *resp = (json_resp_t *)ctx;
+    resp->chunked = true;
+    return httpd_resp_send_chunk(resp->req, data, len);
+}
+
+static void json_resp_begin(json_resp_t *resp, json_writer_t *w, char *buf, size_t size,
+                            httpd_req_t *req, api_timing_t *timing)
+{
+    resp->req = req;
+    resp->timing = timing;
+    resp->start_us = esp_timer_get_time();
+    resp->chunked = false;
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    json_writer_init(w, buf, size, json_resp_flush, resp);
+}
+
+static esp_err_t json_resp_end(json_resp_t *resp, json_writer_t *w)
+{
+    esp_err_t ret;
+    if (!resp->chunked && w->err == ESP_OK && w->depth == 0) {
+        ret = httpd_resp_send(resp->req, w->buf, w->len);
+    } else {
+        ret = json_writer_finish(w);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "JSON response cut short: %s", esp_err_to_name(ret));
+        }
+        httpd_resp_send_chunk(resp->req, NULL, 0);
+    }
+    
+    api_timing_t *t = resp->timing;
+    uint32_t us = (uint32_t)(esp_timer_get_time() - resp->start_us);
+    t->requests++;
+    t->last_us = us;
+    if (us > t->max_us) {
+        t->max_us = us;
+    }
+    t->last_bytes = w->total;
+    return ret;
+}
+
 // API Data endpoint - returns latest sensor data
 static esp_err_t api_data_handler(httpd_req_t *req)
 {
@@ -58,45 +129,46 @@ static esp_err_t api_data_handler(httpd_req_t *req)
         return ESP_FAIL;
     }
     
-    cJSON *json = cJSON_CreateObject();
-    cJSON_AddNumberToObject(json, "timestamp_us", data.timestamp_us);
-    cJSON *accel_g = cJSON_CreateObject();
-    cJSON_AddNumberToObject(accel_g, "x_g", data.accelerometer.x_g);
-    cJSON_AddNumberToObject(accel_g, "y_g", data.accelerometer.y_g);
-    cJSON_AddNumberToObject(accel_g, "z_g", data.accelerometer.z_g);
-    cJSON_AddNumberToObject(accel_g, "magnitude_g", data.accelerometer.magnitude_g);
-    cJSON_AddItemToObject(json, "accelerometer_g", accel_g);
-
-    const float g_to_ms2 = 9.80665f;
-    cJSON *accel_ms2 = cJSON_CreateObject();
-    cJSON_AddNumberToObject(accel_ms2, "x_ms2", data.accelerometer.x_g * g_to_ms2);
-    cJSON_AddNumberToObject(accel_ms2, "y_ms2", data.accelerometer.y_g * g_to_ms2);
-    cJSON_AddNumberToObject(accel_ms2, "z_ms2", data.accelerometer.z_g * g_to_ms2);
-    cJSON_AddNumberToObject(accel_ms2, "magnitude_ms2", data.accelerometer.magnitude_g * g_to_ms2);
-    cJSON_AddItemToObject(json, "accelerometer_ms2", accel_ms2);
-
-    cJSON *stats = cJSON_CreateObject();
-    cJSON_AddNumberToObject(stats, "samples_read", data.stats.samples_read);
-    cJSON_AddNumberToObject(stats, "batch_interval_us", data.stats.batch_interval_us);
-    cJSON_AddNumberToObject(stats, "samples_per_second", data.stats.samples_per_second);
-    cJSON_AddNumberToObject(stats, "plot_samples_per_second", ws_samples_rate);
-    cJSON_AddNumberToObject(stats, "msg_per_second", ws_msg_rate);
-    cJSON_AddNumberToObject(stats, "websocket_total_messages", ws_total_messages);
-    cJSON_AddItemToObject(json, "stats", stats);
-    
-    char *json_string = cJSON_Print(json);
-    if (json_string != NULL) {
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-        httpd_resp_send(req, json_string, strlen(json_string));
-        free(json_string);
-    } else {
-        httpd_resp_set_status(req, "500 Internal Server Error");
-        httpd_resp_send(req, "JSON generation failed", HTTPD_RESP_USE_STRLEN);
-    }
-    
-    cJSON_Delete(json);
-    return ESP_OK;
+    char buf[API_JSON_CHUNK_SIZE];
+    json_resp_t resp;
+    json_writer_t w;
+    json_resp_begin(&resp, &w, buf, sizeof(buf), req, &api_timing[API_TIMING_DATA]);
+    json_writer_begin_object(&w, NULL);
+    json_writer_uint(&w, "timestamp_us", data.timestamp_us);
+    json_writer_begin_object(&w, "accelerometer_g");
+    json_writer_scaled(&w, "x_g", data.accelerometer.x_ug, 6, 5);
+    json_writer_scaled(&w, "y_g", data.accelerometer.y_ug, 6, 5);
+    json_writer_scaled(&w, "z_g", data.accelerometer.z_ug, 6, 5);
+    json_writer_scaled(&w, "magnitude_g", data.accelerometer.magnitude_ug, 6, 5);
+    json_writer_end_object(&w);
+
+    json_writer_begin_object(&w, "accelerometer_ms2");
+    json_writer_scaled(&w, "x_ms2", imu_ug_to_ums2(data.accelerometer.x_ug), 6, 5);
+    json_writer_scaled(&w, "y_ms2", imu_ug_to_ums2(data.accelerometer.y_ug), 6, 5);
+    json_writer_scaled(&w, "z_ms2", imu_ug_to_ums2(data.accelerometer.z_ug), 6, 5);
+    json_writer_scaled(&w, "magnitude_ms2", imu_ug_to_ums2(data.accelerometer.magnitude_ug), 6, 5);
+    json_writer_end_object(&w);
+
+    json_writer_begin_object(&w, "stats");
+    json_writer_uint(&w, "samples_read", data.stats.samples_read);
+    json_writer_scaled(&w, "batch_interval_us", data.stats.batch_interval_ns, 3, 2);
+    json_writer_scaled(&w, "samples_per_second", data.stats.samples_per_second, 0, 2);
+    json_writer_float(&w, "plot_samples_per_second", ws_samples_rate, 2);
+    json_writer_float(&w, "msg_per_second", ws_msg_rate, 2);
+    json_writer_uint(&w, "websocket_total_messages", ws_total_messages);
+    json_writer_end_object(&w);
+    json_writer_end_object(&w);
+    return json_resp_end(&resp, &w);
+}
+
+static void write_api_timing(json_writer_t *w, const char *key, const api_timing_t *t)
+{
+    json_writer_begin_object(w, key);
+    json_writer_uint(w, "requests", t->requests);
+    json_writer_uint(w, "last_us", t->last_us);
+    json_writer_uint(w, "max_us", t->max_us);
+    json_writer_uint(w, "last_bytes", t->last_bytes);
+    json_writer_end_object(w);
 }
 
 // API Stats endpoint - returns buffer statistics
@@ -113,34 +185,45 @@ static esp_err_t api_stats_handler(httpd_req_t *req)
         return ESP_FAIL;
     }
     
-    cJSON *json = cJSON_CreateObject();
-    cJSON_AddNumberToObject(json, "total_samples", stats.total_samples);
-    cJSON_AddNumberToObject(json, "dropped_samples", stats.dropped_samples);
-    cJSON_AddNumberToObject(json, "buffer_overflows", stats.buffer_overflows);
-    cJSON_AddNumberToObject(json, "last_timestamp_us", stats.last_timestamp_us);
-    cJSON_AddNumberToObject(json, "avg_processing_time_us", stats.avg_processing_time_us);
-    cJSON_AddNumberToObject(json, "buffer_count", data_buffer_get_count());
-    cJSON_AddBoolToObject(json, "buffer_full", data_buffer_is_full());
-    cJSON_AddBoolToObject(json, "buffer_empty", data_buffer_is_empty());
+    char buf[API_JSON_CHUNK_SIZE];
+    json_resp_t resp;
+    json_writer_t w;
+    json_resp_begin(&resp, &w, buf, sizeof(buf), req, &api_timing[API_TIMING_STATS]);
+    json_writer_begin_object(&w, NULL);
+    json_writer_uint(&w, "total_samples", stats.total_samples);
+    json_writer_uint(&w, "dropped_samples", stats.dropped_samples);
+    json_writer_uint(&w, "buffer_overflows", stats.buffer_overflows);
+    json_writer_uint(&w, "last_timestamp_us", stats.last_timestamp_us);
+    json_writer_scaled(&w, "avg_processing_time_us", stats.avg_processing_time_ns, 3, 2);
+    json_writer_uint(&w, "buffer_count", data_buffer_get_count());
+    json_writer_bool(&w, "buffer_full", data_buffer_is_full());
+    json_writer_bool(&w, "buffer_empty", data_buffer_is_empty());
     /* imu_odr_hz intentionally omitted from API to avoid confusion with actual plotted points/sec */
-    cJSON_AddNumberToObject(json, "imu_fifo_watermark", imu_manager_get_fifo_watermark());
-    cJSON_AddNumberToObject(json, "ws_msg_per_sec", ws_msg_rate);
-    cJSON_AddNumberToObject(json, "ws_samples_per_sec", ws_samples_rate);
-    cJSON_AddNumberToObject(json, "ws_total_messages", ws_total_messages);
-    
-    char *json_string = cJSON_Print(json);
-    if (json_string != NULL) {
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-        httpd_resp_send(req, json_string, strlen(json_string));
-        free(json_string);
-    } else {
-        httpd_resp_set_status(req, "500 Internal Server Error");
-        httpd_resp_send(req, "JSON generation failed", HTTPD_RESP_USE_STRLEN);
-    }
-    
-    cJSON_Delete(json);
-    return ESP_OK;
+    json_writer_uint(&w, "imu_fifo_watermark", imu_manager_get_fifo_watermark());
+    json_writer_float(&w, "ws_msg_per_sec", ws_msg_rate, 2);
+    json_writer_float(&w, "ws_samples_per_sec", ws_samples_rate, 2);
+    json_writer_uint(&w, "ws_total_messages", ws_total_messages);
+    
+    // Raw counts to fixed point, per sample
+    imu_convert_stats_t conv;
+    imu_manager_get_convert_stats(&conv);
+    json_writer_begin_object(&w, "imu_convert");
+    json_writer_uint(&w, "samples", conv.samples);
+    json_writer_uint(&w, "last_cycles", conv.last_cycles);
+    json_writer_uint(&w, "cycles_per_sample", conv.cycles_per_sample);
+    json_writer_end_object(&w);
+    
+    // Cost of the JSON endpoints themselves, socket send included
+    json_writer_begin_object(&w, "http");
+    write_api_timing(&w, "data", &api_timing[API_TIMING_DATA]);
+    write_api_timing(&w, "stats", &api_timing[API_TIMING_STATS]);
+    write_api_timing(&w, "config", &api_timing[API_TIMING_CONFIG]);
+    json_writer_uint(&w, "free_heap", esp_get_free_heap_size());
+    json_writer_uint(&w, "min_free_heap", esp_get_minimum_free_heap_size());
+    json_writer_end_object(&w);
+    
+    json_writer_end_object(&w);
+    return json_resp_end(&resp, &w);
 }
 
 // API Config endpoint - handles configuration changes
@@ -148,6 +231,10 @@ static esp_err_t api_config_handler(httpd_req_t *req)
 {
     ESP_LOGI(TAG, "API Config request");
     
+    char out[API_JSON_CHUNK_SIZE];
+    json_resp_t resp;
+    json_writer_t w;
+    
     if (req->method == HTTP_POST) {
         char buf[128];
         int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
@@ -163,14 +250,15 @@ static esp_err_t api_config_handler(httpd_req_t *req)
             return ESP_FAIL;
         }
         
-        cJSON *response = cJSON_CreateObject();
+        json_resp_begin(&resp, &w, out, sizeof(out), req, &api_timing[API_TIMING_CONFIG]);
+        json_writer_begin_object(&w, NULL);
         bool changed = false;
         
         // Handle pause/resume
         cJSON *pause = cJSON_GetObjectItem(json, "pause");
         if (pause && cJSON_IsBool(pause)) {
             ws_streaming_paused = cJSON_IsTrue(pause);
-            cJSON_AddBoolToObject(response, "paused", ws_streaming_paused);
+            json_writer_bool(&w, "paused", ws_streaming_paused);
             ESP_LOGI(TAG, "Streaming %s", ws_streaming_paused ? "PAUSED" : "RESUMED");
             changed = true;
         }
@@ -182,50 +270,38 @@ static esp_err_t api_config_handler(httpd_req_t *req)
             if (fs_code <= 3) {
                 esp_err_t err = imu_manager_set_full_scale(fs_code);
                 if (err == ESP_OK) {
-                    cJSON_AddNumberToObject(response, "full_scale", fs_code);
+                    json_writer_uint(&w, "full_scale", fs_code);
                     changed = true;
                 } else {
-                    cJSON_AddStringToObject(response, "error", "Failed to set full scale");
+                    json_writer_string(&w, "error", "Failed to set full scale");
                 }
             } else {
-                cJSON_AddStringToObject(response, "error", "Invalid full scale value");
+                json_writer_string(&w, "error", "Invalid full scale value");
             }
         }
         
-        if (!changed) {
-            cJSON_AddStringToObject(response, "status", "no_changes");
-        } else {
-            cJSON_AddStringToObject(response, "status", "ok");
-        }
-        
-        char *json_string = cJSON_Print(response);
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-        httpd_resp_send(req, json_string, strlen(json_string));
-        
-        free(json_string);
-        cJSON_Delete(response);
+        json_writer_string(&w, "status", changed ? "ok" : "no_changes");
+        json_writer_end_object(&w);
         cJSON_Delete(json);
-        return ESP_OK;
+        return json_resp_end(&resp, &w);
     }
 
     // GET request - return current config
-    cJSON *json = cJSON_CreateObject();
-    cJSON_AddNumberToObject(json, "imu_fifo_watermark", imu_manager_get_fifo_watermark());
-    cJSON_AddNumberToObject(json, "full_scale", imu_manager_get_full_scale());
-    cJSON_AddBoolToObject(json, "paused", ws_streaming_paused);
+    json_resp_begin(&resp, &w, out, sizeof(out), req, &api_timing[API_TIMING_CONFIG]);
+    json_writer_begin_object(&w, NULL);
+    json_writer_uint(&w, "imu_fifo_watermark", imu_manager_get_fifo_watermark());
+    json_writer_uint(&w, "full_scale", imu_manager_get_full_scale());
+    json_writer_bool(&w, "paused", ws_streaming_paused);
+    json_writer_end_object(&w);
+    return json_resp_end(&resp, &w);
+}
 
-    char *json_string = cJSON_Print(json);
-    if (json_string != NULL) {
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-        httpd_resp_send(req, json_string, strlen(json_string));
-        free(json_string);
-    }
-    
-    cJSON_Delete(json);
-    return ESP_OK;
-}// API Download endpoint - returns data in various formats
+static esp_err_t download_send_chunk(const char *data, size_t len, void *ctx)
+{
+    return httpd_resp_send_chunk((httpd_req_t *)ctx, data, len);
+}
+
+// API Download endpoint - streams the whole buffer (or ?max=N oldest records) in chunks
 static esp_err_t api_download_handler(httpd_req_t *req)
 {
     ESP_LOGI(TAG, "API Download request");
@@ -236,34 +312,37 @@ static esp_err_t api_download_handler(httpd_req_t *req)
         char *buf = malloc(buf_len);
         if (httpd_req_get_url_query_str(req, buf, buf_len) == ESP_OK) {
             char format[16];
+            char param[16];
+            uint32_t max_samples = 0;
+            if (httpd_query_key_value(buf, "max", param, sizeof(param)) == ESP_OK) {
+                max_samples = strtoul(param, NULL, 10);
+            }
             if (httpd_query_key_value(buf, "format", format, sizeof(format)) == ESP_OK) {
+                data_buffer_export_format_t fmt = DATA_BUFFER_EXPORT_CSV;
                 if (strcmp(format, "csv") == 0) {
-                    // Return CSV data
-                    char csv_buffer[8192];
-                    esp_err_t ret = data_buffer_export_csv(csv_buffer, sizeof(csv_buffer), 100);
-                    if (ret == ESP_OK) {
-                        httpd_resp_set_type(req, "text/csv");
-                        httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=imu_data.csv");
-                        httpd_resp_send(req, csv_buffer, strlen(csv_buffer));
-                    } else {
-                        httpd_resp_set_status(req, "500 Internal Server Error");
-                        httpd_resp_send(req, "Failed to export CSV", HTTPD_RESP_USE_STRLEN);
-                    }
+                    httpd_resp_set_type(req, "text/csv");
+                    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=imu_data.csv");
                 } else if (strcmp(format, "json") == 0) {
-                    // Return JSON data
-                    char json_buffer[8192];
-                    esp_err_t ret = data_buffer_export_json(json_buffer, sizeof(json_buffer), 100);
-                    if (ret == ESP_OK) {
-                        httpd_resp_set_type(req, "application/json");
-                        httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=imu_data.json");
-                        httpd_resp_send(req, json_buffer, strlen(json_buffer));
-                    } else {
-                        httpd_resp_set_status(req, "500 Internal Server Error");
-                        httpd_resp_send(req, "Failed to export JSON", HTTPD_RESP_USE_STRLEN);
-                    }
+                    fmt = DATA_BUFFER_EXPORT_JSON;
+                    httpd_resp_set_type(req, "application/json");
+                    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=imu_data.json");
                 } else {
                     httpd_resp_set_status(req, "400 Bad Request");
                     httpd_resp_send(req, "Unsupported format", HTTPD_RESP_USE_STRLEN);
+                    free(buf);
+                    return ESP_OK;
+                }
+                // Headers go out with the first chunk; a failure after that can
+                // only end the response early
+                esp_err_t ret = data_buffer_export_stream(fmt, max_samples, download_send_chunk, req);
+                if (ret == ESP_ERR_NO_MEM) {
+                    httpd_resp_set_status(req, "503 Service Unavailable");
+                    httpd_resp_send(req, "Out of memory", HTTPD_RESP_USE_STRLEN);
+                } else {
+                    if (ret != ESP_OK) {
+                        ESP_LOGW(TAG, "Download aborted: %s", esp_err_to_name(ret));
+                    }
+                    httpd_resp_send_chunk(req, NULL, 0);
                 }
             } else {
                 httpd_resp_set_status(req, "400 Bad Request");
@@ -550,9 +629,9 @@ esp_err_t web_server_broadcast_data(const char *data, size_t len)
 static void ws_broadcast_task(void *arg)
 {
     (void)arg;
-    static float temp_x[WS_RECENT_MAX_SAMPLES];
-    static float temp_y[WS_RECENT_MAX_SAMPLES];
-    static float temp_z[WS_RECENT_MAX_SAMPLES];
+    static int16_t temp_x[WS_RECENT_MAX_SAMPLES];
+    static int16_t temp_y[WS_RECENT_MAX_SAMPLES];
+    static int16_t temp_z[WS_RECENT_MAX_SAMPLES];
     static char json_buf[4096];
 
     uint32_t window_msgs = 0;
@@ -560,6 +639,8 @@ static void ws_broadcast_task(void *arg)
     uint64_t window_start_us = esp_timer_get_time();
     uint16_t last_batch_samples = 0;
     uint64_t last_timestamp = 0;
+    uint32_t ws_encode_us = 0;
+    uint32_t ws_encode_errors = 0;
 
     TickType_t last_wake = xTaskGetTickCount();
     TickType_t broadcast_period = pdMS_TO_TICKS(10);
@@ -573,12 +654,14 @@ static void ws_broadcast_task(void *arg)
         uint64_t batch_ts = 0;
         uint16_t fifo_level = 0;  // Not used in polling mode, but kept for API compatibility
         uint32_t seq_id = 0;
+        int32_t sens_ug = 0;
         
         led_status_data_pulse_start();
         
         uint16_t fetched = imu_manager_copy_recent_samples(temp_x, temp_y, temp_z,
                                                            WS_RECENT_MAX_SAMPLES,
-                                                           &batch_ts, &fifo_level, &seq_id);
+                                                           &batch_ts, &fifo_level, &seq_id,
+                                                           &sens_ug);
         
         if (fetched == 0) {
             led_status_data_pulse_end();
@@ -592,7 +675,7 @@ static void ws_broadcast_task(void *arg)
         // Get sensor stats
         imu_data_t d;
         bool have_stats = (data_buffer_get_latest(&d) == ESP_OK) && d.accelerometer.valid;
-        float sensor_sps = have_stats ? d.stats.samples_per_second : 0.0f;
+        uint32_t sensor_sps = have_stats ? d.stats.samples_per_second : 0;
 
         // Update window-based rate calculation
         uint64_t now_us = esp_timer_get_time();
@@ -622,47 +705,52 @@ static void ws_broadcast_task(void *arg)
             window_msgs = 0;
             window_samples = 0;
             window_start_us = now_us;
-            ESP_LOGI(TAG, "WS metrics: %.2f msg/s, %.0f points/s", 
-                     ws_msg_rate, ws_samples_rate);
+            ESP_LOGI(TAG, "WS metrics: %.2f msg/s, %.0f points/s, encode %lu us, %lu too large", 
+                     ws_msg_rate, ws_samples_rate, ws_encode_us, ws_encode_errors);
         }
 
         // Build JSON payload - send fetched samples directly (no ring buffer)
-        float last_chunk_x = 0.0f;
-        float last_chunk_y = 0.0f;
-        float last_chunk_z = 0.0f;
-
-        int n = snprintf(json_buf, sizeof(json_buf), "{\"t\":%llu,\"chunks\":{\"x\":[",
-                         (unsigned long long)(last_timestamp ? last_timestamp : now_us));
-
-        for (uint16_t i = 0; i < fetched && n > 0 && n < (int)sizeof(json_buf); ++i) {
-            last_chunk_x = temp_x[i];
-            n += snprintf(json_buf + n, sizeof(json_buf) - n, i ? ",%.5f" : "%.5f", temp_x[i]);
-        }
-        n += snprintf(json_buf + n, sizeof(json_buf) - n, "],\"y\":[");
-        for (uint16_t i = 0; i < fetched && n > 0 && n < (int)sizeof(json_buf); ++i) {
-            last_chunk_y = temp_y[i];
-            n += snprintf(json_buf + n, sizeof(json_buf) - n, i ? ",%.5f" : "%.5f", temp_y[i]);
-        }
-        n += snprintf(json_buf + n, sizeof(json_buf) - n, "],\"z\":[");
-        for (uint16_t i = 0; i < fetched && n > 0 && n < (int)sizeof(json_buf); ++i) {
-            last_chunk_z = temp_z[i];
-            n += snprintf(json_buf + n, sizeof(json_buf) - n, i ? ",%.5f" : "%.5f", temp_z[i]);
+        // Raw counts scaled to µg here and printed in g: no float per sample
+        const int16_t *axes[3] = { temp_x, temp_y, temp_z };
+        static const char *const axis_keys[3] = { "x", "y", "z" };
+
+        int64_t encode_start_us = esp_timer_get_time();
+        json_writer_t w;
+        json_writer_init(&w, json_buf, sizeof(json_buf), NULL, NULL);
+        json_writer_begin_object(&w, NULL);
+        json_writer_uint(&w, "t", last_timestamp ? last_timestamp : now_us);
+        json_writer_begin_object(&w, "chunks");
+        for (int axis = 0; axis < 3; axis++) {
+            json_writer_begin_array(&w, axis_keys[axis]);
+            for (uint16_t i = 0; i < fetched; ++i) {
+                json_writer_scaled(&w, NULL, (int32_t)axes[axis][i] * sens_ug, 6, 5);
+            }
+            json_writer_end_array(&w);
         }
-
-        float chunk_mag = sqrtf(last_chunk_x * last_chunk_x +
-                                 last_chunk_y * last_chunk_y +
-                                 last_chunk_z * last_chunk_z);
-
-        n += snprintf(json_buf + n, sizeof(json_buf) - n,
-                  "]},\"mag\":%.5f,\"s\":{\"batch\":%u,"
-                          "\"sps\":%.2f,\"pps\":%.2f,\"mps\":%.2f,\"chunk\":%u}}",
-                  chunk_mag, last_batch_samples,
-                  sensor_sps, ws_samples_rate, ws_msg_rate, fetched);
-
-        // Send WebSocket message
-        if (!ws_streaming_paused && n > 0 && n < (int)sizeof(json_buf)) {
-            ws_send_to_all(json_buf, (size_t)n);
-            ws_total_messages++;
+        json_writer_end_object(&w);
+
+        uint32_t chunk_mag = imu_manager_magnitude_lsb(temp_x[fetched - 1],
+                                                       temp_y[fetched - 1],
+                                                       temp_z[fetched - 1]);
+        json_writer_scaled(&w, "mag", (int32_t)chunk_mag * sens_ug, 6, 5);
+        json_writer_begin_object(&w, "s");
+        json_writer_uint(&w, "batch", last_batch_samples);
+        json_writer_scaled(&w, "sps", sensor_sps, 0, 2);
+        json_writer_float(&w, "pps", ws_samples_rate, 2);
+        json_writer_float(&w, "mps", ws_msg_rate, 2);
+        json_writer_uint(&w, "chunk", fetched);
+        json_writer_end_object(&w);
+        json_writer_end_object(&w);
+        ws_encode_us = (uint32_t)(esp_timer_get_time() - encode_start_us);
+
+        // Send WebSocket message; a batch too large for the buffer is dropped whole
+        if (json_writer_finish(&w) == ESP_OK) {
+            if (!ws_streaming_paused) {
+                ws_send_to_all(json_buf, w.len);
+                ws_total_messages++;
+            }
+        } else {
+            ws_encode_errors++;
         }
         
         led_status_data_pulse_end();
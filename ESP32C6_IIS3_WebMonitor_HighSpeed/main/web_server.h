@@ -21,6 +21,9 @@
 #define API_CONFIG_PATH "/api/config"
 #define API_DOWNLOAD_PATH "/api/download"
 
+// Stack buffer of the JSON responses; larger documents go out chunked
+#define API_JSON_CHUNK_SIZE 1024
+
 // WebSocket endpoints
 #define WS_DATA_PATH "/ws/data"
 #define WS_CONTROL_PATH "/ws/control"
@@ -0,0 +1,77 @@
+#ifndef AHRS_H
+#define AHRS_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Mahony AHRS fed with the fixed-point ICM45686 samples (ug, mdps) at the
+// sensor ODR, corrected by the magnetometer when a recent vector is available.
+// The update runs in Q30 integer math: the ESP32-C6 has no FPU.
+
+// Default filter gains
+#define AHRS_DEFAULT_KP             0.5f
+#define AHRS_DEFAULT_KI             0.0f
+// Start-up: gain multiplier and duration for fast initial convergence
+#define AHRS_INIT_GAIN              10
+#define AHRS_INIT_TIME_MS           2000
+// Magnetometer vectors older than this are ignored (6-axis update)
+#define AHRS_MAG_TIMEOUT_US         100000
+
+// Where the published orientation comes from
+typedef enum {
+    AHRS_SOURCE_HOST = 0,       // ahrs_update() on the ESP32-C6
+    AHRS_SOURCE_EDMP_GAF,       // ICM45686 eDMP game rotation vector, forwarded as is
+    AHRS_SOURCE_COUNT,
+} ahrs_source_t;
+
+typedef struct {
+    uint32_t sample_rate_hz;    // Rate of ahrs_update() calls
+    float kp;
+    float ki;
+} ahrs_config_t;
+
+typedef struct {
+    uint64_t timestamp_us;
+    float q[4];                 // w, x, y, z
+    float roll_deg;
+    float pitch_deg;
+    float yaw_deg;
+    bool mag_used;              // Last update was corrected by the magnetometer
+} ahrs_output_t;
+
+// Cost of ahrs_update(), measured on the device
+typedef struct {
+    ahrs_source_t source;
+    uint32_t sample_rate_hz;
+    uint32_t updates;
+    uint32_t mag_updates;
+    uint32_t last_cycles;
+    uint32_t avg_cycles;
+    uint32_t max_cycles;
+    uint32_t avg_ns;
+    uint32_t cpu_load_permille; // avg_ns at sample_rate_hz
+} ahrs_stats_t;
+
+esp_err_t ahrs_init(const ahrs_config_t *config);
+esp_err_t ahrs_set_sample_rate(uint32_t sample_rate_hz);
+void ahrs_reset(void);
+
+// Magnetometer vector in the ICM45686 body frame, any unit; the latest one is used
+void ahrs_set_mag(uint64_t timestamp_us, const int32_t mag[3]);
+void ahrs_update(uint64_t timestamp_us, const int32_t accel_ug[3], const int32_t gyro_mdps[3]);
+
+// Selects the published orientation. ahrs_update() is a no-op while an external
+// source is active; costs are kept per source so both can be compared.
+esp_err_t ahrs_set_source(ahrs_source_t source, uint32_t sample_rate_hz);
+ahrs_source_t ahrs_get_source(void);
+// Orientation computed elsewhere (Q30 w, x, y, z); cycles is what forwarding it cost the host
+void ahrs_publish_external(uint64_t timestamp_us, const int32_t q30[4], uint32_t cycles);
+
+// ESP_ERR_NOT_FOUND before the first update
+esp_err_t ahrs_get_output(ahrs_output_t *out);
+// Stats of the active source, or of any source
+void ahrs_get_stats(ahrs_stats_t *stats);
+void ahrs_get_source_stats(ahrs_source_t source, ahrs_stats_t *stats);
+
+#endif // AHRS_H
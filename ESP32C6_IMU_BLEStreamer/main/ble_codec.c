@@ -0,0 +1,155 @@
+#include "ble_codec.h"
+#include <string.h>
+
+// Differences wrap modulo 2^32, so 32-bit channels need no wider type
+static inline uint32_t zigzag(uint32_t diff)
+{
+    return (diff << 1) ^ (uint32_t)((int32_t)diff >> 31);
+}
+
+static inline uint8_t bit_width(uint32_t v)
+{
+    return v ? (uint8_t)(32 - __builtin_clz(v)) : 0;
+}
+
+size_t ble_codec_varint_len(uint32_t v)
+{
+    size_t n = 1;
+    while (v >= 0x80) {
+        v >>= 7;
+        n++;
+    }
+    return n;
+}
+
+uint8_t *ble_codec_put_varint(uint8_t *p, uint32_t v)
+{
+    while (v >= 0x80) {
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+void ble_codec_block_begin(ble_codec_block_t *b, uint8_t channels, uint8_t record_len, const int32_t *ref)
+{
+    memset(b, 0, sizeof(*b));
+    b->channels = channels;
+    b->record_len = record_len;
+    if (ref != NULL) {
+        memcpy(b->ref, ref, channels * sizeof(int32_t));
+    }
+    memcpy(b->last, b->ref, sizeof(b->last));
+}
+
+void ble_codec_block_add(ble_codec_block_t *b, uint32_t dt_us, const int32_t *values)
+{
+    b->raw_bytes += ble_codec_varint_len(dt_us) + b->record_len;
+
+    if (b->count <= 1) {
+        b->head_bytes += ble_codec_varint_len(dt_us);
+    } else {
+        uint32_t zz = zigzag(dt_us - b->dt_last);
+        if (zz > b->dt_zz_max) {
+            b->dt_zz_max = zz;
+        }
+    }
+    for (int c = 0; c < b->channels; c++) {
+        uint32_t zz = zigzag((uint32_t)values[c] - (uint32_t)b->last[c]);
+        if (b->count == 0) {
+            b->head_bytes += ble_codec_varint_len(zz);
+        } else if (zz > b->zz_max[c]) {
+            b->zz_max[c] = zz;
+        }
+        b->last[c] = values[c];
+    }
+    b->dt_last = dt_us;
+    b->count++;
+}
+
+size_t ble_codec_raw_size(const ble_codec_block_t *b)
+{
+    return b->raw_bytes;
+}
+
+size_t ble_codec_packed_size(const ble_codec_block_t *b)
+{
+    if (b->count == 0) {
+        return 0;
+    }
+    uint32_t bits = 0;
+    for (int c = 0; c < b->channels; c++) {
+        bits += bit_width(b->zz_max[c]);
+    }
+    bits *= b->count - 1;
+    if (b->count > 2) {
+        bits += bit_width(b->dt_zz_max) * (b->count - 2);
+    }
+    return b->head_bytes + 1 + b->channels + (bits + 7) / 8;
+}
+
+// LSB-first bit stream; a value is at most 32 bits on top of < 8 pending
+typedef struct {
+    uint8_t *p;
+    uint64_t acc;
+    uint8_t bits;
+} bit_writer_t;
+
+static inline void put_bits(bit_writer_t *w, uint32_t v, uint8_t width)
+{
+    w->acc |= (uint64_t)v << w->bits;
+    w->bits += width;
+    while (w->bits >= 8) {
+        *w->p++ = (uint8_t)w->acc;
+        w->acc >>= 8;
+        w->bits -= 8;
+    }
+}
+
+uint8_t *ble_codec_write_packed(const ble_codec_block_t *b, const uint32_t *dt_us,
+                                const int32_t *values, uint8_t *out)
+{
+    uint32_t n = b->count;
+    uint8_t ch = b->channels;
+    if (n == 0) {
+        return out;
+    }
+
+    uint8_t *p = ble_codec_put_varint(out, dt_us[0]);
+    if (n > 1) {
+        p = ble_codec_put_varint(p, dt_us[1]);
+    }
+    for (int c = 0; c < ch; c++) {
+        p = ble_codec_put_varint(p, zigzag((uint32_t)values[c] - (uint32_t)b->ref[c]));
+    }
+
+    uint8_t dt_width = bit_width(b->dt_zz_max);
+    uint8_t width[BLE_CODEC_MAX_CHANNELS];
+    *p++ = dt_width;
+    for (int c = 0; c < ch; c++) {
+        width[c] = bit_width(b->zz_max[c]);
+        *p++ = width[c];
+    }
+
+    bit_writer_t w = { .p = p };
+    if (dt_width) {
+        for (uint32_t i = 2; i < n; i++) {
+            put_bits(&w, zigzag(dt_us[i] - dt_us[i - 1]), dt_width);
+        }
+    }
+    for (int c = 0; c < ch; c++) {
+        if (width[c] == 0) {
+            continue;
+        }
+        const int32_t *v = values + c;
+        for (uint32_t i = 1; i < n; i++) {
+            put_bits(&w, zigzag((uint32_t)v[i * BLE_CODEC_MAX_CHANNELS] -
+                                (uint32_t)v[(i - 1) * BLE_CODEC_MAX_CHANNELS]), width[c]);
+        }
+    }
+    if (w.bits) {
+        *w.p++ = (uint8_t)w.acc;
+    }
+    return w.p;
+}
@@ -0,0 +1,56 @@
+#ifndef BLE_CODEC_H
+#define BLE_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Lossless sample block codec for the BLE frames: per-channel first-order
+// delta, zigzag, and bit packing at the widest delta of the block. A block is
+// sized record by record while the frame is filled, then written in one pass.
+//
+// Packed block body (after [type | BLE_CODEC_PACKED][count][record_len]):
+//   varint dt_0, varint dt_1 (count >= 2)
+//   varint zigzag(v_0 - ref) per channel
+//   bit width of the dt run, then of each channel run (1 byte each)
+//   dt run:      zigzag(dt_i - dt_i-1), i = 2..count-1
+//   channel run: zigzag(v_i - v_i-1),   i = 1..count-1, one run per channel
+//   Runs are one LSB-first bit stream, padded to a byte at the end.
+//
+// ref is the last record of the stream in the previous frame, or 0 in a
+// keyframe, so a receiver can start decoding at any keyframe.
+
+#define BLE_CODEC_PACKED            0x80    // Block type flag
+#define BLE_CODEC_MAX_CHANNELS      6
+#define BLE_CODEC_VARINT_MAX        5
+
+typedef struct {
+    uint8_t channels;
+    uint8_t record_len;
+    uint32_t count;
+    int32_t ref[BLE_CODEC_MAX_CHANNELS];
+    int32_t last[BLE_CODEC_MAX_CHANNELS];
+    uint32_t dt_last;
+    uint32_t dt_zz_max;
+    uint32_t zz_max[BLE_CODEC_MAX_CHANNELS];
+    size_t head_bytes;          // Varints of the packed layout
+    size_t raw_bytes;           // Body of the plain layout
+} ble_codec_block_t;
+
+size_t ble_codec_varint_len(uint32_t v);
+uint8_t *ble_codec_put_varint(uint8_t *p, uint32_t v);
+
+// record_len: bytes of one plain record (channels x 2 or 4); ref NULL for 0
+void ble_codec_block_begin(ble_codec_block_t *b, uint8_t channels, uint8_t record_len, const int32_t *ref);
+void ble_codec_block_add(ble_codec_block_t *b, uint32_t dt_us, const int32_t *values);
+
+// Body bytes of either layout for the records added so far
+size_t ble_codec_raw_size(const ble_codec_block_t *b);
+size_t ble_codec_packed_size(const ble_codec_block_t *b);
+
+// Writes the packed body of the records added to b; dt_us[count] and
+// values[count][BLE_CODEC_MAX_CHANNELS] are the same ones, in order.
+// Returns the end.
+uint8_t *ble_codec_write_packed(const ble_codec_block_t *b, const uint32_t *dt_us,
+                                const int32_t *values, uint8_t *out);
+
+#endif // BLE_CODEC_H
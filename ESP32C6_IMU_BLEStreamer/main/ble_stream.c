@@ -7,6 +7,8 @@
 #include "esp_bt_main.h"
 #include "esp_gatt_common_api.h"
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
 #include <string.h>
 #include "led_status.h"
 
@@ -15,14 +17,66 @@ static const char *TAG = "BLE_STREAM";
 static esp_gatt_if_t s_gatts_if = 0;
 static uint16_t s_conn_id = 0xFFFF;
 static uint16_t s_service_handle = 0;
-static uint16_t s_char_handle = 0;
-static bool s_notify_enabled = false;
+static uint16_t s_channel_handle[BLE_STREAM_CHANNELS];    // Data characteristic values
+static uint16_t s_status_handle = 0;
+static uint16_t s_control_handle = 0;
+static uint8_t s_notify_channels = 0;       // Bit per channel with notifications on
+static bool s_status_notify_enabled = false;
+
+// A head-of-queue frame the stack refused this often is dropped
+#define TX_SEND_ATTEMPTS_MAX    3
+
+// Link layer sizes: the notification payload travels as ATT (3-byte header)
+// in an L2CAP PDU (4-byte header), split into LL packets of tx_octets
+#define ATT_MTU_DEFAULT         23
+#define ATT_MTU_LOCAL           247
+#define ATT_NOTIFY_HEADER       3
+#define L2CAP_HEADER            4
+#define LL_OCTETS_DEFAULT       27
+#define LL_OCTETS_MAX           251
+// Fragmented frames: [index | last << 7][FRAGMENT_MARKER] + piece. A whole
+// frame starts with its uint16 length, whose high byte is 0 (<= 244 bytes).
+#define FRAGMENT_HEADER         2
+#define FRAGMENT_MARKER         0xFF
+#define FRAGMENT_LAST           0x80
+
+typedef struct {
+    uint16_t len;
+    uint8_t channel;
+    uint8_t data[BLE_STREAM_FRAME_MAX];
+} tx_frame_t;
+
+static QueueHandle_t s_tx_queue = NULL;
+static volatile bool s_congested = false;
+static uint8_t s_tx_attempts = 0;
+static ble_stream_tx_stats_t s_tx_stats;
+static tx_frame_t s_tx_head;            // Producer task only
+static uint16_t s_tx_offset = 0;        // Bytes of s_tx_head already sent as fragments
+static uint16_t s_tx_piece = 0;
+static uint8_t s_tx_index = 0;
+static uint8_t s_tx_fragment[ATT_MTU_LOCAL - ATT_NOTIFY_HEADER];
+
+// Resets the BLE task asks for; the producer applies them at its next call so
+// that the queue head and the counters are never reset under the pump
+#define TX_RESET_QUEUE          (1 << 0)
+#define TX_RESET_STATS          (1 << 1)
+static portMUX_TYPE s_tx_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile uint8_t s_tx_reset_pending = 0;
+
+// Negotiated per connection
+static uint16_t s_mtu = ATT_MTU_DEFAULT;
+static uint16_t s_ll_tx_octets = LL_OCTETS_DEFAULT;
+static uint16_t s_notify_payload = ATT_MTU_DEFAULT - ATT_NOTIFY_HEADER;
+static uint16_t s_frame_size = BLE_STREAM_FRAME_MIN;
 
 static const uint16_t primary_service_uuid = ESP_GATT_UUID_PRI_SERVICE;
 static const uint16_t character_declaration_uuid = ESP_GATT_UUID_CHAR_DECLARE;
 static const uint16_t character_client_config_uuid = ESP_GATT_UUID_CHAR_CLIENT_CONFIG;
 static const uint8_t char_prop_notify = ESP_GATT_CHAR_PROP_BIT_NOTIFY;
+static const uint8_t char_prop_read_notify = ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_NOTIFY;
+static const uint8_t char_prop_write = ESP_GATT_CHAR_PROP_BIT_WRITE | ESP_GATT_CHAR_PROP_BIT_WRITE_NR;
 static const uint8_t notify_ccc[2] = {0x00, 0x00};
+static const uint8_t status_ccc[2] = {0x00, 0x00};
 
 #if CONFIG_BT_BLE_42_FEATURES_SUPPORTED
 static const esp_ble_adv_params_t s_legacy_adv_params = {
@@ -74,8 +128,138 @@ static esp_gatts_attr_db_t gatt_db[] = {
     // CCC Descriptor
     [3] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_client_config_uuid, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
                                   sizeof(notify_ccc), sizeof(notify_ccc), (uint8_t *)notify_ccc}},
+
+    // Status Characteristic Declaration
+    [4] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ,
+                                  1, 1, (uint8_t *)&char_prop_read_notify}},
+
+    // Status Characteristic Value (Read + Notify), set by ble_stream_set_status()
+    [5] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){BLE_STREAM_CHAR_STATUS_UUID}, ESP_GATT_PERM_READ,
+                                  BLE_STREAM_STATUS_MAX, 0, NULL}},
+
+    // Status CCC Descriptor
+    [6] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_client_config_uuid, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+                                  sizeof(status_ccc), sizeof(status_ccc), (uint8_t *)status_ccc}},
+
+    // Control Characteristic Declaration
+    [7] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ,
+                                  1, 1, (uint8_t *)&char_prop_write}},
+
+    // Control Characteristic Value (Write), handed to imu_ble_on_control()
+    [8] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){BLE_STREAM_CHAR_CONTROL_UUID}, ESP_GATT_PERM_WRITE,
+                                  BLE_STREAM_CONTROL_MAX, 0, NULL}},
+
+    // Per-sensor data characteristics (channels 1-4): declaration, value (Notify), CCC
+    [9] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ,
+                                  1, 1, (uint8_t *)&char_prop_notify}},
+    [10] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){BLE_STREAM_CHAR_IIS3DWB_UUID}, ESP_GATT_PERM_READ,
+                                  BLE_STREAM_FRAME_MAX, 0, NULL}},
+    [11] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_client_config_uuid, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+                                  sizeof(notify_ccc), sizeof(notify_ccc), (uint8_t *)notify_ccc}},
+
+    [12] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ,
+                                  1, 1, (uint8_t *)&char_prop_notify}},
+    [13] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){BLE_STREAM_CHAR_ICM45686_UUID}, ESP_GATT_PERM_READ,
+                                  BLE_STREAM_FRAME_MAX, 0, NULL}},
+    [14] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_client_config_uuid, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+                                  sizeof(notify_ccc), sizeof(notify_ccc), (uint8_t *)notify_ccc}},
+
+    [15] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ,
+                                  1, 1, (uint8_t *)&char_prop_notify}},
+    [16] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){BLE_STREAM_CHAR_IIS2MDC_UUID}, ESP_GATT_PERM_READ,
+                                  BLE_STREAM_FRAME_MAX, 0, NULL}},
+    [17] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_client_config_uuid, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+                                  sizeof(notify_ccc), sizeof(notify_ccc), (uint8_t *)notify_ccc}},
+
+    [18] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ,
+                                  1, 1, (uint8_t *)&char_prop_notify}},
+    [19] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){BLE_STREAM_CHAR_SCL3300_UUID}, ESP_GATT_PERM_READ,
+                                  BLE_STREAM_FRAME_MAX, 0, NULL}},
+    [20] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_client_config_uuid, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+                                  sizeof(notify_ccc), sizeof(notify_ccc), (uint8_t *)notify_ccc}},
 };
 
+#define GATT_DB_LEN     (sizeof(gatt_db) / sizeof(gatt_db[0]))
+// Value of the channel 1 characteristic; the others follow every 3 attributes
+#define GATT_SENSOR_CHAR_VALUE  10
+
+// Channel whose CCC descriptor the handle is, -1 for none
+static int ccc_channel(uint16_t handle)
+{
+    for (int ch = 0; ch < BLE_STREAM_CHANNELS; ch++) {
+        if (s_channel_handle[ch] != 0 && handle == s_channel_handle[ch] + 1) {
+            return ch;
+        }
+    }
+    return -1;
+}
+
+// Queued frames are lost with the connection or the subscription. BLE task:
+// the producer drops them at its next enqueue / pump.
+static void tx_reset(uint8_t what)
+{
+    portENTER_CRITICAL(&s_tx_lock);
+    s_tx_reset_pending |= what;
+    portEXIT_CRITICAL(&s_tx_lock);
+    s_congested = false;
+}
+
+// Producer task: applies the resets requested since its last call
+static void tx_apply_reset(void)
+{
+    if (s_tx_reset_pending == 0) {
+        return;
+    }
+    portENTER_CRITICAL(&s_tx_lock);
+    uint8_t what = s_tx_reset_pending;
+    s_tx_reset_pending = 0;
+    portEXIT_CRITICAL(&s_tx_lock);
+    
+    if (what & TX_RESET_QUEUE) {
+        if (s_tx_queue) {
+            s_tx_stats.frames_dropped += uxQueueMessagesWaiting(s_tx_queue);
+            xQueueReset(s_tx_queue);
+        }
+        s_tx_attempts = 0;
+        s_tx_offset = 0;
+    }
+    // After the queue: the frames dropped belong to the previous connection
+    if (what & TX_RESET_STATS) {
+        memset(&s_tx_stats, 0, sizeof(s_tx_stats));
+    }
+}
+
+// Largest notification payload that fills whole LL packets: at most MTU - 3
+// bytes, cut back so that payload + 7 header bytes (ATT, L2CAP) is a multiple
+// of the LL data length. Below one LL packet the payload is a single packet anyway.
+static uint16_t compute_notify_payload(uint16_t mtu, uint16_t ll_octets)
+{
+    uint16_t payload = mtu - ATT_NOTIFY_HEADER;
+    uint16_t packets = (payload + ATT_NOTIFY_HEADER + L2CAP_HEADER) / ll_octets;
+    if (packets > 0) {
+        payload = packets * ll_octets - ATT_NOTIFY_HEADER - L2CAP_HEADER;
+    }
+    return payload;
+}
+
+// One notification per frame when it holds BLE_STREAM_FRAME_MIN bytes, else
+// the frames are cut into as many aligned fragments as that minimum needs
+static void update_frame_size(void)
+{
+    s_notify_payload = compute_notify_payload(s_mtu, s_ll_tx_octets);
+    if (s_notify_payload >= BLE_STREAM_FRAME_MIN) {
+        s_frame_size = (s_notify_payload > BLE_STREAM_FRAME_MAX) ? BLE_STREAM_FRAME_MAX : s_notify_payload;
+        ESP_LOGI(TAG, "Frame %u B in %u LL packet(s) (MTU %u, LL %u B)", s_frame_size,
+                 (s_frame_size + ATT_NOTIFY_HEADER + L2CAP_HEADER + s_ll_tx_octets - 1) / s_ll_tx_octets,
+                 s_mtu, s_ll_tx_octets);
+    } else {
+        uint16_t piece = s_notify_payload - FRAGMENT_HEADER;
+        uint16_t pieces = (BLE_STREAM_FRAME_MIN + piece - 1) / piece;
+        s_frame_size = pieces * piece;
+        ESP_LOGI(TAG, "Frame %u B in %u fragments (MTU %u, LL %u B)", s_frame_size, pieces, s_mtu, s_ll_tx_octets);
+    }
+}
+
 static void gap_cb(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
 {
     switch (event) {
@@ -103,6 +287,27 @@ static void gap_cb(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
         ESP_LOGI(TAG, "Ext adv stop complete: status=%d", param->ext_adv_stop.status);
         break;
 #endif
+    case ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT:
+        ESP_LOGI(TAG, "Conn params: status=%d int=%d latency=%d timeout=%d",
+                 param->update_conn_params.status,
+                 param->update_conn_params.conn_int,
+                 param->update_conn_params.latency,
+                 param->update_conn_params.timeout);
+        if (param->update_conn_params.status == ESP_BT_STATUS_SUCCESS) {
+            imu_ble_on_conn_params(param->update_conn_params.conn_int * 1250U);     // 1.25 ms units
+        }
+        break;
+    case ESP_GAP_BLE_SET_PKT_LENGTH_COMPLETE_EVT:
+        ESP_LOGI(TAG, "Data length: status=%d tx=%d rx=%d",
+                 param->pkt_data_length_cmpl.status,
+                 param->pkt_data_length_cmpl.params.tx_len,
+                 param->pkt_data_length_cmpl.params.rx_len);
+        if (param->pkt_data_length_cmpl.status == ESP_BT_STATUS_SUCCESS &&
+            param->pkt_data_length_cmpl.params.tx_len >= LL_OCTETS_DEFAULT) {
+            s_ll_tx_octets = param->pkt_data_length_cmpl.params.tx_len;
+            update_frame_size();
+        }
+        break;
     case ESP_GAP_BLE_PHY_UPDATE_COMPLETE_EVT:
         ESP_LOGI(TAG, "PHY updated: status=%d tx=%d rx=%d",
                  param->phy_update.status,
@@ -144,18 +349,29 @@ static void gatts_cb(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
             }
 #endif
         }
-        esp_ble_gatts_create_attr_tab(gatt_db, gatts_if, 4, 0);
+        esp_ble_gatts_create_attr_tab(gatt_db, gatts_if, GATT_DB_LEN, 0);
         break;
     case ESP_GATTS_CREAT_ATTR_TAB_EVT:
         if (param->add_attr_tab.status == ESP_GATT_OK) {
             s_service_handle = param->add_attr_tab.handles[0];
-            s_char_handle = param->add_attr_tab.handles[2];
+            s_channel_handle[0] = param->add_attr_tab.handles[2];
+            for (int ch = 1; ch < BLE_STREAM_CHANNELS; ch++) {
+                s_channel_handle[ch] = param->add_attr_tab.handles[GATT_SENSOR_CHAR_VALUE + 3 * (ch - 1)];
+            }
+            s_status_handle = param->add_attr_tab.handles[5];
+            s_control_handle = param->add_attr_tab.handles[8];
             esp_ble_gatts_start_service(s_service_handle);
         }
         break;
     case ESP_GATTS_CONNECT_EVT:
         s_conn_id = param->connect.conn_id;
+        tx_reset(TX_RESET_QUEUE | TX_RESET_STATS);
+        // Until the central exchanges MTU / data length
+        s_mtu = ATT_MTU_DEFAULT;
+        s_ll_tx_octets = LL_OCTETS_DEFAULT;
+        update_frame_size();
         imu_ble_on_ble_connect();
+        imu_ble_on_conn_params(param->connect.conn_params.interval * 1250U);
         esp_ble_conn_update_params_t conn_params = {
             .latency = 0,
             .max_int = 6,   // ~7.5 ms
@@ -172,11 +388,23 @@ static void gatts_cb(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
                                       ESP_BLE_GAP_PHY_2M_PREF_MASK,
                                       ESP_BLE_GAP_PHY_OPTIONS_NO_PREF);
         // MTU request
-        esp_ble_gatt_set_local_mtu(247);
+        esp_ble_gatt_set_local_mtu(ATT_MTU_LOCAL);
+        // Data length extension: one LL packet per 244-byte notification
+        esp_ble_gap_set_pkt_data_len(param->connect.remote_bda, LL_OCTETS_MAX);
+        break;
+    case ESP_GATTS_MTU_EVT:
+        ESP_LOGI(TAG, "MTU %d", param->mtu.mtu);
+        s_mtu = (param->mtu.mtu < ATT_MTU_DEFAULT) ? ATT_MTU_DEFAULT : param->mtu.mtu;
+        if (s_mtu > ATT_MTU_LOCAL) {
+            s_mtu = ATT_MTU_LOCAL;
+        }
+        update_frame_size();
         break;
     case ESP_GATTS_DISCONNECT_EVT:
         s_conn_id = 0xFFFF;
-        s_notify_enabled = false;
+        s_notify_channels = 0;
+        s_status_notify_enabled = false;
+        tx_reset(TX_RESET_QUEUE);
         imu_ble_on_ble_disconnect();
 #if CONFIG_BT_BLE_42_FEATURES_SUPPORTED
         esp_ble_gap_start_advertising((esp_ble_adv_params_t *)&s_legacy_adv_params);
@@ -191,14 +419,39 @@ static void gatts_cb(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
         break;
     case ESP_GATTS_CONF_EVT:
         break;
-    case ESP_GATTS_WRITE_EVT:
+    case ESP_GATTS_CONGEST_EVT:
+        // The controller ran out of buffers: hold the queue until it drains
+        s_congested = param->congest.congested;
+        if (s_congested) {
+            s_tx_stats.congestion_events++;
+        } else {
+            imu_ble_on_tx_ready();
+        }
+        break;
+    case ESP_GATTS_WRITE_EVT: {
         // CCC written?
-        if (param->write.handle == s_char_handle + 1 && param->write.len >= 2) {
-            s_notify_enabled = (param->write.value[0] & 0x01);
-            ESP_LOGI(TAG, "Notify %s", s_notify_enabled ? "EN" : "DIS");
-            imu_ble_on_notifications_changed(s_notify_enabled);
+        int channel = ccc_channel(param->write.handle);
+        if (channel >= 0 && param->write.len >= 2) {
+            bool enabled = (param->write.value[0] & 0x01);
+            if (enabled) {
+                s_notify_channels |= 1 << channel;
+            } else {
+                s_notify_channels &= ~(1 << channel);
+            }
+            ESP_LOGI(TAG, "Notify %d %s (channels 0x%02X)", channel, enabled ? "EN" : "DIS", s_notify_channels);
+            // Frames of a single unsubscribed channel are dropped by the pump
+            if (s_notify_channels == 0) {
+                tx_reset(TX_RESET_QUEUE);
+            }
+            imu_ble_on_notifications_changed(s_notify_channels);
+        } else if (param->write.handle == s_status_handle + 1 && param->write.len >= 2) {
+            s_status_notify_enabled = (param->write.value[0] & 0x01);
+            ESP_LOGI(TAG, "Status notify %s", s_status_notify_enabled ? "EN" : "DIS");
+        } else if (param->write.handle == s_control_handle && !param->write.is_prep) {
+            imu_ble_on_control(param->write.value, param->write.len);
         }
         break;
+    }
     default:
         break;
     }
@@ -213,6 +466,11 @@ esp_err_t ble_stream_init(void)
     ESP_ERROR_CHECK(esp_bluedroid_init());
     ESP_ERROR_CHECK(esp_bluedroid_enable());
 
+    s_tx_queue = xQueueCreate(BLE_STREAM_TX_QUEUE_LEN, sizeof(tx_frame_t));
+    if (s_tx_queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
     ESP_ERROR_CHECK(esp_ble_gap_register_callback(gap_cb));
     ESP_ERROR_CHECK(esp_ble_gatts_register_callback(gatts_cb));
     ESP_ERROR_CHECK(esp_ble_gatts_app_register(0x42));
@@ -229,9 +487,158 @@ esp_err_t ble_stream_start(void)
     return ESP_OK;
 }
 
-esp_err_t ble_stream_notify(const uint8_t *data, uint16_t len)
+esp_err_t ble_stream_enqueue(uint8_t channel, const uint8_t *data, uint16_t len)
+{
+    if (channel >= BLE_STREAM_CHANNELS) return ESP_ERR_INVALID_ARG;
+    if (!(s_notify_channels & (1 << channel)) || s_conn_id == 0xFFFF || s_channel_handle[channel] == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (len == 0 || len > BLE_STREAM_FRAME_MAX) return ESP_ERR_INVALID_SIZE;
+    tx_apply_reset();
+
+    static tx_frame_t frame;
+    frame.len = len;
+    frame.channel = channel;
+    memcpy(frame.data, data, len);
+    if (xQueueSend(s_tx_queue, &frame, 0) != pdTRUE) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    uint8_t depth = (uint8_t)uxQueueMessagesWaiting(s_tx_queue);
+    if (depth > s_tx_stats.queue_max_depth) {
+        s_tx_stats.queue_max_depth = depth;
+    }
+    return ESP_OK;
+}
+
+uint32_t ble_stream_tx_free(void)
+{
+    tx_apply_reset();
+    return s_tx_queue ? (uint32_t)uxQueueSpacesAvailable(s_tx_queue) : 0;
+}
+
+uint32_t ble_stream_tx_pump(uint32_t max_notifies)
+{
+    uint32_t sent = 0;
+
+    tx_apply_reset();
+    while (sent < max_notifies && !s_congested && s_notify_channels && s_conn_id != 0xFFFF) {
+        if (s_tx_offset == 0 && xQueuePeek(s_tx_queue, &s_tx_head, 0) != pdTRUE) {
+            break;
+        }
+        // The central unsubscribed from the frame's characteristic meanwhile
+        if (!(s_notify_channels & (1 << s_tx_head.channel))) {
+            xQueueReceive(s_tx_queue, &s_tx_head, 0);
+            s_tx_stats.frames_dropped++;
+            s_tx_attempts = 0;
+            s_tx_offset = 0;
+            continue;
+        }
+
+        // Frames longer than the negotiated payload go out in fragments
+        uint8_t *data = s_tx_head.data;
+        uint16_t len = s_tx_head.len;
+        uint16_t piece = len;
+        if (s_tx_offset > 0 || len > s_notify_payload) {
+            // Piece size is fixed per frame in case the MTU changes mid-frame
+            if (s_tx_offset == 0) {
+                s_tx_piece = s_notify_payload - FRAGMENT_HEADER;
+                s_tx_index = 0;
+            }
+            piece = len - s_tx_offset;
+            if (piece > s_tx_piece) {
+                piece = s_tx_piece;
+            }
+            s_tx_fragment[0] = s_tx_index | ((s_tx_offset + piece >= len) ? FRAGMENT_LAST : 0);
+            s_tx_fragment[1] = FRAGMENT_MARKER;
+            memcpy(&s_tx_fragment[FRAGMENT_HEADER], data + s_tx_offset, piece);
+            data = s_tx_fragment;
+            len = piece + FRAGMENT_HEADER;
+        }
+
+        esp_err_t r = esp_ble_gatts_send_indicate(s_gatts_if, s_conn_id, s_channel_handle[s_tx_head.channel],
+                                                  len, data, false);
+        if (r != ESP_OK) {
+            // Kept for the next pump unless the stack keeps refusing it
+            if (++s_tx_attempts >= TX_SEND_ATTEMPTS_MAX) {
+                xQueueReceive(s_tx_queue, &s_tx_head, 0);
+                s_tx_stats.frames_dropped++;
+                s_tx_attempts = 0;
+                s_tx_offset = 0;
+                ESP_LOGW(TAG, "Frame dropped after %d send failures: %s", TX_SEND_ATTEMPTS_MAX, esp_err_to_name(r));
+            }
+            break;
+        }
+        s_tx_attempts = 0;
+        s_tx_stats.notifies_sent++;
+        sent++;
+
+        if (data == s_tx_fragment) {
+            s_tx_offset += piece;
+            s_tx_index++;
+            if (s_tx_offset < s_tx_head.len) {
+                continue;
+            }
+            s_tx_offset = 0;
+        }
+        xQueueReceive(s_tx_queue, &s_tx_head, 0);
+        s_tx_stats.frames_sent++;
+        s_tx_stats.bytes_sent += s_tx_head.len;
+    }
+    return sent;
+}
+
+uint16_t ble_stream_get_frame_size(void)
 {
-    if (!s_notify_enabled || s_conn_id == 0xFFFF || s_char_handle == 0) return ESP_ERR_INVALID_STATE;
-    esp_err_t r = esp_ble_gatts_send_indicate(s_gatts_if, s_conn_id, s_char_handle, len, (uint8_t *)data, false);
-    return r;
+    return s_frame_size;
+}
+
+bool ble_stream_is_congested(void)
+{
+    return s_congested;
+}
+
+void ble_stream_get_tx_stats(ble_stream_tx_stats_t *stats)
+{
+    *stats = s_tx_stats;
+    stats->queue_depth = s_tx_queue ? (uint8_t)uxQueueMessagesWaiting(s_tx_queue) : 0;
+    stats->congested = s_congested;
+    stats->mtu = s_mtu;
+    stats->ll_tx_octets = s_ll_tx_octets;
+    stats->frame_size = s_frame_size;
+}
+
+esp_err_t ble_stream_set_status(const uint8_t *data, uint16_t len)
+{
+    if (s_status_handle == 0) return ESP_ERR_INVALID_STATE;
+    if (len > BLE_STREAM_STATUS_MAX) return ESP_ERR_INVALID_SIZE;
+
+    esp_err_t r = esp_ble_gatts_set_attr_value(s_status_handle, len, data);
+    if (r != ESP_OK || !s_status_notify_enabled || s_conn_id == 0xFFFF || s_congested) {
+        return r;
+    }
+
+    uint16_t payload = s_notify_payload;
+    if (len <= payload) {
+        return esp_ble_gatts_send_indicate(s_gatts_if, s_conn_id, s_status_handle, len, (uint8_t *)data, false);
+    }
+
+    // Below its size (MTU 23) the status is cut like the frames; its flags
+    // byte never equals FRAGMENT_MARKER. A status missing a piece is dropped
+    // by the client and replaced by the next one.
+    uint8_t fragment[BLE_STREAM_STATUS_MAX];
+    uint16_t piece = payload - FRAGMENT_HEADER;
+    uint8_t index = 0;
+    for (uint16_t offset = 0; offset < len; offset += piece, index++) {
+        uint16_t n = (len - offset < piece) ? len - offset : piece;
+        fragment[0] = index | ((offset + n >= len) ? FRAGMENT_LAST : 0);
+        fragment[1] = FRAGMENT_MARKER;
+        memcpy(&fragment[FRAGMENT_HEADER], data + offset, n);
+        r = esp_ble_gatts_send_indicate(s_gatts_if, s_conn_id, s_status_handle, n + FRAGMENT_HEADER,
+                                        fragment, false);
+        if (r != ESP_OK) {
+            return r;
+        }
+    }
+    return ESP_OK;
 }
@@ -2,14 +2,66 @@
 #define BLE_STREAM_H
 
 #include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
 
 // GATT parameters
 #define BLE_STREAM_SERVICE_UUID        0x1815  // example UUID (custom in production)
 #define BLE_STREAM_CHAR_DATA_UUID      0x2A58  // placeholder
+#define BLE_STREAM_CHAR_STATUS_UUID    0x2A59  // placeholder (read + notify)
+#define BLE_STREAM_CHAR_CONTROL_UUID   0x2A5A  // placeholder (write, commands to imu_ble_on_control())
+// One notify characteristic per sensor stream next to the multiplexed 0x2A58
+#define BLE_STREAM_CHAR_IIS3DWB_UUID   0x2A5B  // placeholder
+#define BLE_STREAM_CHAR_ICM45686_UUID  0x2A5C  // placeholder
+#define BLE_STREAM_CHAR_IIS2MDC_UUID   0x2A5D  // placeholder
+#define BLE_STREAM_CHAR_SCL3300_UUID   0x2A5E  // placeholder
 #define BLE_STREAM_DEVICE_NAME         "IMU-BLE"
 
+#define BLE_STREAM_FRAME_MAX           244     // MTU 247 minus the 3-byte notification header
+// Smaller payloads (e.g. MTU 23) carry frames of at least this size in fragments
+#define BLE_STREAM_FRAME_MIN           100
+#define BLE_STREAM_STATUS_MAX          80
+#define BLE_STREAM_CONTROL_MAX         20      // Longest command that fits the default MTU
+// Frames waiting for the controller; a full queue pushes back on the producer
+#define BLE_STREAM_TX_QUEUE_LEN        8
+// Data characteristics: 0 the multiplexed 0x2A58, then one per sensor stream
+// in the order of the UUIDs above
+#define BLE_STREAM_CHANNELS            5
+
+typedef struct {
+    uint32_t frames_sent;
+    uint32_t notifies_sent;         // Frames plus extra fragments
+    uint32_t bytes_sent;
+    uint32_t frames_dropped;        // Discarded from the queue (send failures, disconnect)
+    uint32_t congestion_events;
+    uint8_t queue_depth;
+    uint8_t queue_max_depth;        // High-water mark since connect
+    bool congested;
+    uint16_t mtu;                   // Negotiated ATT MTU
+    uint16_t ll_tx_octets;          // Negotiated LL data length (TX)
+    uint16_t frame_size;            // From ble_stream_get_frame_size()
+} ble_stream_tx_stats_t;
+
 esp_err_t ble_stream_init(void);
 esp_err_t ble_stream_start(void);
-esp_err_t ble_stream_notify(const uint8_t *data, uint16_t len);
+
+// Flow-controlled data path. Frames are queued by the producer and handed to
+// the stack by ble_stream_tx_pump(), which stops while the link reports
+// congestion (ESP_GATTS_CONGEST_EVT) and resumes once it clears; the producer
+// is told through imu_ble_on_tx_ready(). Single producer task only.
+// channel: data characteristic the frame is notified on, which must be subscribed
+esp_err_t ble_stream_enqueue(uint8_t channel, const uint8_t *data, uint16_t len);
+uint32_t ble_stream_tx_free(void);
+// Sends up to max_notifies notifications from the queue, returns how many went
+// out. Frames longer than the negotiated payload are sent in fragments.
+uint32_t ble_stream_tx_pump(uint32_t max_notifies);
+// Frame length that fills whole LL packets for the negotiated MTU and data length
+uint16_t ble_stream_get_frame_size(void);
+bool ble_stream_is_congested(void);
+// Counters since connect
+void ble_stream_get_tx_stats(ble_stream_tx_stats_t *stats);
+
+// Value of the status characteristic; notified when the central subscribed
+esp_err_t ble_stream_set_status(const uint8_t *data, uint16_t len);
 
 #endif // BLE_STREAM_H
@@ -1,25 +1,66 @@
 #include "imu_ble.h"
 #include "ble_stream.h"
+#include "ble_codec.h"
 #include "imu_manager.h"
+#include "ahrs.h"
 #include "led_status.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "esp_cpu.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 
 #include <math.h>
 #include <limits.h>
+#include <stddef.h>
 #include <string.h>
 
 static const char *TAG = "IMU_BLE";
-static const uint8_t FRAME_VERSION = 1;
+static const uint8_t FRAME_VERSION = 2;
+
+// A frame is the header followed by one block per sample stream:
+//   [type:1][count:1][record_len:1] + count x { dt_us: LEB128 varint, record }
+// The header timestamp is the oldest sample in the frame; dt_us of a block's
+// first record is relative to it, every further dt_us to the previous record.
+// With the delta codec a block is bit-packed instead (type | BLE_CODEC_PACKED,
+// see ble_codec.h) whenever that is smaller.
+#define BLE_FRAME_MAX           BLE_STREAM_FRAME_MAX    // Actual size: ble_stream_get_frame_size()
+#define BLOCK_HEADER_BYTES      3
+#define VARINT_MAX_BYTES        BLE_CODEC_VARINT_MAX
+// Records of one stream per frame: packed, a quiet 3-axis record takes ~3 bytes
+#define BATCH_MAX_RECORDS       64
+// Packed blocks refer to the stream's last record in the previous frame, except
+// in keyframes, where a receiver that lost a frame picks up again
+#define KEYFRAME_INTERVAL_DEFAULT 16
+// Frames kept for resend requests (~31 KB): about 3.5 s of the default sensor
+// set with the delta codec, 1.5 s without
+#define RETAIN_FRAMES           128
+#define RESEND_QUEUE_LEN        4
+#define CONFIG_QUEUE_LEN        8
+// Frames queued per connection interval, adapted to what the link takes
+#define FRAMES_PER_EVENT_MIN    1
+#define FRAMES_PER_EVENT_START  4
+#define FRAMES_PER_EVENT_MAX    BLE_STREAM_TX_QUEUE_LEN
+#define ADAPT_RAISE_INTERVALS   16
+// Default connection interval until the central reports its own (7.5 ms)
+#define CONN_INTERVAL_DEFAULT_US 7500
+#define STATS_LOG_INTERVAL_US   5000000
+#define STATUS_INTERVAL_US      1000000
+
+// Producer wake-up reasons (task notification bits)
+#define PRODUCER_EVT_INTERVAL   (1 << 0)    // Drain timer, once per connection interval
+#define PRODUCER_EVT_TX_READY   (1 << 1)    // Link congestion cleared
+#define PRODUCER_EVT_RESTART    (1 << 2)    // Central subscribed or disconnected
+#define PRODUCER_EVT_DISCONNECT (1 << 3)    // Resend requests of the old central are void
 
 static imu_ble_config_t s_cfg;
 static TaskHandle_t s_producer_task = NULL;
-static uint32_t s_frame_seq = 0;
+static esp_timer_handle_t s_drain_timer = NULL;
+static uint32_t s_conn_interval_us = CONN_INTERVAL_DEFAULT_US;
 static uint32_t s_last_error_log_ms = 0;
 static bool s_connected = false;
-static bool s_notifications_ready = false;
+static uint8_t s_subscribed = 0;            // Channels with notifications on, from the BLE task
 
 typedef struct __attribute__((packed)) {
     uint16_t frame_len;
@@ -40,8 +81,200 @@ enum {
     BLE_SENSOR_SCL_ANGLE  = 1 << 6,
     BLE_SENSOR_SCL_ACCEL  = 1 << 7,
     BLE_SENSOR_SCL_TEMP   = 1 << 8,
+    BLE_SENSOR_AHRS       = 1 << 9,
+};
+
+enum {
+    BLE_FRAME_FLAG_ICM_HIRES = 1 << 0,  // ICM accel/gyro sent as 32-bit block 0x16
+    BLE_FRAME_FLAG_KEYFRAME  = 1 << 1,  // Packed blocks start from 0, not the previous frame
+    BLE_FRAME_FLAG_RESENT    = 1 << 2,  // Sent again on request, out of sequence order
+};
+
+// Control characteristic commands: [opcode:1][arguments, little-endian]. The
+// CONTROL_SET_* ones are applied between two frames, and the next frame is a
+// keyframe. Streams are numbered in frame order: 0 IIS3DWB, 1 ICM45686,
+// 2 IIS2MDC, 3 SCL3300; [stream] arguments may be left out for all streams.
+enum {
+    CONTROL_RESEND          = 0x01, // first_seq:u32, count:u16, [channel:u8] - send retained frames again
+    CONTROL_SET_STREAMS     = 0x02, // mask:u8 - bit per stream, bit 4 the AHRS block
+    CONTROL_SET_RATE        = 0x03, // stream:u8, rate_hz:u16 - sensor ODR / poll rate
+    CONTROL_SET_BATCH       = 0x04, // records:u8, [stream:u8] - most records of the stream in a frame (1-64)
+    CONTROL_SET_CODEC       = 0x05, // delta:u8, keyframe_interval:u8 (0: default)
+    CONTROL_SET_INTERVAL    = 0x06, // packet_interval_ms:u16, [stream:u8] - latency bound (>= 10)
+};
+#define CONTROL_STREAM_AHRS     (1 << 4)
+#define PACKET_INTERVAL_MIN_MS  10
+
+// Block types. The temperature blocks hold the newest temperature of their
+// stream and 0x42 the newest orientation, one record each.
+enum {
+    BLOCK_IIS3_ACCEL        = 0x01,     // x, y, z: int16, 1 g = 16384
+    BLOCK_ICM_TEMP          = 0x12,     // int16, 0.01 °C
+    BLOCK_ICM_6AXIS         = 0x15,     // accel x, y, z (1 g = 16384), gyro x, y, z (1 dps = 131.072): int16
+    BLOCK_ICM_6AXIS_HIRES   = 0x16,     // accel x, y, z (ug), gyro x, y, z (mdps): int32
+    BLOCK_IIS2_MAG          = 0x20,     // x, y, z: int16, mG
+    BLOCK_IIS2_TEMP         = 0x21,     // int16, 0.01 °C
+    BLOCK_SCL_TEMP          = 0x32,     // int16, 0.01 °C
+    BLOCK_SCL_INCL          = 0x33,     // angle x, y, z (0.01°), accel x, y, z (1 g = 16384): int16
+    BLOCK_AHRS              = 0x42,     // quaternion w, x, y, z (Q14), roll, pitch, yaw (0.01°): int16
+};
+
+// ICM45686 record bytes per sample (without dt)
+#define ICM_RECORD_BYTES_16BIT  12
+#define ICM_RECORD_BYTES_HIRES  24
+
+// One sample stream of the imu_manager and its read position. Every sample
+// type starts with its uint64_t timestamp_us.
+typedef struct {
+    uint8_t sensor_id;
+    bool enabled;
+    sensor_stream_t *stream;
+    uint32_t cursor;
+    // Frame being built
+    uint8_t *buf;               // BATCH_MAX_RECORDS samples of stream->elem_size
+    uint32_t start;             // Stream sequence of buf[0]
+    uint32_t pending;
+    uint32_t taken;
+    uint64_t last_us;           // Timestamp of the last record taken
+    uint8_t type;               // Block type of the frame
+    ble_codec_block_t codec;    // Size of the records taken, plain and packed
+    uint32_t dt[BATCH_MAX_RECORDS];
+    int32_t values[BATCH_MAX_RECORDS * BLE_CODEC_MAX_CHANNELS];
+    // Last record sent, the reference of the next packed block
+    uint8_t ref_type;           // 0: none
+    int32_t ref[BLE_CODEC_MAX_CHANNELS];
+    // Data characteristic and send policy
+    uint8_t channel;            // CHANNEL_NONE while neither characteristic is subscribed
+    uint32_t batch_records;     // A frame with this many records is sent at once
+    uint16_t interval_ms;       // Latency bound: longest a sample waits for a full frame
+} batch_source_t;
+
+enum { SRC_IIS3DWB = 0, SRC_ICM45686, SRC_IIS2MDC, SRC_SCL3300, SRC_COUNT };
+
+// A stream goes out on its own characteristic (channel = stream + 1) while that
+// is subscribed, multiplexed with the others on channel 0 otherwise. Every
+// channel has its own frame sequence; keyframes and the delta codec references
+// start over whenever a stream changes channel.
+#define CHANNEL_MUX             0
+#define CHANNEL_NONE            0xFF
+#define SOURCE_CHANNEL(src)     ((src) + 1)
+
+typedef struct {
+    uint32_t sequence;
+    bool keyframe_pending;
+} frame_channel_t;
+
+static frame_channel_t s_channels[BLE_STREAM_CHANNELS];
+static uint8_t s_routed = 0;                // Subscription the source channels follow, producer only
+static uint8_t s_rr_channel = 0;            // Last channel served by fill_queue()
+
+static uint8_t s_accel_buf[BATCH_MAX_RECORDS * sizeof(imu_accel_sample_t)];
+static uint8_t s_imu_buf[BATCH_MAX_RECORDS * sizeof(imu_6axis_sample_t)];
+static uint8_t s_mag_buf[BATCH_MAX_RECORDS * sizeof(imu_mag_sample_t)];
+static uint8_t s_incl_buf[BATCH_MAX_RECORDS * sizeof(imu_incl_sample_t)];
+
+static batch_source_t s_sources[SRC_COUNT] = {
+    [SRC_IIS3DWB]  = { .sensor_id = SENSOR_ACCELEROMETER, .buf = s_accel_buf },
+    [SRC_ICM45686] = { .sensor_id = SENSOR_IMU_6AXIS, .buf = s_imu_buf },
+    [SRC_IIS2MDC]  = { .sensor_id = SENSOR_MAGNETOMETER, .buf = s_mag_buf },
+    [SRC_SCL3300]  = { .sensor_id = SENSOR_INCLINOMETER, .buf = s_incl_buf },
 };
 
+// Throughput since the last stats line
+typedef struct {
+    uint32_t frames;
+    uint32_t bytes;
+    uint32_t records[SRC_COUNT];
+    uint32_t lost[SRC_COUNT];   // Overwritten in the stream before they were sent
+    uint32_t plain_bytes;       // The frames' size without the delta codec
+    uint32_t channel_frames[BLE_STREAM_CHANNELS];
+    uint32_t builds;
+    uint64_t build_cycles;
+    uint64_t since_us;
+} stream_stats_t;
+
+static stream_stats_t s_stats;
+static uint32_t s_samples_lost_total = 0;   // Since the stream (re)started
+
+// The last RETAIN_FRAMES sent frames of all channels, oldest overwritten first,
+// kept across stream restarts: the sequences continue, so a central that
+// reconnects can still ask for the frames lost with the connection
+typedef struct {
+    uint32_t sequence;
+    uint8_t channel;
+    uint16_t len;               // 0: empty
+    uint8_t data[BLE_FRAME_MAX];
+} retained_frame_t;
+
+typedef struct {
+    uint32_t first;
+    uint32_t count;
+    uint8_t channel;
+} resend_request_t;
+
+static retained_frame_t s_retained[RETAIN_FRAMES];
+static uint32_t s_retain_next = 0;
+static QueueHandle_t s_resend_queue = NULL;     // From imu_ble_on_control()
+static resend_request_t s_resend;               // Being served, producer task only
+static uint32_t s_frames_resent_total = 0;      // Since the stream (re)started
+static uint32_t s_resend_missed_total = 0;      // Requested but no longer retained
+
+// Configuration commands from imu_ble_on_control(), for the producer
+typedef struct {
+    uint8_t len;
+    uint8_t data[BLE_STREAM_CONTROL_MAX];
+} config_command_t;
+
+static QueueHandle_t s_config_queue = NULL;
+
+static uint8_t s_keyframe_interval = KEYFRAME_INTERVAL_DEFAULT;
+static uint32_t s_batch_records = BATCH_MAX_RECORDS;    // Last set for all streams
+static uint32_t s_frames_per_event = FRAMES_PER_EVENT_START;
+static uint32_t s_full_intervals = 0;
+static uint32_t s_congestion_seen = 0;
+
+// Status characteristic value (little-endian)
+#define STATUS_VERSION          5
+#define STATUS_FLAG_CONGESTED   (1 << 0)
+
+typedef struct __attribute__((packed)) {
+    uint8_t  version;
+    uint8_t  flags;
+    uint8_t  queue_depth;           // Frames waiting for the controller
+    uint8_t  queue_max_depth;       // High-water mark since connect
+    uint8_t  frames_per_event;      // Current budget per connection interval
+    uint8_t  reserved;
+    uint16_t notifies_per_interval; // Measured over the last second, x100
+    uint32_t throughput_bps;        // Frame bytes/s sent over the last second
+    uint32_t conn_interval_us;
+    uint32_t frames_sent;           // Counters since connect
+    uint32_t frames_dropped;
+    uint32_t samples_lost;          // Overwritten in the sensor streams before they were sent
+    uint32_t congestion_events;
+    uint16_t mtu;                   // Negotiated ATT MTU
+    uint16_t ll_tx_octets;          // Negotiated LL data length
+    uint16_t frame_size;            // Frame bytes per LL packet chain (fragmented above MTU - 3)
+    uint32_t frames_resent;         // Version 3: resend requests served since the stream started
+    uint32_t resend_missed;         // Requested frames that were no longer retained
+    uint8_t  streams;               // Version 4: configuration in effect, as CONTROL_SET_STREAMS
+    uint8_t  batch_records;         // Last set for all streams
+    uint8_t  codec;                 // Bit 0: delta codec
+    uint8_t  keyframe_interval;
+    uint16_t packet_interval_ms;    // Last set for all streams
+    uint16_t rate_hz[SRC_COUNT];    // Sensor rates, by stream
+    uint8_t  channels;              // Version 5: data characteristics subscribed, bit per channel
+    uint8_t  stream_channel[SRC_COUNT];         // Channel carrying each stream, 0xFF: none
+    uint8_t  stream_batch_records[SRC_COUNT];
+    uint16_t stream_interval_ms[SRC_COUNT];
+} ble_status_t;
+
+// Sender counters at the last status update
+static struct {
+    uint32_t notifies_sent;
+    uint32_t bytes_sent;
+    uint64_t since_us;
+} s_status;
+
 static inline int16_t clamp_i16(int32_t v)
 {
     if (v > INT16_MAX) return INT16_MAX;
@@ -54,119 +287,406 @@ static inline int16_t float_to_scaled_i16(float value, float scale)
     return clamp_i16(lrintf(value * scale));
 }
 
-static bool append_u8(uint8_t *buf, size_t *offset, size_t max, uint8_t v)
+// value * num / den, rounded, for the fixed-point ICM45686 fields
+static inline int16_t fixed_to_scaled_i16(int32_t value, int32_t num, int32_t den)
 {
-    if (*offset + 1 > max) return false;
-    buf[(*offset)++] = v;
-    return true;
+    int64_t v = (int64_t)value * num;
+    v = (v >= 0) ? (v + den / 2) / den : (v - den / 2) / den;
+    if (v > INT16_MAX) return INT16_MAX;
+    if (v < INT16_MIN) return INT16_MIN;
+    return (int16_t)v;
 }
 
-static bool append_i16(uint8_t *buf, size_t *offset, size_t max, int16_t v)
+static inline uint8_t *put_i16(uint8_t *p, int16_t v)
 {
-    if (*offset + sizeof(int16_t) > max) return false;
-    memcpy(&buf[*offset], &v, sizeof(int16_t));
-    *offset += sizeof(int16_t);
-    return true;
+    memcpy(p, &v, sizeof(v));
+    return p + sizeof(v);
 }
 
-static bool append_vec3(uint8_t *buf, size_t *offset, size_t max, uint8_t type, int16_t x, int16_t y, int16_t z)
+static inline uint8_t *put_i32(uint8_t *p, int32_t v)
 {
-    if (!append_u8(buf, offset, max, type)) return false;
-    if (!append_u8(buf, offset, max, 6)) return false;
-    if (!append_i16(buf, offset, max, x)) return false;
-    if (!append_i16(buf, offset, max, y)) return false;
-    if (!append_i16(buf, offset, max, z)) return false;
-    return true;
+    memcpy(p, &v, sizeof(v));
+    return p + sizeof(v);
 }
 
-static bool append_scalar(uint8_t *buf, size_t *offset, size_t max, uint8_t type, int16_t value)
+static inline const uint8_t *source_sample(const batch_source_t *src, uint32_t i)
 {
-    if (!append_u8(buf, offset, max, type)) return false;
-    if (!append_u8(buf, offset, max, 2)) return false;
-    if (!append_i16(buf, offset, max, value)) return false;
-    return true;
+    return src->buf + i * src->stream->elem_size;
 }
 
-static size_t build_frame(const imu_data_t *data, uint8_t *out, size_t max_len)
+static inline uint64_t sample_time(const uint8_t *sample)
 {
-    if (!data || !out || max_len < sizeof(ble_frame_header_t)) {
-        return 0;
-    }
+    uint64_t ts;
+    memcpy(&ts, sample, sizeof(ts));
+    return ts;
+}
 
-    size_t offset = sizeof(ble_frame_header_t);
-    uint16_t mask = 0;
+// Time step of a record; a clock correction that moved backwards counts as 0
+static inline uint32_t record_dt(uint64_t ts, uint64_t prev_us)
+{
+    return (ts > prev_us) ? (uint32_t)(ts - prev_us) : 0;
+}
 
-    if (data->accelerometer.valid && s_cfg.enable_iis3dwb) {
-        int16_t ax = float_to_scaled_i16(data->accelerometer.x_g, 16384.0f); // 1g -> 16384
-        int16_t ay = float_to_scaled_i16(data->accelerometer.y_g, 16384.0f);
-        int16_t az = float_to_scaled_i16(data->accelerometer.z_g, 16384.0f);
-        if (!append_vec3(out, &offset, max_len, 0x01, ax, ay, az)) return 0;
-        mask |= BLE_SENSOR_IIS3_ACCEL;
+static uint8_t source_block_type(const batch_source_t *src, const uint8_t *sample)
+{
+    switch (src->sensor_id) {
+    case SENSOR_ACCELEROMETER:
+        return BLOCK_IIS3_ACCEL;
+    case SENSOR_IMU_6AXIS:
+        return ((const imu_6axis_sample_t *)sample)->hires ? BLOCK_ICM_6AXIS_HIRES : BLOCK_ICM_6AXIS;
+    case SENSOR_MAGNETOMETER:
+        return BLOCK_IIS2_MAG;
+    default:
+        return BLOCK_SCL_INCL;
     }
+}
 
-    if (data->imu_6axis.valid && s_cfg.enable_icm45686) {
-        int16_t ax = float_to_scaled_i16(data->imu_6axis.accel_x_g, 16384.0f);
-        int16_t ay = float_to_scaled_i16(data->imu_6axis.accel_y_g, 16384.0f);
-        int16_t az = float_to_scaled_i16(data->imu_6axis.accel_z_g, 16384.0f);
-        if (!append_vec3(out, &offset, max_len, 0x10, ax, ay, az)) return 0;
-        mask |= BLE_SENSOR_ICM_ACCEL;
+static uint8_t block_record_len(uint8_t type)
+{
+    switch (type) {
+    case BLOCK_ICM_6AXIS:       return ICM_RECORD_BYTES_16BIT;
+    case BLOCK_ICM_6AXIS_HIRES: return ICM_RECORD_BYTES_HIRES;
+    case BLOCK_SCL_INCL:        return 12;
+    default:                    return 6;
+    }
+}
 
-        int16_t gx = float_to_scaled_i16(data->imu_6axis.gyro_x_dps, 131.072f); // 1dps -> 131
-        int16_t gy = float_to_scaled_i16(data->imu_6axis.gyro_y_dps, 131.072f);
-        int16_t gz = float_to_scaled_i16(data->imu_6axis.gyro_z_dps, 131.072f);
-        if (!append_vec3(out, &offset, max_len, 0x11, gx, gy, gz)) return 0;
-        mask |= BLE_SENSOR_ICM_GYRO;
+static uint8_t block_channels(uint8_t type)
+{
+    return (type == BLOCK_IIS3_ACCEL || type == BLOCK_IIS2_MAG) ? 3 : 6;
+}
 
-        int16_t temp = float_to_scaled_i16(data->imu_6axis.temperature_c, 100.0f);
-        if (!append_scalar(out, &offset, max_len, 0x12, temp)) return 0;
-        mask |= BLE_SENSOR_ICM_TEMP;
+// Scaled record fields of one sample, the int16 / int32 values sent
+static void record_channels(uint8_t type, const uint8_t *sample, int32_t *v)
+{
+    switch (type) {
+    case BLOCK_IIS3_ACCEL: {
+        const imu_accel_sample_t *a = (const imu_accel_sample_t *)sample;
+        v[0] = float_to_scaled_i16(a->x_g, 16384.0f);      // 1g -> 16384
+        v[1] = float_to_scaled_i16(a->y_g, 16384.0f);
+        v[2] = float_to_scaled_i16(a->z_g, 16384.0f);
+        break;
     }
+    case BLOCK_ICM_6AXIS: {
+        const imu_6axis_sample_t *m = (const imu_6axis_sample_t *)sample;
+        v[0] = fixed_to_scaled_i16(m->accel_x_ug, 2048, 125000);     // ug -> 16384/g
+        v[1] = fixed_to_scaled_i16(m->accel_y_ug, 2048, 125000);
+        v[2] = fixed_to_scaled_i16(m->accel_z_ug, 2048, 125000);
+        v[3] = fixed_to_scaled_i16(m->gyro_x_mdps, 16384, 125000);   // mdps -> 131.072/dps
+        v[4] = fixed_to_scaled_i16(m->gyro_y_mdps, 16384, 125000);
+        v[5] = fixed_to_scaled_i16(m->gyro_z_mdps, 16384, 125000);
+        break;
+    }
+    case BLOCK_ICM_6AXIS_HIRES: {
+        // 20-bit data: the fixed-point values as is (ug, mdps)
+        const imu_6axis_sample_t *m = (const imu_6axis_sample_t *)sample;
+        v[0] = m->accel_x_ug;
+        v[1] = m->accel_y_ug;
+        v[2] = m->accel_z_ug;
+        v[3] = m->gyro_x_mdps;
+        v[4] = m->gyro_y_mdps;
+        v[5] = m->gyro_z_mdps;
+        break;
+    }
+    case BLOCK_IIS2_MAG: {
+        const imu_mag_sample_t *m = (const imu_mag_sample_t *)sample;
+        v[0] = float_to_scaled_i16(m->x_mg, 1.0f);         // already mg
+        v[1] = float_to_scaled_i16(m->y_mg, 1.0f);
+        v[2] = float_to_scaled_i16(m->z_mg, 1.0f);
+        break;
+    }
+    case BLOCK_SCL_INCL: {
+        const imu_incl_sample_t *c = (const imu_incl_sample_t *)sample;
+        v[0] = float_to_scaled_i16(c->angle_x_deg, 100.0f);
+        v[1] = float_to_scaled_i16(c->angle_y_deg, 100.0f);
+        v[2] = float_to_scaled_i16(c->angle_z_deg, 100.0f);
+        v[3] = float_to_scaled_i16(c->accel_x_g, 16384.0f);
+        v[4] = float_to_scaled_i16(c->accel_y_g, 16384.0f);
+        v[5] = float_to_scaled_i16(c->accel_z_g, 16384.0f);
+        break;
+    }
+    default:
+        break;
+    }
+}
 
-    if (data->magnetometer.valid && s_cfg.enable_iis2mdc) {
-        int16_t mx = float_to_scaled_i16(data->magnetometer.x_mg, 1.0f);  // already mg
-        int16_t my = float_to_scaled_i16(data->magnetometer.y_mg, 1.0f);
-        int16_t mz = float_to_scaled_i16(data->magnetometer.z_mg, 1.0f);
-        if (!append_vec3(out, &offset, max_len, 0x20, mx, my, mz)) return 0;
-        mask |= BLE_SENSOR_IIS2_MAG;
-
-        int16_t temp = float_to_scaled_i16(data->magnetometer.temperature_c, 100.0f);
-        if (!append_scalar(out, &offset, max_len, 0x21, temp)) return 0;
-        mask |= BLE_SENSOR_IIS2_TEMP;
+// Writes the plain record of the channel values, returns the end
+static uint8_t *encode_record(uint8_t type, const int32_t *v, uint8_t *p)
+{
+    for (int c = 0; c < block_channels(type); c++) {
+        p = (type == BLOCK_ICM_6AXIS_HIRES) ? put_i32(p, v[c]) : put_i16(p, (int16_t)v[c]);
     }
+    return p;
+}
 
-    if (data->inclinometer.valid && s_cfg.enable_scl3300) {
-        int16_t ang_x = float_to_scaled_i16(data->inclinometer.angle_x_deg, 100.0f);
-        int16_t ang_y = float_to_scaled_i16(data->inclinometer.angle_y_deg, 100.0f);
-        int16_t ang_z = float_to_scaled_i16(data->inclinometer.angle_z_deg, 100.0f);
-        if (!append_vec3(out, &offset, max_len, 0x30, ang_x, ang_y, ang_z)) return 0;
-        mask |= BLE_SENSOR_SCL_ANGLE;
+// Block bytes of the records sized in codec, in the layout that will be sent
+static size_t block_bytes(const ble_codec_block_t *codec)
+{
+    size_t plain = ble_codec_raw_size(codec);
+    if (s_cfg.delta_codec) {
+        size_t packed = ble_codec_packed_size(codec);
+        if (packed < plain) {
+            return BLOCK_HEADER_BYTES + packed;
+        }
+    }
+    return BLOCK_HEADER_BYTES + plain;
+}
 
-        int16_t acc_x = float_to_scaled_i16(data->inclinometer.accel_x_g, 16384.0f);
-        int16_t acc_y = float_to_scaled_i16(data->inclinometer.accel_y_g, 16384.0f);
-        int16_t acc_z = float_to_scaled_i16(data->inclinometer.accel_z_g, 16384.0f);
-        if (!append_vec3(out, &offset, max_len, 0x31, acc_x, acc_y, acc_z)) return 0;
-        mask |= BLE_SENSOR_SCL_ACCEL;
+// Newest temperature of the samples taken from a source, 0.01 °C
+static bool source_temperature(const batch_source_t *src, uint8_t *type, int16_t *value)
+{
+    const uint8_t *last = source_sample(src, src->taken - 1);
+    
+    switch (src->sensor_id) {
+    case SENSOR_IMU_6AXIS:
+        *type = BLOCK_ICM_TEMP;
+        *value = fixed_to_scaled_i16(((const imu_6axis_sample_t *)last)->temperature_mc, 1, 10);
+        return true;
+    case SENSOR_MAGNETOMETER:
+        *type = BLOCK_IIS2_TEMP;
+        *value = float_to_scaled_i16(((const imu_mag_sample_t *)last)->temperature_c, 100.0f);
+        return true;
+    case SENSOR_INCLINOMETER:
+        *type = BLOCK_SCL_TEMP;
+        *value = float_to_scaled_i16(((const imu_incl_sample_t *)last)->temperature_c, 100.0f);
+        return true;
+    default:
+        return false;
+    }
+}
 
-        int16_t temp = float_to_scaled_i16(data->inclinometer.temperature_c, 100.0f);
-        if (!append_scalar(out, &offset, max_len, 0x32, temp)) return 0;
-        mask |= BLE_SENSOR_SCL_TEMP;
+static uint16_t block_sensor_mask(uint8_t type)
+{
+    switch (type) {
+    case BLOCK_IIS3_ACCEL:      return BLE_SENSOR_IIS3_ACCEL;
+    case BLOCK_ICM_6AXIS:
+    case BLOCK_ICM_6AXIS_HIRES: return BLE_SENSOR_ICM_ACCEL | BLE_SENSOR_ICM_GYRO | BLE_SENSOR_ICM_TEMP;
+    case BLOCK_IIS2_MAG:        return BLE_SENSOR_IIS2_MAG | BLE_SENSOR_IIS2_TEMP;
+    default:                    return BLE_SENSOR_SCL_ANGLE | BLE_SENSOR_SCL_ACCEL | BLE_SENSOR_SCL_TEMP;
     }
+}
+
+typedef struct {
+    uint32_t records;           // Sensor records in the frame
+    bool full;                  // The next record would not have fit, or a batch is complete
+    uint64_t due_us;            // When the oldest sample reaches its stream's latency bound
+    size_t plain_len;           // Frame length with plain records only
+} frame_info_t;
 
-    if (mask == 0) {
+// Fills out with the oldest unsent samples of the channel's streams, in
+// timestamp order across the streams, until max_len is reached. The read
+// positions only move with commit_frame(), so a frame that is not sent is
+// rebuilt later.
+static size_t build_frame(uint8_t channel, uint8_t *out, size_t max_len, frame_info_t *info)
+{
+    const frame_channel_t *ch = &s_channels[channel];
+    uint64_t base_us = UINT64_MAX;
+    size_t reserve = 0;
+    bool keyframe = s_cfg.delta_codec && (ch->keyframe_pending || (ch->sequence % s_keyframe_interval) == 0);
+    
+    memset(info, 0, sizeof(*info));
+    info->due_us = UINT64_MAX;
+    
+    for (int i = 0; i < SRC_COUNT; i++) {
+        batch_source_t *src = &s_sources[i];
+        src->pending = 0;
+        src->taken = 0;
+        if (!src->enabled || src->stream == NULL || src->channel != channel) {
+            continue;
+        }
+        uint32_t cursor = src->cursor;
+        src->pending = sensor_stream_read(src->stream, &cursor, src->buf, src->batch_records);
+        src->start = cursor - src->pending;
+        if (src->pending == 0) {
+            continue;
+        }
+        
+        // One block per stream: stop where the ICM45686 record format changes
+        uint8_t type = source_block_type(src, source_sample(src, 0));
+        for (uint32_t n = 1; n < src->pending; n++) {
+            if (source_block_type(src, source_sample(src, n)) != type) {
+                src->pending = n;
+                break;
+            }
+        }
+        src->type = type;
+        bool has_ref = !keyframe && src->ref_type == type;
+        ble_codec_block_begin(&src->codec, block_channels(type), block_record_len(type),
+                              has_ref ? src->ref : NULL);
+        
+        uint64_t first_us = sample_time(source_sample(src, 0));
+        if (first_us < base_us) {
+            base_us = first_us;
+        }
+        uint64_t due_us = first_us + (uint64_t)src->interval_ms * 1000ULL;
+        if (due_us < info->due_us) {
+            info->due_us = due_us;
+        }
+        if (src->sensor_id != SENSOR_ACCELEROMETER) {
+            reserve += BLOCK_HEADER_BYTES + VARINT_MAX_BYTES + 2;   // Temperature block
+        }
+    }
+    if (base_us == UINT64_MAX) {
         return 0;
     }
-
+    
+    // The orientation goes with the ICM45686 stream
+    bool with_ahrs = s_cfg.enable_ahrs && s_cfg.enable_icm45686 && s_sources[SRC_ICM45686].channel == channel;
+    if (with_ahrs) {
+        reserve += BLOCK_HEADER_BYTES + VARINT_MAX_BYTES + 14;
+    }
+    
+    // Merge: always take the oldest pending sample that still fits
+    size_t size = sizeof(ble_frame_header_t);
+    for (int i = 0; i < SRC_COUNT; i++) {
+        s_sources[i].last_us = base_us;
+    }
+    while (true) {
+        batch_source_t *next = NULL;
+        uint64_t next_us = UINT64_MAX;
+        for (int i = 0; i < SRC_COUNT; i++) {
+            batch_source_t *src = &s_sources[i];
+            if (src->taken < src->pending) {
+                uint64_t ts = sample_time(source_sample(src, src->taken));
+                if (ts < next_us) {
+                    next_us = ts;
+                    next = src;
+                }
+            }
+        }
+        if (next == NULL) {
+            break;
+        }
+        
+        // Cost: growth of the block in its smaller layout
+        uint32_t dt = record_dt(next_us, next->last_us);
+        int32_t *values = next->values + next->taken * BLE_CODEC_MAX_CHANNELS;
+        record_channels(next->type, source_sample(next, next->taken), values);
+        ble_codec_block_t grown = next->codec;
+        ble_codec_block_add(&grown, dt, values);
+        size_t cost = block_bytes(&grown) - (next->taken ? block_bytes(&next->codec) : 0);
+        if (size + cost + reserve > max_len) {
+            info->full = true;
+            break;
+        }
+        size += cost;
+        next->codec = grown;
+        next->dt[next->taken] = dt;
+        next->last_us = next_us > next->last_us ? next_us : next->last_us;
+        next->taken++;
+        info->records++;
+        if (next->taken == next->batch_records) {
+            info->full = true;
+        }
+    }
+    if (info->records == 0) {
+        return 0;
+    }
+    
+    // Write the blocks, each stream followed by its temperature
+    uint8_t *p = out + sizeof(ble_frame_header_t);
+    uint16_t mask = 0;
+    uint8_t flags = keyframe ? BLE_FRAME_FLAG_KEYFRAME : 0;
+    size_t packed_saving = 0;
+    for (int i = 0; i < SRC_COUNT; i++) {
+        batch_source_t *src = &s_sources[i];
+        if (src->taken == 0) {
+            continue;
+        }
+        uint8_t type = src->type;
+        size_t plain = ble_codec_raw_size(&src->codec);
+        size_t packed = block_bytes(&src->codec) - BLOCK_HEADER_BYTES;
+        *p++ = (packed < plain) ? (type | BLE_CODEC_PACKED) : type;
+        *p++ = (uint8_t)src->taken;
+        *p++ = block_record_len(type);
+        if (packed < plain) {
+            p = ble_codec_write_packed(&src->codec, src->dt, src->values, p);
+            packed_saving += plain - packed;
+        } else {
+            for (uint32_t n = 0; n < src->taken; n++) {
+                p = ble_codec_put_varint(p, src->dt[n]);
+                p = encode_record(type, src->values + n * BLE_CODEC_MAX_CHANNELS, p);
+            }
+        }
+        
+        uint8_t temp_type;
+        int16_t temp;
+        if (source_temperature(src, &temp_type, &temp)) {
+            *p++ = temp_type;
+            *p++ = 1;
+            *p++ = 2;
+            p = ble_codec_put_varint(p, record_dt(src->last_us, base_us));
+            p = put_i16(p, temp);
+        }
+        mask |= block_sensor_mask(type);
+        if (type == BLOCK_ICM_6AXIS_HIRES) {
+            flags |= BLE_FRAME_FLAG_ICM_HIRES;
+        }
+    }
+    
+    ahrs_output_t ori;
+    if (with_ahrs && ahrs_get_output(&ori) == ESP_OK) {
+        *p++ = BLOCK_AHRS;
+        *p++ = 1;
+        *p++ = 14;
+        p = ble_codec_put_varint(p, record_dt(ori.timestamp_us, base_us));
+        for (int i = 0; i < 4; i++) {
+            p = put_i16(p, float_to_scaled_i16(ori.q[i], 16384.0f));   // Q14
+        }
+        p = put_i16(p, float_to_scaled_i16(ori.roll_deg, 100.0f));
+        p = put_i16(p, float_to_scaled_i16(ori.pitch_deg, 100.0f));
+        p = put_i16(p, float_to_scaled_i16(ori.yaw_deg, 100.0f));
+        mask |= BLE_SENSOR_AHRS;
+    }
+    
+    size_t len = (size_t)(p - out);
     ble_frame_header_t header = {
-        .frame_len = (uint16_t)offset,
+        .frame_len = (uint16_t)len,
         .version = FRAME_VERSION,
-        .flags = 0,
+        .flags = flags,
         .sensor_mask = mask,
-        .timestamp_us = (uint32_t)(data->timestamp_us & 0xFFFFFFFF),
-        .sequence = s_frame_seq++,
+        .timestamp_us = (uint32_t)(base_us & 0xFFFFFFFF),
+        .sequence = ch->sequence,
     };
     memcpy(out, &header, sizeof(header));
+    
+    info->plain_len = len + packed_saving;
+    return len;
+}
 
-    return offset;
+// The frame is queued: move the read positions past its samples and keep a
+// copy for resend requests
+static void commit_frame(uint8_t channel, const uint8_t *frame, size_t len, const frame_info_t *info)
+{
+    frame_channel_t *ch = &s_channels[channel];
+    retained_frame_t *slot = &s_retained[s_retain_next++ % RETAIN_FRAMES];
+    slot->sequence = ch->sequence;
+    slot->channel = channel;
+    slot->len = (uint16_t)len;
+    memcpy(slot->data, frame, len);
+    
+    for (int i = 0; i < SRC_COUNT; i++) {
+        batch_source_t *src = &s_sources[i];
+        if (src->pending == 0) {
+            continue;
+        }
+        // The stream overwrote samples before they could be read
+        uint32_t lost = src->start - src->cursor;
+        s_stats.lost[i] += lost;
+        s_samples_lost_total += lost;
+        s_stats.records[i] += src->taken;
+        src->cursor = src->start + src->taken;
+        if (src->taken > 0) {
+            memcpy(src->ref, src->values + (src->taken - 1) * BLE_CODEC_MAX_CHANNELS, sizeof(src->ref));
+            src->ref_type = src->type;
+        }
+    }
+    ch->sequence++;
+    ch->keyframe_pending = false;
+    s_stats.frames++;
+    s_stats.channel_frames[channel]++;
+    s_stats.bytes += len;
+    s_stats.plain_bytes += info->plain_len;
 }
 
 static void log_error_throttled(const char *context, esp_err_t err)
@@ -178,45 +698,516 @@ static void log_error_throttled(const char *context, esp_err_t err)
     }
 }
 
-static void request_stream_restart(void)
+static void log_stats(uint64_t now_us)
 {
-    s_frame_seq = 0;
-    s_last_error_log_ms = 0;
+    uint32_t elapsed_ms = (uint32_t)((now_us - s_stats.since_us) / 1000);
+    if (elapsed_ms == 0) {
+        return;
+    }
+    ble_stream_tx_stats_t tx;
+    ble_stream_get_tx_stats(&tx);
+    ESP_LOGI(TAG, "BLE %lu frames/s, %lu B/s, %lu frames/event, queue %u (max %u), dropped %lu, resent %lu (missed %lu), congestion %lu, frame %u B (MTU %u, LL %u B)",
+             s_stats.frames * 1000 / elapsed_ms, s_stats.bytes * 1000 / elapsed_ms, s_frames_per_event,
+             tx.queue_depth, tx.queue_max_depth, tx.frames_dropped, s_frames_resent_total, s_resend_missed_total,
+             tx.congestion_events, tx.frame_size, tx.mtu, tx.ll_tx_octets);
+    ESP_LOGI(TAG, "Samples/s IIS3DWB %lu, ICM45686 %lu, IIS2MDC %lu, SCL3300 %lu; lost %lu/%lu/%lu/%lu",
+             s_stats.records[SRC_IIS3DWB] * 1000 / elapsed_ms, s_stats.records[SRC_ICM45686] * 1000 / elapsed_ms,
+             s_stats.records[SRC_IIS2MDC] * 1000 / elapsed_ms, s_stats.records[SRC_SCL3300] * 1000 / elapsed_ms,
+             s_stats.lost[SRC_IIS3DWB], s_stats.lost[SRC_ICM45686],
+             s_stats.lost[SRC_IIS2MDC], s_stats.lost[SRC_SCL3300]);
+    if (s_stats.builds > 0 && s_stats.plain_bytes > 0) {
+        ESP_LOGI(TAG, "Frame build %lu cycles; delta codec %s: %lu%% of the plain size (keyframe every %u)",
+                 (uint32_t)(s_stats.build_cycles / s_stats.builds), s_cfg.delta_codec ? "on" : "off",
+                 (uint32_t)((uint64_t)s_stats.bytes * 100 / s_stats.plain_bytes), s_keyframe_interval);
+    }
+    ESP_LOGI(TAG, "Frames/s by characteristic (subscribed 0x%02X): mux %lu, IIS3DWB %lu, ICM45686 %lu, IIS2MDC %lu, SCL3300 %lu",
+             s_routed, s_stats.channel_frames[CHANNEL_MUX] * 1000 / elapsed_ms,
+             s_stats.channel_frames[SOURCE_CHANNEL(SRC_IIS3DWB)] * 1000 / elapsed_ms,
+             s_stats.channel_frames[SOURCE_CHANNEL(SRC_ICM45686)] * 1000 / elapsed_ms,
+             s_stats.channel_frames[SOURCE_CHANNEL(SRC_IIS2MDC)] * 1000 / elapsed_ms,
+             s_stats.channel_frames[SOURCE_CHANNEL(SRC_SCL3300)] * 1000 / elapsed_ms);
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_stats.since_us = now_us;
 }
 
-static void producer_task(void *arg)
+// Streams sent, as the CONTROL_SET_STREAMS mask
+static uint8_t stream_mask(void)
 {
-    const TickType_t period = pdMS_TO_TICKS(s_cfg.packet_interval_ms);
-    TickType_t last = xTaskGetTickCount();
+    uint8_t mask = s_cfg.enable_ahrs ? CONTROL_STREAM_AHRS : 0;
+    for (int i = 0; i < SRC_COUNT; i++) {
+        if (s_sources[i].enabled) {
+            mask |= 1 << i;
+        }
+    }
+    return mask;
+}
 
-    ESP_LOGI(TAG, "Producer started (interval=%ums)", (unsigned)s_cfg.packet_interval_ms);
+// Refreshes the status characteristic from the sender counters
+static void publish_status(uint64_t now_us)
+{
+    uint32_t elapsed_us = (uint32_t)(now_us - s_status.since_us);
+    if (elapsed_us == 0) {
+        return;
+    }
+    ble_stream_tx_stats_t tx;
+    ble_stream_get_tx_stats(&tx);
+    uint32_t notifies = tx.notifies_sent - s_status.notifies_sent;
+    uint32_t bytes = tx.bytes_sent - s_status.bytes_sent;
+    
+    ble_status_t status = {
+        .version = STATUS_VERSION,
+        .flags = tx.congested ? STATUS_FLAG_CONGESTED : 0,
+        .queue_depth = tx.queue_depth,
+        .queue_max_depth = tx.queue_max_depth,
+        .frames_per_event = (uint8_t)s_frames_per_event,
+        .notifies_per_interval = (uint16_t)((uint64_t)notifies * s_conn_interval_us * 100 / elapsed_us),
+        .throughput_bps = (uint32_t)((uint64_t)bytes * 1000000 / elapsed_us),
+        .conn_interval_us = s_conn_interval_us,
+        .frames_sent = tx.frames_sent,
+        .frames_dropped = tx.frames_dropped,
+        .samples_lost = s_samples_lost_total,
+        .congestion_events = tx.congestion_events,
+        .mtu = tx.mtu,
+        .ll_tx_octets = tx.ll_tx_octets,
+        .frame_size = tx.frame_size,
+        .frames_resent = s_frames_resent_total,
+        .resend_missed = s_resend_missed_total,
+        .streams = stream_mask(),
+        .batch_records = (uint8_t)s_batch_records,
+        .codec = s_cfg.delta_codec ? 1 : 0,
+        .keyframe_interval = s_keyframe_interval,
+        .packet_interval_ms = s_cfg.packet_interval_ms,
+    };
+    status.channels = s_routed;
+    for (int i = 0; i < SRC_COUNT; i++) {
+        status.rate_hz[i] = (uint16_t)imu_manager_get_sensor_rate(s_sources[i].sensor_id);
+        status.stream_channel[i] = s_sources[i].channel;
+        status.stream_batch_records[i] = (uint8_t)s_sources[i].batch_records;
+        status.stream_interval_ms[i] = s_sources[i].interval_ms;
+    }
+    esp_err_t ret = ble_stream_set_status((const uint8_t *)&status, sizeof(status));
+    if (ret != ESP_OK) {
+        log_error_throttled("Status update failed", ret);
+    }
+    
+    s_status.notifies_sent = tx.notifies_sent;
+    s_status.bytes_sent = tx.bytes_sent;
+    s_status.since_us = now_us;
+}
 
-    imu_data_t sample;
-    uint8_t frame[244];
+static void force_keyframes(void)
+{
+    for (int ch = 0; ch < BLE_STREAM_CHANNELS; ch++) {
+        s_channels[ch].keyframe_pending = true;
+    }
+}
 
-    while (true) {
-        if (!s_connected || !s_notifications_ready) {
-            vTaskDelayUntil(&last, period);
+// Skips the backlog: streaming restarts with the next samples. The sequences
+// and the retained frames carry on; the next frames are keyframes for a new
+// receiver. Producer task only (or before it runs), between two frames.
+static void restart_stream(void)
+{
+    force_keyframes();
+    s_last_error_log_ms = 0;
+    for (int i = 0; i < SRC_COUNT; i++) {
+        batch_source_t *src = &s_sources[i];
+        src->cursor = sensor_stream_get_seq(src->stream);
+        src->ref_type = 0;
+    }
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_stats.since_us = esp_timer_get_time();
+    memset(&s_status, 0, sizeof(s_status));
+    s_status.since_us = s_stats.since_us;
+    s_samples_lost_total = 0;
+    s_frames_resent_total = 0;
+    s_resend_missed_total = 0;
+    s_frames_per_event = FRAMES_PER_EVENT_START;
+    s_full_intervals = 0;
+    s_congestion_seen = 0;
+}
+
+// From the BLE callbacks: the producer restarts the stream at its next wake-up
+static void request_stream_restart(uint32_t events)
+{
+    if (s_producer_task) {
+        xTaskNotify(s_producer_task, PRODUCER_EVT_RESTART | events, eSetBits);
+    }
+}
+
+// Producer task: the requests of a central that disconnected. Not on every
+// restart, as a new central may ask for frames before the producer restarts.
+static void drop_resend_requests(void)
+{
+    s_resend.count = 0;
+    if (s_resend_queue) {
+        xQueueReset(s_resend_queue);
+    }
+}
+
+// Puts every stream on its own characteristic while that is subscribed, on the
+// multiplexed one otherwise. A stream that changes channel starts its delta
+// references over, so all channels send a keyframe next.
+static void route_streams(uint8_t subscribed)
+{
+    bool changed = false;
+    
+    for (int i = 0; i < SRC_COUNT; i++) {
+        batch_source_t *src = &s_sources[i];
+        uint8_t channel = CHANNEL_NONE;
+        if (subscribed & (1 << SOURCE_CHANNEL(i))) {
+            channel = SOURCE_CHANNEL(i);
+        } else if (subscribed & (1 << CHANNEL_MUX)) {
+            channel = CHANNEL_MUX;
+        }
+        if (channel == src->channel) {
             continue;
         }
+        // Not read while no channel carried it: the backlog is skipped, not lost
+        if (src->channel == CHANNEL_NONE) {
+            src->cursor = sensor_stream_get_seq(src->stream);
+        }
+        src->channel = channel;
+        src->ref_type = 0;
+        changed = true;
+    }
+    if (changed) {
+        force_keyframes();
+    }
+    s_routed = subscribed;
+}
 
-        esp_err_t ret = imu_manager_read_all(&sample);
-        if (ret == ESP_OK) {
-            size_t len = build_frame(&sample, frame, sizeof(frame));
-            if (len > 0) {
-                led_on();
-                esp_err_t ble_ret = ble_stream_notify(frame, (uint16_t)len);
-                led_off();
-
-                if (ble_ret != ESP_OK && ble_ret != ESP_ERR_INVALID_STATE) {
-                    log_error_throttled("BLE notify failed", ble_ret);
-                }
+// AIMD on the frames per connection interval: halved when the link reported
+// congestion, one more after ADAPT_RAISE_INTERVALS intervals that sent the
+// whole budget
+static void adapt_frames_per_event(uint32_t sent)
+{
+    ble_stream_tx_stats_t tx;
+    ble_stream_get_tx_stats(&tx);
+    
+    if (tx.congestion_events != s_congestion_seen) {
+        s_congestion_seen = tx.congestion_events;
+        s_frames_per_event = (s_frames_per_event > 2 * FRAMES_PER_EVENT_MIN) ? s_frames_per_event / 2 : FRAMES_PER_EVENT_MIN;
+        s_full_intervals = 0;
+    } else if (sent >= s_frames_per_event) {
+        if (++s_full_intervals >= ADAPT_RAISE_INTERVALS && s_frames_per_event < FRAMES_PER_EVENT_MAX) {
+            s_frames_per_event++;
+            s_full_intervals = 0;
+        }
+    } else {
+        s_full_intervals = 0;
+    }
+}
+
+static const retained_frame_t *find_retained(uint8_t channel, uint32_t sequence)
+{
+    for (int i = 0; i < RETAIN_FRAMES; i++) {
+        const retained_frame_t *slot = &s_retained[i];
+        if (slot->len != 0 && slot->channel == channel && slot->sequence == sequence) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+// Serves resend requests from the retained frames, ahead of new frames and
+// within the same budget per connection interval
+static void resend_frames(void)
+{
+    static uint8_t frame[BLE_FRAME_MAX];
+    
+    while (ble_stream_tx_free() > 0 && BLE_STREAM_TX_QUEUE_LEN - ble_stream_tx_free() < s_frames_per_event) {
+        if (s_resend.count == 0) {
+            if (xQueueReceive(s_resend_queue, &s_resend, 0) != pdTRUE) {
+                return;
             }
+            // Only the newest RETAIN_FRAMES can still be there
+            if (s_resend.count > RETAIN_FRAMES) {
+                s_resend_missed_total += s_resend.count - RETAIN_FRAMES;
+                s_resend.first += s_resend.count - RETAIN_FRAMES;
+                s_resend.count = RETAIN_FRAMES;
+            }
+        }
+        
+        const retained_frame_t *slot = find_retained(s_resend.channel, s_resend.first);
+        if (slot == NULL) {
+            s_resend_missed_total++;
         } else {
-            log_error_throttled("Sensor read failed", ret);
+            memcpy(frame, slot->data, slot->len);
+            frame[offsetof(ble_frame_header_t, flags)] |= BLE_FRAME_FLAG_RESENT;
+            esp_err_t ret = ble_stream_enqueue(slot->channel, frame, slot->len);
+            if (ret == ESP_ERR_INVALID_STATE) {
+                // The channel is no longer subscribed
+                s_resend_missed_total += s_resend.count;
+                s_resend.count = 0;
+                continue;
+            }
+            if (ret != ESP_OK) {
+                log_error_throttled("BLE resend failed", ret);
+                return;     // Retried next interval
+            }
+            s_frames_resent_total++;
+        }
+        s_resend.first++;
+        s_resend.count--;
+    }
+}
+
+// Tops the send queue up to one interval's budget. The channels take turns,
+// one frame each, and the turn carries over to the next interval, so every
+// subscribed characteristic gets an equal share of the budget however fast
+// the others' streams are. A channel sends full frames, and a partial one once
+// its oldest sample reached its stream's latency bound. While the queue is
+// full the samples stay in the sensor streams.
+static void fill_queue(uint64_t now_us)
+{
+    static uint8_t frame[BLE_FRAME_MAX];
+    uint8_t waiting = 0;        // Channels that may still have a frame due
+    
+    for (int i = 0; i < SRC_COUNT; i++) {
+        if (s_sources[i].enabled && s_sources[i].channel != CHANNEL_NONE) {
+            waiting |= 1 << s_sources[i].channel;
+        }
+    }
+    while (waiting && ble_stream_tx_free() > 0 && BLE_STREAM_TX_QUEUE_LEN - ble_stream_tx_free() < s_frames_per_event) {
+        s_rr_channel = (s_rr_channel + 1) % BLE_STREAM_CHANNELS;
+        uint8_t channel = s_rr_channel;
+        if (!(waiting & (1 << channel))) {
+            continue;
         }
+        
+        frame_info_t info;
+        // Sized to the negotiated MTU / data length
+        uint32_t cycles = esp_cpu_get_cycle_count();
+        size_t len = build_frame(channel, frame, ble_stream_get_frame_size(), &info);
+        cycles = esp_cpu_get_cycle_count() - cycles;
+        if (len == 0) {
+            waiting &= ~(1 << channel);
+            continue;
+        }
+        s_stats.build_cycles += cycles;
+        s_stats.builds++;
+        if (!info.full && now_us < info.due_us) {
+            waiting &= ~(1 << channel);
+            continue;
+        }
+        
+        esp_err_t ble_ret = ble_stream_enqueue(channel, frame, (uint16_t)len);
+        if (ble_ret == ESP_ERR_INVALID_STATE) {
+            // Unsubscribed meanwhile: the streams move at the next interval
+            waiting &= ~(1 << channel);
+            continue;
+        }
+        if (ble_ret != ESP_OK) {
+            log_error_throttled("BLE enqueue failed", ble_ret);
+            break;
+        }
+        commit_frame(channel, frame, len, &info);
+    }
+}
+
+static esp_err_t set_streams(uint8_t mask)
+{
+    esp_err_t result = ESP_OK;
+    
+    for (int i = 0; i < SRC_COUNT; i++) {
+        batch_source_t *src = &s_sources[i];
+        bool enable = (mask >> i) & 1;
+        if (enable == src->enabled) {
+            continue;
+        }
+        esp_err_t ret = (enable && src->stream == NULL) ? ESP_ERR_NOT_FOUND
+                                                        : imu_manager_enable_sensor(src->sensor_id, enable);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Stream %d not %s: %s", i, enable ? "enabled" : "disabled", esp_err_to_name(ret));
+            result = ret;
+            continue;
+        }
+        // Starts with the next sample; the stream was not read while off
+        src->cursor = sensor_stream_get_seq(src->stream);
+        src->enabled = enable;
+    }
+    s_cfg.enable_iis3dwb = s_sources[SRC_IIS3DWB].enabled;
+    s_cfg.enable_icm45686 = s_sources[SRC_ICM45686].enabled;
+    s_cfg.enable_iis2mdc = s_sources[SRC_IIS2MDC].enabled;
+    s_cfg.enable_scl3300 = s_sources[SRC_SCL3300].enabled;
+    s_cfg.enable_ahrs = (mask & CONTROL_STREAM_AHRS) != 0;
+    return result;
+}
+
+static esp_err_t set_stream_rate(uint8_t stream, uint16_t rate_hz)
+{
+    if (stream >= SRC_COUNT || rate_hz == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    batch_source_t *src = &s_sources[stream];
+    esp_err_t ret = (stream == SRC_ICM45686) ? imu_manager_set_sampling_rate(rate_hz)
+                                            : imu_manager_set_sensor_rate(src->sensor_id, rate_hz);
+    
+    // A failed ICM45686 FIFO restart leaves the register reads of the sampler
+    sensor_stream_t *stream_now = imu_manager_get_stream(src->sensor_id);
+    if (stream_now != src->stream) {
+        src->stream = stream_now;
+        src->cursor = stream_now ? sensor_stream_get_seq(stream_now) : 0;
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    switch (stream) {
+    case SRC_IIS3DWB:   s_cfg.iis3dwb_odr_hz = rate_hz; break;
+    case SRC_ICM45686:  s_cfg.icm45686_odr_hz = rate_hz; break;
+    case SRC_IIS2MDC:   s_cfg.iis2mdc_odr_hz = rate_hz; break;
+    default:            s_cfg.scl3300_odr_hz = rate_hz; break;
+    }
+    return ESP_OK;
+}
+
+// One CONTROL_SET_* command. The producer runs it between two frames, so a
+// frame never mixes two configurations.
+static esp_err_t apply_config(const uint8_t *cmd, uint8_t len)
+{
+    uint16_t value;
+    esp_err_t ret = ESP_OK;
+    
+    switch (cmd[0]) {
+    case CONTROL_SET_STREAMS:
+        if (len < 2) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        ret = set_streams(cmd[1]);
+        ESP_LOGI(TAG, "Streams 0x%02X", stream_mask());
+        break;
+    case CONTROL_SET_RATE:
+        if (len < 4) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        memcpy(&value, &cmd[2], sizeof(value));
+        ret = set_stream_rate(cmd[1], value);
+        if (ret == ESP_OK) {
+            ESP_LOGI(TAG, "Stream %u rate %lu Hz", cmd[1], imu_manager_get_sensor_rate(s_sources[cmd[1]].sensor_id));
+        }
+        break;
+    case CONTROL_SET_BATCH:
+        if (len < 2) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (cmd[1] == 0 || cmd[1] > BATCH_MAX_RECORDS || (len >= 3 && cmd[2] >= SRC_COUNT)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (len >= 3) {
+            s_sources[cmd[2]].batch_records = cmd[1];
+            ESP_LOGI(TAG, "Stream %u batch %u records", cmd[2], cmd[1]);
+            break;
+        }
+        s_batch_records = cmd[1];
+        for (int i = 0; i < SRC_COUNT; i++) {
+            s_sources[i].batch_records = cmd[1];
+        }
+        ESP_LOGI(TAG, "Batch %lu records per stream", s_batch_records);
+        break;
+    case CONTROL_SET_CODEC:
+        if (len < 3) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        s_cfg.delta_codec = cmd[1] != 0;
+        s_cfg.keyframe_interval = cmd[2];
+        s_keyframe_interval = cmd[2] ? cmd[2] : KEYFRAME_INTERVAL_DEFAULT;
+        ESP_LOGI(TAG, "Delta codec %s, keyframe every %u", s_cfg.delta_codec ? "on" : "off", s_keyframe_interval);
+        break;
+    case CONTROL_SET_INTERVAL:
+        if (len < 3) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        memcpy(&value, &cmd[1], sizeof(value));
+        if (value < PACKET_INTERVAL_MIN_MS || (len >= 4 && cmd[3] >= SRC_COUNT)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (len >= 4) {
+            s_sources[cmd[3]].interval_ms = value;
+            ESP_LOGI(TAG, "Stream %u latency bound %u ms", cmd[3], value);
+            break;
+        }
+        s_cfg.packet_interval_ms = value;
+        for (int i = 0; i < SRC_COUNT; i++) {
+            s_sources[i].interval_ms = value;
+        }
+        ESP_LOGI(TAG, "Latency bound %u ms", value);
+        break;
+    default:
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    force_keyframes();
+    return ret;
+}
+
+// Runs the queued configuration commands; the status follows right away
+static void apply_config_commands(uint64_t now_us)
+{
+    config_command_t cmd;
+    bool applied = false;
+    
+    while (xQueueReceive(s_config_queue, &cmd, 0) == pdTRUE) {
+        esp_err_t ret = apply_config(cmd.data, cmd.len);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Control command 0x%02X failed: %s", cmd.data[0], esp_err_to_name(ret));
+        }
+        applied = true;
+    }
+    if (applied && s_connected) {
+        publish_status(now_us);
+    }
+}
+
+static void drain_timer_cb(void *arg)
+{
+    if (s_producer_task) {
+        xTaskNotify(s_producer_task, PRODUCER_EVT_INTERVAL, eSetBits);
+    }
+}
 
-        vTaskDelayUntil(&last, period);
+static void producer_task(void *arg)
+{
+    ESP_LOGI(TAG, "Producer started (connection interval %lu us, latency bound %u ms)",
+             s_conn_interval_us, (unsigned)s_cfg.packet_interval_ms);
+    
+    while (true) {
+        uint32_t events = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &events, portMAX_DELAY);
+        if (events & PRODUCER_EVT_DISCONNECT) {
+            drop_resend_requests();
+        }
+        if (events & PRODUCER_EVT_RESTART) {
+            restart_stream();
+        }
+        // Also while paused: a central can configure the stream before it subscribes
+        uint64_t now_us = esp_timer_get_time();
+        if (events & PRODUCER_EVT_INTERVAL) {
+            apply_config_commands(now_us);
+        }
+        if (!s_connected || s_subscribed == 0) {
+            continue;
+        }
+        
+        if (events & PRODUCER_EVT_INTERVAL) {
+            if (s_subscribed != s_routed) {
+                route_streams(s_subscribed);
+            }
+            resend_frames();
+            fill_queue(now_us);
+        }
+        led_on();
+        uint32_t sent = ble_stream_tx_pump(s_frames_per_event);
+        led_off();
+        // Congestion cleared mid-interval: only the queue is flushed
+        if (events & PRODUCER_EVT_INTERVAL) {
+            adapt_frames_per_event(sent);
+        }
+        
+        if (now_us - s_status.since_us >= STATUS_INTERVAL_US) {
+            publish_status(now_us);
+        }
+        if (now_us - s_stats.since_us >= STATS_LOG_INTERVAL_US) {
+            log_stats(now_us);
+        }
     }
 }
 
@@ -230,6 +1221,9 @@ static esp_err_t configure_sensors(void)
         }
     }
 
+    // Stored before init so the FIFO starts in the requested format
+    imu_manager_set_imu_hires(s_cfg.icm45686_hires);
+
     esp_err_t ret = imu_manager_init();
     if (ret != ESP_OK) {
         return ret;
@@ -252,12 +1246,74 @@ static esp_err_t configure_sensors(void)
         if (ret != ESP_OK) return ret;
     }
 
-    ESP_LOGI(TAG, "Sensors configured: MAG=%d IIS3DWB=%d ICM=%d SCL=%d",
-             s_cfg.enable_iis2mdc, s_cfg.enable_iis3dwb,
-             s_cfg.enable_icm45686, s_cfg.enable_scl3300);
+    if (s_cfg.enable_ahrs && s_cfg.ahrs_on_edmp) {
+        ret = imu_manager_set_orientation_source(AHRS_SOURCE_EDMP_GAF);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "eDMP orientation unavailable (%s), using the host AHRS", esp_err_to_name(ret));
+        }
+    }
+
+    // Poll rates of the sampler; 0 keeps the imu_manager default
+    const struct {
+        uint8_t sensor;
+        const char *name;
+        uint16_t hz;
+    } rates[] = {
+        { SENSOR_ACCELEROMETER, "IIS3DWB", s_cfg.iis3dwb_odr_hz },
+        { SENSOR_MAGNETOMETER, "IIS2MDC", s_cfg.iis2mdc_odr_hz },
+        { SENSOR_INCLINOMETER, "SCL3300", s_cfg.scl3300_odr_hz },
+    };
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        if (rates[i].hz == 0) {
+            continue;
+        }
+        ret = imu_manager_set_sensor_rate(rates[i].sensor, rates[i].hz);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "%s: rate %u Hz rejected (%s), using %lu Hz", rates[i].name,
+                     rates[i].hz, esp_err_to_name(ret), imu_manager_get_sensor_rate(rates[i].sensor));
+        }
+    }
+
+    ret = imu_manager_start_sampler();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    s_sources[SRC_IIS3DWB].enabled = s_cfg.enable_iis3dwb;
+    s_sources[SRC_ICM45686].enabled = s_cfg.enable_icm45686;
+    s_sources[SRC_IIS2MDC].enabled = s_cfg.enable_iis2mdc;
+    s_sources[SRC_SCL3300].enabled = s_cfg.enable_scl3300;
+    for (int i = 0; i < SRC_COUNT; i++) {
+        s_sources[i].stream = imu_manager_get_stream(s_sources[i].sensor_id);
+    }
+
+    ESP_LOGI(TAG, "Sensors configured: MAG=%d (%lu Hz) IIS3DWB=%d (%lu Hz) ICM=%d (%lu Hz) SCL=%d (%lu Hz) AHRS=%d",
+             s_cfg.enable_iis2mdc, imu_manager_get_sensor_rate(SENSOR_MAGNETOMETER),
+             s_cfg.enable_iis3dwb, imu_manager_get_sensor_rate(SENSOR_ACCELEROMETER),
+             s_cfg.enable_icm45686, imu_manager_get_sensor_rate(SENSOR_IMU_6AXIS),
+             s_cfg.enable_scl3300, imu_manager_get_sensor_rate(SENSOR_INCLINOMETER), s_cfg.enable_ahrs);
+
+    imu_6axis_format_t fmt;
+    if (s_cfg.enable_icm45686 && imu_manager_get_imu_format(&fmt) == ESP_OK) {
+        ESP_LOGI(TAG, "ICM45686 %s: %u B/record on BLE (%+d vs 16-bit), %lu B/FIFO frame, LSB %lu ug / %lu udps",
+                 fmt.hires ? "20-bit" : "16-bit",
+                 fmt.hires ? ICM_RECORD_BYTES_HIRES : ICM_RECORD_BYTES_16BIT,
+                 fmt.hires ? ICM_RECORD_BYTES_HIRES - ICM_RECORD_BYTES_16BIT : 0,
+                 fmt.fifo_frame_bytes, fmt.accel_lsb_ug, fmt.gyro_lsb_udps);
+    }
     return ESP_OK;
 }
 
+// Runs the drain once per connection event
+static esp_err_t drain_timer_restart(void)
+{
+    if (s_drain_timer == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_timer_stop(s_drain_timer);
+    return esp_timer_start_periodic(s_drain_timer, s_conn_interval_us);
+}
+
 void imu_ble_on_ble_connect(void)
 {
     s_connected = true;
@@ -268,24 +1324,111 @@ void imu_ble_on_ble_connect(void)
 void imu_ble_on_ble_disconnect(void)
 {
     s_connected = false;
-    s_notifications_ready = false;
-    request_stream_restart();
+    s_subscribed = 0;
+    request_stream_restart(PRODUCER_EVT_DISCONNECT);
     led_stop_blink();
     led_on();  // Solid ON when disconnected
     ESP_LOGI(TAG, "Central disconnected");
 }
 
-void imu_ble_on_notifications_changed(bool enabled)
+void imu_ble_on_tx_ready(void)
 {
-    s_notifications_ready = enabled;
-    if (enabled) {
-        request_stream_restart();
+    if (s_producer_task) {
+        xTaskNotify(s_producer_task, PRODUCER_EVT_TX_READY, eSetBits);
+    }
+}
+
+void imu_ble_on_conn_params(uint32_t interval_us)
+{
+    if (interval_us == 0 || interval_us == s_conn_interval_us) {
+        return;
+    }
+    s_conn_interval_us = interval_us;
+    esp_err_t ret = drain_timer_restart();
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+        ESP_LOGW(TAG, "Drain timer restart failed: %s", esp_err_to_name(ret));
+    }
+    ESP_LOGI(TAG, "Connection interval %lu us", interval_us);
+}
+
+void imu_ble_on_control(const uint8_t *data, uint16_t len)
+{
+    if (len == 0) {
+        return;
+    }
+    switch (data[0]) {
+    case CONTROL_RESEND: {
+        uint16_t count;
+        resend_request_t req;
+        if (len < 7 || s_resend_queue == NULL) {
+            break;
+        }
+        memcpy(&req.first, &data[1], sizeof(req.first));
+        memcpy(&count, &data[5], sizeof(count));
+        req.count = count;
+        req.channel = (len >= 8) ? data[7] : CHANNEL_MUX;
+        if (req.channel >= BLE_STREAM_CHANNELS) {
+            break;
+        }
+        ESP_LOGD(TAG, "Resend %lu frames from %lu on channel %u", req.count, req.first, req.channel);
+        if (req.count > 0 && xQueueSend(s_resend_queue, &req, 0) != pdTRUE) {
+            ESP_LOGW(TAG, "Resend queue full, request for %lu frames from %lu dropped", req.count, req.first);
+        }
+        return;
+    }
+    case CONTROL_SET_STREAMS:
+    case CONTROL_SET_RATE:
+    case CONTROL_SET_BATCH:
+    case CONTROL_SET_CODEC:
+    case CONTROL_SET_INTERVAL: {
+        // Checked and applied by the producer between two frames
+        config_command_t cmd = { .len = (uint8_t)len };
+        if (len > sizeof(cmd.data) || s_config_queue == NULL) {
+            break;
+        }
+        memcpy(cmd.data, data, len);
+        if (xQueueSend(s_config_queue, &cmd, 0) != pdTRUE) {
+            ESP_LOGW(TAG, "Config queue full, command 0x%02X dropped", data[0]);
+        }
+        return;
+    }
+    default:
+        break;
+    }
+    ESP_LOGW(TAG, "Invalid control command 0x%02X (%u bytes)", data[0], len);
+}
+
+void imu_ble_on_notifications_changed(uint8_t channels)
+{
+    bool resumes = (s_subscribed == 0 && channels != 0);
+
+    if (resumes) {
+        // Pending before the subscription shows, so the producer restarts first
+        request_stream_restart(0);
+    }
+    s_subscribed = channels;
+    if (resumes) {
         led_stop_blink();  // Stop blinking, let producer task control LED
         led_off();  // Start with LED off
-        ESP_LOGI(TAG, "Notifications enabled, streaming resumes");
-    } else {
+        ESP_LOGI(TAG, "Notifications enabled (channels 0x%02X), streaming resumes", channels);
+    } else if (channels == 0) {
         led_start_blink();  // Resume blinking when not streaming
         ESP_LOGI(TAG, "Notifications disabled, streaming paused");
+    } else {
+        // The producer moves the streams at its next interval
+        ESP_LOGI(TAG, "Notifications on channels 0x%02X", channels);
+    }
+}
+
+static void delete_control_queues(void)
+{
+    if (s_resend_queue) {
+        vQueueDelete(s_resend_queue);
+        s_resend_queue = NULL;
+    }
+    if (s_config_queue) {
+        vQueueDelete(s_config_queue);
+        s_config_queue = NULL;
     }
 }
 
@@ -296,13 +1439,14 @@ esp_err_t imu_ble_init(const imu_ble_config_t *cfg)
     }
     
     // Validate minimum interval for FreeRTOS stability
-    if (cfg->packet_interval_ms < 10) {
+    if (cfg->packet_interval_ms < PACKET_INTERVAL_MIN_MS) {
         ESP_LOGW(TAG, "packet_interval_ms=%u too low, using minimum 10ms", cfg->packet_interval_ms);
         s_cfg = *cfg;
-        s_cfg.packet_interval_ms = 10;
+        s_cfg.packet_interval_ms = PACKET_INTERVAL_MIN_MS;
     } else {
         s_cfg = *cfg;
     }
+    s_keyframe_interval = cfg->keyframe_interval ? cfg->keyframe_interval : KEYFRAME_INTERVAL_DEFAULT;
     
     if (s_producer_task) {
         ESP_LOGW(TAG, "imu_ble already initialised");
@@ -310,14 +1454,27 @@ esp_err_t imu_ble_init(const imu_ble_config_t *cfg)
     }
 
     s_connected = false;
-    s_notifications_ready = false;
-    request_stream_restart();
+    s_subscribed = 0;
+    for (int i = 0; i < SRC_COUNT; i++) {
+        s_sources[i].channel = CHANNEL_NONE;
+        s_sources[i].batch_records = s_batch_records;
+        s_sources[i].interval_ms = s_cfg.packet_interval_ms;
+    }
 
     esp_err_t ret = configure_sensors();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to configure sensors: %s", esp_err_to_name(ret));
         return ret;
     }
+    restart_stream();
+
+    s_resend_queue = xQueueCreate(RESEND_QUEUE_LEN, sizeof(resend_request_t));
+    s_config_queue = xQueueCreate(CONFIG_QUEUE_LEN, sizeof(config_command_t));
+    if (s_resend_queue == NULL || s_config_queue == NULL) {
+        delete_control_queues();
+        imu_manager_deinit();
+        return ESP_ERR_NO_MEM;
+    }
 
     BaseType_t task_ok = xTaskCreatePinnedToCore(
         producer_task,
@@ -331,9 +1488,27 @@ esp_err_t imu_ble_init(const imu_ble_config_t *cfg)
 
     if (task_ok != pdPASS) {
         ESP_LOGE(TAG, "Failed to create producer task");
+        delete_control_queues();
         imu_manager_deinit();
         return ESP_ERR_NO_MEM;
     }
 
+    const esp_timer_create_args_t timer_args = {
+        .callback = drain_timer_cb,
+        .name = "imu_ble_drain",
+    };
+    ret = esp_timer_create(&timer_args, &s_drain_timer);
+    if (ret == ESP_OK) {
+        ret = drain_timer_restart();
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start drain timer: %s", esp_err_to_name(ret));
+        vTaskDelete(s_producer_task);
+        s_producer_task = NULL;
+        delete_control_queues();
+        imu_manager_deinit();
+        return ret;
+    }
+
     return ESP_OK;
 }
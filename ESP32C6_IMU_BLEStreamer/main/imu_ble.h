@@ -5,19 +5,35 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+// Startup configuration; the control characteristic changes the enables, rates,
+// delta codec and packet interval at runtime (imu_ble_on_control())
 typedef struct {
     bool     enable_iis2mdc;
     bool     enable_iis3dwb;
     bool     enable_icm45686;
     bool     enable_scl3300;
-    uint16_t iis3dwb_odr_hz;       // BLE-friendly ODR (e.g., 400-800Hz)
-    uint16_t icm45686_odr_hz;      // 200-400Hz
-    uint16_t packet_interval_ms;   // e.g., 20ms (~50Hz)
+    bool     enable_ahrs;          // Newest ICM45686 orientation in each frame (+20 B)
+    bool     ahrs_on_edmp;         // Orientation from the ICM45686S eDMP (GAF) instead of the host filter
+    uint16_t iis3dwb_odr_hz;       // Poll rate, up to 1600 Hz (0: default 800 Hz)
+    uint16_t icm45686_odr_hz;      // ODR 25-1600 Hz, doubling from 25 (0: default 100 Hz)
+    bool     icm45686_hires;       // 20-bit FIFO data, +12 B per record
+    uint16_t iis2mdc_odr_hz;       // Poll rate, up to 100 Hz (0: default 100 Hz)
+    uint16_t scl3300_odr_hz;       // Poll rate, up to 200 Hz (0: default 50 Hz)
+    uint16_t packet_interval_ms;   // Latency bound: longest a sample waits for a full frame
+    bool     delta_codec;          // Delta + bit-packed blocks where smaller than plain records
+    uint8_t  keyframe_interval;    // Frames between keyframes of the delta codec (0: default 16)
 } imu_ble_config_t;
 
 esp_err_t imu_ble_init(const imu_ble_config_t *cfg);
 void imu_ble_on_ble_connect(void);
 void imu_ble_on_ble_disconnect(void);
-void imu_ble_on_notifications_changed(bool enabled);
+// Data characteristics with notifications on, bit per BLE_STREAM_CHANNELS channel
+void imu_ble_on_notifications_changed(uint8_t channels);
+// Link congestion cleared: queued frames can go out
+void imu_ble_on_tx_ready(void);
+// Connection interval negotiated with the central; frames are drained at this pace
+void imu_ble_on_conn_params(uint32_t interval_us);
+// Command written to the control characteristic (BLE stack task): [opcode:1][arguments]
+void imu_ble_on_control(const uint8_t *data, uint16_t len);
 
 #endif // IMU_BLE_H
@@ -3,12 +3,18 @@
 #include "sensors/iis3dwb.h"
 #include "sensors/icm45686.h"
 #include "sensors/scl3300.h"
+#include "spi_batch.h"
+#include "ahrs.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_cpu.h"
 #include "driver/spi_master.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "sensor_stream.h"
+#include <string.h>
 
 static const char *TAG = "IMU_MANAGER";
 
@@ -22,6 +28,7 @@ static scl3300_t inclinometer_sensor;
 static uint32_t sampling_rate_hz = 100;
 static uint16_t fifo_watermark = 32;
 static uint8_t enabled_sensors = 0x00; // Start with all sensors disabled, enable after successful init
+static uint8_t detected_sensors = 0x00; // Initialized successfully: the ones that can be re-enabled
 
 // Synchronization
 static SemaphoreHandle_t sensor_mutex = NULL;
@@ -31,6 +38,7 @@ static SemaphoreHandle_t sensor_mutex = NULL;
 #define I2C_MASTER_SDA          23
 #define I2C_MASTER_SCL          22
 #define I2C_MASTER_CLK_SPEED    400000
+#define PIN_NUM_DRDY_IIS2MDC    GPIO_NUM_NC     // IIS2MDC DRDY, GPIO_NUM_NC gates reads on STATUS.Zyxda
 
 // All SPI sensors share the same bus (SPI2_HOST) with same MISO/MOSI/CLK
 #define SPI_HOST_1              SPI2_HOST
@@ -46,9 +54,316 @@ static SemaphoreHandle_t sensor_mutex = NULL;
 #define PIN_NUM_CS_IIS3DWB      19      // IIS3DWB Accelerometer
 #define PIN_NUM_CS_ICM45686     20      // ICM45686 IMU 6-axis
 #define PIN_NUM_CS_SCL3300      11      // SCL3300 Inclinometer
+#define PIN_NUM_INT_ICM45686    4       // ICM45686 INT1 (FIFO watermark), GPIO_NUM_NC polls the FIFO
+
+// ICM45686 FIFO streaming
+#define ICM45686_FIFO_WATERMARK     16      // Frames per watermark interrupt
+#define ICM45686_FIFO_COMPRESSION   true    // 16-bit mode only, hires packets cannot be compressed
+#define ICM45686_FIFO_BATCH_SIZE    64      // Samples decoded per publish
+#define ICM45686_STREAM_CAPACITY    512     // Full-ODR samples kept for consumers
+#define ICM_FIFO_TASK_PRIORITY      6
+#define ICM_FIFO_TASK_STACK_SIZE    4096
+
+// ICM45686 counts to fixed point: value = (count * 15625) >> shift
+//   16-bit  ±16 g:    2048 LSB/g   -> µg   (shift 5)   ±2000 dps: 16.384 LSB/dps  -> mdps (shift 8)
+//   20-bit  ±32 g:   16384 LSB/g   -> µg   (shift 8)   ±4000 dps: 131.072 LSB/dps -> mdps (shift 11)
+#define ICM_FIXED_MUL               15625
+#define ICM_ACCEL_SHIFT_16BIT       5
+#define ICM_GYRO_SHIFT_16BIT        8
+#define ICM_ACCEL_SHIFT_HIRES       8
+#define ICM_GYRO_SHIFT_HIRES        11
 
 #define SPI_CLOCK_HZ            6000000
 
+// Sampler: the polled sensors, each at its own rate into its own stream
+#define SAMPLER_TASK_PRIORITY       6
+#define SAMPLER_TASK_STACK_SIZE     4096
+#define ACCEL_STREAM_CAPACITY       512     // 640 ms at 800 Hz
+#define INCL_STREAM_CAPACITY        64
+#define MAG_STREAM_CAPACITY         64
+
+// Sampler bus cycles between timing / bus occupancy log lines (~5 s at 800 Hz)
+#define READ_CYCLE_LOG_INTERVAL 4000
+// Register-mode AHRS rate is re-derived when the read period drifts by more than 1/8
+#define AHRS_RATE_TOLERANCE_SHIFT 3
+
+// ICM45686 FIFO streaming state
+static bool icm_fifo_mode = false;
+static bool icm_fifo_hires = false;
+static volatile bool icm_fifo_running = false;
+static TaskHandle_t icm_fifo_task_handle = NULL;
+static sensor_stream_t imu_stream;
+static icm456xx_fifo_sample_t icm_fifo_batch[ICM45686_FIFO_BATCH_SIZE];
+static uint32_t icm_fifo_batch_count = 0;
+static int64_t icm_clock_offset_us = 0;
+static bool icm_clock_synced = false;
+
+// eDMP GAF offload (ICM45686S builds): the FIFO carries game rotation vectors,
+// accel/gyro are read from the registers
+#if defined(ICM45686S) || defined(ICM45605S)
+#define ICM_GAF_SUPPORTED 1
+#else
+#define ICM_GAF_SUPPORTED 0
+#endif
+static bool icm_gaf_mode = false;
+
+// IIS3DWB and SCL3300 register reads of one sampler cycle share a queued SPI cycle
+static spi_batch_t spi_cycle;   // Guarded by sensor_mutex
+static imu_cycle_stats_t cycle_stats;   // Sampler cycles, sensor_mutex held
+
+// Sensors polled by the sampler task. The ICM45686 is polled only while its
+// FIFO is not streaming (eDMP mode, or the FIFO failed to start).
+enum {
+    POLL_ACCELEROMETER = 0,
+    POLL_IMU_6AXIS,
+    POLL_INCLINOMETER,
+    POLL_MAGNETOMETER,
+    POLL_COUNT
+};
+
+typedef struct {
+    uint8_t sensor_id;
+    uint32_t rate_hz;
+    uint32_t max_rate_hz;
+    sensor_stream_t *stream;
+    size_t sample_size;
+    uint32_t stream_capacity;
+    uint64_t next_us;           // Next read due (esp_timer time)
+} poll_group_t;
+
+static sensor_stream_t accel_stream;
+static sensor_stream_t incl_stream;
+static sensor_stream_t mag_stream;
+
+static poll_group_t poll_groups[POLL_COUNT] = {
+    [POLL_ACCELEROMETER] = {
+        .sensor_id = SENSOR_ACCELEROMETER, .rate_hz = 800, .max_rate_hz = 1600,
+        .stream = &accel_stream, .sample_size = sizeof(imu_accel_sample_t),
+        .stream_capacity = ACCEL_STREAM_CAPACITY,
+    },
+    [POLL_IMU_6AXIS] = {
+        // Rate follows sampling_rate_hz (the FIFO ODR)
+        .sensor_id = SENSOR_IMU_6AXIS, .rate_hz = 0, .max_rate_hz = 1600,
+        .stream = &imu_stream, .sample_size = sizeof(imu_6axis_sample_t),
+        .stream_capacity = ICM45686_STREAM_CAPACITY,
+    },
+    [POLL_INCLINOMETER] = {
+        .sensor_id = SENSOR_INCLINOMETER, .rate_hz = 50, .max_rate_hz = 200,
+        .stream = &incl_stream, .sample_size = sizeof(imu_incl_sample_t),
+        .stream_capacity = INCL_STREAM_CAPACITY,
+    },
+    [POLL_MAGNETOMETER] = {
+        // IIS2MDC output data rate
+        .sensor_id = SENSOR_MAGNETOMETER, .rate_hz = 100, .max_rate_hz = 100,
+        .stream = &mag_stream, .sample_size = sizeof(imu_mag_sample_t),
+        .stream_capacity = MAG_STREAM_CAPACITY,
+    },
+};
+
+static TaskHandle_t sampler_task_handle = NULL;
+static esp_timer_handle_t sampler_timer = NULL;
+static volatile bool sampler_running = false;
+
+// AHRS fed from the FIFO samples, or from the register reads at the caller's rate
+static uint32_t ahrs_rate_hz = 0;
+static uint64_t ahrs_last_reg_us = 0;
+
+// ICM45686 FIFO watermark interrupt: wakes the FIFO task
+static void IRAM_ATTR icm_fifo_isr(void *arg)
+{
+    BaseType_t woken = pdFALSE;
+    
+    if (icm_fifo_task_handle) {
+        vTaskNotifyGiveFromISR(icm_fifo_task_handle, &woken);
+    }
+    portYIELD_FROM_ISR(woken);
+}
+
+static icm456xx_fifo_format_t icm_fifo_format(void)
+{
+    if (icm_fifo_hires) {
+        return ICM456XX_FIFO_FORMAT_HIRES;
+    }
+    return ICM45686_FIFO_COMPRESSION ? ICM456XX_FIFO_FORMAT_COMPRESSED : ICM456XX_FIFO_FORMAT_16BIT;
+}
+
+// The ICM45686 driver maps only its exact ODRs and falls back to 100 Hz for
+// anything else; the register reads cannot go past the group's maximum either
+static bool icm_odr_supported(uint32_t rate_hz)
+{
+    static const uint16_t odrs[] = {25, 50, 100, 200, 400, 800, 1600, 3200, 6400};
+    if (rate_hz > poll_groups[POLL_IMU_6AXIS].max_rate_hz) {
+        return false;
+    }
+    for (size_t i = 0; i < sizeof(odrs) / sizeof(odrs[0]); i++) {
+        if (odrs[i] == rate_hz) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline int32_t icm_count_to_fixed(int32_t count, int shift)
+{
+    // Rounded; 20-bit counts overflow 32 bits before the shift
+    return (int32_t)(((int64_t)count * ICM_FIXED_MUL + (1 << (shift - 1))) >> shift);
+}
+
+static void icm_scale_sample(const int32_t accel[3], const int32_t gyro[3], bool hires, imu_6axis_sample_t *sample)
+{
+    const int accel_shift = hires ? ICM_ACCEL_SHIFT_HIRES : ICM_ACCEL_SHIFT_16BIT;
+    const int gyro_shift = hires ? ICM_GYRO_SHIFT_HIRES : ICM_GYRO_SHIFT_16BIT;
+    
+    sample->accel_x_ug = icm_count_to_fixed(accel[0], accel_shift);
+    sample->accel_y_ug = icm_count_to_fixed(accel[1], accel_shift);
+    sample->accel_z_ug = icm_count_to_fixed(accel[2], accel_shift);
+    sample->gyro_x_mdps = icm_count_to_fixed(gyro[0], gyro_shift);
+    sample->gyro_y_mdps = icm_count_to_fixed(gyro[1], gyro_shift);
+    sample->gyro_z_mdps = icm_count_to_fixed(gyro[2], gyro_shift);
+    sample->hires = hires;
+}
+
+static void ahrs_update_from_sample(const imu_6axis_sample_t *sample)
+{
+    const int32_t accel[3] = { sample->accel_x_ug, sample->accel_y_ug, sample->accel_z_ug };
+    const int32_t gyro[3] = { sample->gyro_x_mdps, sample->gyro_y_mdps, sample->gyro_z_mdps };
+    ahrs_update(sample->timestamp_us, accel, gyro);
+}
+
+// Register reads come at the sampler's pace, which drops late reads and
+// shares the bus with the other sensors: track the measured read period and
+// keep the AHRS constants in line with it
+static void ahrs_track_register_rate(uint64_t timestamp_us)
+{
+    if (ahrs_last_reg_us != 0 && timestamp_us > ahrs_last_reg_us) {
+        uint32_t rate_hz = (uint32_t)(1000000ULL / (timestamp_us - ahrs_last_reg_us));
+        uint32_t diff = (rate_hz > ahrs_rate_hz) ? rate_hz - ahrs_rate_hz : ahrs_rate_hz - rate_hz;
+        if (rate_hz > 0 && diff > (ahrs_rate_hz >> AHRS_RATE_TOLERANCE_SHIFT) &&
+            ahrs_set_sample_rate(rate_hz) == ESP_OK) {
+            ahrs_rate_hz = rate_hz;
+        }
+    }
+    ahrs_last_reg_us = timestamp_us;
+}
+
+// Maps the batch from device time to esp_timer time and pushes it to the stream.
+// The newest sample was in the FIFO when the read started, so read_us minus its
+// device time bounds the clock offset from above; keep the smallest bound and
+// let it creep up slowly to follow oscillator drift.
+static void icm_fifo_publish(int64_t read_us)
+{
+    if (icm_fifo_batch_count == 0) {
+        return;
+    }
+    
+    int64_t offset = read_us - (int64_t)icm_fifo_batch[icm_fifo_batch_count - 1].timestamp_us;
+    if (!icm_clock_synced || offset < icm_clock_offset_us) {
+        icm_clock_offset_us = offset;
+        icm_clock_synced = true;
+    } else {
+        icm_clock_offset_us += (offset - icm_clock_offset_us) / 64;
+    }
+    
+    for (uint32_t i = 0; i < icm_fifo_batch_count; i++) {
+        const icm456xx_fifo_sample_t *raw = &icm_fifo_batch[i];
+        imu_6axis_sample_t sample;
+        
+        sample.timestamp_us = (uint64_t)((int64_t)raw->timestamp_us + icm_clock_offset_us);
+        icm_scale_sample(raw->accel, raw->gyro, raw->hires, &sample);
+        if (raw->hires) {
+            sample.temperature_mc = (int32_t)raw->temperature * 125 / 16 + 25000;   // 16-bit, 128 LSB/°C
+        } else {
+            sample.temperature_mc = (int32_t)raw->temperature * 500 + 25000;        // 8-bit, 2 LSB/°C
+        }
+        ahrs_update_from_sample(&sample);
+        sensor_stream_push(&imu_stream, &sample);
+    }
+    icm_fifo_batch_count = 0;
+}
+
+static void icm_fifo_collect_cb(const icm456xx_fifo_sample_t *sample, void *ctx)
+{
+    int64_t read_us = *(const int64_t *)ctx;
+    
+    if (icm_fifo_batch_count == ICM45686_FIFO_BATCH_SIZE) {
+        icm_fifo_publish(read_us);
+    }
+    icm_fifo_batch[icm_fifo_batch_count++] = *sample;
+}
+
+// Drains the ICM45686 FIFO in one burst per watermark interrupt
+static void icm_fifo_task(void *pvParameters)
+{
+    const TickType_t batch_ticks = pdMS_TO_TICKS(1000UL * ICM45686_FIFO_WATERMARK / sampling_rate_hz);
+    uint32_t read_errors = 0;
+    
+    while (icm_fifo_running) {
+        if (PIN_NUM_INT_ICM45686 != GPIO_NUM_NC) {
+            // Timeout doubles as a safety poll if an edge was missed
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+        } else {
+            vTaskDelay(batch_ticks > 0 ? batch_ticks : 1);
+        }
+        
+        if (!(enabled_sensors & SENSOR_IMU_6AXIS) ||
+            xSemaphoreTake(sensor_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+            continue;
+        }
+        
+        int64_t read_us = esp_timer_get_time();
+        icm_fifo_batch_count = 0;
+        int frames = icm456xx_read_fifo_stream(&imu_6axis_sensor, icm_fifo_collect_cb, &read_us);
+        
+        xSemaphoreGive(sensor_mutex);
+        
+        if (frames < 0) {
+            icm_fifo_batch_count = 0;
+            if ((++read_errors % 100) == 1) {
+                ESP_LOGW(TAG, "ICM45686 FIFO read failed: %d (errors=%lu)", frames, read_errors);
+            }
+            continue;
+        }
+        icm_fifo_publish(read_us);
+    }
+    
+    icm_fifo_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+// Full-ODR FIFO streaming with its drain task
+static bool icm_fifo_task_start(void)
+{
+    if (icm456xx_start_fifo_stream(&imu_6axis_sensor, PIN_NUM_INT_ICM45686, icm_fifo_isr, NULL,
+                                   sampling_rate_hz, ICM45686_FIFO_WATERMARK, icm_fifo_format()) != 0) {
+        return false;
+    }
+    
+    icm_fifo_running = true;
+    if (xTaskCreatePinnedToCore(icm_fifo_task, "icm_fifo", ICM_FIFO_TASK_STACK_SIZE, NULL,
+                                ICM_FIFO_TASK_PRIORITY, &icm_fifo_task_handle, 0) != pdPASS) {
+        icm_fifo_running = false;
+        icm456xx_stop_fifo_stream(&imu_6axis_sensor, PIN_NUM_INT_ICM45686);
+        return false;
+    }
+    icm_clock_synced = false;
+    icm_fifo_mode = true;
+    return true;
+}
+
+// Must be called without sensor_mutex: the task finishes its current drain first
+static void icm_fifo_task_stop(void)
+{
+    icm_fifo_running = false;
+    if (icm_fifo_task_handle) {
+        xTaskNotifyGive(icm_fifo_task_handle);
+    }
+    while (icm_fifo_task_handle) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    icm456xx_stop_fifo_stream(&imu_6axis_sensor, PIN_NUM_INT_ICM45686);
+    icm_fifo_mode = false;
+}
+
 esp_err_t imu_manager_init(void)
 {
     ESP_LOGI(TAG, "Initializing IMU Manager...");
@@ -86,6 +401,13 @@ esp_err_t imu_manager_init(void)
     if (ret != ESP_OK) {
         ESP_LOGW(TAG, "IIS2MDC not detected: %s", esp_err_to_name(ret));
     } else {
+        if (iis2mdc_enable_async(&mag_sensor) != ESP_OK) {
+            ESP_LOGW(TAG, "IIS2MDC async I2C unavailable, mag reads will not overlap SPI");
+        }
+        if (PIN_NUM_DRDY_IIS2MDC != GPIO_NUM_NC &&
+            iis2mdc_enable_drdy_pin(&mag_sensor, PIN_NUM_DRDY_IIS2MDC) != ESP_OK) {
+            ESP_LOGW(TAG, "IIS2MDC DRDY pin unavailable, gating on STATUS");
+        }
         ESP_LOGI(TAG, "IIS2MDC initialized successfully");
         enabled_sensors |= SENSOR_MAGNETOMETER;
     }
@@ -125,13 +447,27 @@ esp_err_t imu_manager_init(void)
         } else {
             icm456xx_start_accel(&imu_6axis_sensor, sampling_rate_hz, 16);
             icm456xx_start_gyro(&imu_6axis_sensor, sampling_rate_hz, 2000);
-            // Disable FIFO interrupt for now (pass GPIO_NUM_NC = -1 is causing error)
-            // ret = icm456xx_enable_fifo_interrupt(&imu_6axis_sensor, PIN_NUM_INT_ICM45686, NULL, fifo_watermark);
-            // if (ret != 0) {
-            //     ESP_LOGW(TAG, "ICM45686 FIFO interrupt setup returned %d", ret);
-            // }
-            ESP_LOGI(TAG, "ICM45686 initialized successfully");
+            
+            // Full-ODR FIFO streaming; register reads remain the fallback
+            if (sensor_stream_init(&imu_stream, sizeof(imu_6axis_sample_t), ICM45686_STREAM_CAPACITY) != ESP_OK ||
+                !icm_fifo_task_start()) {
+                ESP_LOGW(TAG, "ICM45686 FIFO streaming unavailable, using register reads");
+            }
+            ESP_LOGI(TAG, "ICM45686 initialized successfully (%s)",
+                     icm_fifo_mode ? (icm_fifo_hires ? "FIFO, 20-bit" : "FIFO") : "registers");
             enabled_sensors |= SENSOR_IMU_6AXIS;
+            
+            // Orientation is fused at the ICM45686 sample rate
+            ahrs_config_t ahrs_cfg = {
+                .sample_rate_hz = sampling_rate_hz,
+                .kp = AHRS_DEFAULT_KP,
+                .ki = AHRS_DEFAULT_KI,
+            };
+            if (ahrs_init(&ahrs_cfg) == ESP_OK) {
+                ahrs_rate_hz = sampling_rate_hz;
+            } else {
+                ESP_LOGW(TAG, "AHRS init failed");
+            }
         }
     }
     
@@ -149,42 +485,130 @@ esp_err_t imu_manager_init(void)
         }
     }
     
+    detected_sensors = enabled_sensors;
     ESP_LOGI(TAG, "IMU Manager initialized. Enabled sensors: 0x%02X", enabled_sensors);
     return ESP_OK;
 }
 
-esp_err_t imu_manager_read_all(imu_data_t *data)
+// SCL3300 fixed-point getters into the float fields: one single-precision
+// multiply per value, no double arithmetic
+static void incl_convert(imu_data_t *data)
 {
-    if (data == NULL) {
-        return ESP_ERR_INVALID_ARG;
-    }
+    data->inclinometer.angle_x_deg = scl3300_get_angle_x_mdeg(&inclinometer_sensor) * 1e-3f;
+    data->inclinometer.angle_y_deg = scl3300_get_angle_y_mdeg(&inclinometer_sensor) * 1e-3f;
+    data->inclinometer.angle_z_deg = scl3300_get_angle_z_mdeg(&inclinometer_sensor) * 1e-3f;
     
-    if (xSemaphoreTake(sensor_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
-        return ESP_ERR_TIMEOUT;
-    }
+    data->inclinometer.accel_x_g = scl3300_get_accel_x_ug(&inclinometer_sensor) * 1e-6f;
+    data->inclinometer.accel_y_g = scl3300_get_accel_y_ug(&inclinometer_sensor) * 1e-6f;
+    data->inclinometer.accel_z_g = scl3300_get_accel_z_ug(&inclinometer_sensor) * 1e-6f;
     
-    // Set timestamp
-    data->timestamp_us = esp_timer_get_time();
+    data->inclinometer.temperature_c = scl3300_get_temp_mc(&inclinometer_sensor) * 1e-3f;
+}
+
+// Reads the IIS3DWB and SCL3300 (those in sensors) in one batched bus cycle (sensor_mutex held)
+static void read_spi_cycle(imu_data_t *data, uint8_t sensors)
+{
+    spi_transaction_t *accel_t = NULL;
+    spi_transaction_t *incl_t = NULL;
     
-    // Read all enabled sensors
-    if (enabled_sensors & SENSOR_MAGNETOMETER) {
-        imu_manager_read_magnetometer(data);
-    }
+    data->accelerometer.valid = false;
+    data->inclinometer.valid = false;
     
-    if (enabled_sensors & SENSOR_ACCELEROMETER) {
-        imu_manager_read_accelerometer(data);
+    spi_batch_begin(&spi_cycle);
+    if (sensors & SENSOR_ACCELEROMETER) {
+        accel_t = spi_batch_add(&spi_cycle, accel_sensor.spi, 1);
+        if (accel_t != NULL) {
+            iis3dwb_prepare_accel_read(&accel_sensor, accel_t);
+        }
+    }
+    if (sensors & SENSOR_INCLINOMETER) {
+        incl_t = spi_batch_add(&spi_cycle, inclinometer_sensor.spi, SCL3300_AVAILABLE_FRAMES);
+        if (incl_t != NULL) {
+            scl3300_prepare_available(incl_t);
+        }
+    }
+    if (spi_cycle.count == 0 || spi_batch_run(&spi_cycle) != ESP_OK) {
+        return;
     }
     
-    if (enabled_sensors & SENSOR_IMU_6AXIS) {
-        imu_manager_read_imu_6axis(data);
+    if (accel_t != NULL) {
+        iis3dwb_parse_accel(&accel_sensor, &data->accelerometer.x_g,
+                            &data->accelerometer.y_g, &data->accelerometer.z_g);
+        data->accelerometer.valid = true;
+    }
+    if (incl_t != NULL && scl3300_parse_available(&inclinometer_sensor, incl_t) == ESP_OK) {
+        incl_convert(data);
+        data->inclinometer.valid = true;
     }
+}
+
+static void mag_store(imu_data_t *data, iis2mdc_raw_sample_t *raw)
+{
+    // Magnetometer correction for the AHRS. The IIS2MDC axes are taken as aligned
+    // with the ICM45686 body frame; the raw counts are fine, only the direction is used.
+    const int32_t mag[3] = { raw->mag.x, raw->mag.y, raw->mag.z };
+    ahrs_set_mag(esp_timer_get_time(), mag);
     
-    if (enabled_sensors & SENSOR_INCLINOMETER) {
-        imu_manager_read_inclinometer(data);
+    iis2mdc_convert_magnetic_raw_to_mg(&raw->mag, 
+                                     &data->magnetometer.x_mg,
+                                     &data->magnetometer.y_mg,
+                                     &data->magnetometer.z_mg);
+    iis2mdc_convert_temperature_raw_to_celsius(raw->temperature, &data->magnetometer.temperature_c);
+    data->magnetometer.valid = true;
+}
+
+static void cycle_stats_update(uint32_t i2c_us, uint32_t spi_us, uint32_t join_wait_us, uint32_t cycle_us)
+{
+    cycle_stats.cycles++;
+    cycle_stats.last_cycle_us = cycle_us;
+    cycle_stats.last_i2c_us = i2c_us;
+    cycle_stats.last_spi_us = spi_us;
+    cycle_stats.last_join_wait_us = join_wait_us;
+    if (cycle_us > cycle_stats.max_cycle_us) {
+        cycle_stats.max_cycle_us = cycle_us;
     }
+    cycle_stats.total_cycle_us += cycle_us;
+    cycle_stats.total_serial_us += i2c_us + spi_us;
     
-    xSemaphoreGive(sensor_mutex);
-    return ESP_OK;
+    if (cycle_stats.cycles % READ_CYCLE_LOG_INTERVAL == 0) {
+        spi_batch_stats_t bus;
+        spi_batch_get_stats(&bus);
+        ESP_LOGI(TAG, "Cycle %lu us (avg %lu, max %lu, serial avg %lu): SPI %lu us, I2C %lu us, join wait %lu us",
+                 cycle_us, (uint32_t)(cycle_stats.total_cycle_us / cycle_stats.cycles),
+                 cycle_stats.max_cycle_us, (uint32_t)(cycle_stats.total_serial_us / cycle_stats.cycles),
+                 spi_us, i2c_us, join_wait_us);
+        ESP_LOGI(TAG, "SPI batch: %lu transactions, busy %lu us (avg %lu, max %lu), wire %lu us",
+                 bus.last_transactions, bus.last_busy_us, bus.avg_busy_us,
+                 bus.max_busy_us, bus.last_wire_us);
+        
+        // Host fusion vs. eDMP forwarding, each while it was the active source
+        for (int src = 0; src < AHRS_SOURCE_COUNT; src++) {
+            ahrs_stats_t ahrs;
+            ahrs_get_source_stats((ahrs_source_t)src, &ahrs);
+            if (ahrs.updates == 0) {
+                continue;
+            }
+            ESP_LOGI(TAG, "AHRS %s%s: %lu updates at %lu Hz (%lu with mag), %lu cycles avg / %lu max, %lu ns, CPU %lu.%lu%%",
+                     (src == AHRS_SOURCE_HOST) ? "host" : "eDMP GAF",
+                     (src == (int)ahrs_get_source()) ? " (active)" : "",
+                     ahrs.updates, ahrs.sample_rate_hz, ahrs.mag_updates, ahrs.avg_cycles, ahrs.max_cycles,
+                     ahrs.avg_ns, ahrs.cpu_load_permille / 10, ahrs.cpu_load_permille % 10);
+        }
+    }
+}
+
+void imu_manager_get_cycle_stats(imu_cycle_stats_t *stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+    *stats = cycle_stats;
+    stats->avg_cycle_us = stats->cycles ? (uint32_t)(stats->total_cycle_us / stats->cycles) : 0;
+}
+
+void imu_manager_get_spi_bus_stats(spi_batch_stats_t *stats)
+{
+    spi_batch_get_stats(stats);
 }
 
 esp_err_t imu_manager_read_magnetometer(imu_data_t *data)
@@ -194,24 +618,12 @@ esp_err_t imu_manager_read_magnetometer(imu_data_t *data)
         return ESP_ERR_NOT_SUPPORTED;
     }
     
-    iis2mdc_raw_magnetometer_t raw_mag;
-    int16_t temp_raw;
-    
-    esp_err_t ret = iis2mdc_read_magnetic_raw(&mag_sensor, &raw_mag);
+    // One burst per sample; no new data (ESP_ERR_NOT_FOUND) leaves the sample out of the frame
+    iis2mdc_raw_sample_t raw;
+    data->magnetometer.valid = false;
+    esp_err_t ret = iis2mdc_read_sample_raw(&mag_sensor, &raw);
     if (ret == ESP_OK) {
-        iis2mdc_convert_magnetic_raw_to_mg(&raw_mag, 
-                                         &data->magnetometer.x_mg,
-                                         &data->magnetometer.y_mg,
-                                         &data->magnetometer.z_mg);
-        
-        ret = iis2mdc_read_temperature_raw(&mag_sensor, &temp_raw);
-        if (ret == ESP_OK) {
-            iis2mdc_convert_temperature_raw_to_celsius(temp_raw, &data->magnetometer.temperature_c);
-        }
-        
-        data->magnetometer.valid = true;
-    } else {
-        data->magnetometer.valid = false;
+        mag_store(data, &raw);
     }
     
     return ret;
@@ -241,6 +653,62 @@ esp_err_t imu_manager_read_accelerometer(imu_data_t *data)
     return ret;
 }
 
+#if ICM_GAF_SUPPORTED
+typedef struct {
+    int32_t quat_q30[4];
+    uint32_t outputs;
+} icm_gaf_ctx_t;
+
+static void icm_gaf_collect_cb(const inv_imu_edmp_gaf_outputs_t *out, void *ctx)
+{
+    icm_gaf_ctx_t *gaf = (icm_gaf_ctx_t *)ctx;
+    
+    memcpy(gaf->quat_q30, out->grv_quat_q30, sizeof(gaf->quat_q30));
+    gaf->outputs++;
+}
+#endif
+
+// Drains the eDMP outputs and forwards the newest quaternion, with what it cost
+// the host per output (decode, including the FIFO burst). Called with sensor_mutex held.
+static void icm_gaf_forward(uint64_t timestamp_us)
+{
+#if ICM_GAF_SUPPORTED
+    icm_gaf_ctx_t gaf = { .outputs = 0 };
+    uint32_t start = esp_cpu_get_cycle_count();
+    int rc = icm456xx_read_gaf_stream(&imu_6axis_sensor, icm_gaf_collect_cb, &gaf);
+    uint32_t cycles = esp_cpu_get_cycle_count() - start;
+    
+    if (rc >= 0 && gaf.outputs > 0) {
+        ahrs_publish_external(timestamp_us, gaf.quat_q30, cycles / gaf.outputs);
+    }
+#else
+    (void)timestamp_us;
+#endif
+}
+
+// Register read of the ICM45686 (eDMP mode or no FIFO), sensor_mutex held
+static esp_err_t read_6axis_registers(imu_6axis_sample_t *sample)
+{
+    inv_imu_sensor_data_t sensor_data;
+    if (icm456xx_get_data_from_registers(&imu_6axis_sensor, &sensor_data) != 0) {
+        return ESP_FAIL;
+    }
+    // Registers always hold 16-bit data
+    const int32_t accel[3] = { sensor_data.accel_data[0], sensor_data.accel_data[1], sensor_data.accel_data[2] };
+    const int32_t gyro[3] = { sensor_data.gyro_data[0], sensor_data.gyro_data[1], sensor_data.gyro_data[2] };
+    icm_scale_sample(accel, gyro, false, sample);
+    // 16-bit temperature register: 128 LSB/°C, 0 at 25 °C
+    sample->temperature_mc = (int32_t)sensor_data.temp_data * 125 / 16 + 25000;
+    sample->timestamp_us = esp_timer_get_time();
+    if (icm_gaf_mode) {
+        icm_gaf_forward(sample->timestamp_us);
+    } else {
+        ahrs_track_register_rate(sample->timestamp_us);
+        ahrs_update_from_sample(sample);
+    }
+    return ESP_OK;
+}
+
 esp_err_t imu_manager_read_imu_6axis(imu_data_t *data)
 {
     if (!(enabled_sensors & SENSOR_IMU_6AXIS)) {
@@ -248,32 +716,29 @@ esp_err_t imu_manager_read_imu_6axis(imu_data_t *data)
         return ESP_ERR_NOT_SUPPORTED;
     }
     
-    inv_imu_sensor_data_t sensor_data;
-    int ret = icm456xx_get_data_from_registers(&imu_6axis_sensor, &sensor_data);
+    imu_6axis_sample_t sample;
     
-    if (ret == 0) {
-        // Convert raw data to engineering units
-        // Assuming 16-bit data and ±16g range for accel, ±2000dps for gyro
-        const float accel_scale = 16.0f / 32768.0f;  // ±16g
-        const float gyro_scale = 2000.0f / 32768.0f; // ±2000dps
-        
-        data->imu_6axis.accel_x_g = sensor_data.accel_data[0] * accel_scale;
-        data->imu_6axis.accel_y_g = sensor_data.accel_data[1] * accel_scale;
-        data->imu_6axis.accel_z_g = sensor_data.accel_data[2] * accel_scale;
-        
-        data->imu_6axis.gyro_x_dps = sensor_data.gyro_data[0] * gyro_scale;
-        data->imu_6axis.gyro_y_dps = sensor_data.gyro_data[1] * gyro_scale;
-        data->imu_6axis.gyro_z_dps = sensor_data.gyro_data[2] * gyro_scale;
-        
-        // Temperature conversion (assuming 8-bit temp)
-        data->imu_6axis.temperature_c = sensor_data.temp_data + 25.0f;
-        
-        data->imu_6axis.valid = true;
-        return ESP_OK;
-    } else {
+    if (icm_fifo_mode) {
+        // Latest FIFO sample, no bus traffic
+        if (sensor_stream_get_latest(&imu_stream, &sample) != ESP_OK) {
+            data->imu_6axis.valid = false;
+            return ESP_ERR_NOT_FOUND;
+        }
+    } else if (read_6axis_registers(&sample) != ESP_OK) {
         data->imu_6axis.valid = false;
         return ESP_FAIL;
     }
+    
+    data->imu_6axis.accel_x_ug = sample.accel_x_ug;
+    data->imu_6axis.accel_y_ug = sample.accel_y_ug;
+    data->imu_6axis.accel_z_ug = sample.accel_z_ug;
+    data->imu_6axis.gyro_x_mdps = sample.gyro_x_mdps;
+    data->imu_6axis.gyro_y_mdps = sample.gyro_y_mdps;
+    data->imu_6axis.gyro_z_mdps = sample.gyro_z_mdps;
+    data->imu_6axis.temperature_mc = sample.temperature_mc;
+    data->imu_6axis.hires = sample.hires;
+    data->imu_6axis.valid = true;
+    return ESP_OK;
 }
 
 esp_err_t imu_manager_read_inclinometer(imu_data_t *data)
@@ -285,15 +750,7 @@ esp_err_t imu_manager_read_inclinometer(imu_data_t *data)
     
     esp_err_t ret = scl3300_available(&inclinometer_sensor);
     if (ret == ESP_OK) {
-        data->inclinometer.angle_x_deg = scl3300_get_angle_x(&inclinometer_sensor);
-        data->inclinometer.angle_y_deg = scl3300_get_angle_y(&inclinometer_sensor);
-        data->inclinometer.angle_z_deg = scl3300_get_angle_z(&inclinometer_sensor);
-        
-        data->inclinometer.accel_x_g = scl3300_get_accel_x(&inclinometer_sensor);
-        data->inclinometer.accel_y_g = scl3300_get_accel_y(&inclinometer_sensor);
-        data->inclinometer.accel_z_g = scl3300_get_accel_z(&inclinometer_sensor);
-        
-        data->inclinometer.temperature_c = scl3300_get_temp_c(&inclinometer_sensor);
+        incl_convert(data);
         data->inclinometer.valid = true;
     } else {
         data->inclinometer.valid = false;
@@ -302,10 +759,461 @@ esp_err_t imu_manager_read_inclinometer(imu_data_t *data)
     return ret;
 }
 
+static poll_group_t *poll_group_from_sensor(uint8_t sensor_id)
+{
+    for (int i = 0; i < POLL_COUNT; i++) {
+        if (poll_groups[i].sensor_id == sensor_id) {
+            return &poll_groups[i];
+        }
+    }
+    return NULL;
+}
+
+static bool poll_group_active(int index)
+{
+    const poll_group_t *group = &poll_groups[index];
+    
+    if (!(enabled_sensors & group->sensor_id) || group->rate_hz == 0 || group->stream->storage == NULL) {
+        return false;
+    }
+    return index != POLL_IMU_6AXIS || !icm_fifo_mode;
+}
+
+// One bus cycle for every sensor in due; sample timestamps are the read times
+static void sampler_service(uint8_t due)
+{
+    imu_data_t data;
+    
+    if (xSemaphoreTake(sensor_mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
+        return;
+    }
+    
+    // The magnetometer burst runs on the I2C controller during the SPI reads
+    int64_t mag_us = esp_timer_get_time();
+    esp_err_t mag_ret = ESP_ERR_NOT_SUPPORTED;
+    if (due & SENSOR_MAGNETOMETER) {
+        mag_ret = iis2mdc_read_sample_start(&mag_sensor);
+    }
+    
+    int64_t spi_start = esp_timer_get_time();
+    if (due & (SENSOR_ACCELEROMETER | SENSOR_INCLINOMETER)) {
+        uint64_t spi_us = esp_timer_get_time();
+        read_spi_cycle(&data, due);
+        if (data.accelerometer.valid) {
+            imu_accel_sample_t sample = {
+                .timestamp_us = spi_us,
+                .x_g = data.accelerometer.x_g,
+                .y_g = data.accelerometer.y_g,
+                .z_g = data.accelerometer.z_g,
+            };
+            sensor_stream_push(&accel_stream, &sample);
+        }
+        if (data.inclinometer.valid) {
+            imu_incl_sample_t sample = {
+                .timestamp_us = spi_us,
+                .angle_x_deg = data.inclinometer.angle_x_deg,
+                .angle_y_deg = data.inclinometer.angle_y_deg,
+                .angle_z_deg = data.inclinometer.angle_z_deg,
+                .accel_x_g = data.inclinometer.accel_x_g,
+                .accel_y_g = data.inclinometer.accel_y_g,
+                .accel_z_g = data.inclinometer.accel_z_g,
+                .temperature_c = data.inclinometer.temperature_c,
+            };
+            sensor_stream_push(&incl_stream, &sample);
+        }
+    }
+    
+    if (due & SENSOR_IMU_6AXIS) {
+        imu_6axis_sample_t sample;
+        if (read_6axis_registers(&sample) == ESP_OK) {
+            sensor_stream_push(&imu_stream, &sample);
+        }
+    }
+    int64_t spi_end = esp_timer_get_time();
+    
+    uint32_t i2c_us = 0;
+    if (mag_ret == ESP_OK) {
+        iis2mdc_raw_sample_t raw;
+        // ESP_ERR_NOT_FOUND: no new data since the last burst
+        if (iis2mdc_read_sample_finish(&mag_sensor, &raw) == ESP_OK) {
+            mag_store(&data, &raw);
+            imu_mag_sample_t sample = {
+                .timestamp_us = (uint64_t)mag_us,
+                .x_mg = data.magnetometer.x_mg,
+                .y_mg = data.magnetometer.y_mg,
+                .z_mg = data.magnetometer.z_mg,
+                .temperature_c = data.magnetometer.temperature_c,
+            };
+            sensor_stream_push(&mag_stream, &sample);
+        }
+        i2c_us = iis2mdc_get_burst_time_us(&mag_sensor);
+    }
+    int64_t cycle_end = esp_timer_get_time();
+    
+    cycle_stats_update(i2c_us, (uint32_t)(spi_end - spi_start),
+                       (uint32_t)(cycle_end - spi_end), (uint32_t)(cycle_end - mag_us));
+    
+    xSemaphoreGive(sensor_mutex);
+}
+
+static void sampler_task(void *pvParameters)
+{
+    while (sampler_running) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+        
+        uint64_t now = esp_timer_get_time();
+        uint8_t due = 0;
+        for (int i = 0; i < POLL_COUNT; i++) {
+            poll_group_t *group = &poll_groups[i];
+            if (!poll_group_active(i) || now < group->next_us) {
+                continue;
+            }
+            uint32_t period_us = 1000000UL / group->rate_hz;
+            group->next_us += period_us;
+            if (group->next_us <= now) {
+                // More than a period late: drop the missed reads instead of bursting
+                group->next_us = now + period_us;
+            }
+            due |= group->sensor_id;
+        }
+        if (due && sampler_running) {
+            sampler_service(due);
+        }
+    }
+    
+    sampler_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+static void sampler_timer_cb(void *arg)
+{
+    if (sampler_task_handle) {
+        xTaskNotifyGive(sampler_task_handle);
+    }
+}
+
+// Wakes the task at the fastest polled rate; slower groups wait for their due time
+static esp_err_t sampler_timer_restart(void)
+{
+    uint32_t max_rate_hz = 0;
+    uint64_t now = esp_timer_get_time();
+    
+    for (int i = 0; i < POLL_COUNT; i++) {
+        poll_groups[i].next_us = now;
+        // The FIFO task drains the ICM45686 while it streams
+        if (poll_group_active(i) && poll_groups[i].rate_hz > max_rate_hz) {
+            max_rate_hz = poll_groups[i].rate_hz;
+        }
+    }
+    esp_timer_stop(sampler_timer);
+    if (max_rate_hz == 0) {
+        return ESP_OK;
+    }
+    return esp_timer_start_periodic(sampler_timer, 1000000UL / max_rate_hz);
+}
+
+esp_err_t imu_manager_start_sampler(void)
+{
+    if (sensor_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (sampler_running) {
+        return ESP_OK;
+    }
+    
+    poll_groups[POLL_IMU_6AXIS].rate_hz = sampling_rate_hz;
+    for (int i = 0; i < POLL_COUNT; i++) {
+        poll_group_t *group = &poll_groups[i];
+        if (group->stream->storage == NULL &&
+            sensor_stream_init(group->stream, group->sample_size, group->stream_capacity) != ESP_OK) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    
+    if (sampler_timer == NULL) {
+        const esp_timer_create_args_t args = {
+            .callback = sampler_timer_cb,
+            .name = "imu_sampler",
+        };
+        esp_err_t ret = esp_timer_create(&args, &sampler_timer);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    
+    sampler_running = true;
+    if (xTaskCreatePinnedToCore(sampler_task, "imu_sampler", SAMPLER_TASK_STACK_SIZE, NULL,
+                                SAMPLER_TASK_PRIORITY, &sampler_task_handle, 0) != pdPASS) {
+        sampler_running = false;
+        return ESP_ERR_NO_MEM;
+    }
+    
+    esp_err_t ret = sampler_timer_restart();
+    ESP_LOGI(TAG, "Sampler started: IIS3DWB %lu Hz, SCL3300 %lu Hz, IIS2MDC %lu Hz, ICM45686 %lu Hz (%s)",
+             poll_groups[POLL_ACCELEROMETER].rate_hz, poll_groups[POLL_INCLINOMETER].rate_hz,
+             poll_groups[POLL_MAGNETOMETER].rate_hz, sampling_rate_hz, icm_fifo_mode ? "FIFO" : "polled");
+    return ret;
+}
+
+esp_err_t imu_manager_stop_sampler(void)
+{
+    if (!sampler_running) {
+        return ESP_OK;
+    }
+    
+    sampler_running = false;
+    esp_timer_stop(sampler_timer);
+    if (sampler_task_handle) {
+        xTaskNotifyGive(sampler_task_handle);
+    }
+    while (sampler_task_handle) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    return ESP_OK;
+}
+
+esp_err_t imu_manager_set_sensor_rate(uint8_t sensor_id, uint32_t rate_hz)
+{
+    poll_group_t *group = poll_group_from_sensor(sensor_id);
+    
+    // The ICM45686 rate is its FIFO ODR (imu_manager_set_sampling_rate)
+    if (group == NULL || sensor_id == SENSOR_IMU_6AXIS) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (rate_hz == 0 || rate_hz > group->max_rate_hz) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    group->rate_hz = rate_hz;
+    if (sampler_running) {
+        return sampler_timer_restart();
+    }
+    return ESP_OK;
+}
+
+uint32_t imu_manager_get_sensor_rate(uint8_t sensor_id)
+{
+    if (sensor_id == SENSOR_IMU_6AXIS) {
+        return sampling_rate_hz;
+    }
+    poll_group_t *group = poll_group_from_sensor(sensor_id);
+    return (group != NULL) ? group->rate_hz : 0;
+}
+
+// The FIFO stream could not be restarted: stop its drain task and hand the
+// ICM45686 to the sampler's register reads. Called without sensor_mutex.
+static void icm_fifo_fall_back(void)
+{
+    ESP_LOGW(TAG, "ICM45686 FIFO restart failed, using register reads");
+    icm_fifo_task_stop();
+    
+    // The poll group is active again; restart its schedule from now
+    poll_groups[POLL_IMU_6AXIS].rate_hz = sampling_rate_hz;
+    if (sampler_running) {
+        sampler_timer_restart();
+    } else if (imu_manager_start_sampler() != ESP_OK) {
+        ESP_LOGE(TAG, "ICM45686 register reads could not be started");
+    }
+}
+
+esp_err_t imu_manager_set_imu_hires(bool enable)
+{
+    // Before init only the preference is stored
+    if (sensor_mutex == NULL || !(enabled_sensors & SENSOR_IMU_6AXIS)) {
+        icm_fifo_hires = enable;
+        return ESP_OK;
+    }
+    
+    // 20-bit data only exists in FIFO packets
+    if (!icm_fifo_mode) {
+        return enable ? ESP_ERR_NOT_SUPPORTED : ESP_OK;
+    }
+    if (enable == icm_fifo_hires) {
+        return ESP_OK;
+    }
+    
+    if (xSemaphoreTake(sensor_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    
+    uint16_t icm_odr = sampling_rate_hz;
+    icm456xx_stop_fifo_stream(&imu_6axis_sensor, PIN_NUM_INT_ICM45686);
+    icm_fifo_hires = enable;
+    int rc = icm456xx_start_fifo_stream(&imu_6axis_sensor, PIN_NUM_INT_ICM45686, icm_fifo_isr, NULL,
+                                        icm_odr, ICM45686_FIFO_WATERMARK, icm_fifo_format());
+    if (rc != 0) {
+        // Go back to the previous format
+        icm_fifo_hires = !enable;
+        rc = icm456xx_start_fifo_stream(&imu_6axis_sensor, PIN_NUM_INT_ICM45686, icm_fifo_isr, NULL,
+                                        icm_odr, ICM45686_FIFO_WATERMARK, icm_fifo_format());
+        xSemaphoreGive(sensor_mutex);
+        if (rc != 0) {
+            icm_fifo_fall_back();
+        }
+        return ESP_FAIL;
+    }
+    icm_clock_synced = false;
+    xSemaphoreGive(sensor_mutex);
+    
+    imu_6axis_format_t format;
+    imu_manager_get_imu_format(&format);
+    ESP_LOGI(TAG, "ICM45686 FIFO %s: %lu B/frame, %lu B/s, LSB %lu ug / %lu udps",
+             enable ? "20-bit" : "16-bit", format.fifo_frame_bytes, format.fifo_bytes_per_s,
+             format.accel_lsb_ug, format.gyro_lsb_udps);
+    return ESP_OK;
+}
+
+bool imu_manager_get_imu_hires(void)
+{
+    return icm_fifo_hires;
+}
+
+esp_err_t imu_manager_set_orientation_source(ahrs_source_t source)
+{
+    if (source >= AHRS_SOURCE_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if ((source == AHRS_SOURCE_EDMP_GAF) == icm_gaf_mode) {
+        return ESP_OK;
+    }
+#if ICM_GAF_SUPPORTED
+    bool gaf_failed = false;
+    
+    if (sensor_mutex == NULL || !(enabled_sensors & SENSOR_IMU_6AXIS)) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    
+    // The FIFO belongs to either the drain task or the eDMP
+    if (icm_fifo_mode) {
+        icm_fifo_task_stop();
+    }
+    if (xSemaphoreTake(sensor_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    
+    if (source == AHRS_SOURCE_EDMP_GAF) {
+        if (icm456xx_start_gaf(&imu_6axis_sensor, PIN_NUM_INT_ICM45686, NULL) == 0) {
+            icm_gaf_mode = true;
+        } else {
+            ESP_LOGW(TAG, "ICM45686 eDMP GAF start failed, keeping host fusion");
+            icm456xx_stop_gaf(&imu_6axis_sensor, PIN_NUM_INT_ICM45686);
+            gaf_failed = true;
+        }
+    } else {
+        icm456xx_stop_gaf(&imu_6axis_sensor, PIN_NUM_INT_ICM45686);
+        icm_gaf_mode = false;
+    }
+    
+    if (!icm_gaf_mode) {
+        // Host fusion on the full-rate FIFO stream, registers as the fallback
+        icm456xx_start_accel(&imu_6axis_sensor, sampling_rate_hz, 16);
+        icm456xx_start_gyro(&imu_6axis_sensor, sampling_rate_hz, 2000);
+    }
+    xSemaphoreGive(sensor_mutex);
+    
+    if (!icm_gaf_mode && !icm_fifo_task_start()) {
+        icm_fifo_fall_back();
+    } else if (sampler_running) {
+        // The FIFO task and the sampler trade the ICM45686 group
+        sampler_timer_restart();
+    }
+    
+    ahrs_last_reg_us = 0;
+    ahrs_set_source(icm_gaf_mode ? AHRS_SOURCE_EDMP_GAF : AHRS_SOURCE_HOST,
+                    icm_gaf_mode ? ICM456XX_GAF_ODR_HZ : sampling_rate_hz);
+    ahrs_rate_hz = sampling_rate_hz;
+    return gaf_failed ? ESP_FAIL : ESP_OK;
+#else
+    // Needs the ICM45686S eDMP GAF image and driver
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+ahrs_source_t imu_manager_get_orientation_source(void)
+{
+    return icm_gaf_mode ? AHRS_SOURCE_EDMP_GAF : AHRS_SOURCE_HOST;
+}
+
+esp_err_t imu_manager_get_imu_format(imu_6axis_format_t *format)
+{
+    if (format == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    const bool hires = icm_fifo_mode && icm_fifo_hires;
+    
+    memset(format, 0, sizeof(*format));
+    format->hires = hires;
+    format->fifo = icm_fifo_mode;
+    if (icm_fifo_mode) {
+        // Upper bound with compression: compressed frames pack several samples
+        format->fifo_frame_bytes = icm456xx_get_fifo_frame_size(&imu_6axis_sensor);
+        format->fifo_bytes_per_s = format->fifo_frame_bytes * sampling_rate_hz;
+    }
+    format->accel_lsb_ug = ICM_FIXED_MUL >> (hires ? ICM_ACCEL_SHIFT_HIRES : ICM_ACCEL_SHIFT_16BIT);
+    format->gyro_lsb_udps = (ICM_FIXED_MUL * 1000) >> (hires ? ICM_GYRO_SHIFT_HIRES : ICM_GYRO_SHIFT_16BIT);
+    return ESP_OK;
+}
+
 esp_err_t imu_manager_set_sampling_rate(uint32_t rate_hz)
 {
+    if (!icm_odr_supported(rate_hz)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Before init only the rate is stored
+    if (sensor_mutex == NULL || !(detected_sensors & SENSOR_IMU_6AXIS)) {
+        sampling_rate_hz = rate_hz;
+        ESP_LOGI(TAG, "Sampling rate set to %lu Hz", rate_hz);
+        return ESP_OK;
+    }
+    // The eDMP runs the sensor at its own rate
+    if (icm_gaf_mode) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (rate_hz == sampling_rate_hz) {
+        return ESP_OK;
+    }
+    
+    if (xSemaphoreTake(sensor_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    
+    // The FIFO restarts at the new ODR, like a format change
+    uint32_t old_rate_hz = sampling_rate_hz;
+    if (icm_fifo_mode) {
+        icm456xx_stop_fifo_stream(&imu_6axis_sensor, PIN_NUM_INT_ICM45686);
+    }
+    int rc = icm456xx_start_accel(&imu_6axis_sensor, rate_hz, 16);
+    rc |= icm456xx_start_gyro(&imu_6axis_sensor, rate_hz, 2000);
+    if (rc == 0 && icm_fifo_mode) {
+        rc = icm456xx_start_fifo_stream(&imu_6axis_sensor, PIN_NUM_INT_ICM45686, icm_fifo_isr, NULL,
+                                        rate_hz, ICM45686_FIFO_WATERMARK, icm_fifo_format());
+    }
+    if (rc != 0) {
+        // Go back to the previous rate
+        icm456xx_start_accel(&imu_6axis_sensor, old_rate_hz, 16);
+        icm456xx_start_gyro(&imu_6axis_sensor, old_rate_hz, 2000);
+        bool fifo_lost = icm_fifo_mode &&
+            icm456xx_start_fifo_stream(&imu_6axis_sensor, PIN_NUM_INT_ICM45686, icm_fifo_isr, NULL,
+                                       old_rate_hz, ICM45686_FIFO_WATERMARK, icm_fifo_format()) != 0;
+        xSemaphoreGive(sensor_mutex);
+        if (fifo_lost) {
+            icm_fifo_fall_back();
+        }
+        return ESP_FAIL;
+    }
     sampling_rate_hz = rate_hz;
-    ESP_LOGI(TAG, "Sampling rate set to %lu Hz", rate_hz);
+    poll_groups[POLL_IMU_6AXIS].rate_hz = rate_hz;
+    icm_clock_synced = false;
+    xSemaphoreGive(sensor_mutex);
+    
+    if (!icm_fifo_mode && sampler_running) {
+        sampler_timer_restart();
+    }
+    if (ahrs_set_sample_rate(rate_hz) == ESP_OK) {
+        ahrs_rate_hz = rate_hz;
+    }
+    ESP_LOGI(TAG, "ICM45686 ODR %lu Hz -> %lu Hz", old_rate_hz, rate_hz);
     return ESP_OK;
 }
 
@@ -318,6 +1226,10 @@ esp_err_t imu_manager_set_fifo_watermark(uint16_t watermark)
 
 esp_err_t imu_manager_enable_sensor(uint8_t sensor_id, bool enable)
 {
+    // After init a sensor that did not come up stays off
+    if (enable && sensor_mutex != NULL && (sensor_id & ~detected_sensors)) {
+        return ESP_ERR_NOT_FOUND;
+    }
     if (enable) {
         enabled_sensors |= sensor_id;
     } else {
@@ -325,11 +1237,47 @@ esp_err_t imu_manager_enable_sensor(uint8_t sensor_id, bool enable)
     }
     
     ESP_LOGI(TAG, "Sensor 0x%02X %s", sensor_id, enable ? "enabled" : "disabled");
+    // The sampler wakes at the fastest rate still polled
+    if (sampler_running) {
+        return sampler_timer_restart();
+    }
     return ESP_OK;
 }
 
+sensor_stream_t *imu_manager_get_stream(uint8_t sensor_id)
+{
+    // The ICM45686 stream is fed by the FIFO task, the others by the sampler
+    if (sensor_id == SENSOR_IMU_6AXIS && icm_fifo_mode) {
+        return &imu_stream;
+    }
+    poll_group_t *group = poll_group_from_sensor(sensor_id);
+    if (group == NULL || !sampler_running || group->stream->storage == NULL) {
+        return NULL;
+    }
+    return group->stream;
+}
+
 esp_err_t imu_manager_deinit(void)
 {
+    imu_manager_stop_sampler();
+    if (sampler_timer) {
+        esp_timer_delete(sampler_timer);
+        sampler_timer = NULL;
+    }
+    if (icm_fifo_mode) {
+        icm_fifo_task_stop();
+    }
+#if ICM_GAF_SUPPORTED
+    if (icm_gaf_mode) {
+        icm456xx_stop_gaf(&imu_6axis_sensor, PIN_NUM_INT_ICM45686);
+        icm_gaf_mode = false;
+    }
+#endif
+    sensor_stream_deinit(&imu_stream);
+    sensor_stream_deinit(&accel_stream);
+    sensor_stream_deinit(&incl_stream);
+    sensor_stream_deinit(&mag_stream);
+    
     if (sensor_mutex) {
         vSemaphoreDelete(sensor_mutex);
         sensor_mutex = NULL;
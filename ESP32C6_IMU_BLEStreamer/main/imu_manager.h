@@ -2,6 +2,9 @@
 #define IMU_MANAGER_H
 
 #include "esp_err.h"
+#include "sensor_stream.h"
+#include "spi_batch.h"
+#include "ahrs.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -26,15 +29,16 @@ typedef struct {
         bool valid;
     } accelerometer;
     
-    // ICM45686 - IMU 6-axis
+    // ICM45686 - IMU 6-axis, 32-bit fixed point so 20-bit FIFO data keeps its resolution
     struct {
-        float accel_x_g;
-        float accel_y_g;
-        float accel_z_g;
-        float gyro_x_dps;
-        float gyro_y_dps;
-        float gyro_z_dps;
-        float temperature_c;
+        int32_t accel_x_ug;
+        int32_t accel_y_ug;
+        int32_t accel_z_ug;
+        int32_t gyro_x_mdps;
+        int32_t gyro_y_mdps;
+        int32_t gyro_z_mdps;
+        int32_t temperature_mc;     // milli-degrees Celsius
+        bool hires;                 // Decoded from 20-bit high-resolution FIFO packets
         bool valid;
     } imu_6axis;
     
@@ -52,18 +56,110 @@ typedef struct {
     
 } imu_data_t;
 
+// Per-sensor timestamped samples of the sampler streams
+typedef struct {
+    uint64_t timestamp_us;
+    float x_mg;
+    float y_mg;
+    float z_mg;
+    float temperature_c;
+} imu_mag_sample_t;
+
+typedef struct {
+    uint64_t timestamp_us;
+    float x_g;
+    float y_g;
+    float z_g;
+} imu_accel_sample_t;
+
+typedef struct {
+    uint64_t timestamp_us;
+    float angle_x_deg;
+    float angle_y_deg;
+    float angle_z_deg;
+    float accel_x_g;
+    float accel_y_g;
+    float accel_z_g;
+    float temperature_c;
+} imu_incl_sample_t;
+
+// ICM45686 FIFO sample (one per ODR tick)
+typedef struct {
+    uint64_t timestamp_us;
+    int32_t accel_x_ug;
+    int32_t accel_y_ug;
+    int32_t accel_z_ug;
+    int32_t gyro_x_mdps;
+    int32_t gyro_y_mdps;
+    int32_t gyro_z_mdps;
+    int32_t temperature_mc;
+    bool hires;
+} imu_6axis_sample_t;
+
+// ICM45686 data format and what it costs per sample
+typedef struct {
+    bool hires;                 // 20-bit FIFO packets active
+    bool fifo;                  // FIFO streaming (false: register reads)
+    uint32_t fifo_frame_bytes;  // Bytes per FIFO frame on the SPI bus
+    uint32_t fifo_bytes_per_s;  // SPI payload at the current ODR
+    uint32_t accel_lsb_ug;      // Resolution of one accel count
+    uint32_t gyro_lsb_udps;     // Resolution of one gyro count
+} imu_6axis_format_t;
+
+// Sampler bus cycle timing: the I2C magnetometer burst overlaps the SPI reads
+typedef struct {
+    uint32_t cycles;
+    uint32_t last_cycle_us;
+    uint32_t avg_cycle_us;
+    uint32_t max_cycle_us;
+    uint32_t last_i2c_us;       // Magnetometer burst, issue to completion
+    uint32_t last_spi_us;       // SPI sensors
+    uint32_t last_join_wait_us; // Waiting for the I2C burst after the SPI reads
+    uint64_t total_cycle_us;
+    uint64_t total_serial_us;   // Sum of the I2C and SPI parts: the same cycle without overlap
+} imu_cycle_stats_t;
+
 // IMU Manager API
 esp_err_t imu_manager_init(void);
-esp_err_t imu_manager_read_all(imu_data_t *data);
 esp_err_t imu_manager_read_magnetometer(imu_data_t *data);
 esp_err_t imu_manager_read_accelerometer(imu_data_t *data);
 esp_err_t imu_manager_read_imu_6axis(imu_data_t *data);
 esp_err_t imu_manager_read_inclinometer(imu_data_t *data);
 esp_err_t imu_manager_deinit(void);
 
+// Sampler: polls the IIS3DWB, SCL3300 and IIS2MDC (and the ICM45686 while its
+// FIFO is off) at their own rates into one stream per sensor
+esp_err_t imu_manager_start_sampler(void);
+esp_err_t imu_manager_stop_sampler(void);
+// Polling rate of a sampler sensor; the ICM45686 rate is its FIFO ODR
+esp_err_t imu_manager_set_sensor_rate(uint8_t sensor_id, uint32_t rate_hz);
+uint32_t imu_manager_get_sensor_rate(uint8_t sensor_id);
+// Sample stream of a sensor: imu_6axis_sample_t from the ICM45686 FIFO, the
+// imu_*_sample_t of the sampler otherwise (NULL if the sensor is not streamed)
+sensor_stream_t *imu_manager_get_stream(uint8_t sensor_id);
+// Occupancy of the batched SPI cycles (IIS3DWB + SCL3300 register reads)
+void imu_manager_get_spi_bus_stats(spi_batch_stats_t *stats);
+// Timing of the sampler's bus cycles, whose I2C burst overlaps the SPI reads
+void imu_manager_get_cycle_stats(imu_cycle_stats_t *stats);
+
+// ICM45686 high-resolution (20-bit) FIFO mode, switchable at runtime.
+// Hires packets are 20 bytes instead of 16 and disable FIFO compression.
+esp_err_t imu_manager_set_imu_hires(bool enable);
+bool imu_manager_get_imu_hires(void);
+
+// Orientation source: the host AHRS on the FIFO stream, or the ICM45686 eDMP
+// game rotation vector (ICM45686S builds only, ESP_ERR_NOT_SUPPORTED otherwise).
+// In eDMP mode the ICM45686 is read from the registers by the sampler.
+esp_err_t imu_manager_set_orientation_source(ahrs_source_t source);
+ahrs_source_t imu_manager_get_orientation_source(void);
+esp_err_t imu_manager_get_imu_format(imu_6axis_format_t *format);
+
 // Configuration functions
+// ICM45686 ODR (25-1600 Hz, doubling from 25); after init the sensor and its
+// FIFO restart at the new rate. Other rates return ESP_ERR_INVALID_ARG.
 esp_err_t imu_manager_set_sampling_rate(uint32_t rate_hz);
 esp_err_t imu_manager_set_fifo_watermark(uint16_t watermark);
+// Runtime on/off of a sensor's reads; ESP_ERR_NOT_FOUND for one that failed init
 esp_err_t imu_manager_enable_sensor(uint8_t sensor_id, bool enable);
 
 // Sensor IDs
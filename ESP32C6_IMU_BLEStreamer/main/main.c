@@ -32,9 +32,14 @@ void app_main(void)
         .enable_iis3dwb = true,
         .enable_icm45686 = true,
         .enable_scl3300 = true,
+        .enable_ahrs = true,
+        .ahrs_on_edmp = false,      // ICM45686S only: offload fusion to the sensor's eDMP
         .iis3dwb_odr_hz = 800,
         .icm45686_odr_hz = 400,
-        .packet_interval_ms = 20    // ~50 Hz notify bursts (min: 10ms for BLE stability)
+        .icm45686_hires = false,    // 20-bit ICM45686 data for low-amplitude monitoring
+        .packet_interval_ms = 20,   // Latency bound: partial frames go out after 20 ms (min: 10ms)
+        .delta_codec = true,        // Bit-packed sample blocks (block type | 0x80), see ble_codec.h
+        .keyframe_interval = 0,     // Default: a decoder resyncs within 16 frames after a lost one
     };
     ESP_ERROR_CHECK(imu_ble_init(&cfg));
 
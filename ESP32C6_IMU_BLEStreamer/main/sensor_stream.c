@@ -0,0 +1,134 @@
+#include "sensor_stream.h"
+#include "esp_log.h"
+#include <string.h>
+#include <stdlib.h>
+
+static const char *TAG = "SENSOR_STREAM";
+
+esp_err_t sensor_stream_init(sensor_stream_t *stream, size_t elem_size, uint32_t capacity)
+{
+    if (stream == NULL || elem_size == 0 || capacity == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(stream, 0, sizeof(*stream));
+
+    // Power-of-two capacity keeps slot indexing continuous across write_seq wrap
+    while (capacity & (capacity - 1)) {
+        capacity += capacity & -capacity;
+    }
+
+    stream->storage = calloc(capacity, elem_size);
+    if (stream->storage == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate %u x %u bytes", (unsigned)capacity, (unsigned)elem_size);
+        return ESP_ERR_NO_MEM;
+    }
+
+    stream->mutex = xSemaphoreCreateMutex();
+    if (stream->mutex == NULL) {
+        free(stream->storage);
+        stream->storage = NULL;
+        return ESP_FAIL;
+    }
+
+    stream->elem_size = elem_size;
+    stream->capacity = capacity;
+    return ESP_OK;
+}
+
+void sensor_stream_deinit(sensor_stream_t *stream)
+{
+    if (stream == NULL) {
+        return;
+    }
+
+    if (stream->mutex) {
+        vSemaphoreDelete(stream->mutex);
+    }
+    free(stream->storage);
+    memset(stream, 0, sizeof(*stream));
+}
+
+esp_err_t sensor_stream_push(sensor_stream_t *stream, const void *sample)
+{
+    if (stream == NULL || stream->storage == NULL || sample == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Producers run in the acquisition tasks: never wait long for a reader
+    if (xSemaphoreTake(stream->mutex, pdMS_TO_TICKS(2)) != pdTRUE) {
+        stream->dropped++;
+        return ESP_ERR_TIMEOUT;
+    }
+
+    uint32_t slot = stream->write_seq % stream->capacity;
+    memcpy(stream->storage + slot * stream->elem_size, sample, stream->elem_size);
+    stream->write_seq++;
+
+    xSemaphoreGive(stream->mutex);
+    return ESP_OK;
+}
+
+esp_err_t sensor_stream_get_latest(sensor_stream_t *stream, void *sample)
+{
+    if (stream == NULL || stream->storage == NULL || sample == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (xSemaphoreTake(stream->mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    if (stream->write_seq == 0) {
+        xSemaphoreGive(stream->mutex);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    uint32_t slot = (stream->write_seq - 1) % stream->capacity;
+    memcpy(sample, stream->storage + slot * stream->elem_size, stream->elem_size);
+
+    xSemaphoreGive(stream->mutex);
+    return ESP_OK;
+}
+
+uint32_t sensor_stream_read(sensor_stream_t *stream, uint32_t *cursor,
+                            void *samples, uint32_t max_samples)
+{
+    if (stream == NULL || stream->storage == NULL || cursor == NULL || samples == NULL) {
+        return 0;
+    }
+
+    if (xSemaphoreTake(stream->mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
+        return 0;
+    }
+
+    uint32_t available = stream->write_seq - *cursor;
+    if (available > stream->capacity) {
+        // Reader fell behind: skip to the oldest sample still in the ring
+        *cursor = stream->write_seq - stream->capacity;
+        available = stream->capacity;
+    }
+
+    uint32_t n = (available < max_samples) ? available : max_samples;
+    uint8_t *out = (uint8_t *)samples;
+    uint32_t slot = *cursor % stream->capacity;
+
+    // Copy in at most two contiguous chunks
+    uint32_t first = stream->capacity - slot;
+    if (first > n) {
+        first = n;
+    }
+    memcpy(out, stream->storage + slot * stream->elem_size, first * stream->elem_size);
+    if (n > first) {
+        memcpy(out + first * stream->elem_size, stream->storage, (n - first) * stream->elem_size);
+    }
+    *cursor += n;
+
+    xSemaphoreGive(stream->mutex);
+    return n;
+}
+
+uint32_t sensor_stream_get_seq(sensor_stream_t *stream)
+{
+    return (stream != NULL) ? stream->write_seq : 0;
+}
@@ -16,6 +16,31 @@ extern "C" {
 #include "../imu/inv_imu_edmp_gaf.h"
 #endif
 
+/* FIFO packet formats (compression and high resolution are exclusive) */
+typedef enum {
+    ICM456XX_FIFO_FORMAT_16BIT = 0,       /* 16-byte frames, 16-bit data at the configured FSR */
+    ICM456XX_FIFO_FORMAT_COMPRESSED,      /* delta-compressed frames, 16-bit data */
+    ICM456XX_FIFO_FORMAT_HIRES,           /* 20-byte frames, 20-bit data at +-32 g / +-4000 dps */
+} icm456xx_fifo_format_t;
+
+/* One accel+gyro sample decoded from the FIFO */
+typedef struct {
+    uint64_t timestamp_us;                /* device clock (FIFO timestamps), extended to 64 bit */
+    int32_t accel[3];                     /* 16-bit, or 20-bit when hires is set */
+    int32_t gyro[3];
+    int16_t temperature;                  /* 8-bit FIFO temperature sign extended, 16-bit when hires */
+    bool hires;
+    int sensor_mask;                      /* (1 << INV_SENSOR_ACCEL) | (1 << INV_SENSOR_GYRO) | ... */
+} icm456xx_fifo_sample_t;
+
+/* Called once per decoded FIFO sample from icm456xx_read_fifo_stream() */
+typedef void (*icm456xx_fifo_cb_t)(const icm456xx_fifo_sample_t *sample, void *ctx);
+
+#if defined(ICM45686S) || defined(ICM45605S)
+/* Called once per eDMP GAF output decoded by icm456xx_read_gaf_stream() */
+typedef void (*icm456xx_gaf_cb_t)(const inv_imu_edmp_gaf_outputs_t *out, void *ctx);
+#endif
+
 /* Public opaque device handle */
 typedef struct icm456xx_dev_t {
     inv_imu_device_t icm_driver;          /* driver instance (from inv_imu driver) */
@@ -29,8 +54,21 @@ typedef struct icm456xx_dev_t {
 #if defined(ICM45686S) || defined(ICM45605S)
     inv_imu_edmp_gaf_outputs_t gaf_outputs_internal;
     int gaf_status;
+    icm456xx_gaf_cb_t gaf_cb;
+    void *gaf_cb_ctx;
 #endif
     inv_imu_edmp_int_state_t apex_status;
+    /* FIFO streaming state */
+    uint8_t *fifo_buf;                    /* burst read buffer */
+    bool fifo_hires;                      /* 20-bit packets (also used by icm456xx_enable_fifo_interrupt) */
+    icm456xx_fifo_cb_t fifo_cb;
+    void *fifo_cb_ctx;
+    bool fifo_frame_has_ts;               /* current frame carries a FIFO timestamp */
+    bool fifo_ts_valid;
+    uint16_t fifo_last_ts;
+    uint32_t fifo_tmst_resol_us;
+    uint32_t fifo_period_us;
+    uint64_t fifo_time_us;
 } icm456xx_dev_t;
 
 /* APEX indices used internally for apex_enable[] */
@@ -72,11 +110,33 @@ int icm456xx_get_data_from_registers(icm456xx_dev_t *dev, inv_imu_sensor_data_t
 int icm456xx_enable_fifo_interrupt(icm456xx_dev_t *dev, int int_gpio, void (*user_isr)(void*), uint8_t fifo_watermark);
 int icm456xx_get_data_from_fifo(icm456xx_dev_t *dev, inv_imu_fifo_data_t *data);
 
+/* FIFO streaming: stream mode FIFO with timestamps and optional compression.
+   - int_gpio: INT1 pin for the watermark interrupt, or -1 to poll
+   - isr/isr_arg: called from ISR context on each watermark interrupt
+   - odr_hz: accel/gyro ODR already set with icm456xx_start_accel/gyro
+   - format: packet format, see icm456xx_fifo_format_t
+   icm456xx_read_fifo_stream() burst-reads the frames currently in the FIFO and
+   calls cb for every decoded sample. Returns the number of frames read or < 0.
+*/
+int icm456xx_start_fifo_stream(icm456xx_dev_t *dev, int int_gpio, void (*isr)(void*), void *isr_arg,
+                               uint16_t odr_hz, uint16_t fifo_watermark, icm456xx_fifo_format_t format);
+int icm456xx_read_fifo_stream(icm456xx_dev_t *dev, icm456xx_fifo_cb_t cb, void *ctx);
+int icm456xx_stop_fifo_stream(icm456xx_dev_t *dev, int int_gpio);
+/* Bytes per FIFO frame of the active configuration (0 if the FIFO is off) */
+int icm456xx_get_fifo_frame_size(icm456xx_dev_t *dev);
+
 /* APEX / GAF (only available when compiled with appropriate defines) */
 #if defined(ICM45686S) || defined(ICM45605S)
 int icm456xx_start_gaf(icm456xx_dev_t *dev, int int_gpio, void (*user_isr)(void*));
 int icm456xx_get_gaf_data(icm456xx_dev_t *dev, inv_imu_edmp_gaf_outputs_t *out);
 int icm456xx_get_gaf_quat(icm456xx_dev_t *dev, float *w, float *x, float *y, float *z);
+/* GAF streaming: the FIFO carries only the eDMP outputs (game rotation vector
+   at GAF_ODR_HZ); accel/gyro stay readable from the data registers.
+   icm456xx_read_gaf_stream() drains the FIFO once and calls cb for every output.
+   Returns the number of FIFO packets read or < 0. */
+#define ICM456XX_GAF_ODR_HZ 100
+int icm456xx_read_gaf_stream(icm456xx_dev_t *dev, icm456xx_gaf_cb_t cb, void *ctx);
+int icm456xx_stop_gaf(icm456xx_dev_t *dev, int int_gpio);
 #endif
 
 /* APEX features */
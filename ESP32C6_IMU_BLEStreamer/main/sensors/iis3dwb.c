@@ -18,7 +18,7 @@ esp_err_t iis3dwb_init_spi(iis3dwb_handle_t *dev, spi_host_device_t host, gpio_n
         .clock_speed_hz = 10 * 1000 * 1000,
         .mode = 3,
         .spics_io_num = cs_pin,
-        .queue_size = 1
+        .queue_size = IIS3DWB_QUEUE_SIZE
     };
     return spi_bus_add_device(host, &devcfg, &dev->spi);
 }
@@ -63,8 +63,23 @@ esp_err_t iis3dwb_configure_filter(iis3dwb_handle_t *dev, uint8_t lpf2_en, uint8
 }
 
 esp_err_t iis3dwb_read_accel(iis3dwb_handle_t *dev, float *ax, float *ay, float *az) {
-    uint8_t buf[6];
-    ESP_ERROR_CHECK(iis3dwb_read_reg(dev, IIS3DWB_OUTX_L_A, buf, 6));
+    spi_transaction_t t = {0};
+    iis3dwb_prepare_accel_read(dev, &t);
+    ESP_ERROR_CHECK(spi_device_transmit(dev->spi, &t));
+    iis3dwb_parse_accel(dev, ax, ay, az);
+    return ESP_OK;
+}
+
+void iis3dwb_prepare_accel_read(iis3dwb_handle_t *dev, spi_transaction_t *t) {
+    dev->accel_tx[0] = IIS3DWB_OUTX_L_A | 0x80;
+    memset(&dev->accel_tx[1], 0x00, sizeof(dev->accel_tx) - 1);
+    t->length = sizeof(dev->accel_tx) * 8;
+    t->tx_buffer = dev->accel_tx;
+    t->rx_buffer = dev->accel_rx;
+}
+
+void iis3dwb_parse_accel(const iis3dwb_handle_t *dev, float *ax, float *ay, float *az) {
+    const uint8_t *buf = &dev->accel_rx[1];
     int16_t raw_x = (int16_t)(buf[1] << 8 | buf[0]);
     int16_t raw_y = (int16_t)(buf[3] << 8 | buf[2]);
     int16_t raw_z = (int16_t)(buf[5] << 8 | buf[4]);
@@ -72,7 +87,6 @@ esp_err_t iis3dwb_read_accel(iis3dwb_handle_t *dev, float *ax, float *ay, float
     *ax = raw_x * sensitivity / 1000.0f;
     *ay = raw_y * sensitivity / 1000.0f;
     *az = raw_z * sensitivity / 1000.0f;
-    return ESP_OK;
 }
 
 esp_err_t iis3dwb_fifo_config(iis3dwb_handle_t *dev, uint16_t watermark, uint8_t mode) {
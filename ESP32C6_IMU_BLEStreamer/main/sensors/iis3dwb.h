@@ -31,8 +31,13 @@
 #define IIS3DWB_OUTY_L_A        0x2A
 #define IIS3DWB_OUTZ_L_A        0x2C
 
+// Transactions the device queue holds, so reads can join a batched bus cycle
+#define IIS3DWB_QUEUE_SIZE      2
+
 typedef struct {
     spi_device_handle_t spi;
+    uint8_t accel_tx[7];        // Register address + 6 data bytes of a queued accel read
+    uint8_t accel_rx[7];
 } iis3dwb_handle_t;
 
 typedef enum {
@@ -56,6 +61,9 @@ esp_err_t iis3dwb_configure(iis3dwb_handle_t *dev, iis3dwb_fs_t fs, iis3dwb_odr_
 esp_err_t iis3dwb_configure_filter(iis3dwb_handle_t *dev, uint8_t lpf2_en, uint8_t fds, uint8_t hpcf);
 
 esp_err_t iis3dwb_read_accel(iis3dwb_handle_t *dev, float *ax, float *ay, float *az);
+// Split accel read for queued transfers: fill t, run it, then parse the result
+void iis3dwb_prepare_accel_read(iis3dwb_handle_t *dev, spi_transaction_t *t);
+void iis3dwb_parse_accel(const iis3dwb_handle_t *dev, float *ax, float *ay, float *az);
 esp_err_t iis3dwb_fifo_config(iis3dwb_handle_t *dev, uint16_t watermark, uint8_t mode);
 // Sửa đổi prototype
 esp_err_t iis3dwb_fifo_read_burst(iis3dwb_handle_t *dev, uint8_t *data, size_t samples);
@@ -0,0 +1,151 @@
+#include "spi_batch.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <stdbool.h>
+#include <string.h>
+
+static const char *TAG = "SPI_BATCH";
+
+static spi_batch_stats_t batch_stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void spi_batch_begin(spi_batch_t *batch)
+{
+    if (batch != NULL) {
+        batch->count = 0;
+    }
+}
+
+spi_transaction_t *spi_batch_add(spi_batch_t *batch, spi_device_handle_t dev, size_t count)
+{
+    if (batch == NULL || dev == NULL || count == 0 || batch->count + count > SPI_BATCH_MAX_TRANS) {
+        return NULL;
+    }
+
+    spi_transaction_t *t = &batch->trans[batch->count];
+    memset(t, 0, count * sizeof(*t));
+    for (size_t i = 0; i < count; i++) {
+        batch->dev[batch->count + i] = dev;
+    }
+    batch->count += count;
+    return t;
+}
+
+// Time the batch keeps SCLK running, from each device's actual clock
+static uint32_t spi_batch_wire_us(const spi_batch_t *batch)
+{
+    uint64_t wire_ns = 0;
+    spi_device_handle_t dev = NULL;
+    int freq_khz = 0;
+
+    for (uint32_t i = 0; i < batch->count; i++) {
+        if (batch->dev[i] != dev) {
+            dev = batch->dev[i];
+            if (spi_device_get_actual_freq(dev, &freq_khz) != ESP_OK) {
+                freq_khz = 0;
+            }
+        }
+        if (freq_khz > 0) {
+            wire_ns += (uint64_t)batch->trans[i].length * 1000000 / freq_khz;
+        }
+    }
+    return (uint32_t)(wire_ns / 1000);
+}
+
+esp_err_t spi_batch_run(spi_batch_t *batch)
+{
+    if (batch == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (batch->count == 0) {
+        return ESP_OK;
+    }
+
+    // spi_device_acquire_bus() locks the bus to a single device, so it can only
+    // cover the cycle when every transaction targets that device. Mixed cycles
+    // rely on the caller's bus lock and let the driver arbitrate per transaction.
+    spi_device_handle_t owner = batch->dev[0];
+    for (uint32_t i = 1; i < batch->count; i++) {
+        if (batch->dev[i] != owner) {
+            owner = NULL;
+            break;
+        }
+    }
+
+    int64_t start = esp_timer_get_time();
+    esp_err_t ret = ESP_OK;
+    uint32_t queued = 0;
+    bool acquired = false;
+
+    if (owner != NULL) {
+        ret = spi_device_acquire_bus(owner, portMAX_DELAY);
+        acquired = (ret == ESP_OK);
+    }
+
+    // Each device queue must hold its share of the batch (queue_size at init)
+    for (; ret == ESP_OK && queued < batch->count; queued++) {
+        ret = spi_device_queue_trans(batch->dev[queued], &batch->trans[queued], portMAX_DELAY);
+        if (ret != ESP_OK) {
+            break;
+        }
+    }
+
+    // Results come back per device in queue order: collect everything that was queued
+    for (uint32_t i = 0; i < queued; i++) {
+        spi_transaction_t *done;
+        esp_err_t r = spi_device_get_trans_result(batch->dev[i], &done, portMAX_DELAY);
+        if (r != ESP_OK && ret == ESP_OK) {
+            ret = r;
+        }
+    }
+
+    if (acquired) {
+        spi_device_release_bus(owner);
+    }
+
+    uint32_t busy_us = (uint32_t)(esp_timer_get_time() - start);
+    uint32_t wire_us = spi_batch_wire_us(batch);
+
+    portENTER_CRITICAL(&stats_lock);
+    batch_stats.cycles++;
+    batch_stats.transactions += queued;
+    if (ret != ESP_OK) {
+        batch_stats.errors++;
+    }
+    batch_stats.last_transactions = queued;
+    batch_stats.last_busy_us = busy_us;
+    batch_stats.last_wire_us = wire_us;
+    if (busy_us > batch_stats.max_busy_us) {
+        batch_stats.max_busy_us = busy_us;
+    }
+    batch_stats.total_busy_us += busy_us;
+    batch_stats.total_wire_us += wire_us;
+    portEXIT_CRITICAL(&stats_lock);
+
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Batch of %u transactions failed after %u: %s",
+                 (unsigned)batch->count, (unsigned)queued, esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+void spi_batch_get_stats(spi_batch_stats_t *stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+
+    portENTER_CRITICAL(&stats_lock);
+    *stats = batch_stats;
+    portEXIT_CRITICAL(&stats_lock);
+
+    stats->avg_busy_us = stats->cycles ? (uint32_t)(stats->total_busy_us / stats->cycles) : 0;
+}
+
+void spi_batch_reset_stats(void)
+{
+    portENTER_CRITICAL(&stats_lock);
+    memset(&batch_stats, 0, sizeof(batch_stats));
+    portEXIT_CRITICAL(&stats_lock);
+}
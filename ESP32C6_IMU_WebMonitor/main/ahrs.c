@@ -0,0 +1,433 @@
+#include "ahrs.h"
+#include "esp_log.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#include "freertos/FreeRTOS.h"
+#include <math.h>
+#include <string.h>
+
+static const char *TAG = "AHRS";
+
+// Q30 fixed point: 1.0 == 1 << 30, range [-2, 2)
+#define Q30_ONE         (1L << 30)
+#define Q30_HALF        (1L << 29)
+// Half-angle increments and the integral term use 16 more fractional bits
+#define Q46_EXTRA_SHIFT 16
+// Quaternion norm error below which one Newton step renormalises
+#define NORM_FAST_LIMIT (1L << 20)
+
+#define MDPS_TO_RAD     (3.14159265358979 / 180000.0)
+#define RAD_TO_DEG      57.29577951f
+
+// Per-sample constants, derived from the gains and the sample rate
+typedef struct {
+    int32_t gyro_k;             // mdps -> half-angle per sample, Q46
+    int32_t kp_dt;              // Kp * dt, Q30
+    int32_t kp_init_dt;         // Start-up gain * dt, Q30
+    int32_t ki_dt2;             // Ki * dt^2, Q46
+    uint32_t init_updates;
+} ahrs_consts_t;
+
+static ahrs_config_t ahrs_config = {
+    .sample_rate_hz = 400,
+    .kp = AHRS_DEFAULT_KP,
+    .ki = AHRS_DEFAULT_KI,
+};
+static ahrs_consts_t consts;
+
+// Filter state, owned by the task calling ahrs_update()
+static int32_t q[4] = { Q30_ONE, 0, 0, 0 };
+static int64_t integral[3];     // Q46
+static uint32_t filter_updates; // Since the last reset: selects the start-up gain
+
+// Shared with the producers of mag vectors and the output readers
+static portMUX_TYPE ahrs_lock = portMUX_INITIALIZER_UNLOCKED;
+static int32_t mag_vec[3];
+static uint64_t mag_timestamp_us;
+static bool mag_valid;
+static int32_t out_q[4];
+static uint64_t out_timestamp_us;
+static bool out_mag_used;
+static bool out_valid;
+
+// Cost accounting per source, kept across switches so they can be compared
+typedef struct {
+    ahrs_stats_t stats;
+    uint64_t total_cycles;
+} ahrs_source_acc_t;
+
+static ahrs_source_t active_source = AHRS_SOURCE_HOST;
+static uint32_t external_rate_hz;
+static ahrs_source_acc_t source_acc[AHRS_SOURCE_COUNT];
+
+static inline int32_t q30_mul(int32_t a, int32_t b)
+{
+    return (int32_t)(((int64_t)a * b) >> 30);
+}
+
+static uint32_t isqrt64(uint64_t x)
+{
+    uint64_t res = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+
+    while (bit > x) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (x >= res + bit) {
+            x -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)res;
+}
+
+// Scales a vector of any magnitude to a Q30 unit vector; false for a zero vector
+static bool normalize_vec(const int32_t in[3], int32_t out[3])
+{
+    uint32_t m = 0;
+    for (int i = 0; i < 3; i++) {
+        uint32_t a = (in[i] < 0) ? (uint32_t)0 - (uint32_t)in[i] : (uint32_t)in[i];
+        if (a > m) {
+            m = a;
+        }
+    }
+    if (m == 0) {
+        return false;
+    }
+
+    // Bring the largest component to 15 bits so the squares and the division stay in range
+    int shift = (32 - __builtin_clz(m)) - 15;
+    int32_t v[3];
+    for (int i = 0; i < 3; i++) {
+        v[i] = (shift >= 0) ? (in[i] >> shift) : (int32_t)((uint32_t)in[i] << -shift);
+    }
+
+    uint64_t n2 = (uint64_t)((int64_t)v[0] * v[0]) + (uint64_t)((int64_t)v[1] * v[1]) +
+                  (uint64_t)((int64_t)v[2] * v[2]);
+    uint32_t n = isqrt64(n2);
+    if (n == 0) {
+        return false;
+    }
+
+    int64_t inv = (int64_t)(((uint64_t)1 << 46) / n);
+    for (int i = 0; i < 3; i++) {
+        out[i] = (int32_t)(((int64_t)v[i] * inv) >> 16);
+    }
+    return true;
+}
+
+static void normalize_quat(int32_t quat[4])
+{
+    int64_t n2 = 0;
+    for (int i = 0; i < 4; i++) {
+        n2 += (int64_t)quat[i] * quat[i];
+    }
+
+    int64_t err = (n2 >> 30) - Q30_ONE;
+    if (err > -NORM_FAST_LIMIT && err < NORM_FAST_LIMIT) {
+        // 1/sqrt(n2) ~ (3 - n2) / 2 near 1: no division on the common path
+        int32_t inv = (int32_t)(Q30_ONE - err / 2);
+        for (int i = 0; i < 4; i++) {
+            quat[i] = q30_mul(quat[i], inv);
+        }
+        return;
+    }
+
+    uint32_t n = isqrt64((uint64_t)n2);
+    if (n == 0) {
+        quat[0] = Q30_ONE;
+        quat[1] = quat[2] = quat[3] = 0;
+        return;
+    }
+    for (int i = 0; i < 4; i++) {
+        quat[i] = (int32_t)(((int64_t)quat[i] << 30) / n);
+    }
+}
+
+static void ahrs_compute_consts(void)
+{
+    const double dt = 1.0 / ahrs_config.sample_rate_hz;
+
+    consts.gyro_k = (int32_t)(MDPS_TO_RAD * 0.5 * dt * (double)(1LL << 46) + 0.5);
+    consts.kp_dt = (int32_t)(ahrs_config.kp * dt * Q30_ONE + 0.5);
+    consts.kp_init_dt = (int32_t)(ahrs_config.kp * AHRS_INIT_GAIN * dt * Q30_ONE + 0.5);
+    consts.ki_dt2 = (int32_t)(ahrs_config.ki * dt * dt * (double)(1LL << 46) + 0.5);
+    consts.init_updates = ahrs_config.sample_rate_hz * AHRS_INIT_TIME_MS / 1000;
+}
+
+esp_err_t ahrs_init(const ahrs_config_t *config)
+{
+    if (config != NULL) {
+        if (config->sample_rate_hz == 0 || config->kp < 0.0f || config->ki < 0.0f) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        ahrs_config = *config;
+    }
+
+    ahrs_compute_consts();
+    ahrs_reset();
+
+    ESP_LOGI(TAG, "Mahony AHRS at %lu Hz (Kp=%.2f, Ki=%.3f)",
+             ahrs_config.sample_rate_hz, ahrs_config.kp, ahrs_config.ki);
+    return ESP_OK;
+}
+
+esp_err_t ahrs_set_sample_rate(uint32_t sample_rate_hz)
+{
+    if (sample_rate_hz == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ahrs_config.sample_rate_hz = sample_rate_hz;
+    ahrs_compute_consts();
+    return ESP_OK;
+}
+
+static void ahrs_reset_filter(void)
+{
+    q[0] = Q30_ONE;
+    q[1] = q[2] = q[3] = 0;
+    memset(integral, 0, sizeof(integral));
+    filter_updates = 0;
+}
+
+void ahrs_reset(void)
+{
+    ahrs_reset_filter();
+
+    portENTER_CRITICAL(&ahrs_lock);
+    out_valid = false;
+    mag_valid = false;
+    memset(source_acc, 0, sizeof(source_acc));
+    portEXIT_CRITICAL(&ahrs_lock);
+}
+
+// Records one published orientation and its host cost
+static void ahrs_account(ahrs_source_t source, uint32_t cycles, bool mag_used)
+{
+    ahrs_source_acc_t *acc = &source_acc[source];
+
+    acc->stats.updates++;
+    if (mag_used) {
+        acc->stats.mag_updates++;
+    }
+    acc->stats.last_cycles = cycles;
+    if (cycles > acc->stats.max_cycles) {
+        acc->stats.max_cycles = cycles;
+    }
+    acc->total_cycles += cycles;
+}
+
+esp_err_t ahrs_set_source(ahrs_source_t source, uint32_t sample_rate_hz)
+{
+    if (source >= AHRS_SOURCE_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (source == AHRS_SOURCE_HOST) {
+        // The host filter restarts from its start-up gain
+        ahrs_reset_filter();
+        if (sample_rate_hz > 0) {
+            ahrs_set_sample_rate(sample_rate_hz);
+        }
+    } else {
+        external_rate_hz = sample_rate_hz;
+    }
+
+    portENTER_CRITICAL(&ahrs_lock);
+    active_source = source;
+    out_valid = false;
+    portEXIT_CRITICAL(&ahrs_lock);
+
+    ESP_LOGI(TAG, "Orientation source: %s", (source == AHRS_SOURCE_HOST) ? "host filter" : "eDMP GAF");
+    return ESP_OK;
+}
+
+ahrs_source_t ahrs_get_source(void)
+{
+    return active_source;
+}
+
+void ahrs_publish_external(uint64_t timestamp_us, const int32_t q30[4], uint32_t cycles)
+{
+    portENTER_CRITICAL(&ahrs_lock);
+    if (active_source != AHRS_SOURCE_HOST) {
+        memcpy(out_q, q30, sizeof(out_q));
+        out_timestamp_us = timestamp_us;
+        out_mag_used = false;
+        out_valid = true;
+        ahrs_account(active_source, cycles, false);
+    }
+    portEXIT_CRITICAL(&ahrs_lock);
+}
+
+void ahrs_set_mag(uint64_t timestamp_us, const int32_t mag[3])
+{
+    portENTER_CRITICAL(&ahrs_lock);
+    memcpy(mag_vec, mag, sizeof(mag_vec));
+    mag_timestamp_us = timestamp_us;
+    mag_valid = true;
+    portEXIT_CRITICAL(&ahrs_lock);
+}
+
+void ahrs_update(uint64_t timestamp_us, const int32_t accel_ug[3], const int32_t gyro_mdps[3])
+{
+    // Offloaded: the host filter does not run at all
+    if (active_source != AHRS_SOURCE_HOST) {
+        return;
+    }
+
+    uint32_t start = esp_cpu_get_cycle_count();
+
+    int32_t mag_raw[3];
+    bool have_mag;
+    portENTER_CRITICAL(&ahrs_lock);
+    // FIFO samples are timestamped in the past: the vector may be slightly newer
+    int64_t mag_age_us = (int64_t)(timestamp_us - mag_timestamp_us);
+    have_mag = mag_valid && mag_age_us < AHRS_MAG_TIMEOUT_US && mag_age_us > -AHRS_MAG_TIMEOUT_US;
+    memcpy(mag_raw, mag_vec, sizeof(mag_raw));
+    portEXIT_CRITICAL(&ahrs_lock);
+
+    const int32_t q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+    int32_t half_e[3] = { 0, 0, 0 };
+    int32_t a[3];
+    int32_t m[3];
+    bool mag_used = false;
+
+    // Feedback only with a usable accelerometer vector
+    if (normalize_vec(accel_ug, a)) {
+        const int32_t q0q0 = q30_mul(q0, q0), q0q1 = q30_mul(q0, q1), q0q2 = q30_mul(q0, q2);
+        const int32_t q0q3 = q30_mul(q0, q3), q1q1 = q30_mul(q1, q1), q1q2 = q30_mul(q1, q2);
+        const int32_t q1q3 = q30_mul(q1, q3), q2q2 = q30_mul(q2, q2), q2q3 = q30_mul(q2, q3);
+        const int32_t q3q3 = q30_mul(q3, q3);
+
+        // Estimated direction of gravity, halved
+        const int32_t hvx = q1q3 - q0q2;
+        const int32_t hvy = q0q1 + q2q3;
+        const int32_t hvz = q0q0 - Q30_HALF + q3q3;
+
+        half_e[0] = q30_mul(a[1], hvz) - q30_mul(a[2], hvy);
+        half_e[1] = q30_mul(a[2], hvx) - q30_mul(a[0], hvz);
+        half_e[2] = q30_mul(a[0], hvy) - q30_mul(a[1], hvx);
+
+        if (have_mag && normalize_vec(mag_raw, m)) {
+            // Earth field in the reference frame, then back to the body frame, halved
+            const int32_t hx = 2 * (q30_mul(m[0], Q30_HALF - q2q2 - q3q3) + q30_mul(m[1], q1q2 - q0q3) +
+                                    q30_mul(m[2], q1q3 + q0q2));
+            const int32_t hy = 2 * (q30_mul(m[0], q1q2 + q0q3) + q30_mul(m[1], Q30_HALF - q1q1 - q3q3) +
+                                    q30_mul(m[2], q2q3 - q0q1));
+            const int32_t bx = (int32_t)isqrt64((uint64_t)((int64_t)hx * hx + (int64_t)hy * hy));
+            const int32_t bz = 2 * (q30_mul(m[0], q1q3 - q0q2) + q30_mul(m[1], q2q3 + q0q1) +
+                                    q30_mul(m[2], Q30_HALF - q1q1 - q2q2));
+
+            const int32_t hwx = q30_mul(bx, Q30_HALF - q2q2 - q3q3) + q30_mul(bz, q1q3 - q0q2);
+            const int32_t hwy = q30_mul(bx, q1q2 - q0q3) + q30_mul(bz, q0q1 + q2q3);
+            const int32_t hwz = q30_mul(bx, q0q2 + q1q3) + q30_mul(bz, Q30_HALF - q1q1 - q2q2);
+
+            half_e[0] += q30_mul(m[1], hwz) - q30_mul(m[2], hwy);
+            half_e[1] += q30_mul(m[2], hwx) - q30_mul(m[0], hwz);
+            half_e[2] += q30_mul(m[0], hwy) - q30_mul(m[1], hwx);
+            mag_used = true;
+        }
+    }
+
+    // Half-angle increments: gyro + proportional + integral feedback
+    const int32_t kp_dt = (filter_updates < consts.init_updates) ? consts.kp_init_dt : consts.kp_dt;
+    int32_t theta[3];
+    for (int i = 0; i < 3; i++) {
+        int32_t t = (int32_t)(((int64_t)gyro_mdps[i] * consts.gyro_k) >> Q46_EXTRA_SHIFT);
+        t += q30_mul(half_e[i], kp_dt);
+        if (consts.ki_dt2 > 0) {
+            integral[i] += ((int64_t)half_e[i] * consts.ki_dt2) >> 30;
+            t += (int32_t)(integral[i] >> Q46_EXTRA_SHIFT);
+        }
+        theta[i] = t;
+    }
+
+    q[0] = q0 - q30_mul(q1, theta[0]) - q30_mul(q2, theta[1]) - q30_mul(q3, theta[2]);
+    q[1] = q1 + q30_mul(q0, theta[0]) + q30_mul(q2, theta[2]) - q30_mul(q3, theta[1]);
+    q[2] = q2 + q30_mul(q0, theta[1]) - q30_mul(q1, theta[2]) + q30_mul(q3, theta[0]);
+    q[3] = q3 + q30_mul(q0, theta[2]) + q30_mul(q1, theta[1]) - q30_mul(q2, theta[0]);
+    normalize_quat(q);
+    filter_updates++;
+
+    uint32_t cycles = esp_cpu_get_cycle_count() - start;
+
+    portENTER_CRITICAL(&ahrs_lock);
+    if (active_source == AHRS_SOURCE_HOST) {
+        memcpy(out_q, q, sizeof(out_q));
+        out_timestamp_us = timestamp_us;
+        out_mag_used = mag_used;
+        out_valid = true;
+    }
+    ahrs_account(AHRS_SOURCE_HOST, cycles, mag_used);
+    portEXIT_CRITICAL(&ahrs_lock);
+}
+
+esp_err_t ahrs_get_output(ahrs_output_t *out)
+{
+    if (out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int32_t qi[4];
+    portENTER_CRITICAL(&ahrs_lock);
+    if (!out_valid) {
+        portEXIT_CRITICAL(&ahrs_lock);
+        return ESP_ERR_NOT_FOUND;
+    }
+    memcpy(qi, out_q, sizeof(qi));
+    out->timestamp_us = out_timestamp_us;
+    out->mag_used = out_mag_used;
+    portEXIT_CRITICAL(&ahrs_lock);
+
+    // Float only here, at the (much lower) publishing rate
+    const float scale = 1.0f / (float)Q30_ONE;
+    const float w = qi[0] * scale, x = qi[1] * scale, y = qi[2] * scale, z = qi[3] * scale;
+    out->q[0] = w;
+    out->q[1] = x;
+    out->q[2] = y;
+    out->q[3] = z;
+
+    float sinp = 2.0f * (w * y - z * x);
+    if (sinp > 1.0f) {
+        sinp = 1.0f;
+    } else if (sinp < -1.0f) {
+        sinp = -1.0f;
+    }
+    out->roll_deg = atan2f(2.0f * (w * x + y * z), 1.0f - 2.0f * (x * x + y * y)) * RAD_TO_DEG;
+    out->pitch_deg = asinf(sinp) * RAD_TO_DEG;
+    out->yaw_deg = atan2f(2.0f * (w * z + x * y), 1.0f - 2.0f * (y * y + z * z)) * RAD_TO_DEG;
+    return ESP_OK;
+}
+
+void ahrs_get_source_stats(ahrs_source_t source, ahrs_stats_t *out)
+{
+    if (out == NULL || source >= AHRS_SOURCE_COUNT) {
+        return;
+    }
+
+    uint64_t cycles;
+    portENTER_CRITICAL(&ahrs_lock);
+    *out = source_acc[source].stats;
+    cycles = source_acc[source].total_cycles;
+    portEXIT_CRITICAL(&ahrs_lock);
+
+    out->source = source;
+    out->sample_rate_hz = (source == AHRS_SOURCE_HOST) ? ahrs_config.sample_rate_hz : external_rate_hz;
+    out->avg_cycles = out->updates ? (uint32_t)(cycles / out->updates) : 0;
+    uint32_t ticks_per_us = esp_rom_get_cpu_ticks_per_us();
+    if (ticks_per_us > 0) {
+        out->avg_ns = (uint32_t)((uint64_t)out->avg_cycles * 1000 / ticks_per_us);
+        out->cpu_load_permille = (uint32_t)((uint64_t)out->avg_ns * out->sample_rate_hz / 1000000);
+    }
+}
+
+void ahrs_get_stats(ahrs_stats_t *out)
+{
+    ahrs_get_source_stats(active_source, out);
+}
@@ -0,0 +1,379 @@
+// Host check and benchmark of the Q30 AHRS update. Not part of the firmware
+// build (not listed in CMakeLists.txt); host/ holds stand-ins for the few
+// ESP-IDF headers ahrs.c includes. The BLE streamer carries an identical
+// ahrs.c, so this covers both.
+//
+//   gcc -std=gnu17 -O2 -Ihost -I. ahrs_bench.c ahrs.c -o ahrs_bench -lm
+//   ./ahrs_bench [count]
+//
+// First runs ahrs_update() on simulated ICM45686/IIS2MDC data next to a
+// double-precision copy of the same Mahony filter, and checks that the Q30
+// path stays with the reference and with the true orientation. Then times
+// the update. Host times are only a relative measure: the ESP32-C6 cost is
+// what ahrs_get_stats() reports from the cycle counter on the device.
+
+#include "ahrs.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEG_TO_RAD      (3.14159265358979 / 180.0)
+#define MAG_RATE_HZ     100
+#define BENCH_SAMPLES   4096
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+// xorshift64*: fixed seed, so runs are comparable
+static uint64_t rng_next(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+// Uniform noise in [-amplitude, amplitude]
+static double rng_noise(double amplitude)
+{
+    return amplitude * ((double)(rng_next() >> 11) / (double)(1ULL << 52) - 1.0);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void quat_mul(const double a[4], const double b[4], double out[4])
+{
+    double r[4] = {
+        a[0] * b[0] - a[1] * b[1] - a[2] * b[2] - a[3] * b[3],
+        a[0] * b[1] + a[1] * b[0] + a[2] * b[3] - a[3] * b[2],
+        a[0] * b[2] - a[1] * b[3] + a[2] * b[0] + a[3] * b[1],
+        a[0] * b[3] + a[1] * b[2] - a[2] * b[1] + a[3] * b[0],
+    };
+    memcpy(out, r, sizeof(r));
+}
+
+// Earth-frame vector seen in the body frame of q (body -> earth)
+static void quat_rotate_inv(const double q[4], const double v[3], double out[3])
+{
+    const double qc[4] = { q[0], -q[1], -q[2], -q[3] };
+    const double p[4] = { 0.0, v[0], v[1], v[2] };
+    double t[4];
+    quat_mul(qc, p, t);
+    quat_mul(t, q, t);
+    out[0] = t[1];
+    out[1] = t[2];
+    out[2] = t[3];
+}
+
+// Rotation between two orientations, degrees
+static double quat_angle_deg(const double a[4], const double b[4])
+{
+    double dot = fabs(a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3]);
+    return 2.0 * acos(dot > 1.0 ? 1.0 : dot) / DEG_TO_RAD;
+}
+
+// Angle between the gravity directions of two orientations: the part a 6-axis filter observes
+static double tilt_angle_deg(const double a[4], const double b[4])
+{
+    const double up[3] = { 0.0, 0.0, 1.0 };
+    double ga[3], gb[3];
+    quat_rotate_inv(a, up, ga);
+    quat_rotate_inv(b, up, gb);
+    double dot = ga[0] * gb[0] + ga[1] * gb[1] + ga[2] * gb[2];
+    return acos(dot > 1.0 ? 1.0 : dot) / DEG_TO_RAD;
+}
+
+// Same filter as ahrs_update() in double precision
+typedef struct {
+    double q[4];
+    double integral[3];
+    double kp;
+    double ki;
+    double dt;
+    uint32_t init_updates;
+    uint32_t updates;
+} ref_filter_t;
+
+static void ref_init(ref_filter_t *f, const ahrs_config_t *cfg)
+{
+    memset(f, 0, sizeof(*f));
+    f->q[0] = 1.0;
+    f->kp = cfg->kp;
+    f->ki = cfg->ki;
+    f->dt = 1.0 / cfg->sample_rate_hz;
+    f->init_updates = cfg->sample_rate_hz * AHRS_INIT_TIME_MS / 1000;
+}
+
+static int ref_normalize(const int32_t in[3], double out[3])
+{
+    double n = sqrt((double)in[0] * in[0] + (double)in[1] * in[1] + (double)in[2] * in[2]);
+    if (n == 0.0) {
+        return 0;
+    }
+    for (int i = 0; i < 3; i++) {
+        out[i] = in[i] / n;
+    }
+    return 1;
+}
+
+static void ref_update(ref_filter_t *f, const int32_t accel_ug[3], const int32_t gyro_mdps[3],
+                       const int32_t *mag)
+{
+    const double q0 = f->q[0], q1 = f->q[1], q2 = f->q[2], q3 = f->q[3];
+    double half_e[3] = { 0.0, 0.0, 0.0 };
+    double a[3], m[3];
+
+    if (ref_normalize(accel_ug, a)) {
+        const double hvx = q1 * q3 - q0 * q2;
+        const double hvy = q0 * q1 + q2 * q3;
+        const double hvz = q0 * q0 - 0.5 + q3 * q3;
+        half_e[0] = a[1] * hvz - a[2] * hvy;
+        half_e[1] = a[2] * hvx - a[0] * hvz;
+        half_e[2] = a[0] * hvy - a[1] * hvx;
+
+        if (mag != NULL && ref_normalize(mag, m)) {
+            const double hx = 2.0 * (m[0] * (0.5 - q2 * q2 - q3 * q3) + m[1] * (q1 * q2 - q0 * q3) +
+                                     m[2] * (q1 * q3 + q0 * q2));
+            const double hy = 2.0 * (m[0] * (q1 * q2 + q0 * q3) + m[1] * (0.5 - q1 * q1 - q3 * q3) +
+                                     m[2] * (q2 * q3 - q0 * q1));
+            const double bx = sqrt(hx * hx + hy * hy);
+            const double bz = 2.0 * (m[0] * (q1 * q3 - q0 * q2) + m[1] * (q2 * q3 + q0 * q1) +
+                                     m[2] * (0.5 - q1 * q1 - q2 * q2));
+            const double hwx = bx * (0.5 - q2 * q2 - q3 * q3) + bz * (q1 * q3 - q0 * q2);
+            const double hwy = bx * (q1 * q2 - q0 * q3) + bz * (q0 * q1 + q2 * q3);
+            const double hwz = bx * (q0 * q2 + q1 * q3) + bz * (0.5 - q1 * q1 - q2 * q2);
+            half_e[0] += m[1] * hwz - m[2] * hwy;
+            half_e[1] += m[2] * hwx - m[0] * hwz;
+            half_e[2] += m[0] * hwy - m[1] * hwx;
+        }
+    }
+
+    const double kp = (f->updates < f->init_updates) ? f->kp * AHRS_INIT_GAIN : f->kp;
+    double theta[3];
+    for (int i = 0; i < 3; i++) {
+        f->integral[i] += half_e[i] * f->ki * f->dt * f->dt;
+        theta[i] = gyro_mdps[i] * DEG_TO_RAD * 1e-3 * 0.5 * f->dt + half_e[i] * kp * f->dt + f->integral[i];
+    }
+
+    double q[4] = {
+        q0 - q1 * theta[0] - q2 * theta[1] - q3 * theta[2],
+        q1 + q0 * theta[0] + q2 * theta[2] - q3 * theta[1],
+        q2 + q0 * theta[1] - q1 * theta[2] + q3 * theta[0],
+        q3 + q0 * theta[2] + q1 * theta[1] - q2 * theta[0],
+    };
+    double n = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    for (int i = 0; i < 4; i++) {
+        f->q[i] = q[i] / n;
+    }
+    f->updates++;
+}
+
+// Simulated board: turns at a varying body rate from a tilted start, heading
+// north like the filter's initial state (Kp 0.5 takes tens of seconds to turn
+// a large heading error, the same in both filters)
+typedef struct {
+    double q[4];                // True orientation, body -> earth
+    double t;
+    double dt;
+} sim_t;
+
+static void sim_init(sim_t *s, uint32_t rate_hz)
+{
+    // Roll 20, pitch -10 degrees
+    const double r = 20.0 * DEG_TO_RAD / 2, p = -10.0 * DEG_TO_RAD / 2;
+    s->q[0] = cos(r) * cos(p);
+    s->q[1] = sin(r) * cos(p);
+    s->q[2] = cos(r) * sin(p);
+    s->q[3] = -sin(r) * sin(p);
+    s->t = 0.0;
+    s->dt = 1.0 / rate_hz;
+}
+
+// Sensor readings at the current orientation, then one step of true motion
+static void sim_step(sim_t *s, int32_t accel_ug[3], int32_t gyro_mdps[3], int32_t mag[3], int free_fall)
+{
+    const double w[3] = {
+        60.0 * sin(0.7 * s->t) * DEG_TO_RAD,
+        40.0 * cos(0.5 * s->t) * DEG_TO_RAD,
+        45.0 * DEG_TO_RAD,
+    };
+    const double up[3] = { 0.0, 0.0, 1.0 };
+    const double field[3] = { 0.5, 0.0, -0.866 };
+    double g[3], b[3];
+    quat_rotate_inv(s->q, up, g);
+    quat_rotate_inv(s->q, field, b);
+
+    for (int i = 0; i < 3; i++) {
+        accel_ug[i] = free_fall ? 0 : (int32_t)lround(g[i] * 1e6 + rng_noise(2000.0));
+        gyro_mdps[i] = (int32_t)lround(w[i] / DEG_TO_RAD * 1e3 + rng_noise(50.0));
+        // IIS2MDC counts, 1.5 mG/LSB at about 0.5 G
+        mag[i] = (int32_t)lround(b[i] * 333.0 + rng_noise(2.0));
+    }
+
+    // Constant body rate over the step: exact rotation
+    double wn = sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+    double half = 0.5 * wn * s->dt;
+    double k = sin(half) / wn;
+    const double dq[4] = { cos(half), w[0] * k, w[1] * k, w[2] * k };
+    quat_mul(s->q, dq, s->q);
+    s->t += s->dt;
+}
+
+typedef struct {
+    uint32_t rate_hz;
+    float ki;
+    int use_mag;
+    double max_ref_deg;         // Q30 against the double filter, whole run
+    double max_truth_deg;       // Against the true orientation once settled (tilt only without mag);
+                                // the 100 Hz mag vector is up to 10 ms old while the board turns
+} scenario_t;
+
+#define RUN_SECONDS         20
+#define SETTLE_SECONDS      5
+
+static int run_scenario(const scenario_t *sc)
+{
+    const ahrs_config_t cfg = { .sample_rate_hz = sc->rate_hz, .kp = AHRS_DEFAULT_KP, .ki = sc->ki };
+    ref_filter_t ref;
+    sim_t sim;
+
+    rng_state = 0x9E3779B97F4A7C15ULL;
+    ahrs_init(&cfg);
+    ahrs_set_source(AHRS_SOURCE_HOST, sc->rate_hz);
+    ref_init(&ref, &cfg);
+    sim_init(&sim, sc->rate_hz);
+
+    const uint32_t samples = sc->rate_hz * RUN_SECONDS;
+    const uint32_t mag_every = sc->rate_hz / MAG_RATE_HZ;
+    double max_ref = 0.0, max_truth = 0.0;
+    int32_t mag_held[3] = { 0, 0, 0 };
+    int have_mag = 0;
+
+    for (uint32_t n = 0; n < samples; n++) {
+        int32_t accel[3], gyro[3], mag[3];
+        uint64_t ts = (uint64_t)n * 1000000 / sc->rate_hz;
+        // A short free fall: no accelerometer feedback
+        int free_fall = n >= sc->rate_hz * 8 && n < sc->rate_hz * 8 + 10;
+        sim_step(&sim, accel, gyro, mag, free_fall);
+
+        if (sc->use_mag && n % mag_every == 0) {
+            memcpy(mag_held, mag, sizeof(mag_held));
+            ahrs_set_mag(ts, mag_held);
+            have_mag = 1;
+        }
+        ahrs_update(ts, accel, gyro);
+        ref_update(&ref, accel, gyro, have_mag ? mag_held : NULL);
+
+        ahrs_output_t out;
+        if (ahrs_get_output(&out) != ESP_OK) {
+            fprintf(stderr, "%lu Hz: no output after an update\n", (unsigned long)sc->rate_hz);
+            return 1;
+        }
+        const double est[4] = { out.q[0], out.q[1], out.q[2], out.q[3] };
+        double d = quat_angle_deg(est, ref.q);
+        if (d > max_ref) {
+            max_ref = d;
+        }
+        if (n >= sc->rate_hz * SETTLE_SECONDS) {
+            d = sc->use_mag ? quat_angle_deg(est, sim.q) : tilt_angle_deg(est, sim.q);
+            if (d > max_truth) {
+                max_truth = d;
+            }
+        }
+    }
+
+    int failed = max_ref > sc->max_ref_deg || max_truth > sc->max_truth_deg;
+    printf("  %4lu Hz %s Ki %.2f: vs double %.4f deg (limit %.2f), vs truth %.3f deg (limit %.2f)%s\n",
+           (unsigned long)sc->rate_hz, sc->use_mag ? "9-axis" : "6-axis", sc->ki, max_ref, sc->max_ref_deg,
+           max_truth, sc->max_truth_deg, failed ? "  FAIL" : "");
+    return failed;
+}
+
+static int run_checks(void)
+{
+    static const scenario_t scenarios[] = {
+        { .rate_hz = 100,  .ki = 0.0f,  .use_mag = 1, .max_ref_deg = 0.1, .max_truth_deg = 1.5 },
+        { .rate_hz = 400,  .ki = 0.0f,  .use_mag = 1, .max_ref_deg = 0.1, .max_truth_deg = 1.5 },
+        { .rate_hz = 400,  .ki = 0.0f,  .use_mag = 0, .max_ref_deg = 0.1, .max_truth_deg = 0.5 },
+        { .rate_hz = 400,  .ki = 0.05f, .use_mag = 1, .max_ref_deg = 0.1, .max_truth_deg = 1.5 },
+        { .rate_hz = 1600, .ki = 0.0f,  .use_mag = 1, .max_ref_deg = 0.1, .max_truth_deg = 1.5 },
+        { .rate_hz = 6400, .ki = 0.0f,  .use_mag = 1, .max_ref_deg = 0.1, .max_truth_deg = 1.5 },
+    };
+    int errors = 0;
+
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        errors += run_scenario(&scenarios[i]);
+    }
+    return errors;
+}
+
+static int32_t bench_accel[BENCH_SAMPLES][3];
+static int32_t bench_gyro[BENCH_SAMPLES][3];
+static int32_t bench_mag[BENCH_SAMPLES][3];
+
+#define BENCH(label, setup, call)                                           \
+    do {                                                                    \
+        double start = now_ns();                                            \
+        for (long i = 0; i < count; i++) {                                  \
+            const long s = i % BENCH_SAMPLES;                               \
+            const uint64_t ts = (uint64_t)i * 625;                          \
+            (void)s;                                                        \
+            (void)ts;                                                       \
+            setup;                                                          \
+            call;                                                           \
+        }                                                                   \
+        printf("  %-24s %6.1f ns\n", label, (now_ns() - start) / count);    \
+    } while (0)
+
+// At 1600 Hz with the magnetometer at 100 Hz, like the FIFO stream
+static void run_bench(long count)
+{
+    const ahrs_config_t cfg = { .sample_rate_hz = 1600, .kp = AHRS_DEFAULT_KP, .ki = AHRS_DEFAULT_KI };
+    const uint32_t mag_every = cfg.sample_rate_hz / MAG_RATE_HZ;
+    ref_filter_t ref;
+    sim_t sim;
+    ahrs_output_t out;
+    volatile float sink = 0.0f;
+
+    rng_state = 0x9E3779B97F4A7C15ULL;
+    sim_init(&sim, cfg.sample_rate_hz);
+    for (int n = 0; n < BENCH_SAMPLES; n++) {
+        sim_step(&sim, bench_accel[n], bench_gyro[n], bench_mag[n], 0);
+    }
+
+    ahrs_init(&cfg);
+    BENCH("ahrs_update 6-axis", (void)0,
+          ahrs_update(ts, bench_accel[s], bench_gyro[s]));
+    ahrs_init(&cfg);
+    BENCH("ahrs_update 9-axis", if (s % mag_every == 0) ahrs_set_mag(ts, bench_mag[s]),
+          ahrs_update(ts, bench_accel[s], bench_gyro[s]));
+    BENCH("ahrs_get_output", (void)0,
+          (ahrs_get_output(&out), sink += out.yaw_deg));
+    ref_init(&ref, &cfg);
+    BENCH("double reference 9-axis", (void)0,
+          ref_update(&ref, bench_accel[s], bench_gyro[s], bench_mag[s - s % mag_every]));
+    sink += (float)ref.q[0];
+    (void)sink;
+}
+
+int main(int argc, char **argv)
+{
+    long count = argc > 1 ? atol(argv[1]) : 2000000;
+    if (count <= 0) {
+        count = 2000000;
+    }
+
+    printf("check: Q30 filter against a double-precision copy and the simulated motion\n");
+    int errors = run_checks();
+    printf("check: %d failed\n", errors);
+
+    printf("time per call, host (the device cost is in ahrs_get_stats()):\n");
+    run_bench(count);
+    return errors ? 1 : 0;
+}
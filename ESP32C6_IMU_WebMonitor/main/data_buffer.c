@@ -1,29 +1,127 @@
 #include "data_buffer.h"
 #include "esp_log.h"
-#include "cJSON.h"
+#include "json_writer.h"
+#include "num_format.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <math.h>
 #include "esp_timer.h"
 
 static const char *TAG = "DATA_BUFFER";
 
-// Circular buffer structure
+// Records per timestamp keyframe; the ring evicts whole blocks
+#define DATA_BUFFER_BLOCK           32
+#define DATA_BUFFER_MAX_CHANNELS    7
+// Record flags: one valid bit per sensor group, plus the ICM45686 format
+#define RECORD_FLAG_IMU_HIRES       0x80
+
+#define FIELD(f) offsetof(imu_data_t, f)
+
+// A channel is stored as an integer count of lsb field units
+typedef struct {
+    uint16_t offset;            // Field in imu_data_t
+    bool fixed;                 // int32_t field (ICM45686 fixed point), float otherwise
+    float lsb;
+} column_desc_t;
+
 typedef struct {
-    imu_data_t data[DATA_BUFFER_SIZE];
-    uint32_t head;
-    uint32_t tail;
-    uint32_t count;
-    bool full;
+    uint8_t sensor_id;
+    uint16_t valid_offset;
+    uint8_t channels;
+    column_desc_t col[DATA_BUFFER_MAX_CHANNELS];
+} sensor_desc_t;
+
+// Every column resolves one count of its sensor or finer, so the raw count is
+// recovered from the int16 value. Native LSBs: IIS2MDC 1.5 mG, 0.125 degC;
+// IIS3DWB 0.061 mg (+-2 g); SCL3300 5625/1024 mdeg, 1/12000 g in modes 3/4
+// (modes 1/2 are 2 and 4 of those counts), 1/18.9 degC; ICM45686 1/128 degC
+// (the 8-bit FIFO temperature is 64 of those). The ICM45686 accel/gyro LSB
+// is its exact count at configure time; 20-bit data keeps the int32 field.
+// Columns saturate at int16: SCL3300 accel at +-2.73 g (mode 2 reads +-2.4 g).
+static const sensor_desc_t sensor_desc[] = {
+    { SENSOR_MAGNETOMETER, FIELD(magnetometer.valid), 4, {
+        { FIELD(magnetometer.x_mg), false, 1.5f },
+        { FIELD(magnetometer.y_mg), false, 1.5f },
+        { FIELD(magnetometer.z_mg), false, 1.5f },
+        { FIELD(magnetometer.temperature_c), false, 0.01f },
+    } },
+    { SENSOR_ACCELEROMETER, FIELD(accelerometer.valid), 3, {
+        { FIELD(accelerometer.x_g), false, 0.061e-3f },
+        { FIELD(accelerometer.y_g), false, 0.061e-3f },
+        { FIELD(accelerometer.z_g), false, 0.061e-3f },
+    } },
+    { SENSOR_IMU_6AXIS, FIELD(imu_6axis.valid), 7, {
+        { FIELD(imu_6axis.accel_x_ug), true, 0 },
+        { FIELD(imu_6axis.accel_y_ug), true, 0 },
+        { FIELD(imu_6axis.accel_z_ug), true, 0 },
+        { FIELD(imu_6axis.gyro_x_mdps), true, 0 },
+        { FIELD(imu_6axis.gyro_y_mdps), true, 0 },
+        { FIELD(imu_6axis.gyro_z_mdps), true, 0 },
+        { FIELD(imu_6axis.temperature_mc), true, 7.8125f },
+    } },
+    { SENSOR_INCLINOMETER, FIELD(inclinometer.valid), 7, {
+        { FIELD(inclinometer.angle_x_deg), false, 90.0f / 16384 },
+        { FIELD(inclinometer.angle_y_deg), false, 90.0f / 16384 },
+        { FIELD(inclinometer.angle_z_deg), false, 90.0f / 16384 },
+        { FIELD(inclinometer.accel_x_g), false, 1.0f / 12000 },
+        { FIELD(inclinometer.accel_y_g), false, 1.0f / 12000 },
+        { FIELD(inclinometer.accel_z_g), false, 1.0f / 12000 },
+        { FIELD(inclinometer.temperature_c), false, 0.01f },
+    } },
+};
+#define SENSOR_GROUP_COUNT (sizeof(sensor_desc) / sizeof(sensor_desc[0]))
+
+typedef struct {
+    bool allocated;
+    uint8_t width;              // 2: int16 counts of lsb; 4: the int32 field as is (20-bit ICM45686)
+    float lsb[DATA_BUFFER_MAX_CHANNELS];
+    float inv_lsb[DATA_BUFFER_MAX_CHANNELS];
+    uint8_t *col[DATA_BUFFER_MAX_CHANNELS];
+} column_group_t;
+
+// Broadcast ring: records are addressed by sequence number. add() is the only
+// writer and never waits for readers; readers keep their own cursors and check
+// tail_seq after reading in place to detect records the writer reclaimed.
+typedef struct {
+    uint8_t *storage;           // One allocation for every column
+    uint32_t capacity;          // Records, a multiple of DATA_BUFFER_BLOCK
+    uint64_t *block_base_us;    // Timestamp keyframe of each block
+    uint32_t *ts_offset_us;     // Per record, delta to its block keyframe
+    uint8_t *flags;
+    column_group_t groups[SENSOR_GROUP_COUNT];
+    volatile uint32_t head_seq; // Sequence of the next record, published after it is stored
+    volatile uint32_t tail_seq; // Oldest retained record, advanced before its block is reused
+    volatile uint32_t lap_seq;  // A sequence stored at ring position 0
+    uint8_t layout_sensors;
+    uint32_t layout_rate_hz;
+    bool layout_hires;
     buffer_stats_t stats;
 } data_buffer_t;
 
 static data_buffer_t buffer;
+// Guards the column layout: held by readers and data_buffer_configure(), never by add()
 static SemaphoreHandle_t buffer_mutex = NULL;
 
+static inline uint32_t seq_load(volatile uint32_t *seq)
+{
+    return __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+}
+
+// Sequences only move forward: tail_seq is advanced by the writer and by clear()
+static void tail_advance(uint32_t to)
+{
+    uint32_t cur = seq_load(&buffer.tail_seq);
+    while ((int32_t)(to - cur) > 0 &&
+           !__atomic_compare_exchange_n(&buffer.tail_seq, &cur, to, false,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE)) {
+    }
+}
+
 esp_err_t data_buffer_init(void)
 {
     ESP_LOGI(TAG, "Initializing data buffer...");
@@ -35,57 +133,264 @@ esp_err_t data_buffer_init(void)
         return ESP_FAIL;
     }
     
-    // Initialize buffer
+    // Columns are allocated by data_buffer_configure() once the sensors are known
     memset(&buffer, 0, sizeof(buffer));
-    buffer.head = 0;
-    buffer.tail = 0;
-    buffer.count = 0;
-    buffer.full = false;
-    
-    // Initialize statistics
-    buffer.stats.total_samples = 0;
-    buffer.stats.dropped_samples = 0;
-    buffer.stats.buffer_overflows = 0;
-    buffer.stats.last_timestamp_us = 0;
-    buffer.stats.avg_processing_time_us = 0.0f;
-    
-    ESP_LOGI(TAG, "Data buffer initialized with size %d", DATA_BUFFER_SIZE);
+    
+    ESP_LOGI(TAG, "Data buffer initialized, %d s of history within %d bytes",
+             DATA_BUFFER_RETENTION_S, DATA_BUFFER_MEMORY_BUDGET);
     return ESP_OK;
 }
 
+esp_err_t data_buffer_configure(uint8_t sensors, uint32_t frame_rate_hz)
+{
+    if (buffer_mutex == NULL || frame_rate_hz == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    imu_6axis_format_t fmt = {0};
+    if (sensors & SENSOR_IMU_6AXIS) {
+        imu_manager_get_imu_format(&fmt);
+    }
+    if (buffer.storage != NULL && sensors == buffer.layout_sensors &&
+        frame_rate_hz == buffer.layout_rate_hz && fmt.hires == buffer.layout_hires) {
+        return ESP_OK;
+    }
+    
+    // Bytes per record: keyframe offset, flags and every enabled channel
+    column_group_t groups[SENSOR_GROUP_COUNT];
+    memset(groups, 0, sizeof(groups));
+    uint32_t record_bytes = sizeof(uint32_t) + sizeof(uint8_t);
+    for (size_t g = 0; g < SENSOR_GROUP_COUNT; g++) {
+        const sensor_desc_t *desc = &sensor_desc[g];
+        column_group_t *grp = &groups[g];
+        if (!(sensors & desc->sensor_id)) {
+            continue;
+        }
+        grp->allocated = true;
+        grp->width = sizeof(int16_t);
+        for (int c = 0; c < desc->channels; c++) {
+            grp->lsb[c] = desc->col[c].lsb;
+        }
+        if (desc->sensor_id == SENSOR_IMU_6AXIS) {
+            if (fmt.hires) {
+                grp->width = sizeof(int32_t);
+            } else {
+                // One column count per sensor count: full scale is exactly int16
+                for (int c = 0; c < 3; c++) {
+                    grp->lsb[c] = fmt.accel_count_ug;
+                    grp->lsb[c + 3] = fmt.gyro_count_mdps;
+                }
+            }
+        }
+        for (int c = 0; c < desc->channels; c++) {
+            grp->inv_lsb[c] = 1.0f / grp->lsb[c];
+        }
+        record_bytes += desc->channels * grp->width;
+    }
+    
+    uint32_t capacity = frame_rate_hz * DATA_BUFFER_RETENTION_S;
+    uint32_t budget = (uint32_t)((uint64_t)DATA_BUFFER_MEMORY_BUDGET * DATA_BUFFER_BLOCK /
+                                 (record_bytes * DATA_BUFFER_BLOCK + sizeof(uint64_t)));
+    if (capacity > budget) {
+        capacity = budget;
+    }
+    capacity -= capacity % DATA_BUFFER_BLOCK;
+    if (capacity < 2 * DATA_BUFFER_BLOCK) {
+        capacity = 2 * DATA_BUFFER_BLOCK;
+    }
+    size_t bytes = (size_t)capacity / DATA_BUFFER_BLOCK * sizeof(uint64_t) +
+                   (size_t)capacity * record_bytes;
+    
+    uint8_t *storage = malloc(bytes);
+    if (storage == NULL) {
+        ESP_LOGE(TAG, "No memory for %u history bytes", (unsigned)bytes);
+        return ESP_ERR_NO_MEM;
+    }
+    
+    if (xSemaphoreTake(buffer_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        free(storage);
+        return ESP_ERR_TIMEOUT;
+    }
+    
+    free(buffer.storage);
+    buffer.storage = storage;
+    buffer.capacity = capacity;
+    
+    // Widest elements first: every column size is a multiple of the block, so each stays aligned
+    uint8_t *p = storage;
+    buffer.block_base_us = (uint64_t *)p;
+    p += capacity / DATA_BUFFER_BLOCK * sizeof(uint64_t);
+    buffer.ts_offset_us = (uint32_t *)p;
+    p += capacity * sizeof(uint32_t);
+    for (uint8_t width = sizeof(int32_t); width >= sizeof(int16_t); width /= 2) {
+        for (size_t g = 0; g < SENSOR_GROUP_COUNT; g++) {
+            if (!groups[g].allocated || groups[g].width != width) {
+                continue;
+            }
+            for (int c = 0; c < sensor_desc[g].channels; c++) {
+                groups[g].col[c] = p;
+                p += capacity * width;
+            }
+        }
+    }
+    buffer.flags = p;
+    memcpy(buffer.groups, groups, sizeof(groups));
+    
+    // Sequences keep counting so reader cursors stay valid; the old history is gone
+    uint32_t head = seq_load(&buffer.head_seq);
+    buffer.lap_seq = head;
+    tail_advance(head);
+    buffer.layout_sensors = sensors;
+    buffer.layout_rate_hz = frame_rate_hz;
+    buffer.layout_hires = fmt.hires;
+    buffer.stats.capacity = capacity;
+    buffer.stats.bytes_per_record = record_bytes;
+    buffer.stats.memory_bytes = bytes;
+    
+    xSemaphoreGive(buffer_mutex);
+    
+    ESP_LOGI(TAG, "History for sensors 0x%02X: %lu records (%lu s at %lu Hz), %lu B/record, %u B",
+             sensors, capacity, capacity / frame_rate_hz, frame_rate_hz, record_bytes, (unsigned)bytes);
+    return ESP_OK;
+}
+
+static inline uint32_t record_count(void)
+{
+    uint32_t tail = seq_load(&buffer.tail_seq);
+    return seq_load(&buffer.head_seq) - tail;
+}
+
+// Ring position of a sequence number: any lap start works as the reference, so a
+// reader holding an older lap_seq still lands on the right slot
+static inline uint32_t record_pos(uint32_t seq)
+{
+    int32_t rel = (int32_t)(seq - buffer.lap_seq) % (int32_t)buffer.capacity;
+    return (rel < 0) ? (uint32_t)(rel + (int32_t)buffer.capacity) : (uint32_t)rel;
+}
+
+// After reading a record in place: false if the writer reclaimed it meanwhile
+static inline bool record_still_valid(uint32_t seq)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return (int32_t)(seq - seq_load(&buffer.tail_seq)) >= 0;
+}
+
+static void record_store(uint32_t pos, const imu_data_t *data)
+{
+    uint32_t block = pos / DATA_BUFFER_BLOCK;
+    if (pos % DATA_BUFFER_BLOCK == 0) {
+        buffer.block_base_us[block] = data->timestamp_us;
+    }
+    uint64_t base = buffer.block_base_us[block];
+    buffer.ts_offset_us[pos] = (data->timestamp_us > base) ? (uint32_t)(data->timestamp_us - base) : 0;
+    
+    uint8_t flags = 0;
+    const uint8_t *src = (const uint8_t *)data;
+    for (size_t g = 0; g < SENSOR_GROUP_COUNT; g++) {
+        const sensor_desc_t *desc = &sensor_desc[g];
+        const column_group_t *grp = &buffer.groups[g];
+        if (!grp->allocated || !*(const bool *)(src + desc->valid_offset)) {
+            continue;
+        }
+        flags |= 1 << g;
+        for (int c = 0; c < desc->channels; c++) {
+            const column_desc_t *col = &desc->col[c];
+            if (grp->width == sizeof(int32_t)) {
+                memcpy(grp->col[c] + pos * sizeof(int32_t), src + col->offset, sizeof(int32_t));
+                continue;
+            }
+            float v;
+            if (col->fixed) {
+                int32_t i;
+                memcpy(&i, src + col->offset, sizeof(i));
+                v = (float)i;
+            } else {
+                memcpy(&v, src + col->offset, sizeof(v));
+            }
+            long q = lrintf(v * grp->inv_lsb[c]);
+            int16_t count = (q > INT16_MAX) ? INT16_MAX : (q < INT16_MIN) ? INT16_MIN : (int16_t)q;
+            ((int16_t *)grp->col[c])[pos] = count;
+        }
+    }
+    if (data->imu_6axis.valid && data->imu_6axis.hires) {
+        flags |= RECORD_FLAG_IMU_HIRES;
+    }
+    buffer.flags[pos] = flags;
+}
+
+// Gathers the columns of the record at a ring position back into a frame
+static void record_load_pos(uint32_t pos, imu_data_t *data)
+{
+    uint8_t flags = buffer.flags[pos];
+    uint8_t *dst = (uint8_t *)data;
+    
+    memset(data, 0, sizeof(*data));
+    data->timestamp_us = buffer.block_base_us[pos / DATA_BUFFER_BLOCK] + buffer.ts_offset_us[pos];
+    for (size_t g = 0; g < SENSOR_GROUP_COUNT; g++) {
+        const sensor_desc_t *desc = &sensor_desc[g];
+        const column_group_t *grp = &buffer.groups[g];
+        if (!(flags & (1 << g))) {
+            continue;
+        }
+        *(bool *)(dst + desc->valid_offset) = true;
+        for (int c = 0; c < desc->channels; c++) {
+            const column_desc_t *col = &desc->col[c];
+            if (grp->width == sizeof(int32_t)) {
+                memcpy(dst + col->offset, grp->col[c] + pos * sizeof(int32_t), sizeof(int32_t));
+                continue;
+            }
+            float v = ((const int16_t *)grp->col[c])[pos] * grp->lsb[c];
+            if (col->fixed) {
+                int32_t i = (int32_t)lrintf(v);
+                memcpy(dst + col->offset, &i, sizeof(i));
+            } else {
+                memcpy(dst + col->offset, &v, sizeof(v));
+            }
+        }
+    }
+    data->imu_6axis.hires = (flags & RECORD_FLAG_IMU_HIRES) != 0;
+}
+
+static inline void record_load(uint32_t seq, imu_data_t *data)
+{
+    record_load_pos(record_pos(seq), data);
+}
+
 esp_err_t data_buffer_add(const imu_data_t *data)
 {
     if (data == NULL) {
         return ESP_ERR_INVALID_ARG;
     }
     
-    if (xSemaphoreTake(buffer_mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
+    // Only the task calling data_buffer_configure() adds, so the layout is stable here
+    if (buffer.storage == NULL) {
         buffer.stats.dropped_samples++;
-        return ESP_ERR_TIMEOUT;
+        return ESP_ERR_INVALID_STATE;
     }
     
     int64_t start_time = esp_timer_get_time();
     
-    // Check if buffer is full
-    if (buffer.full && !DATA_BUFFER_OVERWRITE) {
-        buffer.stats.dropped_samples++;
-        xSemaphoreGive(buffer_mutex);
-        return ESP_ERR_NO_MEM;
-    }
-    
-    // Add data to buffer
-    buffer.data[buffer.head] = *data;
-    buffer.head = (buffer.head + 1) % DATA_BUFFER_SIZE;
+    uint32_t head = buffer.head_seq;
+    uint32_t pos = record_pos(head);
     
-    if (buffer.full) {
-        buffer.tail = (buffer.tail + 1) % DATA_BUFFER_SIZE;
-        buffer.stats.buffer_overflows++;
-    } else {
-        buffer.count++;
-        if (buffer.head == buffer.tail) {
-            buffer.full = true;
+    // Starting a block reuses its keyframe: the records of the block's previous lap go with it
+    if (pos % DATA_BUFFER_BLOCK == 0 && record_count() + DATA_BUFFER_BLOCK > buffer.capacity) {
+        if (!DATA_BUFFER_OVERWRITE) {
+            buffer.stats.dropped_samples++;
+            return ESP_ERR_NO_MEM;
         }
+        uint32_t tail = seq_load(&buffer.tail_seq);
+        uint32_t new_tail = head + DATA_BUFFER_BLOCK - buffer.capacity;
+        buffer.stats.buffer_overflows += new_tail - tail;
+        tail_advance(new_tail);
     }
+    if (pos == 0) {
+        buffer.lap_seq = head;
+    }
+    
+    // Add data to buffer, then publish it
+    record_store(pos, data);
+    __atomic_store_n(&buffer.head_seq, head + 1, __ATOMIC_RELEASE);
     
     // Update statistics
     buffer.stats.total_samples++;
@@ -95,34 +400,125 @@ esp_err_t data_buffer_add(const imu_data_t *data)
     float processing_time = (float)(end_time - start_time);
     buffer.stats.avg_processing_time_us = (buffer.stats.avg_processing_time_us * 0.9f) + (processing_time * 0.1f);
     
-    xSemaphoreGive(buffer_mutex);
     return ESP_OK;
 }
 
-esp_err_t data_buffer_get(imu_data_t *data)
+void data_buffer_cursor_init(data_buffer_cursor_t *cursor, bool from_oldest)
 {
-    if (data == NULL) {
+    if (cursor == NULL) {
+        return;
+    }
+    cursor->seq = from_oldest ? seq_load(&buffer.tail_seq) : seq_load(&buffer.head_seq);
+    cursor->overruns = 0;
+}
+
+esp_err_t data_buffer_read_begin(data_buffer_cursor_t *cursor, uint32_t max_records, data_buffer_read_t *read)
+{
+    if (cursor == NULL || read == NULL) {
         return ESP_ERR_INVALID_ARG;
     }
+    memset(read, 0, sizeof(*read));
     
     if (xSemaphoreTake(buffer_mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
         return ESP_ERR_TIMEOUT;
     }
-    
-    if (buffer.count == 0 && !buffer.full) {
+    if (buffer.storage == NULL) {
         xSemaphoreGive(buffer_mutex);
         return ESP_ERR_NOT_FOUND;
     }
     
-    *data = buffer.data[buffer.tail];
-    buffer.tail = (buffer.tail + 1) % DATA_BUFFER_SIZE;
-    buffer.count--;
-    buffer.full = false;
+    uint32_t tail = seq_load(&buffer.tail_seq);
+    uint32_t head = seq_load(&buffer.head_seq);
     
-    xSemaphoreGive(buffer_mutex);
+    // Fell behind the ring: skip to the oldest record still there
+    if ((int32_t)(cursor->seq - tail) < 0) {
+        read->lost = tail - cursor->seq;
+        cursor->overruns += read->lost;
+        cursor->seq = tail;
+    } else if ((int32_t)(head - cursor->seq) < 0) {
+        cursor->seq = head;
+    }
+    
+    uint32_t n = head - cursor->seq;
+    if (max_records > 0 && n > max_records) {
+        n = max_records;
+    }
+    read->first_seq = cursor->seq;
+    read->count = n;
+    read->lag = head - cursor->seq - n;
+    if (n > 0) {
+        uint32_t pos = record_pos(cursor->seq);
+        uint32_t first = buffer.capacity - pos;
+        read->span[0].pos = pos;
+        read->span[0].len = (n < first) ? n : first;
+        read->span[1].pos = 0;
+        read->span[1].len = n - read->span[0].len;
+    }
     return ESP_OK;
 }
 
+uint32_t data_buffer_read_end(data_buffer_cursor_t *cursor, const data_buffer_read_t *read)
+{
+    if (cursor == NULL || read == NULL) {
+        return 0;
+    }
+    
+    // Records the writer reclaimed while they were being read
+    uint32_t overwritten = 0;
+    if (read->count > 0 && !record_still_valid(read->first_seq)) {
+        overwritten = seq_load(&buffer.tail_seq) - read->first_seq;
+        if (overwritten > read->count) {
+            overwritten = read->count;
+        }
+        cursor->overruns += overwritten;
+    }
+    cursor->seq = read->first_seq + read->count;
+    
+    xSemaphoreGive(buffer_mutex);
+    return overwritten;
+}
+
+void data_buffer_load(uint32_t pos, imu_data_t *data)
+{
+    if (data != NULL && pos < buffer.capacity) {
+        record_load_pos(pos, data);
+    }
+}
+
+uint64_t data_buffer_timestamp_at(uint32_t pos)
+{
+    return buffer.block_base_us[pos / DATA_BUFFER_BLOCK] + buffer.ts_offset_us[pos];
+}
+
+bool data_buffer_valid_at(uint32_t pos, uint8_t sensor_id)
+{
+    for (size_t g = 0; g < SENSOR_GROUP_COUNT; g++) {
+        if (sensor_desc[g].sensor_id == sensor_id) {
+            return (buffer.flags[pos] & (1 << g)) != 0;
+        }
+    }
+    return false;
+}
+
+const void *data_buffer_column(uint8_t sensor_id, uint8_t channel, uint8_t *width, float *lsb)
+{
+    for (size_t g = 0; g < SENSOR_GROUP_COUNT; g++) {
+        const column_group_t *grp = &buffer.groups[g];
+        if (sensor_desc[g].sensor_id != sensor_id || !grp->allocated ||
+            channel >= sensor_desc[g].channels) {
+            continue;
+        }
+        if (width != NULL) {
+            *width = grp->width;
+        }
+        if (lsb != NULL) {
+            *lsb = (grp->width == sizeof(int32_t)) ? 1.0f : grp->lsb[channel];
+        }
+        return grp->col[channel];
+    }
+    return NULL;
+}
+
 esp_err_t data_buffer_get_latest(imu_data_t *data)
 {
     if (data == NULL) {
@@ -133,21 +529,17 @@ esp_err_t data_buffer_get_latest(imu_data_t *data)
         return ESP_ERR_TIMEOUT;
     }
     
-    // Buffer is empty only when count is 0 AND not full
-    // If full=true, buffer has DATA_BUFFER_SIZE valid samples
-    if (buffer.count == 0 && !buffer.full) {
+    if (buffer.storage == NULL || record_count() == 0) {
         xSemaphoreGive(buffer_mutex);
         return ESP_ERR_NOT_FOUND;
     }
     
-    // Get the most recent data
-    // When full, head points to next write position, so last valid is head-1
-    // When not full, head-1 is also the last written
-    uint32_t latest_idx = (buffer.head - 1 + DATA_BUFFER_SIZE) % DATA_BUFFER_SIZE;
-    *data = buffer.data[latest_idx];
+    uint32_t seq = seq_load(&buffer.head_seq) - 1;
+    record_load(seq, data);
+    bool valid = record_still_valid(seq);
     
     xSemaphoreGive(buffer_mutex);
-    return ESP_OK;
+    return valid ? ESP_OK : ESP_ERR_INVALID_STATE;
 }
 
 esp_err_t data_buffer_get_range(imu_data_t *data, uint32_t start_idx, uint32_t count)
@@ -160,8 +552,9 @@ esp_err_t data_buffer_get_range(imu_data_t *data, uint32_t start_idx, uint32_t c
         return ESP_ERR_TIMEOUT;
     }
     
-    uint32_t available_count = buffer.full ? DATA_BUFFER_SIZE : buffer.count;
-    if (start_idx >= available_count) {
+    uint32_t tail = seq_load(&buffer.tail_seq);
+    uint32_t available_count = seq_load(&buffer.head_seq) - tail;
+    if (buffer.storage == NULL || start_idx >= available_count) {
         xSemaphoreGive(buffer_mutex);
         return ESP_ERR_INVALID_ARG;
     }
@@ -170,12 +563,12 @@ esp_err_t data_buffer_get_range(imu_data_t *data, uint32_t start_idx, uint32_t c
                            (available_count - start_idx) : count;
     
     for (uint32_t i = 0; i < actual_count; i++) {
-        uint32_t idx = (buffer.tail + start_idx + i) % DATA_BUFFER_SIZE;
-        data[i] = buffer.data[idx];
+        record_load(tail + start_idx + i, &data[i]);
     }
+    bool valid = record_still_valid(tail + start_idx);
     
     xSemaphoreGive(buffer_mutex);
-    return ESP_OK;
+    return valid ? ESP_OK : ESP_ERR_INVALID_STATE;
 }
 
 esp_err_t data_buffer_get_stats(buffer_stats_t *stats)
@@ -196,304 +589,271 @@ esp_err_t data_buffer_get_stats(buffer_stats_t *stats)
 
 esp_err_t data_buffer_clear(void)
 {
-    if (xSemaphoreTake(buffer_mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
-        return ESP_ERR_TIMEOUT;
-    }
-    
-    buffer.head = 0;
-    buffer.tail = 0;
-    buffer.count = 0;
-    buffer.full = false;
-    
-    xSemaphoreGive(buffer_mutex);
+    tail_advance(seq_load(&buffer.head_seq));
     return ESP_OK;
 }
 
 uint32_t data_buffer_get_count(void)
 {
-    if (xSemaphoreTake(buffer_mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
-        return 0;
-    }
-    
-    uint32_t count = buffer.full ? DATA_BUFFER_SIZE : buffer.count;
-    xSemaphoreGive(buffer_mutex);
-    return count;
+    return record_count();
+}
+
+uint32_t data_buffer_get_head_seq(void)
+{
+    return seq_load(&buffer.head_seq);
 }
 
 bool data_buffer_is_full(void)
 {
-    if (xSemaphoreTake(buffer_mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
-        return false;
-    }
-    
-    bool full = buffer.full;
-    xSemaphoreGive(buffer_mutex);
-    return full;
+    // Whole blocks are evicted, so a full ring holds between capacity - block and capacity records
+    return buffer.storage != NULL && record_count() + DATA_BUFFER_BLOCK > buffer.capacity;
 }
 
 bool data_buffer_is_empty(void)
 {
-    if (xSemaphoreTake(buffer_mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
-        return true;
-    }
-    
-    bool empty = (buffer.count == 0 && !buffer.full);
-    xSemaphoreGive(buffer_mutex);
-    return empty;
+    return record_count() == 0;
 }
 
-esp_err_t data_buffer_export_json(char *json_buffer, size_t buffer_size, uint32_t max_samples)
+// Each field takes at most NUM_FORMAT_MAX_LEN with its separator
+static char *csv_float(char *p, float value, uint8_t decimals)
 {
-    if (json_buffer == NULL || buffer_size == 0) {
-        return ESP_ERR_INVALID_ARG;
-    }
-    
-    if (xSemaphoreTake(buffer_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
-        return ESP_ERR_TIMEOUT;
-    }
-    
-    cJSON *root = cJSON_CreateObject();
-    cJSON *samples = cJSON_CreateArray();
-    cJSON *stats = cJSON_CreateObject();
-    
-    // Add statistics
-    cJSON_AddNumberToObject(stats, "total_samples", buffer.stats.total_samples);
-    cJSON_AddNumberToObject(stats, "dropped_samples", buffer.stats.dropped_samples);
-    cJSON_AddNumberToObject(stats, "buffer_overflows", buffer.stats.buffer_overflows);
-    cJSON_AddNumberToObject(stats, "last_timestamp_us", buffer.stats.last_timestamp_us);
-    cJSON_AddNumberToObject(stats, "avg_processing_time_us", buffer.stats.avg_processing_time_us);
-    cJSON_AddItemToObject(root, "statistics", stats);
-    
-    // Add samples
-    uint32_t available_count = buffer.full ? DATA_BUFFER_SIZE : buffer.count;
-    uint32_t export_count = (max_samples > 0 && max_samples < available_count) ? 
-                           max_samples : available_count;
-    
-    for (uint32_t i = 0; i < export_count; i++) {
-        uint32_t idx = (buffer.tail + i) % DATA_BUFFER_SIZE;
-        imu_data_t *data = &buffer.data[idx];
-        
-        cJSON *sample = cJSON_CreateObject();
-        cJSON_AddNumberToObject(sample, "timestamp_us", data->timestamp_us);
-        
-        // Magnetometer data
-        if (data->magnetometer.valid) {
-            cJSON *mag = cJSON_CreateObject();
-            cJSON_AddNumberToObject(mag, "x_mg", data->magnetometer.x_mg);
-            cJSON_AddNumberToObject(mag, "y_mg", data->magnetometer.y_mg);
-            cJSON_AddNumberToObject(mag, "z_mg", data->magnetometer.z_mg);
-            cJSON_AddNumberToObject(mag, "temperature_c", data->magnetometer.temperature_c);
-            cJSON_AddItemToObject(sample, "magnetometer", mag);
-        }
-        
-        // Accelerometer data
-        if (data->accelerometer.valid) {
-            cJSON *accel = cJSON_CreateObject();
-            cJSON_AddNumberToObject(accel, "x_g", data->accelerometer.x_g);
-            cJSON_AddNumberToObject(accel, "y_g", data->accelerometer.y_g);
-            cJSON_AddNumberToObject(accel, "z_g", data->accelerometer.z_g);
-            cJSON_AddItemToObject(sample, "accelerometer", accel);
-        }
-        
-        // IMU 6-axis data
-        if (data->imu_6axis.valid) {
-            cJSON *imu = cJSON_CreateObject();
-            cJSON *accel = cJSON_CreateObject();
-            cJSON *gyro = cJSON_CreateObject();
-            
-            cJSON_AddNumberToObject(accel, "x_g", data->imu_6axis.accel_x_g);
-            cJSON_AddNumberToObject(accel, "y_g", data->imu_6axis.accel_y_g);
-            cJSON_AddNumberToObject(accel, "z_g", data->imu_6axis.accel_z_g);
-            cJSON_AddNumberToObject(gyro, "x_dps", data->imu_6axis.gyro_x_dps);
-            cJSON_AddNumberToObject(gyro, "y_dps", data->imu_6axis.gyro_y_dps);
-            cJSON_AddNumberToObject(gyro, "z_dps", data->imu_6axis.gyro_z_dps);
-            cJSON_AddNumberToObject(imu, "temperature_c", data->imu_6axis.temperature_c);
-            
-            cJSON_AddItemToObject(imu, "accelerometer", accel);
-            cJSON_AddItemToObject(imu, "gyroscope", gyro);
-            cJSON_AddItemToObject(sample, "imu_6axis", imu);
-        }
-        
-        // Inclinometer data
-        if (data->inclinometer.valid) {
-            cJSON *incl = cJSON_CreateObject();
-            cJSON *angles = cJSON_CreateObject();
-            cJSON *accel = cJSON_CreateObject();
-            
-            cJSON_AddNumberToObject(angles, "x_deg", data->inclinometer.angle_x_deg);
-            cJSON_AddNumberToObject(angles, "y_deg", data->inclinometer.angle_y_deg);
-            cJSON_AddNumberToObject(angles, "z_deg", data->inclinometer.angle_z_deg);
-            cJSON_AddNumberToObject(accel, "x_g", data->inclinometer.accel_x_g);
-            cJSON_AddNumberToObject(accel, "y_g", data->inclinometer.accel_y_g);
-            cJSON_AddNumberToObject(accel, "z_g", data->inclinometer.accel_z_g);
-            cJSON_AddNumberToObject(incl, "temperature_c", data->inclinometer.temperature_c);
-            
-            cJSON_AddItemToObject(incl, "angles", angles);
-            cJSON_AddItemToObject(incl, "accelerometer", accel);
-            cJSON_AddItemToObject(sample, "inclinometer", incl);
-        }
-        
-        cJSON_AddItemToArray(samples, sample);
-    }
-    
-    cJSON_AddItemToObject(root, "samples", samples);
-    cJSON_AddNumberToObject(root, "sample_count", export_count);
-    
-    char *json_string = cJSON_Print(root);
-    if (json_string != NULL) {
-        strncpy(json_buffer, json_string, buffer_size - 1);
-        json_buffer[buffer_size - 1] = '\0';
-        free(json_string);
-    }
-    
-    cJSON_Delete(root);
-    xSemaphoreGive(buffer_mutex);
-    return ESP_OK;
+    *p++ = ',';
+    return p + num_format_float(p, value, decimals);
+}
+
+static char *csv_fixed(char *p, int32_t value, uint8_t scale)
+{
+    *p++ = ',';
+    return p + num_format_fixed(p, value, scale, scale);
+}
+
+// out has room for DATA_BUFFER_EXPORT_ROW_MAX; invalid sensors print as zeros
+static int export_row_csv(char *out, const imu_data_t *data)
+{
+    const bool mag = data->magnetometer.valid;
+    const bool acc = data->accelerometer.valid;
+    const bool imu = data->imu_6axis.valid;
+    const bool inc = data->inclinometer.valid;
+    char *p = out;
+    
+    p += num_format_u64(p, data->timestamp_us);
+    p = csv_float(p, mag ? data->magnetometer.x_mg : 0.0f, 3);
+    p = csv_float(p, mag ? data->magnetometer.y_mg : 0.0f, 3);
+    p = csv_float(p, mag ? data->magnetometer.z_mg : 0.0f, 3);
+    p = csv_float(p, mag ? data->magnetometer.temperature_c : 0.0f, 2);
+    p = csv_float(p, acc ? data->accelerometer.x_g : 0.0f, 3);
+    p = csv_float(p, acc ? data->accelerometer.y_g : 0.0f, 3);
+    p = csv_float(p, acc ? data->accelerometer.z_g : 0.0f, 3);
+    // Fixed point printed at full resolution (µg, mdps, m°C)
+    p = csv_fixed(p, imu ? data->imu_6axis.accel_x_ug : 0, 6);
+    p = csv_fixed(p, imu ? data->imu_6axis.accel_y_ug : 0, 6);
+    p = csv_fixed(p, imu ? data->imu_6axis.accel_z_ug : 0, 6);
+    p = csv_fixed(p, imu ? data->imu_6axis.gyro_x_mdps : 0, 3);
+    p = csv_fixed(p, imu ? data->imu_6axis.gyro_y_mdps : 0, 3);
+    p = csv_fixed(p, imu ? data->imu_6axis.gyro_z_mdps : 0, 3);
+    p = csv_fixed(p, imu ? data->imu_6axis.temperature_mc : 0, 3);
+    p = csv_float(p, inc ? data->inclinometer.angle_x_deg : 0.0f, 3);
+    p = csv_float(p, inc ? data->inclinometer.angle_y_deg : 0.0f, 3);
+    p = csv_float(p, inc ? data->inclinometer.angle_z_deg : 0.0f, 3);
+    p = csv_float(p, inc ? data->inclinometer.accel_x_g : 0.0f, 3);
+    p = csv_float(p, inc ? data->inclinometer.accel_y_g : 0.0f, 3);
+    p = csv_float(p, inc ? data->inclinometer.accel_z_g : 0.0f, 3);
+    p = csv_float(p, inc ? data->inclinometer.temperature_c : 0.0f, 2);
+    *p++ = '\n';
+    return (int)(p - out);
+}
+
+// Same objects the cJSON export produced, written compact in one pass
+static void export_row_json(json_writer_t *w, const imu_data_t *data)
+{
+    json_writer_begin_object(w, NULL);
+    json_writer_uint(w, "timestamp_us", data->timestamp_us);
+    
+    if (data->magnetometer.valid) {
+        json_writer_begin_object(w, "magnetometer");
+        json_writer_float(w, "x_mg", data->magnetometer.x_mg, 3);
+        json_writer_float(w, "y_mg", data->magnetometer.y_mg, 3);
+        json_writer_float(w, "z_mg", data->magnetometer.z_mg, 3);
+        json_writer_float(w, "temperature_c", data->magnetometer.temperature_c, 2);
+        json_writer_end_object(w);
+    }
+    if (data->accelerometer.valid) {
+        json_writer_begin_object(w, "accelerometer");
+        json_writer_float(w, "x_g", data->accelerometer.x_g, 5);
+        json_writer_float(w, "y_g", data->accelerometer.y_g, 5);
+        json_writer_float(w, "z_g", data->accelerometer.z_g, 5);
+        json_writer_end_object(w);
+    }
+    if (data->imu_6axis.valid) {
+        json_writer_begin_object(w, "imu_6axis");
+        json_writer_fixed(w, "temperature_c", data->imu_6axis.temperature_mc, 3);
+        json_writer_bool(w, "hires", data->imu_6axis.hires);
+        json_writer_begin_object(w, "accelerometer");
+        json_writer_fixed(w, "x_g", data->imu_6axis.accel_x_ug, 6);
+        json_writer_fixed(w, "y_g", data->imu_6axis.accel_y_ug, 6);
+        json_writer_fixed(w, "z_g", data->imu_6axis.accel_z_ug, 6);
+        json_writer_end_object(w);
+        json_writer_begin_object(w, "gyroscope");
+        json_writer_fixed(w, "x_dps", data->imu_6axis.gyro_x_mdps, 3);
+        json_writer_fixed(w, "y_dps", data->imu_6axis.gyro_y_mdps, 3);
+        json_writer_fixed(w, "z_dps", data->imu_6axis.gyro_z_mdps, 3);
+        json_writer_end_object(w);
+        json_writer_end_object(w);
+    }
+    if (data->inclinometer.valid) {
+        json_writer_begin_object(w, "inclinometer");
+        json_writer_float(w, "temperature_c", data->inclinometer.temperature_c, 2);
+        json_writer_begin_object(w, "angles");
+        json_writer_float(w, "x_deg", data->inclinometer.angle_x_deg, 3);
+        json_writer_float(w, "y_deg", data->inclinometer.angle_y_deg, 3);
+        json_writer_float(w, "z_deg", data->inclinometer.angle_z_deg, 3);
+        json_writer_end_object(w);
+        json_writer_begin_object(w, "accelerometer");
+        json_writer_float(w, "x_g", data->inclinometer.accel_x_g, 4);
+        json_writer_float(w, "y_g", data->inclinometer.accel_y_g, 4);
+        json_writer_float(w, "z_g", data->inclinometer.accel_z_g, 4);
+        json_writer_end_object(w);
+        json_writer_end_object(w);
+    }
+    
+    json_writer_end_object(w);
 }
 
-esp_err_t data_buffer_export_csv(char *csv_buffer, size_t buffer_size, uint32_t max_samples)
+esp_err_t data_buffer_export_stream(data_buffer_export_format_t format, uint32_t max_samples,
+                                    data_buffer_write_cb_t write, void *ctx)
 {
-    if (csv_buffer == NULL || buffer_size == 0) {
+    if (write == NULL || (format != DATA_BUFFER_EXPORT_CSV && format != DATA_BUFFER_EXPORT_JSON)) {
         return ESP_ERR_INVALID_ARG;
     }
     
-    if (xSemaphoreTake(buffer_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
-        return ESP_ERR_TIMEOUT;
-    }
-    
-    // CSV header
-    int offset = snprintf(csv_buffer, buffer_size,
-        "timestamp_us,mag_x_mg,mag_y_mg,mag_z_mg,mag_temp_c,"
-        "accel_x_g,accel_y_g,accel_z_g,"
-        "imu_accel_x_g,imu_accel_y_g,imu_accel_z_g,"
-        "imu_gyro_x_dps,imu_gyro_y_dps,imu_gyro_z_dps,imu_temp_c,"
-        "incl_angle_x_deg,incl_angle_y_deg,incl_angle_z_deg,"
-        "incl_accel_x_g,incl_accel_y_g,incl_accel_z_g,incl_temp_c\n");
-    
-    if (offset >= buffer_size) {
-        xSemaphoreGive(buffer_mutex);
+    imu_data_t *batch = malloc(DATA_BUFFER_EXPORT_BATCH * sizeof(imu_data_t));
+    char *out = malloc(DATA_BUFFER_EXPORT_CHUNK);
+    if (batch == NULL || out == NULL) {
+        free(batch);
+        free(out);
         return ESP_ERR_NO_MEM;
     }
     
-    // Add data rows
-    uint32_t available_count = buffer.full ? DATA_BUFFER_SIZE : buffer.count;
-    uint32_t export_count = (max_samples > 0 && max_samples < available_count) ? 
-                           max_samples : available_count;
+    // Snapshot: the records present now, oldest first. Records the writer adds
+    // meanwhile are left out; records it reclaims before they are copied are skipped.
+    data_buffer_cursor_t cursor;
+    data_buffer_cursor_init(&cursor, true);
+    uint32_t remaining = buffer.storage ? seq_load(&buffer.head_seq) - cursor.seq : 0;
+    if (max_samples > 0 && remaining > max_samples) {
+        remaining = max_samples;
+    }
+    uint32_t end_seq = cursor.seq + remaining;
     
-    for (uint32_t i = 0; i < export_count; i++) {
-        uint32_t idx = (buffer.tail + i) % DATA_BUFFER_SIZE;
-        imu_data_t *data = &buffer.data[idx];
-        
-        int row_len = snprintf(csv_buffer + offset, buffer_size - offset,
-            "%llu,%.3f,%.3f,%.3f,%.2f,"
-            "%.3f,%.3f,%.3f,"
-            "%.3f,%.3f,%.3f,"
-            "%.3f,%.3f,%.3f,%.2f,"
-            "%.3f,%.3f,%.3f,"
-            "%.3f,%.3f,%.3f,%.2f\n",
-            data->timestamp_us,
-            data->magnetometer.valid ? data->magnetometer.x_mg : 0.0f,
-            data->magnetometer.valid ? data->magnetometer.y_mg : 0.0f,
-            data->magnetometer.valid ? data->magnetometer.z_mg : 0.0f,
-            data->magnetometer.valid ? data->magnetometer.temperature_c : 0.0f,
-            data->accelerometer.valid ? data->accelerometer.x_g : 0.0f,
-            data->accelerometer.valid ? data->accelerometer.y_g : 0.0f,
-            data->accelerometer.valid ? data->accelerometer.z_g : 0.0f,
-            data->imu_6axis.valid ? data->imu_6axis.accel_x_g : 0.0f,
-            data->imu_6axis.valid ? data->imu_6axis.accel_y_g : 0.0f,
-            data->imu_6axis.valid ? data->imu_6axis.accel_z_g : 0.0f,
-            data->imu_6axis.valid ? data->imu_6axis.gyro_x_dps : 0.0f,
-            data->imu_6axis.valid ? data->imu_6axis.gyro_y_dps : 0.0f,
-            data->imu_6axis.valid ? data->imu_6axis.gyro_z_dps : 0.0f,
-            data->imu_6axis.valid ? data->imu_6axis.temperature_c : 0.0f,
-            data->inclinometer.valid ? data->inclinometer.angle_x_deg : 0.0f,
-            data->inclinometer.valid ? data->inclinometer.angle_y_deg : 0.0f,
-            data->inclinometer.valid ? data->inclinometer.angle_z_deg : 0.0f,
-            data->inclinometer.valid ? data->inclinometer.accel_x_g : 0.0f,
-            data->inclinometer.valid ? data->inclinometer.accel_y_g : 0.0f,
-            data->inclinometer.valid ? data->inclinometer.accel_z_g : 0.0f,
-            data->inclinometer.valid ? data->inclinometer.temperature_c : 0.0f);
+    uint32_t exported = 0;
+    uint32_t skipped = 0;
+    uint32_t busy = 0;
+    size_t bytes = 0;
+    int64_t start_time = esp_timer_get_time();
+    esp_err_t ret = ESP_OK;
+    
+    // JSON goes through the writer, which flushes the chunk by itself; CSV rows
+    // are bounded, so the chunk is flushed whenever a row might not fit
+    json_writer_t w;
+    int len = 0;
+    if (format == DATA_BUFFER_EXPORT_JSON) {
+        buffer_stats_t stats = {0};
+        data_buffer_get_stats(&stats);
+        json_writer_init(&w, out, DATA_BUFFER_EXPORT_CHUNK, write, ctx);
+        json_writer_begin_object(&w, NULL);
+        json_writer_begin_object(&w, "statistics");
+        json_writer_uint(&w, "total_samples", stats.total_samples);
+        json_writer_uint(&w, "dropped_samples", stats.dropped_samples);
+        json_writer_uint(&w, "buffer_overflows", stats.buffer_overflows);
+        json_writer_uint(&w, "last_timestamp_us", stats.last_timestamp_us);
+        json_writer_float(&w, "avg_processing_time_us", stats.avg_processing_time_us, 2);
+        json_writer_end_object(&w);
+        json_writer_begin_array(&w, "samples");
+    } else {
+        len = snprintf(out, DATA_BUFFER_EXPORT_CHUNK,
+            "timestamp_us,mag_x_mg,mag_y_mg,mag_z_mg,mag_temp_c,"
+            "accel_x_g,accel_y_g,accel_z_g,"
+            "imu_accel_x_g,imu_accel_y_g,imu_accel_z_g,"
+            "imu_gyro_x_dps,imu_gyro_y_dps,imu_gyro_z_dps,imu_temp_c,"
+            "incl_angle_x_deg,incl_angle_y_deg,incl_angle_z_deg,"
+            "incl_accel_x_g,incl_accel_y_g,incl_accel_z_g,incl_temp_c\n");
+    }
+    
+    while ((int32_t)(end_seq - cursor.seq) > 0) {
+        uint32_t want = end_seq - cursor.seq;
+        if (want > DATA_BUFFER_EXPORT_BATCH) {
+            want = DATA_BUFFER_EXPORT_BATCH;
+        }
         
-        if (row_len >= (buffer_size - offset)) {
-            break; // Buffer full
+        // Copy a batch out so the layout lock is not held while the sink sends
+        data_buffer_read_t rd;
+        ret = data_buffer_read_begin(&cursor, want, &rd);
+        if (ret == ESP_ERR_TIMEOUT && ++busy < DATA_BUFFER_EXPORT_RETRIES) {
+            vTaskDelay(1);
+            continue;
         }
-        offset += row_len;
-    }
-    
-    xSemaphoreGive(buffer_mutex);
-    return ESP_OK;
-}
-
-esp_err_t data_buffer_export_csv_dynamic(char **out_buf, size_t *out_len, uint32_t max_samples) {
-    if (!out_buf || !out_len) {
-        return ESP_ERR_INVALID_ARG;
-    }
-    *out_buf = NULL;
-    *out_len = 0;
-    size_t capacity = 8192;
-    char *buffer = malloc(capacity);
-    if (!buffer) {
-        return ESP_ERR_NO_MEM;
-    }
-    esp_err_t ret = data_buffer_export_csv(buffer, capacity, max_samples);
-    if (ret == ESP_ERR_NO_MEM) {
-        size_t new_capacity = capacity * 2;
-        while (new_capacity < capacity * 8) {
-            char *new_buf = realloc(buffer, new_capacity);
-            if (!new_buf) {
-                free(buffer);
-                return ESP_ERR_NO_MEM;
-            }
-            buffer = new_buf;
-            ret = data_buffer_export_csv(buffer, new_capacity, max_samples);
-            if (ret != ESP_ERR_NO_MEM) {
-                break;
+        if (ret != ESP_OK) {
+            break;
+        }
+        busy = 0;
+        uint32_t n = 0;
+        for (int s = 0; s < 2; s++) {
+            for (uint32_t i = 0; i < rd.span[s].len; i++) {
+                data_buffer_load(rd.span[s].pos + i, &batch[n++]);
             }
-            new_capacity *= 2;
         }
-    }
-    if (ret == ESP_OK) {
-        *out_buf = buffer;
-        *out_len = strlen(buffer);
-        return ESP_OK;
-    }
-    free(buffer);
-    return ret;
-}
-
-esp_err_t data_buffer_export_json_dynamic(char **out_buf, size_t *out_len, uint32_t max_samples) {
-    if (!out_buf || !out_len) {
-        return ESP_ERR_INVALID_ARG;
-    }
-    *out_buf = NULL;
-    *out_len = 0;
-    size_t capacity = 8192;
-    char *buffer = malloc(capacity);
-    if (!buffer) {
-        return ESP_ERR_NO_MEM;
-    }
-    esp_err_t ret = data_buffer_export_json(buffer, capacity, max_samples);
-    if (ret == ESP_ERR_NO_MEM) {
-        size_t new_capacity = capacity * 2;
-        while (new_capacity < capacity * 8) {
-            char *new_buf = realloc(buffer, new_capacity);
-            if (!new_buf) {
-                free(buffer);
-                return ESP_ERR_NO_MEM;
+        uint32_t overwritten = data_buffer_read_end(&cursor, &rd);
+        skipped += rd.lost + overwritten;
+        
+        // A cursor that was pushed past the snapshot end may have read newer records
+        uint32_t in_snapshot = n;
+        if ((int32_t)(cursor.seq - end_seq) > 0) {
+            uint32_t extra = cursor.seq - end_seq;
+            in_snapshot = (extra < n) ? n - extra : 0;
+        }
+        
+        for (uint32_t i = overwritten; i < in_snapshot; i++) {
+            if (format == DATA_BUFFER_EXPORT_JSON) {
+                export_row_json(&w, &batch[i]);
+                ret = w.err;
+            } else {
+                if (len > DATA_BUFFER_EXPORT_CHUNK - DATA_BUFFER_EXPORT_ROW_MAX) {
+                    ret = write(out, len, ctx);
+                    bytes += len;
+                    len = 0;
+                }
+                if (ret == ESP_OK) {
+                    len += export_row_csv(out + len, &batch[i]);
+                }
             }
-            buffer = new_buf;
-            ret = data_buffer_export_json(buffer, new_capacity, max_samples);
-            if (ret != ESP_ERR_NO_MEM) {
+            if (ret != ESP_OK) {
                 break;
             }
-            new_capacity *= 2;
+            exported++;
+        }
+        if (ret != ESP_OK || n == 0) {
+            break;
         }
     }
-    if (ret == ESP_OK) {
-        *out_buf = buffer;
-        *out_len = strlen(buffer);
-        return ESP_OK;
+    
+    if (format == DATA_BUFFER_EXPORT_JSON) {
+        if (ret == ESP_OK) {
+            json_writer_end_array(&w);
+            json_writer_uint(&w, "sample_count", exported);
+            json_writer_uint(&w, "skipped", skipped);
+            json_writer_end_object(&w);
+            ret = json_writer_finish(&w);
+        }
+        bytes = w.total;
+    } else if (ret == ESP_OK && len > 0) {
+        ret = write(out, len, ctx);
+        bytes += len;
     }
-    free(buffer);
+    
+    ESP_LOGI(TAG, "Export: %lu records (%lu skipped), %u bytes, %lld ms",
+             (unsigned long)exported, (unsigned long)skipped, (unsigned)bytes,
+             (esp_timer_get_time() - start_time) / 1000);
+    
+    free(batch);
+    free(out);
     return ret;
 }
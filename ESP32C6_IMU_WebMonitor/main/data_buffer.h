@@ -4,10 +4,13 @@
 #include "esp_err.h"
 #include "imu_manager.h"
 #include <stdint.h>
+#include <stddef.h>
 #include <stdbool.h>
 
-// Buffer configuration
-#define DATA_BUFFER_SIZE 1000  // Number of samples to keep in buffer
+// Buffer configuration: columnar history of the fused frames, one column per
+// channel of each enabled sensor, sized by the frame rate within a RAM budget
+#define DATA_BUFFER_RETENTION_S     50          // Seconds of history to keep
+#define DATA_BUFFER_MEMORY_BUDGET   (48 * 1024) // Upper bound for all columns
 #define DATA_BUFFER_OVERWRITE true  // Overwrite oldest data when full
 
 // Statistics structure
@@ -17,12 +20,35 @@ typedef struct {
     uint32_t buffer_overflows;
     uint64_t last_timestamp_us;
     float avg_processing_time_us;
+    uint32_t capacity;          // Records the current layout can hold
+    uint32_t bytes_per_record;
+    uint32_t memory_bytes;      // Allocated for the columns
 } buffer_stats_t;
 
+// Independent reader position in the broadcast ring
+typedef struct {
+    uint32_t seq;               // Next record this reader consumes
+    uint32_t overruns;          // Records this reader lost to the writer so far
+} data_buffer_cursor_t;
+
+// Result of data_buffer_read_begin(): up to two contiguous ring spans, read in place
+typedef struct {
+    uint32_t first_seq;
+    uint32_t count;             // Records in both spans
+    struct {
+        uint32_t pos;           // Ring position, for data_buffer_load() and data_buffer_column()
+        uint32_t len;
+    } span[2];
+    uint32_t lag;               // Records still behind the head after this read
+    uint32_t lost;              // Records skipped because the cursor fell out of the ring
+} data_buffer_read_t;
+
 // Data buffer API
 esp_err_t data_buffer_init(void);
+// Allocates columns for the enabled sensors at the given frame rate. A no-op when
+// nothing changed; otherwise the history is cleared.
+esp_err_t data_buffer_configure(uint8_t sensors, uint32_t frame_rate_hz);
 esp_err_t data_buffer_add(const imu_data_t *data);
-esp_err_t data_buffer_get(imu_data_t *data);
 esp_err_t data_buffer_get_latest(imu_data_t *data);
 esp_err_t data_buffer_get_range(imu_data_t *data, uint32_t start_idx, uint32_t count);
 esp_err_t data_buffer_get_stats(buffer_stats_t *stats);
@@ -30,11 +56,40 @@ esp_err_t data_buffer_clear(void);
 uint32_t data_buffer_get_count(void);
 bool data_buffer_is_full(void);
 bool data_buffer_is_empty(void);
+uint32_t data_buffer_get_head_seq(void);
+
+// Multi-reader access. The writer never waits for readers: a reader that falls
+// behind skips ahead (lost), and records reclaimed while being read are reported
+// by data_buffer_read_end() as the first N records of that read.
+void data_buffer_cursor_init(data_buffer_cursor_t *cursor, bool from_oldest);
+// Holds the column layout until data_buffer_read_end(); max_records 0 means all
+esp_err_t data_buffer_read_begin(data_buffer_cursor_t *cursor, uint32_t max_records, data_buffer_read_t *read);
+uint32_t data_buffer_read_end(data_buffer_cursor_t *cursor, const data_buffer_read_t *read);
+// In-place access to positions inside a read
+void data_buffer_load(uint32_t pos, imu_data_t *data);
+uint64_t data_buffer_timestamp_at(uint32_t pos);
+bool data_buffer_valid_at(uint32_t pos, uint8_t sensor_id);
+// Column base of one channel (index by position): int16 counts of lsb, or int32 when width is 4
+const void *data_buffer_column(uint8_t sensor_id, uint8_t channel, uint8_t *width, float *lsb);
+
+// Streaming export: rows are formatted into one reusable chunk and handed to
+// the sink as it fills, so memory stays constant whatever the export size
+#define DATA_BUFFER_EXPORT_CHUNK    2048    // Bytes per sink call, at most
+#define DATA_BUFFER_EXPORT_ROW_MAX  704     // Longest CSV row: 22 fields of up to NUM_FORMAT_MAX_LEN
+#define DATA_BUFFER_EXPORT_BATCH    16      // Records copied out of the ring per lock
+#define DATA_BUFFER_EXPORT_RETRIES  10      // Busy layout lock attempts before giving up
+
+typedef enum {
+    DATA_BUFFER_EXPORT_CSV = 0,
+    DATA_BUFFER_EXPORT_JSON,
+} data_buffer_export_format_t;
+
+// Receives each filled chunk; anything but ESP_OK stops the export
+typedef esp_err_t (*data_buffer_write_cb_t)(const char *data, size_t len, void *ctx);
 
-// JSON export functions
-esp_err_t data_buffer_export_json(char *json_buffer, size_t buffer_size, uint32_t max_samples);
-esp_err_t data_buffer_export_csv(char *csv_buffer, size_t buffer_size, uint32_t max_samples);
-esp_err_t data_buffer_export_json_dynamic(char **out_buf, size_t *out_len, uint32_t max_samples);
-esp_err_t data_buffer_export_csv_dynamic(char **out_buf, size_t *out_len, uint32_t max_samples);
+// Exports the records buffered when the call starts, oldest first; max_samples
+// 0 means all. Records reclaimed by the writer before they are copied are skipped.
+esp_err_t data_buffer_export_stream(data_buffer_export_format_t format, uint32_t max_samples,
+                                    data_buffer_write_cb_t write, void *ctx);
 
 #endif // DATA_BUFFER_H
@@ -0,0 +1,12 @@
+// Host stand-in for ahrs_bench.c: the bench times ahrs_update() itself
+#ifndef HOST_ESP_CPU_H
+#define HOST_ESP_CPU_H
+
+#include <stdint.h>
+
+static inline uint32_t esp_cpu_get_cycle_count(void)
+{
+    return 0;
+}
+
+#endif // HOST_ESP_CPU_H
@@ -0,0 +1,12 @@
+// Host stand-in for ahrs_bench.c: only what ahrs.c uses
+#ifndef HOST_ESP_ERR_H
+#define HOST_ESP_ERR_H
+
+typedef int esp_err_t;
+
+#define ESP_OK                  0
+#define ESP_FAIL                -1
+#define ESP_ERR_INVALID_ARG     0x102
+#define ESP_ERR_NOT_FOUND       0x105
+
+#endif // HOST_ESP_ERR_H
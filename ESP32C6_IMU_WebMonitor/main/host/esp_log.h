@@ -0,0 +1,9 @@
+// Host stand-in for ahrs_bench.c: logging is dropped
+#ifndef HOST_ESP_LOG_H
+#define HOST_ESP_LOG_H
+
+#define ESP_LOGE(tag, ...) ((void)(tag))
+#define ESP_LOGW(tag, ...) ((void)(tag))
+#define ESP_LOGI(tag, ...) ((void)(tag))
+
+#endif // HOST_ESP_LOG_H
@@ -0,0 +1,12 @@
+// Host stand-in for ahrs_bench.c: the ESP32-C6 CPU clock
+#ifndef HOST_ESP_ROM_SYS_H
+#define HOST_ESP_ROM_SYS_H
+
+#include <stdint.h>
+
+static inline uint32_t esp_rom_get_cpu_ticks_per_us(void)
+{
+    return 160;
+}
+
+#endif // HOST_ESP_ROM_SYS_H
@@ -0,0 +1,11 @@
+// Host stand-in for ahrs_bench.c: single-threaded, critical sections are empty
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+typedef int portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    0
+#define portENTER_CRITICAL(mux)         ((void)(mux))
+#define portEXIT_CRITICAL(mux)          ((void)(mux))
+
+#endif // HOST_FREERTOS_H
@@ -3,15 +3,52 @@
 #include "sensors/iis3dwb.h"
 #include "sensors/icm45686.h"
 #include "sensors/scl3300.h"
+#include "spi_batch.h"
+#include "ahrs.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_cpu.h"
 #include "driver/spi_master.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include <string.h>
 
 static const char *TAG = "IMU_MANAGER";
 
+// Rate groups: one per sensor, indexed like the notify bits of the scheduler tasks
+enum {
+    RATE_GROUP_MAGNETOMETER = 0,
+    RATE_GROUP_ACCELEROMETER,
+    RATE_GROUP_IMU_6AXIS,
+    RATE_GROUP_INCLINOMETER,
+    RATE_GROUP_COUNT
+};
+
+typedef struct {
+    uint8_t sensor_id;
+    const char *name;
+    uint32_t rate_hz;
+    uint32_t max_rate_hz;
+    size_t sample_size;
+    uint32_t stream_capacity;
+    bool irq_driven;            // Released by a sensor interrupt instead of the group timer
+    TaskHandle_t *owner;
+    esp_timer_handle_t timer;
+    volatile bool pending;
+    volatile uint64_t release_us;
+    sensor_stream_t stream;
+    imu_rate_group_stats_t stats;
+} rate_group_t;
+
+typedef union {
+    imu_mag_sample_t mag;
+    imu_accel_sample_t accel;
+    imu_6axis_sample_t imu;
+    imu_incl_sample_t incl;
+} sensor_sample_t;
+
 // Sensor handles
 static iis2mdc_handle_t mag_sensor;
 static iis3dwb_handle_t accel_sensor;
@@ -23,14 +60,67 @@ static uint32_t sampling_rate_hz = 100;
 static uint16_t fifo_watermark = 32;
 static uint8_t enabled_sensors = 0x00; // Start with all sensors disabled, enable after successful init
 
-// Synchronization
-static SemaphoreHandle_t sensor_mutex = NULL;
+// Synchronization: one lock per bus so I2C and SPI reads never wait on each other
+static SemaphoreHandle_t spi_mutex = NULL;
+static SemaphoreHandle_t i2c_mutex = NULL;
+
+// Scheduler
+static TaskHandle_t spi_sched_task = NULL;
+static TaskHandle_t i2c_sched_task = NULL;
+static volatile bool scheduler_running = false;
+
+// Register reads of the IIS3DWB and SCL3300 share one queued SPI cycle
+#define SPI_BATCH_GROUPS ((1UL << RATE_GROUP_ACCELEROMETER) | (1UL << RATE_GROUP_INCLINOMETER))
+static spi_batch_t spi_cycle;   // Guarded by spi_mutex
+
+typedef struct {
+    imu_accel_sample_t accel;
+    imu_incl_sample_t incl;
+    esp_err_t accel_ret;
+    esp_err_t incl_ret;
+} spi_cycle_result_t;
+
+static rate_group_t rate_groups[RATE_GROUP_COUNT] = {
+    [RATE_GROUP_MAGNETOMETER] = {
+        .sensor_id = SENSOR_MAGNETOMETER, .name = "mag",
+        .rate_hz = 100, .max_rate_hz = 100,
+        .sample_size = sizeof(imu_mag_sample_t), .stream_capacity = 64,
+        .owner = &i2c_sched_task,
+    },
+    [RATE_GROUP_ACCELEROMETER] = {
+        .sensor_id = SENSOR_ACCELEROMETER, .name = "accel",
+        .rate_hz = 1000, .max_rate_hz = 4000,
+        .sample_size = sizeof(imu_accel_sample_t), .stream_capacity = 512,
+        .owner = &spi_sched_task,
+    },
+    [RATE_GROUP_IMU_6AXIS] = {
+        .sensor_id = SENSOR_IMU_6AXIS, .name = "imu6",
+        .rate_hz = 400, .max_rate_hz = 1600,
+        .sample_size = sizeof(imu_6axis_sample_t), .stream_capacity = 512,
+        .owner = &spi_sched_task,
+    },
+    [RATE_GROUP_INCLINOMETER] = {
+        .sensor_id = SENSOR_INCLINOMETER, .name = "incl",
+        .rate_hz = 50, .max_rate_hz = 200,
+        .sample_size = sizeof(imu_incl_sample_t), .stream_capacity = 32,
+        .owner = &spi_sched_task,
+    },
+};
+
+static void icm_fifo_isr(void *arg);
+
+// Scheduler tasks: SPI group preempts the I2C group
+#define SPI_SCHED_TASK_PRIORITY     6
+#define I2C_SCHED_TASK_PRIORITY     5
+#define SCHED_TASK_STACK_SIZE       4096
 
 // GPIO Configuration
 #define I2C_MASTER_BUS          I2C_NUM_0
 #define I2C_MASTER_SDA          23
 #define I2C_MASTER_SCL          22
 #define I2C_MASTER_CLK_SPEED    400000
+#define PIN_NUM_DRDY_IIS2MDC    GPIO_NUM_NC     // IIS2MDC DRDY, GPIO_NUM_NC gates reads on STATUS.Zyxda
+#define IIS2MDC_ODR_PERIOD_US   10000           // 100 Hz continuous mode set by iis2mdc_init()
 
 // All SPI sensors share the same bus (SPI2_HOST) with same MISO/MOSI/CLK
 #define SPI_HOST_1              SPI2_HOST
@@ -46,17 +136,110 @@ static SemaphoreHandle_t sensor_mutex = NULL;
 #define PIN_NUM_CS_IIS3DWB      19      // IIS3DWB Accelerometer
 #define PIN_NUM_CS_ICM45686     20      // ICM45686 IMU 6-axis
 #define PIN_NUM_CS_SCL3300      11      // SCL3300 Inclinometer
-// #define PIN_NUM_INT_ICM45686    4       // ICM45686 Interrupt pin (optional, use GPIO_NUM_NC to disable)
+#define PIN_NUM_INT_ICM45686    4       // ICM45686 INT1 (FIFO watermark), GPIO_NUM_NC polls the FIFO from the group timer
+
+// ICM45686 FIFO streaming
+#define ICM45686_FIFO_WATERMARK     16      // Frames per watermark interrupt
+#define ICM45686_FIFO_COMPRESSION   true    // 16-bit mode only, hires packets cannot be compressed
+#define ICM45686_FIFO_BATCH_SIZE    64      // Samples decoded per publish
+
+// ICM45686 counts to fixed point: value = (count * 15625) >> shift
+//   16-bit  ±16 g:    2048 LSB/g   -> µg   (shift 5)   ±2000 dps: 16.384 LSB/dps  -> mdps (shift 8)
+//   20-bit  ±32 g:   16384 LSB/g   -> µg   (shift 8)   ±4000 dps: 131.072 LSB/dps -> mdps (shift 11)
+#define ICM_FIXED_MUL               15625
+#define ICM_ACCEL_SHIFT_16BIT       5
+#define ICM_GYRO_SHIFT_16BIT        8
+#define ICM_ACCEL_SHIFT_HIRES       8
+#define ICM_GYRO_SHIFT_HIRES        11
 
 #define SPI_CLOCK_HZ            6000000
 
+// ICM45686 FIFO state: batch of decoded samples and device-to-host clock offset
+static bool icm_fifo_mode = false;
+static bool icm_fifo_hires = false;
+static icm456xx_fifo_sample_t icm_fifo_batch[ICM45686_FIFO_BATCH_SIZE];
+static uint32_t icm_fifo_batch_count = 0;
+static int64_t icm_clock_offset_us = 0;
+static bool icm_clock_synced = false;
+
+// eDMP GAF offload (ICM45686S builds): the FIFO carries game rotation vectors,
+// accel/gyro are read from the registers at the GAF rate
+#if defined(ICM45686S) || defined(ICM45605S)
+#define ICM_GAF_SUPPORTED 1
+#else
+#define ICM_GAF_SUPPORTED 0
+#endif
+static bool icm_gaf_mode = false;
+#if ICM_GAF_SUPPORTED
+static uint32_t icm_gaf_saved_rate_hz = 0;
+#endif
+
+// IIS2MDC sample time: the conversion finished between the previous poll and
+// this one, so the middle of that window replaces the read time (guarded by i2c_mutex)
+static uint64_t mag_last_poll_us = 0;
+
+static rate_group_t *rate_group_from_sensor(uint8_t sensor_id)
+{
+    for (int i = 0; i < RATE_GROUP_COUNT; i++) {
+        if (rate_groups[i].sensor_id == sensor_id) {
+            return &rate_groups[i];
+        }
+    }
+    return NULL;
+}
+
+static uint32_t rate_group_period_us(const rate_group_t *group)
+{
+    // In FIFO mode the IMU group is released once per watermark, not per sample
+    if (group->sensor_id == SENSOR_IMU_6AXIS && icm_fifo_mode) {
+        return (uint32_t)(1000000ULL * ICM45686_FIFO_WATERMARK / group->rate_hz);
+    }
+    return 1000000UL / group->rate_hz;
+}
+
+// Smallest ICM45686 ODR that is not slower than the requested read rate
+static uint16_t icm_odr_for_rate(uint32_t rate_hz)
+{
+    static const uint16_t odrs[] = {25, 50, 100, 200, 400, 800, 1600, 3200, 6400};
+    for (size_t i = 0; i < sizeof(odrs) / sizeof(odrs[0]); i++) {
+        if (odrs[i] >= rate_hz) {
+            return odrs[i];
+        }
+    }
+    return 6400;
+}
+
+// Rate of the ICM45686 samples: the ODR in FIFO mode, the read rate otherwise
+static uint32_t icm_sample_rate_hz(void)
+{
+    uint32_t rate_hz = rate_groups[RATE_GROUP_IMU_6AXIS].rate_hz;
+    return icm_fifo_mode ? icm_odr_for_rate(rate_hz) : rate_hz;
+}
+
+// Magnetometer correction for the AHRS. The IIS2MDC axes are taken as aligned
+// with the ICM45686 body frame; the raw counts are fine, only the direction is used.
+static void ahrs_feed_mag(uint64_t timestamp_us, const iis2mdc_raw_sample_t *raw)
+{
+    const int32_t mag[3] = { raw->mag.x, raw->mag.y, raw->mag.z };
+    ahrs_set_mag(timestamp_us, mag);
+}
+
+static icm456xx_fifo_format_t icm_fifo_format(void)
+{
+    if (icm_fifo_hires) {
+        return ICM456XX_FIFO_FORMAT_HIRES;
+    }
+    return ICM45686_FIFO_COMPRESSION ? ICM456XX_FIFO_FORMAT_COMPRESSED : ICM456XX_FIFO_FORMAT_16BIT;
+}
+
 esp_err_t imu_manager_init(void)
 {
     ESP_LOGI(TAG, "Initializing IMU Manager...");
     
-    // Create mutex for thread safety
-    sensor_mutex = xSemaphoreCreateMutex();
-    if (sensor_mutex == NULL) {
+    // Create one mutex per bus for thread safety
+    spi_mutex = xSemaphoreCreateMutex();
+    i2c_mutex = xSemaphoreCreateMutex();
+    if (spi_mutex == NULL || i2c_mutex == NULL) {
         ESP_LOGE(TAG, "Failed to create sensor mutex");
         return ESP_FAIL;
     }
@@ -87,6 +270,10 @@ esp_err_t imu_manager_init(void)
     if (ret != ESP_OK) {
         ESP_LOGW(TAG, "IIS2MDC not detected: %s", esp_err_to_name(ret));
     } else {
+        if (PIN_NUM_DRDY_IIS2MDC != GPIO_NUM_NC &&
+            iis2mdc_enable_drdy_pin(&mag_sensor, PIN_NUM_DRDY_IIS2MDC) != ESP_OK) {
+            ESP_LOGW(TAG, "IIS2MDC DRDY pin unavailable, gating on STATUS");
+        }
         ESP_LOGI(TAG, "IIS2MDC initialized successfully");
         enabled_sensors |= SENSOR_MAGNETOMETER;
     }
@@ -124,15 +311,30 @@ esp_err_t imu_manager_init(void)
         if (ret != 0) {
             ESP_LOGW(TAG, "ICM45686 begin failed: %d", ret);
         } else {
-            icm456xx_start_accel(&imu_6axis_sensor, sampling_rate_hz, 16);
-            icm456xx_start_gyro(&imu_6axis_sensor, sampling_rate_hz, 2000);
-            // Disable FIFO interrupt for now (pass GPIO_NUM_NC = -1 is causing error)
-            // ret = icm456xx_enable_fifo_interrupt(&imu_6axis_sensor, PIN_NUM_INT_ICM45686, NULL, fifo_watermark);
-            // if (ret != 0) {
-            //     ESP_LOGW(TAG, "ICM45686 FIFO interrupt setup returned %d", ret);
-            // }
-            ESP_LOGI(TAG, "ICM45686 initialized successfully");
+            uint16_t icm_odr = icm_odr_for_rate(rate_groups[RATE_GROUP_IMU_6AXIS].rate_hz);
+            icm456xx_start_accel(&imu_6axis_sensor, icm_odr, 16);
+            icm456xx_start_gyro(&imu_6axis_sensor, icm_odr, 2000);
+            ret = icm456xx_start_fifo_stream(&imu_6axis_sensor, PIN_NUM_INT_ICM45686, icm_fifo_isr, NULL,
+                                             icm_odr, ICM45686_FIFO_WATERMARK, icm_fifo_format());
+            if (ret != 0) {
+                ESP_LOGW(TAG, "ICM45686 FIFO streaming unavailable (%d), using register reads", ret);
+            } else {
+                icm_fifo_mode = true;
+                rate_groups[RATE_GROUP_IMU_6AXIS].irq_driven = (PIN_NUM_INT_ICM45686 != GPIO_NUM_NC);
+            }
+            ESP_LOGI(TAG, "ICM45686 initialized successfully (%s)",
+                     icm_fifo_mode ? (icm_fifo_hires ? "FIFO, 20-bit" : "FIFO") : "registers");
             enabled_sensors |= SENSOR_IMU_6AXIS;
+            
+            // Orientation is fused at the ICM45686 sample rate
+            ahrs_config_t ahrs_cfg = {
+                .sample_rate_hz = icm_sample_rate_hz(),
+                .kp = AHRS_DEFAULT_KP,
+                .ki = AHRS_DEFAULT_KI,
+            };
+            if (ahrs_init(&ahrs_cfg) != ESP_OK) {
+                ESP_LOGW(TAG, "AHRS init failed");
+            }
         }
     }
     
@@ -150,44 +352,249 @@ esp_err_t imu_manager_init(void)
         }
     }
     
+    // One timestamped stream per detected sensor
+    for (int i = 0; i < RATE_GROUP_COUNT; i++) {
+        rate_group_t *group = &rate_groups[i];
+        if (!(enabled_sensors & group->sensor_id)) {
+            continue;
+        }
+        ret = sensor_stream_init(&group->stream, group->sample_size, group->stream_capacity);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "No stream for %s: %s", group->name, esp_err_to_name(ret));
+            enabled_sensors &= ~group->sensor_id;
+        }
+    }
+    
     ESP_LOGI(TAG, "IMU Manager initialized. Enabled sensors: 0x%02X", enabled_sensors);
     return ESP_OK;
 }
 
+// Cost of scaling one sample of a rate group, counted from cycle `start`
+static void rate_group_convert(int index, uint32_t start)
+{
+    imu_rate_group_stats_t *stats = &rate_groups[index].stats;
+    uint32_t cycles = esp_cpu_get_cycle_count() - start;
+    
+    stats->last_convert_cycles = cycles;
+    if (cycles > stats->max_convert_cycles) {
+        stats->max_convert_cycles = cycles;
+    }
+    stats->total_convert_cycles += cycles;
+    stats->converts++;
+}
+
 esp_err_t imu_manager_read_all(imu_data_t *data)
 {
     if (data == NULL) {
         return ESP_ERR_INVALID_ARG;
     }
     
-    if (xSemaphoreTake(sensor_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+    // Set timestamp
+    data->timestamp_us = esp_timer_get_time();
+    
+    // Each reader takes its own bus lock; the scheduler tasks are the
+    // concurrent path, with the I2C magnetometer on its own task
+    imu_manager_read_magnetometer(data);
+    imu_manager_read_accelerometer(data);
+    imu_manager_read_imu_6axis(data);
+    imu_manager_read_inclinometer(data);
+    
+    return ESP_OK;
+}
+
+static void icm_scale_sample(const int32_t accel[3], const int32_t gyro[3], bool hires, imu_6axis_sample_t *sample);
+
+static void ahrs_update_from_sample(const imu_6axis_sample_t *sample)
+{
+    const int32_t accel[3] = { sample->accel_x_ug, sample->accel_y_ug, sample->accel_z_ug };
+    const int32_t gyro[3] = { sample->gyro_x_mdps, sample->gyro_y_mdps, sample->gyro_z_mdps };
+    ahrs_update(sample->timestamp_us, accel, gyro);
+}
+
+// One burst per sample; ESP_ERR_NOT_FOUND when the sensor has nothing new
+static esp_err_t read_mag_sample(imu_mag_sample_t *sample)
+{
+    iis2mdc_raw_sample_t raw;
+    
+    if (xSemaphoreTake(i2c_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
         return ESP_ERR_TIMEOUT;
     }
     
-    // Set timestamp
-    data->timestamp_us = esp_timer_get_time();
+    uint64_t poll_us = esp_timer_get_time();
+    esp_err_t ret = iis2mdc_read_sample_raw(&mag_sensor, &raw);
     
-    // Read all enabled sensors
-    if (enabled_sensors & SENSOR_MAGNETOMETER) {
-        imu_manager_read_magnetometer(data);
+    uint64_t window_us = IIS2MDC_ODR_PERIOD_US;
+    if (mag_last_poll_us != 0 && poll_us - mag_last_poll_us < window_us) {
+        window_us = poll_us - mag_last_poll_us;
     }
+    mag_last_poll_us = poll_us;
+    sample->timestamp_us = poll_us - window_us / 2;
     
-    if (enabled_sensors & SENSOR_ACCELEROMETER) {
-        imu_manager_read_accelerometer(data);
+    xSemaphoreGive(i2c_mutex);
+    
+    if (ret == ESP_OK) {
+        ahrs_feed_mag(sample->timestamp_us, &raw);
+        uint32_t start = esp_cpu_get_cycle_count();
+        iis2mdc_convert_magnetic_raw_to_mg(&raw.mag, &sample->x_mg, &sample->y_mg, &sample->z_mg);
+        iis2mdc_convert_temperature_raw_to_celsius(raw.temperature, &sample->temperature_c);
+        rate_group_convert(RATE_GROUP_MAGNETOMETER, start);
     }
+    return ret;
+}
+
+// SCL3300 fixed-point getters into the float sample: one single-precision
+// multiply per value, no double arithmetic
+static void incl_convert(imu_incl_sample_t *sample)
+{
+    sample->angle_x_deg = scl3300_get_angle_x_mdeg(&inclinometer_sensor) * 1e-3f;
+    sample->angle_y_deg = scl3300_get_angle_y_mdeg(&inclinometer_sensor) * 1e-3f;
+    sample->angle_z_deg = scl3300_get_angle_z_mdeg(&inclinometer_sensor) * 1e-3f;
+    
+    sample->accel_x_g = scl3300_get_accel_x_ug(&inclinometer_sensor) * 1e-6f;
+    sample->accel_y_g = scl3300_get_accel_y_ug(&inclinometer_sensor) * 1e-6f;
+    sample->accel_z_g = scl3300_get_accel_z_ug(&inclinometer_sensor) * 1e-6f;
+    
+    sample->temperature_c = scl3300_get_temp_mc(&inclinometer_sensor) * 1e-3f;
+}
+
+// Reads the requested SPI_BATCH_GROUPS in one batched bus cycle
+static void read_spi_cycle(uint32_t groups, spi_cycle_result_t *res)
+{
+    spi_transaction_t *accel_t = NULL;
+    spi_transaction_t *incl_t = NULL;
+    
+    res->accel_ret = ESP_ERR_NOT_SUPPORTED;
+    res->incl_ret = ESP_ERR_NOT_SUPPORTED;
     
-    if (enabled_sensors & SENSOR_IMU_6AXIS) {
-        imu_manager_read_imu_6axis(data);
+    if (xSemaphoreTake(spi_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        res->accel_ret = ESP_ERR_TIMEOUT;
+        res->incl_ret = ESP_ERR_TIMEOUT;
+        return;
     }
     
-    if (enabled_sensors & SENSOR_INCLINOMETER) {
-        imu_manager_read_inclinometer(data);
+    spi_batch_begin(&spi_cycle);
+    if (groups & (1UL << RATE_GROUP_ACCELEROMETER)) {
+        accel_t = spi_batch_add(&spi_cycle, accel_sensor.spi, 1);
+        if (accel_t != NULL) {
+            iis3dwb_prepare_accel_read(&accel_sensor, accel_t);
+        }
+    }
+    if (groups & (1UL << RATE_GROUP_INCLINOMETER)) {
+        incl_t = spi_batch_add(&spi_cycle, inclinometer_sensor.spi, SCL3300_AVAILABLE_FRAMES);
+        if (incl_t != NULL) {
+            scl3300_prepare_available(incl_t);
+        }
     }
     
-    xSemaphoreGive(sensor_mutex);
+    uint64_t timestamp_us = esp_timer_get_time();
+    esp_err_t ret = spi_batch_run(&spi_cycle);
+    
+    if (accel_t != NULL) {
+        res->accel_ret = ret;
+        if (ret == ESP_OK) {
+            res->accel.timestamp_us = timestamp_us;
+            uint32_t start = esp_cpu_get_cycle_count();
+            iis3dwb_parse_accel(&accel_sensor, &res->accel.x_g, &res->accel.y_g, &res->accel.z_g);
+            rate_group_convert(RATE_GROUP_ACCELEROMETER, start);
+        }
+    }
+    if (incl_t != NULL) {
+        res->incl_ret = (ret == ESP_OK) ? scl3300_parse_available(&inclinometer_sensor, incl_t) : ret;
+        if (res->incl_ret == ESP_OK) {
+            res->incl.timestamp_us = timestamp_us;
+            uint32_t start = esp_cpu_get_cycle_count();
+            incl_convert(&res->incl);
+            rate_group_convert(RATE_GROUP_INCLINOMETER, start);
+        }
+    }
+    
+    xSemaphoreGive(spi_mutex);
+}
+
+static esp_err_t read_accel_sample(imu_accel_sample_t *sample)
+{
+    spi_cycle_result_t res;
+    
+    read_spi_cycle(1UL << RATE_GROUP_ACCELEROMETER, &res);
+    *sample = res.accel;
+    return res.accel_ret;
+}
+
+#if ICM_GAF_SUPPORTED
+typedef struct {
+    int32_t quat_q30[4];
+    uint32_t outputs;
+} icm_gaf_ctx_t;
+
+static void icm_gaf_collect_cb(const inv_imu_edmp_gaf_outputs_t *out, void *ctx)
+{
+    icm_gaf_ctx_t *gaf = (icm_gaf_ctx_t *)ctx;
+    
+    memcpy(gaf->quat_q30, out->grv_quat_q30, sizeof(gaf->quat_q30));
+    gaf->outputs++;
+}
+#endif
+
+// Drains the eDMP outputs and forwards the newest quaternion, with what it cost
+// the host per output (decode, including the FIFO burst). Called with spi_mutex held.
+static void icm_gaf_forward(uint64_t timestamp_us)
+{
+#if ICM_GAF_SUPPORTED
+    icm_gaf_ctx_t gaf = { .outputs = 0 };
+    uint32_t start = esp_cpu_get_cycle_count();
+    int rc = icm456xx_read_gaf_stream(&imu_6axis_sensor, icm_gaf_collect_cb, &gaf);
+    uint32_t cycles = esp_cpu_get_cycle_count() - start;
+    
+    if (rc >= 0 && gaf.outputs > 0) {
+        ahrs_publish_external(timestamp_us, gaf.quat_q30, cycles / gaf.outputs);
+    }
+#else
+    (void)timestamp_us;
+#endif
+}
+
+static esp_err_t read_6axis_sample(imu_6axis_sample_t *sample)
+{
+    inv_imu_sensor_data_t sensor_data;
+    
+    if (xSemaphoreTake(spi_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    
+    sample->timestamp_us = esp_timer_get_time();
+    int ret = icm456xx_get_data_from_registers(&imu_6axis_sensor, &sensor_data);
+    if (icm_gaf_mode) {
+        icm_gaf_forward(sample->timestamp_us);
+    }
+    
+    xSemaphoreGive(spi_mutex);
+    
+    if (ret != 0) {
+        return ESP_FAIL;
+    }
+    
+    // Registers always hold 16-bit data
+    uint32_t start = esp_cpu_get_cycle_count();
+    const int32_t accel[3] = { sensor_data.accel_data[0], sensor_data.accel_data[1], sensor_data.accel_data[2] };
+    const int32_t gyro[3] = { sensor_data.gyro_data[0], sensor_data.gyro_data[1], sensor_data.gyro_data[2] };
+    icm_scale_sample(accel, gyro, false, sample);
+    
+    // 16-bit temperature register: 128 LSB/°C, 0 at 25 °C
+    sample->temperature_mc = (int32_t)sensor_data.temp_data * 125 / 16 + 25000;
+    rate_group_convert(RATE_GROUP_IMU_6AXIS, start);
+    ahrs_update_from_sample(sample);
     return ESP_OK;
 }
 
+static esp_err_t read_incl_sample(imu_incl_sample_t *sample)
+{
+    spi_cycle_result_t res;
+    
+    read_spi_cycle(1UL << RATE_GROUP_INCLINOMETER, &res);
+    *sample = res.incl;
+    return res.incl_ret;
+}
+
 esp_err_t imu_manager_read_magnetometer(imu_data_t *data)
 {
     if (!(enabled_sensors & SENSOR_MAGNETOMETER)) {
@@ -195,21 +602,13 @@ esp_err_t imu_manager_read_magnetometer(imu_data_t *data)
         return ESP_ERR_NOT_SUPPORTED;
     }
     
-    iis2mdc_raw_magnetometer_t raw_mag;
-    int16_t temp_raw;
-    
-    esp_err_t ret = iis2mdc_read_magnetic_raw(&mag_sensor, &raw_mag);
+    imu_mag_sample_t sample;
+    esp_err_t ret = read_mag_sample(&sample);
     if (ret == ESP_OK) {
-        iis2mdc_convert_magnetic_raw_to_mg(&raw_mag, 
-                                         &data->magnetometer.x_mg,
-                                         &data->magnetometer.y_mg,
-                                         &data->magnetometer.z_mg);
-        
-        ret = iis2mdc_read_temperature_raw(&mag_sensor, &temp_raw);
-        if (ret == ESP_OK) {
-            iis2mdc_convert_temperature_raw_to_celsius(temp_raw, &data->magnetometer.temperature_c);
-        }
-        
+        data->magnetometer.x_mg = sample.x_mg;
+        data->magnetometer.y_mg = sample.y_mg;
+        data->magnetometer.z_mg = sample.z_mg;
+        data->magnetometer.temperature_c = sample.temperature_c;
         data->magnetometer.valid = true;
     } else {
         data->magnetometer.valid = false;
@@ -225,15 +624,12 @@ esp_err_t imu_manager_read_accelerometer(imu_data_t *data)
         return ESP_ERR_NOT_SUPPORTED;
     }
     
-    float ax = 0.0f;
-    float ay = 0.0f;
-    float az = 0.0f;
-    
-    esp_err_t ret = iis3dwb_read_accel(&accel_sensor, &ax, &ay, &az);
+    imu_accel_sample_t sample;
+    esp_err_t ret = read_accel_sample(&sample);
     if (ret == ESP_OK) {
-        data->accelerometer.x_g = ax;
-        data->accelerometer.y_g = ay;
-        data->accelerometer.z_g = az;
+        data->accelerometer.x_g = sample.x_g;
+        data->accelerometer.y_g = sample.y_g;
+        data->accelerometer.z_g = sample.z_g;
         data->accelerometer.valid = true;
     } else {
         data->accelerometer.valid = false;
@@ -249,32 +645,23 @@ esp_err_t imu_manager_read_imu_6axis(imu_data_t *data)
         return ESP_ERR_NOT_SUPPORTED;
     }
     
-    inv_imu_sensor_data_t sensor_data;
-    int ret = icm456xx_get_data_from_registers(&imu_6axis_sensor, &sensor_data);
-    
-    if (ret == 0) {
-        // Convert raw data to engineering units
-        // Assuming 16-bit data and ±16g range for accel, ±2000dps for gyro
-        const float accel_scale = 16.0f / 32768.0f;  // ±16g
-        const float gyro_scale = 2000.0f / 32768.0f; // ±2000dps
-        
-        data->imu_6axis.accel_x_g = sensor_data.accel_data[0] * accel_scale;
-        data->imu_6axis.accel_y_g = sensor_data.accel_data[1] * accel_scale;
-        data->imu_6axis.accel_z_g = sensor_data.accel_data[2] * accel_scale;
-        
-        data->imu_6axis.gyro_x_dps = sensor_data.gyro_data[0] * gyro_scale;
-        data->imu_6axis.gyro_y_dps = sensor_data.gyro_data[1] * gyro_scale;
-        data->imu_6axis.gyro_z_dps = sensor_data.gyro_data[2] * gyro_scale;
-        
-        // Temperature conversion (assuming 8-bit temp)
-        data->imu_6axis.temperature_c = sensor_data.temp_data + 25.0f;
-        
+    imu_6axis_sample_t sample;
+    esp_err_t ret = read_6axis_sample(&sample);
+    if (ret == ESP_OK) {
+        data->imu_6axis.accel_x_ug = sample.accel_x_ug;
+        data->imu_6axis.accel_y_ug = sample.accel_y_ug;
+        data->imu_6axis.accel_z_ug = sample.accel_z_ug;
+        data->imu_6axis.gyro_x_mdps = sample.gyro_x_mdps;
+        data->imu_6axis.gyro_y_mdps = sample.gyro_y_mdps;
+        data->imu_6axis.gyro_z_mdps = sample.gyro_z_mdps;
+        data->imu_6axis.temperature_mc = sample.temperature_mc;
+        data->imu_6axis.hires = sample.hires;
         data->imu_6axis.valid = true;
-        return ESP_OK;
     } else {
         data->imu_6axis.valid = false;
-        return ESP_FAIL;
     }
+    
+    return ret;
 }
 
 esp_err_t imu_manager_read_inclinometer(imu_data_t *data)
@@ -284,17 +671,16 @@ esp_err_t imu_manager_read_inclinometer(imu_data_t *data)
         return ESP_ERR_NOT_SUPPORTED;
     }
     
-    esp_err_t ret = scl3300_available(&inclinometer_sensor);
+    imu_incl_sample_t sample;
+    esp_err_t ret = read_incl_sample(&sample);
     if (ret == ESP_OK) {
-        data->inclinometer.angle_x_deg = scl3300_get_angle_x(&inclinometer_sensor);
-        data->inclinometer.angle_y_deg = scl3300_get_angle_y(&inclinometer_sensor);
-        data->inclinometer.angle_z_deg = scl3300_get_angle_z(&inclinometer_sensor);
-        
-        data->inclinometer.accel_x_g = scl3300_get_accel_x(&inclinometer_sensor);
-        data->inclinometer.accel_y_g = scl3300_get_accel_y(&inclinometer_sensor);
-        data->inclinometer.accel_z_g = scl3300_get_accel_z(&inclinometer_sensor);
-        
-        data->inclinometer.temperature_c = scl3300_get_temp_c(&inclinometer_sensor);
+        data->inclinometer.angle_x_deg = sample.angle_x_deg;
+        data->inclinometer.angle_y_deg = sample.angle_y_deg;
+        data->inclinometer.angle_z_deg = sample.angle_z_deg;
+        data->inclinometer.accel_x_g = sample.accel_x_g;
+        data->inclinometer.accel_y_g = sample.accel_y_g;
+        data->inclinometer.accel_z_g = sample.accel_z_g;
+        data->inclinometer.temperature_c = sample.temperature_c;
         data->inclinometer.valid = true;
     } else {
         data->inclinometer.valid = false;
@@ -303,6 +689,703 @@ esp_err_t imu_manager_read_inclinometer(imu_data_t *data)
     return ret;
 }
 
+static inline int32_t icm_count_to_fixed(int32_t count, int shift)
+{
+    // Rounded; 20-bit counts overflow 32 bits before the shift
+    return (int32_t)(((int64_t)count * ICM_FIXED_MUL + (1 << (shift - 1))) >> shift);
+}
+
+static void icm_scale_sample(const int32_t accel[3], const int32_t gyro[3], bool hires, imu_6axis_sample_t *sample)
+{
+    const int accel_shift = hires ? ICM_ACCEL_SHIFT_HIRES : ICM_ACCEL_SHIFT_16BIT;
+    const int gyro_shift = hires ? ICM_GYRO_SHIFT_HIRES : ICM_GYRO_SHIFT_16BIT;
+    
+    sample->accel_x_ug = icm_count_to_fixed(accel[0], accel_shift);
+    sample->accel_y_ug = icm_count_to_fixed(accel[1], accel_shift);
+    sample->accel_z_ug = icm_count_to_fixed(accel[2], accel_shift);
+    sample->gyro_x_mdps = icm_count_to_fixed(gyro[0], gyro_shift);
+    sample->gyro_y_mdps = icm_count_to_fixed(gyro[1], gyro_shift);
+    sample->gyro_z_mdps = icm_count_to_fixed(gyro[2], gyro_shift);
+    sample->hires = hires;
+}
+
+// Maps the batch from device time to esp_timer time and pushes it to the stream.
+// The newest sample was in the FIFO when the read started, so read_us minus its
+// device time bounds the clock offset from above; keep the smallest bound and
+// let it creep up slowly to follow oscillator drift.
+static void icm_fifo_publish(sensor_stream_t *stream, int64_t read_us)
+{
+    if (icm_fifo_batch_count == 0) {
+        return;
+    }
+    
+    int64_t offset = read_us - (int64_t)icm_fifo_batch[icm_fifo_batch_count - 1].timestamp_us;
+    if (!icm_clock_synced || offset < icm_clock_offset_us) {
+        icm_clock_offset_us = offset;
+        icm_clock_synced = true;
+    } else {
+        icm_clock_offset_us += (offset - icm_clock_offset_us) / 64;
+    }
+    
+    for (uint32_t i = 0; i < icm_fifo_batch_count; i++) {
+        const icm456xx_fifo_sample_t *raw = &icm_fifo_batch[i];
+        imu_6axis_sample_t sample;
+        
+        sample.timestamp_us = (uint64_t)((int64_t)raw->timestamp_us + icm_clock_offset_us);
+        icm_scale_sample(raw->accel, raw->gyro, raw->hires, &sample);
+        if (raw->hires) {
+            sample.temperature_mc = (int32_t)raw->temperature * 125 / 16 + 25000;   // 16-bit, 128 LSB/°C
+        } else {
+            sample.temperature_mc = (int32_t)raw->temperature * 500 + 25000;        // 8-bit, 2 LSB/°C
+        }
+        ahrs_update_from_sample(&sample);
+        sensor_stream_push(stream, &sample);
+    }
+    icm_fifo_batch_count = 0;
+}
+
+typedef struct {
+    sensor_stream_t *stream;
+    int64_t read_us;
+} icm_fifo_ctx_t;
+
+static void icm_fifo_collect_cb(const icm456xx_fifo_sample_t *sample, void *ctx)
+{
+    icm_fifo_ctx_t *fifo_ctx = (icm_fifo_ctx_t *)ctx;
+    
+    if (icm_fifo_batch_count == ICM45686_FIFO_BATCH_SIZE) {
+        icm_fifo_publish(fifo_ctx->stream, fifo_ctx->read_us);
+    }
+    icm_fifo_batch[icm_fifo_batch_count++] = *sample;
+}
+
+// Drains the ICM45686 FIFO in one burst and pushes every sample
+static esp_err_t read_6axis_fifo(sensor_stream_t *stream)
+{
+    icm_fifo_ctx_t ctx = { .stream = stream };
+    
+    if (xSemaphoreTake(spi_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    
+    ctx.read_us = esp_timer_get_time();
+    icm_fifo_batch_count = 0;
+    int frames = icm456xx_read_fifo_stream(&imu_6axis_sensor, icm_fifo_collect_cb, &ctx);
+    
+    xSemaphoreGive(spi_mutex);
+    
+    if (frames < 0) {
+        icm_fifo_batch_count = 0;
+        return ESP_FAIL;
+    }
+    
+    icm_fifo_publish(stream, ctx.read_us);
+    return ESP_OK;
+}
+
+static esp_err_t rate_group_read(int index, sensor_sample_t *sample)
+{
+    switch (index) {
+    case RATE_GROUP_MAGNETOMETER:  return read_mag_sample(&sample->mag);
+    case RATE_GROUP_ACCELEROMETER: return read_accel_sample(&sample->accel);
+    case RATE_GROUP_IMU_6AXIS:     return read_6axis_sample(&sample->imu);
+    case RATE_GROUP_INCLINOMETER:  return read_incl_sample(&sample->incl);
+    default:                       return ESP_ERR_INVALID_ARG;
+    }
+}
+
+// Marks one period of a rate group as released; false if the previous one is still pending
+static inline bool rate_group_release(rate_group_t *group)
+{
+    if (!scheduler_running || *group->owner == NULL) {
+        return false;
+    }
+    
+    group->stats.released++;
+    if (group->pending) {
+        // Previous period not served yet: keep its release time, count the overrun
+        group->stats.overruns++;
+        return false;
+    }
+    
+    group->release_us = esp_timer_get_time();
+    group->pending = true;
+    return true;
+}
+
+// esp_timer callback: releases one period of a rate group
+static void rate_group_timer_cb(void *arg)
+{
+    int index = (int)(intptr_t)arg;
+    rate_group_t *group = &rate_groups[index];
+    
+    if (rate_group_release(group)) {
+        xTaskNotify(*group->owner, 1UL << index, eSetBits);
+    }
+}
+
+// ICM45686 FIFO watermark interrupt: releases the IMU group
+static void IRAM_ATTR icm_fifo_isr(void *arg)
+{
+    rate_group_t *group = &rate_groups[RATE_GROUP_IMU_6AXIS];
+    BaseType_t woken = pdFALSE;
+    
+    if (rate_group_release(group)) {
+        xTaskNotifyFromISR(*group->owner, 1UL << RATE_GROUP_IMU_6AXIS, eSetBits, &woken);
+    }
+    portYIELD_FROM_ISR(woken);
+}
+
+static void rate_group_complete(int index, esp_err_t ret, int64_t start, int64_t end)
+{
+    rate_group_t *group = &rate_groups[index];
+    
+    if (ret == ESP_OK) {
+        group->stats.completed++;
+    } else if (ret == ESP_ERR_NOT_FOUND) {
+        group->stats.stale_reads++;
+    } else if (ret != ESP_ERR_NOT_SUPPORTED) {
+        group->stats.read_errors++;
+    }
+    
+    uint32_t exec_us = (uint32_t)(end - start);
+    uint32_t latency_us = (uint32_t)(end - (int64_t)group->release_us);
+    group->stats.last_exec_us = exec_us;
+    if (exec_us > group->stats.max_exec_us) {
+        group->stats.max_exec_us = exec_us;
+    }
+    if (latency_us > group->stats.max_latency_us) {
+        group->stats.max_latency_us = latency_us;
+    }
+    if (latency_us > rate_group_period_us(group)) {
+        group->stats.deadline_misses++;
+    }
+    
+    group->pending = false;
+}
+
+static void rate_group_service(int index)
+{
+    rate_group_t *group = &rate_groups[index];
+    sensor_sample_t sample;
+    esp_err_t ret = ESP_ERR_NOT_SUPPORTED;
+    
+    int64_t start = esp_timer_get_time();
+    if ((enabled_sensors & group->sensor_id) && index == RATE_GROUP_IMU_6AXIS && icm_fifo_mode) {
+        ret = read_6axis_fifo(&group->stream);
+    } else if (enabled_sensors & group->sensor_id) {
+        ret = rate_group_read(index, &sample);
+        if (ret == ESP_OK) {
+            sensor_stream_push(&group->stream, &sample);
+        }
+    }
+    int64_t end = esp_timer_get_time();
+    
+    rate_group_complete(index, ret, start, end);
+}
+
+// Serves every pending SPI_BATCH_GROUPS member with a single bus cycle
+static void rate_group_service_batch(uint32_t groups)
+{
+    spi_cycle_result_t res;
+    uint32_t enabled = 0;
+    
+    if (enabled_sensors & SENSOR_ACCELEROMETER) {
+        enabled |= groups & (1UL << RATE_GROUP_ACCELEROMETER);
+    }
+    if (enabled_sensors & SENSOR_INCLINOMETER) {
+        enabled |= groups & (1UL << RATE_GROUP_INCLINOMETER);
+    }
+    
+    int64_t start = esp_timer_get_time();
+    if (enabled) {
+        read_spi_cycle(enabled, &res);
+    } else {
+        res.accel_ret = ESP_ERR_NOT_SUPPORTED;
+        res.incl_ret = ESP_ERR_NOT_SUPPORTED;
+    }
+    if (res.accel_ret == ESP_OK) {
+        sensor_stream_push(&rate_groups[RATE_GROUP_ACCELEROMETER].stream, &res.accel);
+    }
+    if (res.incl_ret == ESP_OK) {
+        sensor_stream_push(&rate_groups[RATE_GROUP_INCLINOMETER].stream, &res.incl);
+    }
+    int64_t end = esp_timer_get_time();
+    
+    if (groups & (1UL << RATE_GROUP_ACCELEROMETER)) {
+        rate_group_complete(RATE_GROUP_ACCELEROMETER, res.accel_ret, start, end);
+    }
+    if (groups & (1UL << RATE_GROUP_INCLINOMETER)) {
+        rate_group_complete(RATE_GROUP_INCLINOMETER, res.incl_ret, start, end);
+    }
+}
+
+// Serves the rate groups notified to this task, earliest deadline first
+static void rate_group_task(void *pvParameters)
+{
+    TaskHandle_t *handle = (TaskHandle_t *)pvParameters;
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    
+    while (scheduler_running) {
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &bits, pdMS_TO_TICKS(100));
+        
+        while (scheduler_running) {
+            int next = -1;
+            uint64_t next_deadline = UINT64_MAX;
+            
+            for (int i = 0; i < RATE_GROUP_COUNT; i++) {
+                rate_group_t *group = &rate_groups[i];
+                if (*group->owner != self || !group->pending) {
+                    continue;
+                }
+                uint64_t deadline = group->release_us + rate_group_period_us(group);
+                if (deadline < next_deadline) {
+                    next_deadline = deadline;
+                    next = i;
+                }
+            }
+            
+            if (next < 0) {
+                break;
+            }
+            
+            // Batchable register reads released together share one bus cycle
+            if (SPI_BATCH_GROUPS & (1UL << next)) {
+                uint32_t groups = 0;
+                for (int i = 0; i < RATE_GROUP_COUNT; i++) {
+                    if ((SPI_BATCH_GROUPS & (1UL << i)) && *rate_groups[i].owner == self &&
+                        rate_groups[i].pending) {
+                        groups |= 1UL << i;
+                    }
+                }
+                rate_group_service_batch(groups);
+                continue;
+            }
+            rate_group_service(next);
+        }
+    }
+    
+    // Clearing the handle tells imu_manager_stop_scheduler() this task is done
+    *handle = NULL;
+    vTaskDelete(NULL);
+}
+
+static esp_err_t rate_group_start_timer(int index)
+{
+    rate_group_t *group = &rate_groups[index];
+    
+    if (group->timer == NULL) {
+        const esp_timer_create_args_t args = {
+            .callback = rate_group_timer_cb,
+            .arg = (void *)(intptr_t)index,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = group->name,
+            .skip_unhandled_events = true,
+        };
+        esp_err_t ret = esp_timer_create(&args, &group->timer);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    
+    return esp_timer_start_periodic(group->timer, rate_group_period_us(group));
+}
+
+esp_err_t imu_manager_start_scheduler(void)
+{
+    if (scheduler_running) {
+        return ESP_OK;
+    }
+    
+    for (int i = 0; i < RATE_GROUP_COUNT; i++) {
+        rate_groups[i].pending = false;
+    }
+    scheduler_running = true;
+    
+    if (xTaskCreatePinnedToCore(rate_group_task, "imu_spi_sched", SCHED_TASK_STACK_SIZE,
+                                &spi_sched_task, SPI_SCHED_TASK_PRIORITY, &spi_sched_task, 0) != pdPASS ||
+        xTaskCreatePinnedToCore(rate_group_task, "imu_i2c_sched", SCHED_TASK_STACK_SIZE,
+                                &i2c_sched_task, I2C_SCHED_TASK_PRIORITY, &i2c_sched_task, 0) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create scheduler tasks");
+        imu_manager_stop_scheduler();
+        return ESP_FAIL;
+    }
+    
+    for (int i = 0; i < RATE_GROUP_COUNT; i++) {
+        rate_group_t *group = &rate_groups[i];
+        if (group->stream.storage == NULL) {
+            continue;
+        }
+        if (group->irq_driven) {
+            ESP_LOGI(TAG, "Rate group %s: %lu Hz, released by interrupt", group->name, group->rate_hz);
+            continue;
+        }
+        esp_err_t ret = rate_group_start_timer(i);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to start %s timer: %s", group->name, esp_err_to_name(ret));
+            imu_manager_stop_scheduler();
+            return ret;
+        }
+        ESP_LOGI(TAG, "Rate group %s: %lu Hz", group->name, group->rate_hz);
+    }
+    
+    return ESP_OK;
+}
+
+esp_err_t imu_manager_stop_scheduler(void)
+{
+    for (int i = 0; i < RATE_GROUP_COUNT; i++) {
+        rate_group_t *group = &rate_groups[i];
+        if (group->timer) {
+            esp_timer_stop(group->timer);
+            esp_timer_delete(group->timer);
+            group->timer = NULL;
+        }
+    }
+    
+    // Wake the tasks and wait until both have left their loop, so a restart
+    // never runs next to the old ones. Suspended, no task can delete itself
+    // between the handle check and the notify.
+    scheduler_running = false;
+    vTaskSuspendAll();
+    if (spi_sched_task) {
+        xTaskNotify(spi_sched_task, 0, eNoAction);
+    }
+    if (i2c_sched_task) {
+        xTaskNotify(i2c_sched_task, 0, eNoAction);
+    }
+    xTaskResumeAll();
+    while (spi_sched_task || i2c_sched_task) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    
+    for (int i = 0; i < RATE_GROUP_COUNT; i++) {
+        rate_groups[i].pending = false;
+    }
+    return ESP_OK;
+}
+
+esp_err_t imu_manager_set_sensor_rate(uint8_t sensor_id, uint32_t rate_hz)
+{
+    rate_group_t *group = rate_group_from_sensor(sensor_id);
+    if (group == NULL || rate_hz == 0 || rate_hz > group->max_rate_hz) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    // The eDMP runs the ICM45686 at a fixed rate
+    if (sensor_id == SENSOR_IMU_6AXIS && icm_gaf_mode) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    group->rate_hz = rate_hz;
+    
+    // Keep the ICM45686 ODR at least as fast as its read rate
+    if (sensor_id == SENSOR_IMU_6AXIS && (enabled_sensors & SENSOR_IMU_6AXIS) &&
+        xSemaphoreTake(spi_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+        uint16_t icm_odr = icm_odr_for_rate(rate_hz);
+        icm456xx_start_accel(&imu_6axis_sensor, icm_odr, 16);
+        icm456xx_start_gyro(&imu_6axis_sensor, icm_odr, 2000);
+        if (icm_fifo_mode) {
+            // Restart the stream so the FIFO timestamps use the new sample period
+            icm456xx_stop_fifo_stream(&imu_6axis_sensor, PIN_NUM_INT_ICM45686);
+            if (icm456xx_start_fifo_stream(&imu_6axis_sensor, PIN_NUM_INT_ICM45686, icm_fifo_isr, NULL,
+                                           icm_odr, ICM45686_FIFO_WATERMARK, icm_fifo_format()) != 0) {
+                ESP_LOGW(TAG, "ICM45686 FIFO restart failed, using register reads");
+                icm_fifo_mode = false;
+                group->irq_driven = false;
+            }
+            icm_clock_synced = false;
+        }
+        ahrs_set_sample_rate(icm_sample_rate_hz());
+        xSemaphoreGive(spi_mutex);
+    }
+    
+    if (scheduler_running && !group->irq_driven && group->stream.storage) {
+        if (group->timer) {
+            esp_timer_stop(group->timer);
+        }
+        esp_err_t ret = rate_group_start_timer(group - rate_groups);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    
+    ESP_LOGI(TAG, "Rate group %s set to %lu Hz", group->name, rate_hz);
+    return ESP_OK;
+}
+
+uint32_t imu_manager_get_sensor_rate(uint8_t sensor_id)
+{
+    rate_group_t *group = rate_group_from_sensor(sensor_id);
+    return group ? group->rate_hz : 0;
+}
+
+esp_err_t imu_manager_get_rate_group_stats(uint8_t sensor_id, imu_rate_group_stats_t *stats)
+{
+    rate_group_t *group = rate_group_from_sensor(sensor_id);
+    if (group == NULL || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    *stats = group->stats;
+    stats->rate_hz = group->rate_hz;
+    stats->avg_convert_cycles = stats->converts ? (uint32_t)(stats->total_convert_cycles / stats->converts) : 0;
+    return ESP_OK;
+}
+
+void imu_manager_get_spi_bus_stats(spi_batch_stats_t *stats)
+{
+    spi_batch_get_stats(stats);
+}
+
+sensor_stream_t *imu_manager_get_stream(uint8_t sensor_id)
+{
+    rate_group_t *group = rate_group_from_sensor(sensor_id);
+    if (group == NULL || group->stream.storage == NULL) {
+        return NULL;
+    }
+    return &group->stream;
+}
+
+esp_err_t imu_manager_get_latest(imu_data_t *data)
+{
+    if (data == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    memset(data, 0, sizeof(*data));
+    
+    imu_mag_sample_t mag;
+    if ((enabled_sensors & SENSOR_MAGNETOMETER) &&
+        sensor_stream_get_latest(imu_manager_get_stream(SENSOR_MAGNETOMETER), &mag) == ESP_OK) {
+        data->magnetometer.x_mg = mag.x_mg;
+        data->magnetometer.y_mg = mag.y_mg;
+        data->magnetometer.z_mg = mag.z_mg;
+        data->magnetometer.temperature_c = mag.temperature_c;
+        data->magnetometer.valid = true;
+        if (mag.timestamp_us > data->timestamp_us) {
+            data->timestamp_us = mag.timestamp_us;
+        }
+    }
+    
+    imu_accel_sample_t accel;
+    if ((enabled_sensors & SENSOR_ACCELEROMETER) &&
+        sensor_stream_get_latest(imu_manager_get_stream(SENSOR_ACCELEROMETER), &accel) == ESP_OK) {
+        data->accelerometer.x_g = accel.x_g;
+        data->accelerometer.y_g = accel.y_g;
+        data->accelerometer.z_g = accel.z_g;
+        data->accelerometer.valid = true;
+        if (accel.timestamp_us > data->timestamp_us) {
+            data->timestamp_us = accel.timestamp_us;
+        }
+    }
+    
+    imu_6axis_sample_t imu;
+    if ((enabled_sensors & SENSOR_IMU_6AXIS) &&
+        sensor_stream_get_latest(imu_manager_get_stream(SENSOR_IMU_6AXIS), &imu) == ESP_OK) {
+        data->imu_6axis.accel_x_ug = imu.accel_x_ug;
+        data->imu_6axis.accel_y_ug = imu.accel_y_ug;
+        data->imu_6axis.accel_z_ug = imu.accel_z_ug;
+        data->imu_6axis.gyro_x_mdps = imu.gyro_x_mdps;
+        data->imu_6axis.gyro_y_mdps = imu.gyro_y_mdps;
+        data->imu_6axis.gyro_z_mdps = imu.gyro_z_mdps;
+        data->imu_6axis.temperature_mc = imu.temperature_mc;
+        data->imu_6axis.hires = imu.hires;
+        data->imu_6axis.valid = true;
+        if (imu.timestamp_us > data->timestamp_us) {
+            data->timestamp_us = imu.timestamp_us;
+        }
+    }
+    
+    imu_incl_sample_t incl;
+    if ((enabled_sensors & SENSOR_INCLINOMETER) &&
+        sensor_stream_get_latest(imu_manager_get_stream(SENSOR_INCLINOMETER), &incl) == ESP_OK) {
+        data->inclinometer.angle_x_deg = incl.angle_x_deg;
+        data->inclinometer.angle_y_deg = incl.angle_y_deg;
+        data->inclinometer.angle_z_deg = incl.angle_z_deg;
+        data->inclinometer.accel_x_g = incl.accel_x_g;
+        data->inclinometer.accel_y_g = incl.accel_y_g;
+        data->inclinometer.accel_z_g = incl.accel_z_g;
+        data->inclinometer.temperature_c = incl.temperature_c;
+        data->inclinometer.valid = true;
+        if (incl.timestamp_us > data->timestamp_us) {
+            data->timestamp_us = incl.timestamp_us;
+        }
+    }
+    
+    return (data->timestamp_us != 0) ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+// Re-arms the IMU group after a mode switch or a FIFO fallback: its timer, or its FIFO interrupt
+static esp_err_t imu_group_restart(void)
+{
+    rate_group_t *group = &rate_groups[RATE_GROUP_IMU_6AXIS];
+    
+    if (!scheduler_running || group->stream.storage == NULL) {
+        return ESP_OK;
+    }
+    if (group->timer) {
+        esp_timer_stop(group->timer);
+    }
+    return group->irq_driven ? ESP_OK : rate_group_start_timer(RATE_GROUP_IMU_6AXIS);
+}
+
+esp_err_t imu_manager_set_imu_hires(bool enable)
+{
+    // Before init only the preference is stored
+    if (spi_mutex == NULL || !(enabled_sensors & SENSOR_IMU_6AXIS)) {
+        icm_fifo_hires = enable;
+        return ESP_OK;
+    }
+    
+    // 20-bit data only exists in FIFO packets
+    if (!icm_fifo_mode) {
+        return enable ? ESP_ERR_NOT_SUPPORTED : ESP_OK;
+    }
+    if (enable == icm_fifo_hires) {
+        return ESP_OK;
+    }
+    
+    if (xSemaphoreTake(spi_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    
+    uint16_t icm_odr = icm_odr_for_rate(rate_groups[RATE_GROUP_IMU_6AXIS].rate_hz);
+    icm456xx_stop_fifo_stream(&imu_6axis_sensor, PIN_NUM_INT_ICM45686);
+    icm_fifo_hires = enable;
+    int rc = icm456xx_start_fifo_stream(&imu_6axis_sensor, PIN_NUM_INT_ICM45686, icm_fifo_isr, NULL,
+                                        icm_odr, ICM45686_FIFO_WATERMARK, icm_fifo_format());
+    if (rc != 0) {
+        // Go back to the previous format
+        icm_fifo_hires = !enable;
+        rc = icm456xx_start_fifo_stream(&imu_6axis_sensor, PIN_NUM_INT_ICM45686, icm_fifo_isr, NULL,
+                                        icm_odr, ICM45686_FIFO_WATERMARK, icm_fifo_format());
+        if (rc != 0) {
+            ESP_LOGW(TAG, "ICM45686 FIFO restart failed, using register reads");
+            icm_fifo_mode = false;
+            rate_groups[RATE_GROUP_IMU_6AXIS].irq_driven = false;
+            ahrs_set_sample_rate(icm_sample_rate_hz());
+            xSemaphoreGive(spi_mutex);
+            // Without the FIFO interrupt the group needs its timer back
+            imu_group_restart();
+            return ESP_FAIL;
+        }
+        xSemaphoreGive(spi_mutex);
+        return ESP_FAIL;
+    }
+    icm_clock_synced = false;
+    xSemaphoreGive(spi_mutex);
+    
+    imu_6axis_format_t format;
+    imu_manager_get_imu_format(&format);
+    ESP_LOGI(TAG, "ICM45686 FIFO %s: %lu B/frame, %lu B/s, LSB %lu ug / %lu udps",
+             enable ? "20-bit" : "16-bit", format.fifo_frame_bytes, format.fifo_bytes_per_s,
+             format.accel_lsb_ug, format.gyro_lsb_udps);
+    return ESP_OK;
+}
+
+bool imu_manager_get_imu_hires(void)
+{
+    return icm_fifo_hires;
+}
+
+esp_err_t imu_manager_set_orientation_source(ahrs_source_t source)
+{
+    if (source >= AHRS_SOURCE_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if ((source == AHRS_SOURCE_EDMP_GAF) == icm_gaf_mode) {
+        return ESP_OK;
+    }
+#if ICM_GAF_SUPPORTED
+    rate_group_t *group = &rate_groups[RATE_GROUP_IMU_6AXIS];
+    bool gaf_failed = false;
+    
+    if (!(enabled_sensors & SENSOR_IMU_6AXIS)) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (xSemaphoreTake(spi_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    
+    if (source == AHRS_SOURCE_EDMP_GAF) {
+        // The FIFO now belongs to the eDMP; accel/gyro come from the registers
+        if (icm_fifo_mode) {
+            icm456xx_stop_fifo_stream(&imu_6axis_sensor, PIN_NUM_INT_ICM45686);
+            icm_fifo_mode = false;
+        }
+        group->irq_driven = false;
+        icm_gaf_saved_rate_hz = group->rate_hz;
+        if (icm456xx_start_gaf(&imu_6axis_sensor, PIN_NUM_INT_ICM45686, NULL) == 0) {
+            icm_gaf_mode = true;
+            group->rate_hz = ICM456XX_GAF_ODR_HZ;
+        } else {
+            ESP_LOGW(TAG, "ICM45686 eDMP GAF start failed, keeping host fusion");
+            icm456xx_stop_gaf(&imu_6axis_sensor, PIN_NUM_INT_ICM45686);
+            gaf_failed = true;
+        }
+    } else {
+        icm456xx_stop_gaf(&imu_6axis_sensor, PIN_NUM_INT_ICM45686);
+        icm_gaf_mode = false;
+        group->rate_hz = icm_gaf_saved_rate_hz;
+    }
+    
+    if (!icm_gaf_mode) {
+        // Host fusion on the full-rate FIFO stream, registers as the fallback
+        uint16_t icm_odr = icm_odr_for_rate(group->rate_hz);
+        icm456xx_start_accel(&imu_6axis_sensor, icm_odr, 16);
+        icm456xx_start_gyro(&imu_6axis_sensor, icm_odr, 2000);
+        if (icm456xx_start_fifo_stream(&imu_6axis_sensor, PIN_NUM_INT_ICM45686, icm_fifo_isr, NULL,
+                                       icm_odr, ICM45686_FIFO_WATERMARK, icm_fifo_format()) == 0) {
+            icm_fifo_mode = true;
+            group->irq_driven = (PIN_NUM_INT_ICM45686 != GPIO_NUM_NC);
+        } else {
+            ESP_LOGW(TAG, "ICM45686 FIFO restart failed, using register reads");
+        }
+        icm_clock_synced = false;
+    }
+    
+    xSemaphoreGive(spi_mutex);
+    
+    ahrs_set_source(icm_gaf_mode ? AHRS_SOURCE_EDMP_GAF : AHRS_SOURCE_HOST,
+                    icm_gaf_mode ? ICM456XX_GAF_ODR_HZ : icm_sample_rate_hz());
+    esp_err_t ret = imu_group_restart();
+    return gaf_failed ? ESP_FAIL : ret;
+#else
+    // Needs the ICM45686S eDMP GAF image and driver
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+ahrs_source_t imu_manager_get_orientation_source(void)
+{
+    return icm_gaf_mode ? AHRS_SOURCE_EDMP_GAF : AHRS_SOURCE_HOST;
+}
+
+esp_err_t imu_manager_get_imu_format(imu_6axis_format_t *format)
+{
+    if (format == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    const bool hires = icm_fifo_mode && icm_fifo_hires;
+    
+    memset(format, 0, sizeof(*format));
+    format->hires = hires;
+    format->fifo = icm_fifo_mode;
+    if (icm_fifo_mode) {
+        // Upper bound with compression: compressed frames pack several samples
+        format->fifo_frame_bytes = icm456xx_get_fifo_frame_size(&imu_6axis_sensor);
+        format->fifo_bytes_per_s = format->fifo_frame_bytes * icm_odr_for_rate(rate_groups[RATE_GROUP_IMU_6AXIS].rate_hz);
+    }
+    format->accel_lsb_ug = ICM_FIXED_MUL >> (hires ? ICM_ACCEL_SHIFT_HIRES : ICM_ACCEL_SHIFT_16BIT);
+    format->gyro_lsb_udps = (ICM_FIXED_MUL * 1000) >> (hires ? ICM_GYRO_SHIFT_HIRES : ICM_GYRO_SHIFT_16BIT);
+    format->accel_count_ug = (float)ICM_FIXED_MUL / (1 << (hires ? ICM_ACCEL_SHIFT_HIRES : ICM_ACCEL_SHIFT_16BIT));
+    format->gyro_count_mdps = (float)ICM_FIXED_MUL / (1 << (hires ? ICM_GYRO_SHIFT_HIRES : ICM_GYRO_SHIFT_16BIT));
+    return ESP_OK;
+}
+
 esp_err_t imu_manager_set_sampling_rate(uint32_t rate_hz)
 {
     sampling_rate_hz = rate_hz;
@@ -346,9 +1429,19 @@ uint8_t imu_manager_get_enabled_sensors(void)
 
 esp_err_t imu_manager_deinit(void)
 {
-    if (sensor_mutex) {
-        vSemaphoreDelete(sensor_mutex);
-        sensor_mutex = NULL;
+    imu_manager_stop_scheduler();
+    
+    for (int i = 0; i < RATE_GROUP_COUNT; i++) {
+        sensor_stream_deinit(&rate_groups[i].stream);
+    }
+    
+    if (spi_mutex) {
+        vSemaphoreDelete(spi_mutex);
+        spi_mutex = NULL;
+    }
+    if (i2c_mutex) {
+        vSemaphoreDelete(i2c_mutex);
+        i2c_mutex = NULL;
     }
     
     ESP_LOGI(TAG, "IMU Manager deinitialized");
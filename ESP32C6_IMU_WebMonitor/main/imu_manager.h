@@ -2,6 +2,9 @@
 #define IMU_MANAGER_H
 
 #include "esp_err.h"
+#include "sensor_stream.h"
+#include "spi_batch.h"
+#include "ahrs.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -26,15 +29,16 @@ typedef struct {
         bool valid;
     } accelerometer;
     
-    // ICM45686 - IMU 6-axis
+    // ICM45686 - IMU 6-axis, 32-bit fixed point so 20-bit FIFO data keeps its resolution
     struct {
-        float accel_x_g;
-        float accel_y_g;
-        float accel_z_g;
-        float gyro_x_dps;
-        float gyro_y_dps;
-        float gyro_z_dps;
-        float temperature_c;
+        int32_t accel_x_ug;
+        int32_t accel_y_ug;
+        int32_t accel_z_ug;
+        int32_t gyro_x_mdps;
+        int32_t gyro_y_mdps;
+        int32_t gyro_z_mdps;
+        int32_t temperature_mc;     // milli-degrees Celsius
+        bool hires;                 // Decoded from 20-bit high-resolution FIFO packets
         bool valid;
     } imu_6axis;
     
@@ -52,6 +56,77 @@ typedef struct {
     
 } imu_data_t;
 
+// Per-sensor timestamped samples (one stream per sensor)
+typedef struct {
+    uint64_t timestamp_us;
+    float x_mg;
+    float y_mg;
+    float z_mg;
+    float temperature_c;
+} imu_mag_sample_t;
+
+typedef struct {
+    uint64_t timestamp_us;
+    float x_g;
+    float y_g;
+    float z_g;
+} imu_accel_sample_t;
+
+typedef struct {
+    uint64_t timestamp_us;
+    int32_t accel_x_ug;
+    int32_t accel_y_ug;
+    int32_t accel_z_ug;
+    int32_t gyro_x_mdps;
+    int32_t gyro_y_mdps;
+    int32_t gyro_z_mdps;
+    int32_t temperature_mc;
+    bool hires;
+} imu_6axis_sample_t;
+
+// ICM45686 data format and what it costs per sample
+typedef struct {
+    bool hires;                 // 20-bit FIFO packets active
+    bool fifo;                  // FIFO streaming (false: register reads)
+    uint32_t fifo_frame_bytes;  // Bytes per FIFO frame on the SPI bus
+    uint32_t fifo_bytes_per_s;  // SPI payload at the current ODR
+    uint32_t accel_lsb_ug;      // Resolution of one accel count
+    uint32_t gyro_lsb_udps;     // Resolution of one gyro count
+    float accel_count_ug;       // Exact accel count in accel_*_ug units (488.28125 at 16 bit)
+    float gyro_count_mdps;      // Exact gyro count in gyro_*_mdps units
+} imu_6axis_format_t;
+
+typedef struct {
+    uint64_t timestamp_us;
+    float angle_x_deg;
+    float angle_y_deg;
+    float angle_z_deg;
+    float accel_x_g;
+    float accel_y_g;
+    float accel_z_g;
+    float temperature_c;
+} imu_incl_sample_t;
+
+// Rate group statistics (one group per sensor)
+typedef struct {
+    uint32_t rate_hz;
+    uint32_t released;          // Periods started by the group timer
+    uint32_t completed;         // Reads finished
+    uint32_t read_errors;
+    uint32_t stale_reads;       // Reads skipped because the sensor had no new data
+    uint32_t deadline_misses;   // Reads finished after the end of their period
+    uint32_t overruns;          // Periods skipped because the previous read was still pending
+    uint32_t last_exec_us;
+    uint32_t max_exec_us;
+    uint32_t max_latency_us;    // Release to completion
+    // CPU cycles turning one register sample's raw counts into units
+    uint32_t last_convert_cycles;
+    uint32_t avg_convert_cycles;
+    uint32_t max_convert_cycles;
+    uint64_t total_convert_cycles;
+    uint32_t converts;
+} imu_rate_group_stats_t;
+
 // IMU Manager API
 esp_err_t imu_manager_init(void);
 esp_err_t imu_manager_read_all(imu_data_t *data);
@@ -61,6 +136,31 @@ esp_err_t imu_manager_read_imu_6axis(imu_data_t *data);
 esp_err_t imu_manager_read_inclinometer(imu_data_t *data);
 esp_err_t imu_manager_deinit(void);
 
+// Rate-group scheduler: each sensor is read at its own rate into its own stream.
+// SPI sensors share one high-priority task, the I2C magnetometer has its own.
+esp_err_t imu_manager_start_scheduler(void);
+esp_err_t imu_manager_stop_scheduler(void);
+esp_err_t imu_manager_set_sensor_rate(uint8_t sensor_id, uint32_t rate_hz);
+uint32_t imu_manager_get_sensor_rate(uint8_t sensor_id);
+esp_err_t imu_manager_get_rate_group_stats(uint8_t sensor_id, imu_rate_group_stats_t *stats);
+sensor_stream_t *imu_manager_get_stream(uint8_t sensor_id);
+// Occupancy of the batched SPI cycles (IIS3DWB + SCL3300 register reads)
+void imu_manager_get_spi_bus_stats(spi_batch_stats_t *stats);
+// Snapshot of the latest sample of every stream (for imu_data_t consumers)
+esp_err_t imu_manager_get_latest(imu_data_t *data);
+
+// ICM45686 high-resolution (20-bit) FIFO mode, switchable at runtime.
+// Hires packets are 20 bytes instead of 16 and disable FIFO compression.
+esp_err_t imu_manager_set_imu_hires(bool enable);
+bool imu_manager_get_imu_hires(void);
+
+// Orientation source: the host AHRS on the FIFO stream, or the ICM45686 eDMP
+// game rotation vector (ICM45686S builds only, ESP_ERR_NOT_SUPPORTED otherwise).
+// In eDMP mode the IMU group is read from the registers at ICM456XX_GAF_ODR_HZ.
+esp_err_t imu_manager_set_orientation_source(ahrs_source_t source);
+ahrs_source_t imu_manager_get_orientation_source(void);
+esp_err_t imu_manager_get_imu_format(imu_6axis_format_t *format);
+
 // Configuration functions
 esp_err_t imu_manager_set_sampling_rate(uint32_t rate_hz);
 esp_err_t imu_manager_set_fifo_watermark(uint16_t watermark);
@@ -0,0 +1,59 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Streaming JSON emitter. Text goes straight into a caller-provided buffer that
+// is handed to the flush callback whenever it fills, so building a document
+// needs no tree and no heap. Without a callback the document must fit in the
+// buffer. Errors are sticky: once a write fails the rest are no-ops and
+// json_writer_finish() returns the first error.
+//
+// Keys are written as is; string values are escaped.
+
+#define JSON_WRITER_MAX_DEPTH   32
+
+// Receives each filled buffer; anything but ESP_OK stops the writer
+typedef esp_err_t (*json_writer_flush_t)(const char *data, size_t len, void *ctx);
+
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;                 // Bytes waiting in buf
+    size_t total;               // Bytes produced so far, flushed or not
+    json_writer_flush_t flush;
+    void *ctx;
+    esp_err_t err;
+    uint8_t depth;
+    uint32_t has_items;         // Bit per nesting level: next value needs a comma
+} json_writer_t;
+
+void json_writer_init(json_writer_t *w, char *buf, size_t size, json_writer_flush_t flush, void *ctx);
+
+// key is NULL for array elements and the top-level value
+void json_writer_begin_object(json_writer_t *w, const char *key);
+void json_writer_end_object(json_writer_t *w);
+void json_writer_begin_array(json_writer_t *w, const char *key);
+void json_writer_end_array(json_writer_t *w);
+
+void json_writer_int(json_writer_t *w, const char *key, int64_t value);
+void json_writer_uint(json_writer_t *w, const char *key, uint64_t value);
+// value / 10^decimals written exactly, e.g. (-1234567, 6) -> -1.234567
+void json_writer_fixed(json_writer_t *w, const char *key, int64_t value, uint8_t decimals);
+// value / 10^scale rounded to decimals, e.g. (-1234567, 6, 3) -> -1.235
+void json_writer_scaled(json_writer_t *w, const char *key, int64_t value, uint8_t scale, uint8_t decimals);
+// Rounded to at most 9 decimals like printf; NaN, infinities and |value| >= 1e19 become null
+void json_writer_float(json_writer_t *w, const char *key, float value, uint8_t decimals);
+void json_writer_bool(json_writer_t *w, const char *key, bool value);
+void json_writer_string(json_writer_t *w, const char *key, const char *value);
+void json_writer_null(json_writer_t *w, const char *key);
+
+// Hands the buffered bytes to the callback
+esp_err_t json_writer_flush(json_writer_t *w);
+// Flushes what is left; ESP_ERR_INVALID_STATE if objects or arrays are still open
+esp_err_t json_writer_finish(json_writer_t *w);
+
+#endif // JSON_WRITER_H
@@ -16,6 +16,7 @@
 #include "web_server.h"
 #include "imu_manager.h"
 #include "data_buffer.h"
+#include "time_align.h"
 #include "led_status.h"
 
 static const char *TAG = "MAIN";
@@ -151,6 +152,15 @@ void wifi_init_sta(void)
     }
 }
 
+// Aligned frames drained per imu_task period, enough for TIME_ALIGN_MAX_RATE_HZ
+#define IMU_ALIGN_MAX_FRAMES        32
+
+static void emit_aligned_frame(const imu_data_t *frame, void *ctx)
+{
+    (void)ctx;
+    data_buffer_add(frame);
+}
+
 // IMU data collection task
 static void imu_task(void *pvParameters)
 {
@@ -163,28 +173,61 @@ static void imu_task(void *pvParameters)
         return;
     }
     
-    imu_data_t sensor_data;
+    // Each sensor is now read by its own rate group into its own stream
+    if (imu_manager_start_scheduler() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start IMU rate-group scheduler");
+        vTaskDelete(NULL);
+        return;
+    }
+    
+    time_align_config_t align_cfg = {
+        .output_rate_hz = TIME_ALIGN_DEFAULT_RATE_HZ,
+        .interp = TIME_ALIGN_LINEAR,
+        .max_latency_us = TIME_ALIGN_DEFAULT_LATENCY_US,
+    };
+    if (time_align_init(&align_cfg) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize time alignment");
+        vTaskDelete(NULL);
+        return;
+    }
+    
     TickType_t last_wake_time = xTaskGetTickCount();
-    const TickType_t frequency = pdMS_TO_TICKS(50); // 10Hz sampling (reduced from 100Hz to avoid watchdog)
+    const TickType_t frequency = pdMS_TO_TICKS(50); // Drain period, frames come at the aligned output rate
     uint32_t read_count = 0;
+    uint32_t next_log = 100;
     
     while (1) {
-        // Collect data from all sensors
-        if (imu_manager_read_all(&sensor_data) == ESP_OK) {
-            // Add to circular buffer
-            data_buffer_add(&sensor_data);
-            read_count++;
-            
-            // printf("time(us): %lld, ii3s: x:%f - y:%f - z:%f - valid:%d \r\n", 
-            //     sensor_data.timestamp_us ,sensor_data.accelerometer.x_g, sensor_data.accelerometer.y_g, sensor_data.accelerometer.z_g, sensor_data.accelerometer.valid);
-            // Log every 100 reads
-            if (read_count % 100 == 0) {
-                ESP_LOGI(TAG, "IMU read count: %lu, buffer adds: %lu, mag_valid=%d", 
-                         read_count, read_count,
-                         sensor_data.magnetometer.valid);
+        // History columns follow the enabled sensors and the frame rate
+        data_buffer_configure(imu_manager_get_enabled_sensors(), time_align_get_output_rate());
+        
+        // Fused frames: every stream resampled to the common timeline
+        read_count += time_align_process(emit_aligned_frame, NULL, IMU_ALIGN_MAX_FRAMES);
+        
+        // Log every 100 frames
+        if (read_count >= next_log) {
+            next_log = read_count + 100;
+            static const struct {
+                uint8_t id;
+                const char *name;
+            } groups[] = {
+                {SENSOR_MAGNETOMETER, "mag"},
+                {SENSOR_ACCELEROMETER, "accel"},
+                {SENSOR_IMU_6AXIS, "imu6"},
+                {SENSOR_INCLINOMETER, "incl"},
+            };
+            time_align_stats_t align;
+            time_align_get_stats(&align);
+            ESP_LOGI(TAG, "Aligned frames: %lu @ %lu Hz (partial=%lu skipped=%lu lag=%lu/%lu us)",
+                     align.frames, align.output_rate_hz, align.partial_frames,
+                     align.skipped_frames, align.last_lag_us, align.max_lag_us);
+            for (size_t i = 0; i < sizeof(groups) / sizeof(groups[0]); i++) {
+                imu_rate_group_stats_t st;
+                if (imu_manager_get_rate_group_stats(groups[i].id, &st) == ESP_OK && st.released > 0) {
+                    ESP_LOGI(TAG, "  %-5s %4lu Hz: done=%lu err=%lu miss=%lu overrun=%lu exec=%lu/%lu us",
+                             groups[i].name, st.rate_hz, st.completed, st.read_errors,
+                             st.deadline_misses, st.overruns, st.last_exec_us, st.max_exec_us);
+                }
             }
-        } else {
-            ESP_LOGW(TAG, "Failed to read IMU data");
         }
         
         // Maintain precise timing
@@ -197,27 +240,40 @@ static void data_processor_task(void *pvParameters)
 {
     ESP_LOGI(TAG, "Data processor task started");
     
-    imu_data_t data;
+    data_buffer_cursor_t cursor;
+    data_buffer_cursor_init(&cursor, false);
     uint32_t processed_count = 0;
+    uint32_t next_log = 1000;
+    uint64_t last_ts_us = 0;
+    uint32_t gap_count = 0;
     
     while (1) {
-        // Process data from buffer (use get_latest to not consume/delete data)
-        // This allows ws_broadcast_task to also read the same data
-        if (data_buffer_get_latest(&data) == ESP_OK) {
-            // Calculate statistics, apply filters, etc.
-            processed_count++;
+        // Every frame once, in place, through this task's own cursor
+        data_buffer_read_t rd;
+        if (data_buffer_read_begin(&cursor, 0, &rd) == ESP_OK) {
+            // Calculate statistics, apply filters, etc.: here, holes in the timeline
+            uint64_t max_gap_us = 2000000ULL / time_align_get_output_rate();
+            for (int s = 0; s < 2; s++) {
+                for (uint32_t i = 0; i < rd.span[s].len; i++) {
+                    uint64_t ts = data_buffer_timestamp_at(rd.span[s].pos + i);
+                    if (last_ts_us != 0 && ts - last_ts_us > max_gap_us) {
+                        gap_count++;
+                    }
+                    last_ts_us = ts;
+                }
+            }
+            data_buffer_read_end(&cursor, &rd);
+            processed_count += rd.count;
             
             // Log statistics every 1000 samples
-            if (processed_count % 1000 == 0) {
-                ESP_LOGI(TAG, "Processed %lu samples", processed_count);
+            if (processed_count >= next_log) {
+                next_log = processed_count + 1000;
+                ESP_LOGI(TAG, "Processed %lu samples (lag %lu, overruns %lu, gaps %lu)",
+                         processed_count, rd.lag, cursor.overruns, gap_count);
             }
-        } else {
-            // Buffer empty, wait longer to avoid busy-waiting
-            vTaskDelay(pdMS_TO_TICKS(10));
         }
         
-        // Always yield to other tasks
-        vTaskDelay(pdMS_TO_TICKS(100)); // Process at 10Hz, same as IMU sampling rate
+        vTaskDelay(pdMS_TO_TICKS(100)); // Drain at 10 Hz, the cursor keeps the frames in between
     }
 }
 
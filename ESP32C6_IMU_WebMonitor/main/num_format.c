@@ -0,0 +1,194 @@
+#include "num_format.h"
+#include <stdbool.h>
+#include <string.h>
+
+// Bit pattern of 1e19f; positive floats order like their bit patterns
+#define NUM_FORMAT_FLOAT_LIMIT_BITS 0x5F0AC723UL
+
+static const uint32_t pow10_u32[NUM_FORMAT_MAX_DECIMALS + 1] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+};
+
+// Two digits per division halves the divisions for long numbers
+static const char digit_pairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// Writes value as exactly n digits, zero padded; value < 10^n
+static void put_digits(char *out, uint32_t value, uint32_t n)
+{
+    char *p = out + n;
+    while (n >= 2) {
+        uint32_t pair = value % 100;
+        value /= 100;
+        p -= 2;
+        memcpy(p, &digit_pairs[pair * 2], 2);
+        n -= 2;
+    }
+    if (n == 1) {
+        *--p = (char)('0' + value);
+    }
+}
+
+size_t num_format_u32(char *out, uint32_t value)
+{
+    uint32_t n = 1;
+    while (n < 10 && value >= pow10_u32[n]) {
+        n++;
+    }
+    put_digits(out, value, n);
+    return n;
+}
+
+size_t num_format_u64(char *out, uint64_t value)
+{
+    if (value <= UINT32_MAX) {
+        return num_format_u32(out, (uint32_t)value);
+    }
+
+    // 32-bit division is a single instruction on the ESP32-C6, 64-bit is a
+    // libgcc call: split off nine digits at a time and print the parts as u32
+    uint64_t high = value / 1000000000;
+    uint32_t low = (uint32_t)(value - high * 1000000000);
+    size_t n;
+    if (high <= UINT32_MAX) {
+        n = num_format_u32(out, (uint32_t)high);
+    } else {
+        uint32_t top = (uint32_t)(high / 1000000000);
+        uint32_t mid = (uint32_t)(high - (uint64_t)top * 1000000000);
+        n = num_format_u32(out, top);
+        put_digits(out + n, mid, 9);
+        n += 9;
+    }
+    put_digits(out + n, low, 9);
+    return n + 9;
+}
+
+size_t num_format_i64(char *out, int64_t value)
+{
+    if (value < 0) {
+        *out = '-';
+        return 1 + num_format_u64(out + 1, -(uint64_t)value);
+    }
+    return num_format_u64(out, (uint64_t)value);
+}
+
+static size_t put_decimal(char *out, bool negative, uint64_t int_part, uint32_t frac, uint8_t decimals)
+{
+    size_t n = 0;
+    // Anything that rounds to zero is printed unsigned
+    if (negative && (int_part != 0 || frac != 0)) {
+        out[n++] = '-';
+    }
+    n += num_format_u64(out + n, int_part);
+    if (decimals > 0) {
+        out[n++] = '.';
+        put_digits(out + n, frac, decimals);
+        n += decimals;
+    }
+    return n;
+}
+
+size_t num_format_fixed(char *out, int64_t value, uint8_t scale, uint8_t decimals)
+{
+    if (scale > NUM_FORMAT_MAX_DECIMALS) {
+        scale = NUM_FORMAT_MAX_DECIMALS;
+    }
+    if (decimals > NUM_FORMAT_MAX_DECIMALS) {
+        decimals = NUM_FORMAT_MAX_DECIMALS;
+    }
+
+    uint64_t mag = value < 0 ? -(uint64_t)value : (uint64_t)value;
+    uint32_t unit = pow10_u32[scale];
+    uint64_t int_part;
+    uint32_t frac;
+    if (mag <= UINT32_MAX) {
+        int_part = (uint32_t)mag / unit;
+        frac = (uint32_t)mag % unit;
+    } else {
+        int_part = mag / unit;
+        frac = (uint32_t)(mag - int_part * unit);
+    }
+
+    if (decimals < scale) {
+        uint32_t drop = pow10_u32[scale - decimals];
+        frac = (frac + drop / 2) / drop;
+        if (frac >= pow10_u32[decimals]) {
+            frac -= pow10_u32[decimals];
+            int_part++;
+        }
+    } else {
+        frac *= pow10_u32[decimals - scale];
+    }
+    return put_decimal(out, value < 0, int_part, frac, decimals);
+}
+
+size_t num_format_float(char *out, float value, uint8_t decimals)
+{
+    // Works on the IEEE 754 fields, so no soft-float routine is involved
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    bool negative = (bits >> 31) != 0;
+    uint32_t exponent = (bits >> 23) & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (exponent == 0xFF && mantissa != 0) {
+        memcpy(out, "nan", 3);
+        return 3;
+    }
+    if ((bits & 0x7FFFFFFF) >= NUM_FORMAT_FLOAT_LIMIT_BITS) {
+        if (negative) {
+            memcpy(out, "-inf", 4);
+            return 4;
+        }
+        memcpy(out, "inf", 3);
+        return 3;
+    }
+    if (decimals > NUM_FORMAT_MAX_DECIMALS) {
+        decimals = NUM_FORMAT_MAX_DECIMALS;
+    }
+
+    // value = m * 2^-shift
+    uint32_t m = (exponent == 0) ? mantissa : (mantissa | 0x800000);
+    int32_t shift = (exponent == 0) ? 149 : 150 - (int32_t)exponent;
+    uint32_t scale = pow10_u32[decimals];
+    uint64_t int_part;
+    uint32_t frac = 0;
+    if (shift <= 0) {
+        int_part = (uint64_t)m << -shift;
+    } else {
+        uint32_t frac_bits = m;
+        int_part = 0;
+        if (shift < 24) {
+            int_part = m >> shift;
+            frac_bits = m & ((1UL << shift) - 1);
+        }
+        // The fraction times 10^decimals is below 2^54; anything shifted out
+        // past 2^-64 is far below half a unit and rounds to zero
+        if (shift < 64) {
+            uint64_t scaled = (uint64_t)frac_bits * scale;
+            uint64_t rem = scaled & ((1ULL << shift) - 1);
+            uint64_t half = 1ULL << (shift - 1);
+            frac = (uint32_t)(scaled >> shift);
+            // Exact binary value rounded half to even, as printf does; with
+            // no decimals the last digit is the integer's
+            uint32_t last = (decimals > 0) ? frac : (uint32_t)int_part;
+            if (rem > half || (rem == half && (last & 1))) {
+                frac++;
+            }
+            if (frac >= scale) {
+                frac -= scale;
+                int_part++;
+            }
+        }
+    }
+    return put_decimal(out, negative, int_part, frac, decimals);
+}
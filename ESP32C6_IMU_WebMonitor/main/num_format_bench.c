@@ -0,0 +1,165 @@
+// Host check and benchmark of num_format against printf. Not part of the
+// firmware build (not listed in CMakeLists.txt). The HighSpeed monitor
+// carries an identical num_format.c, so this covers both.
+//
+//   gcc -std=gnu17 -O2 -I. num_format_bench.c num_format.c -o num_format_bench -lm
+//   ./num_format_bench [count]
+//
+// First compares the output of every function with printf or an exact
+// integer reference (count random values each), then times both paths.
+
+#include "num_format.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+// xorshift64*: fixed seed, so runs are comparable
+static uint64_t rng_next(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+// Finite float with a magnitude spread over the range the encoders see
+static float rng_float(void)
+{
+    uint64_t r = rng_next();
+    float mantissa = (float)(r & 0xFFFFFF) / (float)0x1000000;
+    int exponent = (int)((r >> 24) % 40) - 20;
+    float value = ldexpf(mantissa, exponent);
+    return (r >> 63) ? -value : value;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Exact reference of num_format_fixed: value / 10^scale rounded half away from zero
+static int fixed_reference(char *out, int64_t value, unsigned scale, unsigned decimals)
+{
+    uint64_t mag = value < 0 ? (uint64_t)0 - (uint64_t)value : (uint64_t)value;
+    uint64_t unit = 1;
+    for (unsigned i = 0; i < scale; i++) {
+        unit *= 10;
+    }
+    uint64_t int_part = mag / unit;
+    uint64_t frac = mag % unit;
+    if (decimals < scale) {
+        uint64_t drop = 1;
+        for (unsigned i = decimals; i < scale; i++) {
+            drop *= 10;
+        }
+        frac = (frac + drop / 2) / drop;
+        uint64_t full = unit / drop;
+        if (frac >= full) {
+            frac -= full;
+            int_part++;
+        }
+    } else {
+        for (unsigned i = scale; i < decimals; i++) {
+            frac *= 10;
+        }
+    }
+    const char *sign = (value < 0 && (int_part || frac)) ? "-" : "";
+    if (decimals == 0) {
+        return sprintf(out, "%s%" PRIu64, sign, int_part);
+    }
+    return sprintf(out, "%s%" PRIu64 ".%0*" PRIu64, sign, int_part, (int)decimals, frac);
+}
+
+static int check(const char *what, const char *got, size_t got_len, const char *want)
+{
+    if (got_len == strlen(want) && memcmp(got, want, got_len) == 0) {
+        return 0;
+    }
+    fprintf(stderr, "%s: got \"%.*s\", want \"%s\"\n", what, (int)got_len, got, want);
+    return 1;
+}
+
+static int run_checks(long count)
+{
+    char got[NUM_FORMAT_MAX_LEN];
+    char want[64];
+    int errors = 0;
+
+    for (long i = 0; i < count && errors < 10; i++) {
+        float f = rng_float();
+        uint8_t decimals = (uint8_t)(i % (NUM_FORMAT_MAX_DECIMALS + 1));
+        snprintf(want, sizeof(want), "%.*f", decimals, f);
+        // printf keeps the sign of a result that rounds to zero, num_format does not
+        const char *w = (strspn(want, "-0.") == strlen(want) && want[0] == '-') ? want + 1 : want;
+        errors += check("float", got, num_format_float(got, f, decimals), w);
+
+        int64_t v = (int64_t)rng_next() >> (rng_next() % 40);
+        uint8_t scale = (uint8_t)(rng_next() % (NUM_FORMAT_MAX_DECIMALS + 1));
+        fixed_reference(want, v, scale, decimals);
+        errors += check("fixed", got, num_format_fixed(got, v, scale, decimals), want);
+
+        uint64_t u = rng_next() >> (rng_next() % 64);
+        snprintf(want, sizeof(want), "%" PRIu64, u);
+        errors += check("u64", got, num_format_u64(got, u), want);
+
+        snprintf(want, sizeof(want), "%" PRId64, (int64_t)u);
+        errors += check("i64", got, num_format_i64(got, (int64_t)u), want);
+
+        snprintf(want, sizeof(want), "%" PRIu32, (uint32_t)u);
+        errors += check("u32", got, num_format_u32(got, (uint32_t)u), want);
+    }
+    return errors;
+}
+
+#define BENCH(label, setup, call)                                           \
+    do {                                                                    \
+        rng_state = 0x9E3779B97F4A7C15ULL;                                  \
+        double start = now_ns();                                            \
+        for (long i = 0; i < count; i++) {                                  \
+            setup;                                                          \
+            sink += (size_t)(call);                                         \
+        }                                                                   \
+        printf("  %-22s %6.1f ns\n", label, (now_ns() - start) / count);    \
+    } while (0)
+
+static void run_bench(long count)
+{
+    char out[64];
+    volatile size_t sink = 0;
+    float f;
+    int64_t ug;
+    uint64_t ts;
+    uint32_t small;
+
+    BENCH("%.5f float", f = rng_float(), snprintf(out, sizeof(out), "%.5f", f));
+    BENCH("num_format_float", f = rng_float(), num_format_float(out, f, 5));
+    BENCH("%.6f of ug/1e6", ug = (int32_t)rng_next(), snprintf(out, sizeof(out), "%.6f", ug / 1e6));
+    BENCH("num_format_fixed 6/6", ug = (int32_t)rng_next(), num_format_fixed(out, ug, 6, 6));
+    BENCH("%llu timestamp", ts = rng_next() >> 24, snprintf(out, sizeof(out), "%" PRIu64, ts));
+    BENCH("num_format_u64", ts = rng_next() >> 24, num_format_u64(out, ts));
+    BENCH("%u small", small = (uint32_t)rng_next() % 100000, snprintf(out, sizeof(out), "%" PRIu32, small));
+    BENCH("num_format_u32", small = (uint32_t)rng_next() % 100000, num_format_u32(out, small));
+    (void)sink;
+}
+
+int main(int argc, char **argv)
+{
+    long count = argc > 1 ? atol(argv[1]) : 2000000;
+    if (count <= 0) {
+        count = 2000000;
+    }
+
+    int errors = run_checks(count);
+    printf("check: %ld values per function, %d mismatches\n", count, errors);
+
+    printf("time per number (setup included):\n");
+    run_bench(count);
+    return errors ? 1 : 0;
+}
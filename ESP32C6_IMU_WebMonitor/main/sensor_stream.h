@@ -0,0 +1,35 @@
+#ifndef SENSOR_STREAM_H
+#define SENSOR_STREAM_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// Fixed-element ring holding the timestamped samples of one sensor.
+// Each sensor owns its own stream, so a slow producer never stalls the others.
+typedef struct {
+    uint8_t *storage;
+    size_t elem_size;
+    uint32_t capacity;
+    uint32_t write_seq;         // Total samples ever pushed (sequence of the next sample)
+    uint32_t dropped;           // Samples lost because the stream was busy
+    SemaphoreHandle_t mutex;
+} sensor_stream_t;
+
+esp_err_t sensor_stream_init(sensor_stream_t *stream, size_t elem_size, uint32_t capacity);
+void sensor_stream_deinit(sensor_stream_t *stream);
+
+// Producer side
+esp_err_t sensor_stream_push(sensor_stream_t *stream, const void *sample);
+
+// Consumer side
+esp_err_t sensor_stream_get_latest(sensor_stream_t *stream, void *sample);
+// Copies up to max_samples starting at *cursor and advances it. If the cursor
+// fell behind the ring it is moved to the oldest retained sample.
+uint32_t sensor_stream_read(sensor_stream_t *stream, uint32_t *cursor,
+                            void *samples, uint32_t max_samples);
+uint32_t sensor_stream_get_seq(sensor_stream_t *stream);
+
+#endif // SENSOR_STREAM_H
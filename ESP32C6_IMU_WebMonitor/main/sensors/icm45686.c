@@ -14,6 +14,8 @@ static const char *TAG = "ICM45686_C";
 #define DEFAULT_SPI_CLOCK_HZ 6000000
 #define GYR_STARTUP_TIME_US 5000
 #define DEFAULT_WOM_THS_MG (52 >> 2) /* matches Arduino code */
+/* Largest FIFO burst: 1 command byte + data must fit the bus max_transfer_sz (4096) */
+#define FIFO_READ_MAX_BYTES 4000
 
 /* single global pointer used by the inv driver callbacks (matches original design) */
 static icm456xx_dev_t *icm_dev_ptr = NULL;
@@ -91,14 +93,52 @@ static void transport_sleep_us(uint32_t us)
 /* FIFO sensor event callback (used by inv driver to signal GAF outputs) */
 static void fifo_sensor_event_cb(inv_imu_sensor_event_t *event)
 {
-#if defined(ICM45686S) || defined(ICM45605S)
     if (!icm_dev_ptr) return;
+    icm456xx_dev_t *dev = icm_dev_ptr;
+#if defined(ICM45686S) || defined(ICM45605S)
     if (event->sensor_mask & (1 << INV_SENSOR_ES0)) {
-        icm_dev_ptr->gaf_status = inv_imu_edmp_gaf_build_outputs(&icm_dev_ptr->icm_driver, (const uint8_t *)event->es0, &icm_dev_ptr->gaf_outputs_internal);
+        dev->gaf_status = inv_imu_edmp_gaf_build_outputs(&dev->icm_driver, (const uint8_t *)event->es0, &dev->gaf_outputs_internal);
+        if (dev->gaf_status == 1 && dev->gaf_cb) {
+            dev->gaf_cb(&dev->gaf_outputs_internal, dev->gaf_cb_ctx);
+            dev->gaf_status = 0;
+        }
     }
-#else
-    (void)event;
 #endif
+
+    if (!dev->fifo_cb) return;
+    if (!(event->sensor_mask & ((1 << INV_SENSOR_ACCEL) | (1 << INV_SENSOR_GYRO)))) return;
+
+    /* Extend the 16-bit FIFO timestamp; compressed samples carry none and are
+       spaced by the ODR period */
+    if (dev->fifo_frame_has_ts && dev->fifo_ts_valid) {
+        uint16_t delta = (uint16_t)(event->timestamp_fsync - dev->fifo_last_ts);
+        dev->fifo_time_us += (uint64_t)delta * dev->fifo_tmst_resol_us;
+    } else if (dev->fifo_ts_valid) {
+        dev->fifo_time_us += dev->fifo_period_us;
+    }
+    if (dev->fifo_frame_has_ts) {
+        dev->fifo_last_ts = event->timestamp_fsync;
+        dev->fifo_ts_valid = true;
+        dev->fifo_frame_has_ts = false;   /* further events of this frame are compressed */
+    }
+
+    icm456xx_fifo_sample_t sample = {
+        .timestamp_us = dev->fifo_time_us,
+        .temperature = event->temperature,
+        .hires = dev->fifo_hires,
+        .sensor_mask = event->sensor_mask,
+    };
+    for (int i = 0; i < 3; i++) {
+        if (dev->fifo_hires) {
+            /* 20-bit value: 16 MSBs from the data field, 4 LSBs from the extension nibble */
+            sample.accel[i] = ((int32_t)event->accel[i] << 4) | (event->accel_high_res[i] & 0xF);
+            sample.gyro[i] = ((int32_t)event->gyro[i] << 4) | (event->gyro_high_res[i] & 0xF);
+        } else {
+            sample.accel[i] = event->accel[i];
+            sample.gyro[i] = event->gyro[i];
+        }
+    }
+    dev->fifo_cb(&sample, dev->fifo_cb_ctx);
 }
 
 /* ------------ Public API -------------- */
@@ -297,7 +337,7 @@ int icm456xx_enable_fifo_interrupt(icm456xx_dev_t *dev, int int_gpio, void (*use
     const inv_imu_fifo_config_t fifo_config = {
         .gyro_en=true,
         .accel_en=true,
-        .hires_en=false,
+        .hires_en=dev->fifo_hires,
         .fifo_wm_th=fifo_watermark,
         .fifo_mode=FIFO_CONFIG0_FIFO_MODE_SNAPSHOT,
         .fifo_depth=FIFO_CONFIG0_FIFO_DEPTH_MAX
@@ -345,6 +385,150 @@ int icm456xx_get_data_from_fifo(icm456xx_dev_t *dev, inv_imu_fifo_data_t *data)
     return inv_imu_get_fifo_frame(&dev->icm_driver, data);
 }
 
+/* configure INT1 pin + isr handler (shared by the FIFO paths) */
+static int setup_int1_gpio(int int_gpio, void (*isr)(void*), void *isr_arg)
+{
+    gpio_config_t io_conf = {
+        .intr_type = GPIO_INTR_POSEDGE,
+        .mode = GPIO_MODE_INPUT,
+        .pin_bit_mask = 1ULL << int_gpio,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .pull_up_en = GPIO_PULLUP_ENABLE
+    };
+    if (gpio_config(&io_conf) != ESP_OK) return -1;
+
+    /* ESP_ERR_INVALID_STATE means the service is already installed */
+    esp_err_t ret = gpio_install_isr_service(0);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) return -1;
+
+    return (gpio_isr_handler_add(int_gpio, (gpio_isr_t)isr, isr_arg) == ESP_OK) ? 0 : -1;
+}
+
+int icm456xx_start_fifo_stream(icm456xx_dev_t *dev, int int_gpio, void (*isr)(void*), void *isr_arg,
+                               uint16_t odr_hz, uint16_t fifo_watermark, icm456xx_fifo_format_t format)
+{
+    if (!dev || odr_hz == 0) return -1;
+    int rc = 0;
+    inv_imu_int_state_t it_conf;
+    const bool compression = (format == ICM456XX_FIFO_FORMAT_COMPRESSED);
+    const bool hires = (format == ICM456XX_FIFO_FORMAT_HIRES);
+    const inv_imu_adv_fifo_config_t fifo_config = {
+        .base_conf = {
+            .gyro_en    = INV_IMU_ENABLE,
+            .accel_en   = INV_IMU_ENABLE,
+            .hires_en   = hires ? INV_IMU_ENABLE : INV_IMU_DISABLE,
+            .fifo_wm_th = fifo_watermark,
+            .fifo_mode  = FIFO_CONFIG0_FIFO_MODE_STREAM,
+            .fifo_depth = FIFO_CONFIG0_FIFO_DEPTH_MAX,
+        },
+        .fifo_wr_wm_gt_th     = FIFO_CONFIG2_FIFO_WR_WM_EQ_OR_GT_TH,
+        .tmst_fsync_en        = INV_IMU_ENABLE,
+        .es1_en               = INV_IMU_DISABLE,
+        .es0_en               = INV_IMU_DISABLE,
+        .es0_6b_9b            = FIFO_CONFIG4_FIFO_ES0_6B,
+        .comp_en              = compression ? INV_IMU_ENABLE : INV_IMU_DISABLE,
+        /* regular uncompressed frames re-anchor baselines and timestamps */
+        .comp_nc_flow_cfg     = compression ? FIFO_CONFIG4_FIFO_COMP_NC_FLOW_CFG_EVERY_16_FR
+                                            : FIFO_CONFIG4_FIFO_COMP_NC_FLOW_CFG_DIS,
+        .gyro_dec             = ODR_DECIMATE_CONFIG_GYRO_FIFO_ODR_DEC_1,
+        .accel_dec            = ODR_DECIMATE_CONFIG_ACCEL_FIFO_ODR_DEC_1
+    };
+
+    if (!dev->fifo_buf) {
+        dev->fifo_buf = (uint8_t *)heap_caps_malloc(FIFO_READ_MAX_BYTES, MALLOC_CAP_8BIT);
+        if (!dev->fifo_buf) return -1;
+    }
+
+    rc |= inv_imu_adv_set_fifo_config(&dev->icm_driver, &fifo_config);
+    rc |= inv_imu_adv_reset_fifo(&dev->icm_driver);
+    if (rc != 0) return rc;
+
+    dev->fifo_hires = hires;
+    dev->fifo_tmst_resol_us = inv_imu_adv_get_timestamp_resolution_us(&dev->icm_driver);
+    if (dev->fifo_tmst_resol_us == 0) dev->fifo_tmst_resol_us = 1;
+    dev->fifo_period_us = 1000000UL / odr_hz;
+    dev->fifo_ts_valid = false;
+    dev->fifo_time_us = 0;
+
+    if (int_gpio >= 0) {
+        if (setup_int1_gpio(int_gpio, isr, isr_arg) != 0) return -1;
+
+        memset(&it_conf, INV_IMU_DISABLE, sizeof(it_conf));
+        it_conf.INV_FIFO_THS = INV_IMU_ENABLE;
+        rc |= inv_imu_set_config_int(&dev->icm_driver, INV_IMU_INT1, &it_conf);
+        rc |= inv_imu_set_pin_config_int(&dev->icm_driver, INV_IMU_INT1, &(inv_imu_int_pin_config_t){
+            .int_polarity = INTX_CONFIG2_INTX_POLARITY_HIGH,
+            .int_mode = INTX_CONFIG2_INTX_MODE_PULSE,
+            .int_drive = INTX_CONFIG2_INTX_DRIVE_PP
+        });
+    }
+
+    return rc;
+}
+
+int icm456xx_read_fifo_stream(icm456xx_dev_t *dev, icm456xx_fifo_cb_t cb, void *ctx)
+{
+    if (!dev || !dev->fifo_buf || !cb) return -1;
+    const inv_imu_adv_var_t *e = (const inv_imu_adv_var_t *)dev->icm_driver.adv_var;
+    const uint8_t frame_size = dev->icm_driver.fifo_frame_size;
+    uint16_t frame_count = 0;
+
+    int rc = inv_imu_get_frame_count(&dev->icm_driver, &frame_count);
+    if (rc != 0) return rc;
+
+    /* AN-000364: in stream mode only the first M-1 frames may be read */
+    if (frame_count > 0) frame_count--;
+    if (frame_count > FIFO_READ_MAX_BYTES / frame_size) frame_count = FIFO_READ_MAX_BYTES / frame_size;
+    if (frame_count == 0) return 0;
+
+    /* one burst for the whole batch */
+    rc = inv_imu_read_reg(&dev->icm_driver, FIFO_DATA, frame_count * frame_size, dev->fifo_buf);
+    if (rc != 0) return rc;
+
+    dev->fifo_cb = cb;
+    dev->fifo_cb_ctx = ctx;
+    for (uint16_t i = 0; i < frame_count; i++) {
+        const uint8_t *frame = &dev->fifo_buf[i * frame_size];
+        const fifo_header_t *header = (const fifo_header_t *)frame;
+
+        /* compressed frames (ext_header set) carry no timestamp, uncompressed
+           ones do when both accel and gyro are present */
+        if (e->fifo_comp_en) {
+            dev->fifo_frame_has_ts = !header->bits.ext_header &&
+                                     header->bits.accel_bit && header->bits.gyro_bit;
+        } else {
+            dev->fifo_frame_has_ts = header->bits.timestamp_bit;
+        }
+        rc |= inv_imu_adv_parse_fifo_data(&dev->icm_driver, frame, 1);
+    }
+    dev->fifo_cb = NULL;
+    dev->fifo_cb_ctx = NULL;
+
+    return (rc != 0) ? rc : frame_count;
+}
+
+int icm456xx_stop_fifo_stream(icm456xx_dev_t *dev, int int_gpio)
+{
+    if (!dev) return -1;
+    inv_imu_int_state_t it_conf;
+
+    if (int_gpio >= 0) gpio_isr_handler_remove(int_gpio);
+    memset(&it_conf, INV_IMU_DISABLE, sizeof(it_conf));
+    int rc = inv_imu_set_config_int(&dev->icm_driver, INV_IMU_INT1, &it_conf);
+
+    if (dev->fifo_buf) {
+        heap_caps_free(dev->fifo_buf);
+        dev->fifo_buf = NULL;
+    }
+    return rc;
+}
+
+int icm456xx_get_fifo_frame_size(icm456xx_dev_t *dev)
+{
+    if (!dev || !dev->fifo_buf) return 0;
+    return dev->icm_driver.fifo_frame_size;
+}
+
 /* APEX/GAF wrappers (partial port of original logic) */
 #if defined(ICM45686S) || defined(ICM45605S)
 int icm456xx_start_gaf(icm456xx_dev_t *dev, int int_gpio, void (*user_isr)(void*))
@@ -358,7 +542,7 @@ int icm456xx_start_gaf(icm456xx_dev_t *dev, int int_gpio, void (*user_isr)(void*
             .accel_en   = INV_IMU_DISABLE,
             .hires_en   = INV_IMU_DISABLE,
             .fifo_wm_th = 4,
-            .fifo_mode = FIFO_CONFIG0_FIFO_MODE_SNAPSHOT,
+            .fifo_mode = FIFO_CONFIG0_FIFO_MODE_STREAM,
             .fifo_depth = FIFO_CONFIG0_FIFO_DEPTH_GAF,
         },
         .fifo_wr_wm_gt_th     = FIFO_CONFIG2_FIFO_WR_WM_EQ_OR_GT_TH,
@@ -375,32 +559,40 @@ int icm456xx_start_gaf(icm456xx_dev_t *dev, int int_gpio, void (*user_isr)(void*
     icm456xx_stop_accel(dev);
     icm456xx_stop_gyro(dev);
 
+    /* inv_imu_adv_get_data_from_fifo() may return the whole FIFO */
+    if (dev->fifo_buf) heap_caps_free(dev->fifo_buf);
+    dev->fifo_buf = (uint8_t *)heap_caps_malloc(FIFO_MIRRORING_SIZE, MALLOC_CAP_8BIT);
+    if (!dev->fifo_buf) return -1;
+
     rc |= inv_imu_edmp_set_frequency(&dev->icm_driver, DMP_EXT_SEN_ODR_CFG_APEX_ODR_100_HZ);
     rc |= inv_imu_edmp_gaf_init(&dev->icm_driver);
 
     rc |= inv_imu_edmp_gaf_init_parameters(&dev->icm_driver, &gaf_params);
-    gaf_params.pdr_us = 10000;
+    gaf_params.pdr_us = 1000000UL / ICM456XX_GAF_ODR_HZ;
     rc |= inv_imu_edmp_gaf_set_parameters(&dev->icm_driver, &gaf_params);
     if (rc != 0) return rc;
 
-    rc |= icm456xx_start_accel(dev, 100, 16);
-    rc |= icm456xx_start_gyro(dev, 100, 2000);
+    rc |= icm456xx_start_accel(dev, ICM456XX_GAF_ODR_HZ, 16);
+    rc |= icm456xx_start_gyro(dev, ICM456XX_GAF_ODR_HZ, 2000);
     transport_sleep_us(GYR_STARTUP_TIME_US);
 
     rc |= inv_imu_adv_set_fifo_config(&dev->icm_driver, &fifo_config);
-    /* configure int gpio similarly to start_gaf expectations */
-    /* add user gpio isr */
-    gpio_config_t io_conf = {
-        .intr_type = GPIO_INTR_POSEDGE,
-        .mode = GPIO_MODE_INPUT,
-        .pin_bit_mask = 1ULL << int_gpio,
-        .pull_up_en = GPIO_PULLUP_ENABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-    };
-    gpio_config(&io_conf);
-    static bool isr_service_installed = false;
-    if (!isr_service_installed) { gpio_install_isr_service(0); isr_service_installed = true; }
-    gpio_isr_handler_add(int_gpio, (gpio_isr_t)user_isr, NULL);
+    rc |= inv_imu_adv_reset_fifo(&dev->icm_driver);
+
+    /* optional FIFO threshold interrupt, as for the FIFO stream */
+    if (int_gpio >= 0 && user_isr) {
+        inv_imu_int_state_t it_conf;
+
+        if (setup_int1_gpio(int_gpio, user_isr, NULL) != 0) return -1;
+        memset(&it_conf, INV_IMU_DISABLE, sizeof(it_conf));
+        it_conf.INV_FIFO_THS = INV_IMU_ENABLE;
+        rc |= inv_imu_set_config_int(&dev->icm_driver, INV_IMU_INT1, &it_conf);
+        rc |= inv_imu_set_pin_config_int(&dev->icm_driver, INV_IMU_INT1, &(inv_imu_int_pin_config_t){
+            .int_polarity = INTX_CONFIG2_INTX_POLARITY_HIGH,
+            .int_mode = INTX_CONFIG2_INTX_MODE_PULSE,
+            .int_drive = INTX_CONFIG2_INTX_DRIVE_PP
+        });
+    }
 
     rc |= inv_imu_edmp_gaf_enable(&dev->icm_driver);
     rc |= inv_imu_edmp_enable(&dev->icm_driver);
@@ -428,6 +620,45 @@ int icm456xx_get_gaf_data(icm456xx_dev_t *dev, inv_imu_edmp_gaf_outputs_t *out)
     }
 }
 
+int icm456xx_read_gaf_stream(icm456xx_dev_t *dev, icm456xx_gaf_cb_t cb, void *ctx)
+{
+    if (!dev || !dev->fifo_buf || !cb) return -1;
+    uint16_t fifo_count = 0;
+
+    /* one burst for everything in the FIFO, decoded through fifo_sensor_event_cb */
+    int rc = inv_imu_adv_get_data_from_fifo(&dev->icm_driver, dev->fifo_buf, &fifo_count);
+    if (rc != 0) return rc;
+    if (fifo_count == 0) return 0;
+
+    dev->gaf_cb = cb;
+    dev->gaf_cb_ctx = ctx;
+    rc = inv_imu_adv_parse_fifo_data(&dev->icm_driver, dev->fifo_buf, fifo_count);
+    dev->gaf_cb = NULL;
+    dev->gaf_cb_ctx = NULL;
+
+    return (rc != 0) ? rc : fifo_count;
+}
+
+int icm456xx_stop_gaf(icm456xx_dev_t *dev, int int_gpio)
+{
+    if (!dev) return -1;
+    inv_imu_int_state_t it_conf;
+    int rc = 0;
+
+    if (int_gpio >= 0) gpio_isr_handler_remove(int_gpio);
+    memset(&it_conf, INV_IMU_DISABLE, sizeof(it_conf));
+    rc |= inv_imu_set_config_int(&dev->icm_driver, INV_IMU_INT1, &it_conf);
+    rc |= inv_imu_edmp_gaf_disable(&dev->icm_driver);
+    rc |= inv_imu_edmp_disable(&dev->icm_driver);
+    dev->gaf_status = 0;
+
+    if (dev->fifo_buf) {
+        heap_caps_free(dev->fifo_buf);
+        dev->fifo_buf = NULL;
+    }
+    return rc;
+}
+
 int icm456xx_get_gaf_quat(icm456xx_dev_t *dev, float *w, float *x, float *y, float *z)
 {
     if (!dev || !w || !x || !y || !z) return -1;
@@ -717,6 +948,10 @@ int icm456xx_deinit(icm456xx_dev_t *dev)
         spi_bus_remove_device(dev->spi_handle);
         dev->spi_handle = NULL;
     }
+    if (dev->fifo_buf) {
+        heap_caps_free(dev->fifo_buf);
+        dev->fifo_buf = NULL;
+    }
     if (icm_dev_ptr == dev) icm_dev_ptr = NULL;
     return 0;
 }
@@ -1,18 +1,53 @@
 #include "iis2mdc.h"
 #include "esp_log.h"
 #include "esp_check.h"
+#include "driver/gpio.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
 
 static const char *TAG = "IIS2MDC";
 
+// I2C master ISR: one call per finished transfer in asynchronous mode
+static bool IRAM_ATTR iis2mdc_trans_done_cb(i2c_master_dev_handle_t dev, const i2c_master_event_data_t *evt, void *arg) {
+    iis2mdc_handle_t *sensor = (iis2mdc_handle_t *)arg;
+    BaseType_t woken = pdFALSE;
+
+    sensor->xfer_err = (evt->event == I2C_EVENT_DONE) ? ESP_OK : ESP_FAIL;
+    sensor->done_us = esp_timer_get_time();
+    xSemaphoreGiveFromISR(sensor->done_sem, &woken);
+    return woken == pdTRUE;
+}
+
+// Asynchronous transfers return once queued: block until the callback reports back
+static esp_err_t iis2mdc_wait_done(iis2mdc_handle_t *sensor, esp_err_t ret) {
+    if (ret != ESP_OK || sensor->done_sem == NULL) {
+        return ret;
+    }
+    // +1 tick: a 10 ms timeout must not expire at the very next tick boundary
+    if (xSemaphoreTake(sensor->done_sem, pdMS_TO_TICKS(IIS2MDC_I2C_TIMEOUT_MS) + 1) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    return sensor->xfer_err;
+}
+
+// Drops a completion left over from a transfer that timed out earlier
+static void iis2mdc_clear_done(iis2mdc_handle_t *sensor) {
+    if (sensor->done_sem != NULL) {
+        xSemaphoreTake(sensor->done_sem, 0);
+    }
+}
+
 static esp_err_t iis2mdc_write_reg(iis2mdc_handle_t *sensor, uint8_t reg, uint8_t data) {
     uint8_t buf[2] = { reg, data };
-    return i2c_master_transmit(sensor->dev_handle, buf, 2, -1);
+    iis2mdc_clear_done(sensor);
+    return iis2mdc_wait_done(sensor, i2c_master_transmit(sensor->dev_handle, buf, 2, IIS2MDC_I2C_TIMEOUT_MS));
 }
 
 static esp_err_t iis2mdc_read_reg(iis2mdc_handle_t *sensor, uint8_t reg, uint8_t *data, size_t len) {
-    esp_err_t ret = i2c_master_transmit(sensor->dev_handle, &reg, 1, -1);
-    if (ret != ESP_OK) return ret;
-    return i2c_master_receive(sensor->dev_handle, data, len, -1);
+    // Repeated start: register address and data in a single bus transaction
+    iis2mdc_clear_done(sensor);
+    return iis2mdc_wait_done(sensor,
+        i2c_master_transmit_receive(sensor->dev_handle, &reg, 1, data, len, IIS2MDC_I2C_TIMEOUT_MS));
 }
 
 esp_err_t iis2mdc_init(iis2mdc_handle_t *sensor, i2c_port_t port, gpio_num_t sda, gpio_num_t scl, uint32_t clk_speed_hz) {
@@ -22,9 +57,14 @@ esp_err_t iis2mdc_init(iis2mdc_handle_t *sensor, i2c_port_t port, gpio_num_t sda
         .scl_io_num = scl,
         .clk_source = I2C_CLK_SRC_DEFAULT,
         .glitch_ignore_cnt = 7,
+        .trans_queue_depth = IIS2MDC_TRANS_QUEUE_DEPTH,
         .flags.enable_internal_pullup = true
     };
 
+    sensor->drdy_pin = GPIO_NUM_NC;
+    sensor->done_sem = NULL;
+    sensor->burst_pending = false;
+
     ESP_RETURN_ON_ERROR(i2c_new_master_bus(&bus_cfg, &sensor->bus_handle), TAG, "Failed to create I2C bus");
 
     i2c_device_config_t dev_cfg = {
@@ -47,9 +87,108 @@ esp_err_t iis2mdc_config(iis2mdc_handle_t *sensor, uint8_t cfg_a, uint8_t cfg_b,
     ESP_RETURN_ON_ERROR(iis2mdc_write_reg(sensor, IIS2MDC_REG_CFG_REG_A, cfg_a), TAG, "Write CFG_REG_A failed");
     ESP_RETURN_ON_ERROR(iis2mdc_write_reg(sensor, IIS2MDC_REG_CFG_REG_B, cfg_b), TAG, "Write CFG_REG_B failed");
     ESP_RETURN_ON_ERROR(iis2mdc_write_reg(sensor, IIS2MDC_REG_CFG_REG_C, cfg_c), TAG, "Write CFG_REG_C failed");
+    sensor->cfg_c = cfg_c;
+    return ESP_OK;
+}
+
+esp_err_t iis2mdc_enable_drdy_pin(iis2mdc_handle_t *sensor, gpio_num_t pin) {
+    if (pin == GPIO_NUM_NC) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    gpio_config_t io_conf = {
+        .intr_type = GPIO_INTR_DISABLE,
+        .mode = GPIO_MODE_INPUT,
+        .pin_bit_mask = 1ULL << pin,
+        .pull_down_en = GPIO_PULLDOWN_ENABLE,
+        .pull_up_en = GPIO_PULLUP_DISABLE
+    };
+    ESP_RETURN_ON_ERROR(gpio_config(&io_conf), TAG, "DRDY GPIO config failed");
+
+    uint8_t cfg_c = sensor->cfg_c | IIS2MDC_CFG_C_DRDY_ON_PIN;
+    ESP_RETURN_ON_ERROR(iis2mdc_write_reg(sensor, IIS2MDC_REG_CFG_REG_C, cfg_c), TAG, "Write CFG_REG_C failed");
+    sensor->cfg_c = cfg_c;
+    sensor->drdy_pin = pin;
     return ESP_OK;
 }
 
+esp_err_t iis2mdc_enable_async(iis2mdc_handle_t *sensor) {
+    if (sensor->done_sem != NULL) {
+        return ESP_OK;
+    }
+
+    sensor->done_sem = xSemaphoreCreateBinary();
+    if (sensor->done_sem == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    i2c_master_event_callbacks_t cbs = {
+        .on_trans_done = iis2mdc_trans_done_cb,
+    };
+    esp_err_t ret = i2c_master_register_event_callbacks(sensor->dev_handle, &cbs, sensor);
+    if (ret != ESP_OK) {
+        vSemaphoreDelete(sensor->done_sem);
+        sensor->done_sem = NULL;
+    }
+    return ret;
+}
+
+esp_err_t iis2mdc_read_sample_start(iis2mdc_handle_t *sensor) {
+    sensor->burst_pending = false;
+
+    // DRDY low: nothing new, skip the bus entirely
+    if (sensor->drdy_pin != GPIO_NUM_NC && gpio_get_level(sensor->drdy_pin) == 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // STATUS (0x67) is directly followed by OUTX_L..TEMP_OUT_H: 9 bytes, auto-increment.
+    // The buffers live in the handle because an asynchronous burst outlives this call.
+    iis2mdc_clear_done(sensor);
+    sensor->burst_reg = IIS2MDC_REG_STATUS;
+    sensor->start_us = esp_timer_get_time();
+    ESP_RETURN_ON_ERROR(i2c_master_transmit_receive(sensor->dev_handle, &sensor->burst_reg, 1,
+                                                    sensor->burst_buf, sizeof(sensor->burst_buf),
+                                                    IIS2MDC_I2C_TIMEOUT_MS),
+                        TAG, "Failed to read sample");
+    if (sensor->done_sem == NULL) {
+        sensor->done_us = esp_timer_get_time();
+    }
+    sensor->burst_pending = true;
+    return ESP_OK;
+}
+
+esp_err_t iis2mdc_read_sample_finish(iis2mdc_handle_t *sensor, iis2mdc_raw_sample_t *sample) {
+    if (!sensor->burst_pending) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    sensor->burst_pending = false;
+    ESP_RETURN_ON_ERROR(iis2mdc_wait_done(sensor, ESP_OK), TAG, "Failed to read sample");
+
+    const uint8_t *buf = sensor->burst_buf;
+    sample->status = buf[0];
+    if (!(buf[0] & IIS2MDC_STATUS_ZYXDA)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    sample->mag.x = (int16_t)((buf[2] << 8) | buf[1]);
+    sample->mag.y = (int16_t)((buf[4] << 8) | buf[3]);
+    sample->mag.z = (int16_t)((buf[6] << 8) | buf[5]);
+    sample->temperature = (int16_t)((buf[8] << 8) | buf[7]);
+    return ESP_OK;
+}
+
+esp_err_t iis2mdc_read_sample_raw(iis2mdc_handle_t *sensor, iis2mdc_raw_sample_t *sample) {
+    esp_err_t ret = iis2mdc_read_sample_start(sensor);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return iis2mdc_read_sample_finish(sensor, sample);
+}
+
+uint32_t iis2mdc_get_burst_time_us(const iis2mdc_handle_t *sensor) {
+    return (sensor->done_us > sensor->start_us) ? (uint32_t)(sensor->done_us - sensor->start_us) : 0;
+}
+
 esp_err_t iis2mdc_read_magnetic_raw(iis2mdc_handle_t *sensor, iis2mdc_raw_magnetometer_t *mag) {
     uint8_t buf[6];
     ESP_RETURN_ON_ERROR(iis2mdc_read_reg(sensor, IIS2MDC_REG_OUTX_L, buf, 6), TAG, "Failed to read mag data");
@@ -63,7 +202,7 @@ esp_err_t iis2mdc_read_magnetic_raw(iis2mdc_handle_t *sensor, iis2mdc_raw_magnet
 esp_err_t iis2mdc_convert_magnetic_raw_to_mg(iis2mdc_raw_magnetometer_t *raw, float *x_mg, float *y_mg, float *z_mg) {
 
     // Conversion factor for IIS2MDC is 1.5 mG/LSB
-    const float conversion_factor = 1.5f;
+    const float conversion_factor = IIS2MDC_UGAUSS_PER_LSB / 1000.0f;
     *x_mg = (float)(raw->x) * conversion_factor;
     *y_mg = (float)(raw->y) * conversion_factor;   
     *z_mg = (float)(raw->z) * conversion_factor;
@@ -80,6 +219,21 @@ esp_err_t iis2mdc_read_temperature_raw(iis2mdc_handle_t *sensor, int16_t *temp)
 
 esp_err_t iis2mdc_convert_temperature_raw_to_celsius(int16_t raw_temp, float *temp_celsius) {
     // Conversion formula: Temp (C) = (Raw Temp / 8) + 25
-    *temp_celsius = ((float)raw_temp / 8.0f) + 25.0f;
+    // (multiplying by 0.125 is exact and avoids a soft-float division)
+    *temp_celsius = ((float)raw_temp * 0.125f) + 25.0f;
+    return ESP_OK;
+}
+
+esp_err_t iis2mdc_convert_magnetic_raw_to_ugauss(const iis2mdc_raw_magnetometer_t *raw,
+                                                 int32_t *x_ugauss, int32_t *y_ugauss, int32_t *z_ugauss) {
+    *x_ugauss = (int32_t)raw->x * IIS2MDC_UGAUSS_PER_LSB;
+    *y_ugauss = (int32_t)raw->y * IIS2MDC_UGAUSS_PER_LSB;
+    *z_ugauss = (int32_t)raw->z * IIS2MDC_UGAUSS_PER_LSB;
+    return ESP_OK;
+}
+
+esp_err_t iis2mdc_convert_temperature_raw_to_mc(int16_t raw_temp, int32_t *temp_mc) {
+    // 8 LSB/degC: 125 mdegC per LSB
+    *temp_mc = (int32_t)raw_temp * 125 + 25000;
     return ESP_OK;
 }
\ No newline at end of file
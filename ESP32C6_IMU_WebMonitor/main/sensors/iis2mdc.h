@@ -3,7 +3,10 @@
 
 #include "driver/i2c_master.h"
 #include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include <stdint.h>
+#include <stdbool.h>
 
 #define IIS2MDC_I2C_ADDR         0x1E  // 0011110b
 #define IIS2MDC_WHO_AM_I_VAL     0x40
@@ -23,24 +26,74 @@
 #define IIS2MDC_REG_TEMP_OUT_L   0x6E
 #define IIS2MDC_REG_TEMP_OUT_H   0x6F
 
+// STATUS_REG bits
+#define IIS2MDC_STATUS_ZYXDA     0x08  // New X, Y and Z data available
+
+// CFG_REG_C bits
+#define IIS2MDC_CFG_C_DRDY_ON_PIN 0x01
+#define IIS2MDC_CFG_C_BDU        0x10
+
+// Upper bound for one register access; the bus never blocks the caller forever
+#define IIS2MDC_I2C_TIMEOUT_MS   10
+// Transfers the bus can hold in flight once asynchronous mode is enabled
+#define IIS2MDC_TRANS_QUEUE_DEPTH 4
+
+// Sensitivity: 1.5 mG/LSB
+#define IIS2MDC_UGAUSS_PER_LSB   1500
+
 typedef struct {
     int16_t x;
     int16_t y;
     int16_t z;
 } iis2mdc_raw_magnetometer_t;
 
+// STATUS + OUTX_L..TEMP_OUT_H, read in one repeated-start burst
+typedef struct {
+    uint8_t status;
+    iis2mdc_raw_magnetometer_t mag;
+    int16_t temperature;
+} iis2mdc_raw_sample_t;
+
 typedef struct {
     i2c_master_bus_handle_t bus_handle;
     i2c_master_dev_handle_t dev_handle;
+    uint8_t cfg_c;
+    gpio_num_t drdy_pin;        // GPIO_NUM_NC: new data is detected from STATUS.Zyxda
+    // Split sample read (start/finish); asynchronous once done_sem exists
+    SemaphoreHandle_t done_sem;
+    volatile esp_err_t xfer_err;
+    volatile int64_t done_us;
+    int64_t start_us;
+    bool burst_pending;
+    uint8_t burst_reg;
+    uint8_t burst_buf[9];
 } iis2mdc_handle_t;
 
 // API
 esp_err_t iis2mdc_init(iis2mdc_handle_t *sensor, i2c_port_t port, gpio_num_t sda, gpio_num_t scl, uint32_t clk_speed_hz);
 esp_err_t iis2mdc_read_who_am_i(iis2mdc_handle_t *sensor, uint8_t *id);
 esp_err_t iis2mdc_config(iis2mdc_handle_t *sensor, uint8_t cfg_a, uint8_t cfg_b, uint8_t cfg_c);
+// Reads STATUS and all outputs in one transfer. Returns ESP_ERR_NOT_FOUND without
+// touching the outputs when no new sample is available (DRDY low or Zyxda clear).
+esp_err_t iis2mdc_read_sample_raw(iis2mdc_handle_t *sensor, iis2mdc_raw_sample_t *sample);
+// Split form of iis2mdc_read_sample_raw(). In asynchronous mode start returns as
+// soon as the burst is queued and finish waits for it, so other buses can work
+// in between; otherwise start completes the transfer and finish only decodes.
+esp_err_t iis2mdc_read_sample_start(iis2mdc_handle_t *sensor);
+esp_err_t iis2mdc_read_sample_finish(iis2mdc_handle_t *sensor, iis2mdc_raw_sample_t *sample);
+// Duration of the last burst, issue to completion
+uint32_t iis2mdc_get_burst_time_us(const iis2mdc_handle_t *sensor);
+// Switches the device to the I2C master's callback mode (all later transfers are queued)
+esp_err_t iis2mdc_enable_async(iis2mdc_handle_t *sensor);
+// Routes DRDY to the INT/DRDY pin and gates reads on its level (no bus access while low)
+esp_err_t iis2mdc_enable_drdy_pin(iis2mdc_handle_t *sensor, gpio_num_t pin);
 esp_err_t iis2mdc_read_magnetic_raw(iis2mdc_handle_t *sensor, iis2mdc_raw_magnetometer_t *mag);
 esp_err_t iis2mdc_convert_magnetic_raw_to_mg(iis2mdc_raw_magnetometer_t *raw, float *x_mg, float *y_mg, float *z_mg);
 esp_err_t iis2mdc_read_temperature_raw(iis2mdc_handle_t *sensor, int16_t *temp);
 esp_err_t iis2mdc_convert_temperature_raw_to_celsius(int16_t raw_temp, float *temp_celsius);
+// Integer-only conversions: micro-gauss (1500 per LSB) and milli-degrees Celsius
+esp_err_t iis2mdc_convert_magnetic_raw_to_ugauss(const iis2mdc_raw_magnetometer_t *raw,
+                                                 int32_t *x_ugauss, int32_t *y_ugauss, int32_t *z_ugauss);
+esp_err_t iis2mdc_convert_temperature_raw_to_mc(int16_t raw_temp, int32_t *temp_mc);
 
 #endif // IIS2MDC_H
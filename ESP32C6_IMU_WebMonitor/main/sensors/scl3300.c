@@ -38,6 +38,18 @@ static uint8_t scl3300_calculate_crc(uint32_t data)
     crc = (uint8_t)~crc;  // invert result
     return crc;
 }
+// --- Split a response frame and check its CRC / return status ---
+static void scl3300_decode_frame(scl3300_t *dev, uint32_t val)
+{
+    dev->last_cmd  = (val >> 24) & 0xFF;
+    dev->last_data = (val >> 8)  & 0xFFFF;
+    dev->last_crc  = val & 0xFF;
+
+    uint8_t calc_crc = scl3300_calculate_crc(val);
+    dev->crcerr = (dev->last_crc != calc_crc);
+    dev->statuserr= ((dev->last_cmd & 0x03) != 0x03);
+}
+
 // --- SPI transfer (32-bit command) ---
 static esp_err_t scl3300_transfer(scl3300_t *dev, uint32_t cmd, uint32_t *resp)
 {
@@ -56,14 +68,7 @@ static esp_err_t scl3300_transfer(scl3300_t *dev, uint32_t cmd, uint32_t *resp)
     uint32_t val = __builtin_bswap32(rx);  // đảo lại thành host order
     if (resp) *resp = val;
 
-    dev->last_cmd  = (val >> 24) & 0xFF;
-    dev->last_data = (val >> 8)  & 0xFFFF;
-    dev->last_crc  = val & 0xFF;
-
-    uint8_t calc_crc = scl3300_calculate_crc(val);
-    dev->crcerr = (dev->last_crc != calc_crc);
-    dev->statuserr= ((dev->last_cmd & 0x03) != 0x03);
-
+    scl3300_decode_frame(dev, val);
     return ESP_OK;
 }
 
@@ -90,6 +95,82 @@ esp_err_t scl3300_read_reg(scl3300_t *dev, uint32_t cmd, int16_t *out)
     return ESP_OK;
 }
 
+// --- Pipelined read ---
+// SCL3300 answers each frame with the result of the previous command, so
+// cmds[0..count-1] followed by one NOP return all registers in count + 1
+// frames. The frames are queued as one batch; CS is released between them,
+// and the driver's turnaround between queued transactions provides the
+// CSB-high gap the device needs.
+void scl3300_prepare_regs(const uint32_t *cmds, size_t count, spi_transaction_t *t)
+{
+    const size_t frames = count + 1;
+
+    memset(t, 0, sizeof(t[0]) * frames);
+    for (size_t i = 0; i < frames; i++) {
+        uint32_t cmd = (i < count) ? cmds[i] : SCL3300_NOP;
+        t[i].length = 32;
+        t[i].flags = SPI_TRANS_USE_TXDATA | SPI_TRANS_USE_RXDATA;
+        t[i].tx_data[0] = (cmd >> 24) & 0xFF;  // MSB first
+        t[i].tx_data[1] = (cmd >> 16) & 0xFF;
+        t[i].tx_data[2] = (cmd >> 8) & 0xFF;
+        t[i].tx_data[3] = cmd & 0xFF;
+    }
+}
+
+esp_err_t scl3300_parse_regs(scl3300_t *dev, const uint32_t *cmds, const spi_transaction_t *t,
+                             int16_t *out, size_t count)
+{
+    // Frame i + 1 carries the answer to cmds[i]; the answer in frame 0
+    // belongs to whatever was sent before and is ignored
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t *rx = t[i + 1].rx_data;
+        uint32_t val = ((uint32_t)rx[0] << 24) | ((uint32_t)rx[1] << 16) |
+                       ((uint32_t)rx[2] << 8) | rx[3];
+
+        scl3300_decode_frame(dev, val);
+        if (dev->crcerr) {
+            ESP_LOGE(TAG, "CRC error on reg 0x%08" PRIX32, cmds[i]);
+            return ESP_FAIL;
+        }
+        if (dev->statuserr) {
+            ESP_LOGE(TAG, "Status error on reg 0x%08" PRIX32, cmds[i]);
+            return ESP_FAIL;
+        }
+        out[i] = (int16_t)dev->last_data;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t scl3300_read_regs(scl3300_t *dev, const uint32_t *cmds, int16_t *out, size_t count)
+{
+    if (!dev || !cmds || !out || count == 0 || count > SCL3300_PIPELINE_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    spi_transaction_t t[SCL3300_PIPELINE_MAX + 1];
+    const size_t frames = count + 1;
+    size_t queued = 0;
+    esp_err_t ret = ESP_OK;
+
+    scl3300_prepare_regs(cmds, count, t);
+
+    for (; queued < frames; queued++) {
+        ret = spi_device_queue_trans(dev->spi, &t[queued], portMAX_DELAY);
+        if (ret != ESP_OK) break;
+    }
+
+    // Collect everything that was queued, even after a queueing error
+    for (size_t i = 0; i < queued; i++) {
+        spi_transaction_t *done;
+        esp_err_t r = spi_device_get_trans_result(dev->spi, &done, portMAX_DELAY);
+        if (r != ESP_OK && ret == ESP_OK) ret = r;
+    }
+    ESP_RETURN_ON_ERROR(ret, TAG, "pipelined transfer failed");
+
+    return scl3300_parse_regs(dev, cmds, t, out, count);
+}
+
 
 esp_err_t scl3300_init(spi_host_device_t host, gpio_num_t cs_pin, scl3300_t *dev)
 {
@@ -102,7 +183,7 @@ esp_err_t scl3300_init(spi_host_device_t host, gpio_num_t cs_pin, scl3300_t *dev
         .clock_speed_hz = 4 * 1000 * 1000, // 4 MHz
         .mode           = 0,
         .spics_io_num   = cs_pin,
-        .queue_size     = 1,
+        .queue_size     = SCL3300_PIPELINE_MAX + 1,   // one pipelined read in flight
     };
     ESP_ERROR_CHECK(spi_bus_add_device(host, &devcfg, &dev->spi));
 
@@ -159,7 +240,16 @@ esp_err_t scl3300_init(spi_host_device_t host, gpio_num_t cs_pin, scl3300_t *dev
 
 esp_err_t scl3300_set_mode(scl3300_t *dev, uint8_t mode) {
     if (mode < 1 || mode > 4) return ESP_ERR_INVALID_ARG;
+    // Cache the sensitivity so the accel getters need no per-read mode switch
+    static const uint16_t ug_per_3lsb[5] = {
+        0,
+        3000000 / SCL3300_MODE1_LSB_PER_G,
+        3000000 / SCL3300_MODE2_LSB_PER_G,
+        3000000 / SCL3300_MODE34_LSB_PER_G,
+        3000000 / SCL3300_MODE34_LSB_PER_G,
+    };
     dev->mode = mode;
+    dev->accel_ug_per_3lsb = ug_per_3lsb[mode];
     uint32_t resp;
     uint32_t cmd[5] = {0, ChgMode1, ChgMode2, ChgMode3, ChgMode4};
     return scl3300_transfer(dev, cmd[mode], &resp);
@@ -171,15 +261,38 @@ bool scl3300_is_connected(scl3300_t *dev) {
     return (dev->last_data == 0x00C1 && !dev->crcerr && !dev->statuserr);
 }
 
+// 8 frames instead of 14 with one command + NOP per register
+static const uint32_t available_cmds[SCL3300_AVAILABLE_FRAMES - 1] = {
+    RdAccX, RdAccY, RdAccZ, RdTemp, RdAngX, RdAngY, RdAngZ
+};
+
+static void scl3300_store_data(scl3300_t *dev, const int16_t *val) {
+    dev->data.AccX = val[0];
+    dev->data.AccY = val[1];
+    dev->data.AccZ = val[2];
+    dev->data.TEMP = val[3];
+    dev->data.AngX = val[4];
+    dev->data.AngY = val[5];
+    dev->data.AngZ = val[6];
+}
+
 esp_err_t scl3300_available(scl3300_t *dev) {
-    if (scl3300_read_reg(dev, RdAccX, &dev->data.AccX) != ESP_OK) return ESP_FAIL;
-    if (scl3300_read_reg(dev, RdAccY, &dev->data.AccY) != ESP_OK) return ESP_FAIL;
-    if (scl3300_read_reg(dev, RdAccZ, &dev->data.AccZ) != ESP_OK) return ESP_FAIL;
-    if (scl3300_read_reg(dev, RdTemp, &dev->data.TEMP) != ESP_OK) return ESP_FAIL;
-    if (scl3300_read_reg(dev, RdAngX, &dev->data.AngX) != ESP_OK) return ESP_FAIL;
-    if (scl3300_read_reg(dev, RdAngY, &dev->data.AngY) != ESP_OK) return ESP_FAIL;
-    if (scl3300_read_reg(dev, RdAngZ, &dev->data.AngZ) != ESP_OK) return ESP_FAIL;
+    int16_t val[SCL3300_AVAILABLE_FRAMES - 1];
+
+    if (scl3300_read_regs(dev, available_cmds, val, SCL3300_AVAILABLE_FRAMES - 1) != ESP_OK) return ESP_FAIL;
+    scl3300_store_data(dev, val);
+    return ESP_OK;
+}
 
+void scl3300_prepare_available(spi_transaction_t *t) {
+    scl3300_prepare_regs(available_cmds, SCL3300_AVAILABLE_FRAMES - 1, t);
+}
+
+esp_err_t scl3300_parse_available(scl3300_t *dev, const spi_transaction_t *t) {
+    int16_t val[SCL3300_AVAILABLE_FRAMES - 1];
+
+    if (scl3300_parse_regs(dev, available_cmds, t, val, SCL3300_AVAILABLE_FRAMES - 1) != ESP_OK) return ESP_FAIL;
+    scl3300_store_data(dev, val);
     return ESP_OK;
 }
 
@@ -205,30 +318,31 @@ uint16_t scl3300_wakeup(scl3300_t *dev)    { uint32_t r; scl3300_transfer(dev, W
 uint16_t scl3300_reset(scl3300_t *dev)     { uint32_t r; scl3300_transfer(dev, SWreset, &r); vTaskDelay(pdMS_TO_TICKS(2)); return dev->last_data; }
 
 // === Conversion helpers ===
-static double scl3300_angle(int16_t raw) {
-    return (raw / 16384.0) * 90.0;
-}
-static double scl3300_accel(scl3300_t *dev, int16_t raw) {
-    switch (dev->mode) {
-        case 1: return raw / 6000.0;
-        case 2: return raw / 3000.0;
-        case 3: return raw / 12000.0;
-        case 4: return raw / 12000.0;
-        default: return raw / 12000.0;
-    }
+// Rounds num / den to nearest; den > 0
+static int32_t scl3300_div_round(int32_t num, int32_t den) {
+    return (num >= 0) ? (num + den / 2) / den : (num - den / 2) / den;
+}
+// 90 deg = 16384 LSB, so 1 LSB = 5625 / 1024 mdeg exactly
+static int32_t scl3300_angle_mdeg(int16_t raw) {
+    return scl3300_div_round((int32_t)raw * 5625, 1024);
+}
+// |raw| * 1000 fits in 32 bits, the divisor is a constant
+static int32_t scl3300_accel_ug(const scl3300_t *dev, int16_t raw) {
+    return scl3300_div_round((int32_t)raw * dev->accel_ug_per_3lsb, 3);
 }
 
-double scl3300_get_angle_x(scl3300_t *dev) { return scl3300_angle(dev->data.AngX); }
-double scl3300_get_angle_y(scl3300_t *dev) { return scl3300_angle(dev->data.AngY); }
-double scl3300_get_angle_z(scl3300_t *dev) { return scl3300_angle(dev->data.AngZ); }
+int32_t scl3300_get_angle_x_mdeg(const scl3300_t *dev) { return scl3300_angle_mdeg(dev->data.AngX); }
+int32_t scl3300_get_angle_y_mdeg(const scl3300_t *dev) { return scl3300_angle_mdeg(dev->data.AngY); }
+int32_t scl3300_get_angle_z_mdeg(const scl3300_t *dev) { return scl3300_angle_mdeg(dev->data.AngZ); }
 
-double scl3300_get_accel_x(scl3300_t *dev) { return scl3300_accel(dev, dev->data.AccX); }
-double scl3300_get_accel_y(scl3300_t *dev) { return scl3300_accel(dev, dev->data.AccY); }
-double scl3300_get_accel_z(scl3300_t *dev) { return scl3300_accel(dev, dev->data.AccZ); }
+int32_t scl3300_get_accel_x_ug(const scl3300_t *dev) { return scl3300_accel_ug(dev, dev->data.AccX); }
+int32_t scl3300_get_accel_y_ug(const scl3300_t *dev) { return scl3300_accel_ug(dev, dev->data.AccY); }
+int32_t scl3300_get_accel_z_ug(const scl3300_t *dev) { return scl3300_accel_ug(dev, dev->data.AccZ); }
 
-double scl3300_get_temp_c(scl3300_t *dev) {
-    return -273.0 + (dev->data.TEMP / 18.9);
+// T = -273 + TEMP / 18.9 degC
+int32_t scl3300_get_temp_mc(const scl3300_t *dev) {
+    return scl3300_div_round((int32_t)dev->data.TEMP * 10000, 189) - 273000;
 }
-double scl3300_get_temp_f(scl3300_t *dev) {
-    return scl3300_get_temp_c(dev) * 9.0/5.0 + 32.0;
+int32_t scl3300_get_temp_mf(const scl3300_t *dev) {
+    return scl3300_div_round(scl3300_get_temp_mc(dev) * 9, 5) + 32000;
 }
@@ -35,6 +35,16 @@
 
 #define SCL3300_NOP   0x00000000
 
+// Longest pipelined read (registers per batch)
+#define SCL3300_PIPELINE_MAX  8
+// Frames of a scl3300_available() read: 7 registers + trailing NOP
+#define SCL3300_AVAILABLE_FRAMES  8
+
+// Accelerometer sensitivity per mode (LSB/g, datasheet)
+#define SCL3300_MODE1_LSB_PER_G   6000
+#define SCL3300_MODE2_LSB_PER_G   3000
+#define SCL3300_MODE34_LSB_PER_G  12000
+
 // === Data structure for raw readings ===
 typedef struct {
     int16_t AccX;
@@ -54,6 +64,7 @@ typedef struct {
     spi_device_handle_t spi;
     gpio_num_t cs_pin;
     uint8_t mode;       // 1..4
+    uint16_t accel_ug_per_3lsb; // 3 * 10^6 / sensitivity (exact in every mode), set with mode
     bool fast_read;
     bool crcerr;
     bool statuserr;
@@ -67,6 +78,17 @@ typedef struct {
 esp_err_t scl3300_init(spi_host_device_t host, gpio_num_t cs_pin, scl3300_t *dev);
 esp_err_t scl3300_set_mode(scl3300_t *dev, uint8_t mode);
 esp_err_t scl3300_available(scl3300_t *dev);   // read all data
+esp_err_t scl3300_read_reg(scl3300_t *dev, uint32_t cmd, int16_t *out);
+// Pipelined: out[i] = answer to cmds[i], count + 1 SPI frames in one queued batch
+esp_err_t scl3300_read_regs(scl3300_t *dev, const uint32_t *cmds, int16_t *out, size_t count);
+// Split pipelined read for callers that queue the frames themselves:
+// prepare fills count + 1 transactions, parse checks and decodes them once done
+void      scl3300_prepare_regs(const uint32_t *cmds, size_t count, spi_transaction_t *t);
+esp_err_t scl3300_parse_regs(scl3300_t *dev, const uint32_t *cmds, const spi_transaction_t *t,
+                             int16_t *out, size_t count);
+// Same for the full data read (SCL3300_AVAILABLE_FRAMES transactions)
+void      scl3300_prepare_available(spi_transaction_t *t);
+esp_err_t scl3300_parse_available(scl3300_t *dev, const spi_transaction_t *t);
 bool      scl3300_is_connected(scl3300_t *dev);
 
 uint16_t  scl3300_get_errflag1(scl3300_t *dev);
@@ -78,13 +100,15 @@ uint16_t  scl3300_wakeup(scl3300_t *dev);
 uint16_t  scl3300_reset(scl3300_t *dev);
 
 // === Calculated values ===
-double scl3300_get_angle_x(scl3300_t *dev);
-double scl3300_get_angle_y(scl3300_t *dev);
-double scl3300_get_angle_z(scl3300_t *dev);
+// Raw counts of the last read are in dev->data. The getters below scale them
+// with integer arithmetic only (no FPU on the ESP32-C6), rounded to nearest.
+int32_t scl3300_get_angle_x_mdeg(const scl3300_t *dev);    // milli-degrees
+int32_t scl3300_get_angle_y_mdeg(const scl3300_t *dev);
+int32_t scl3300_get_angle_z_mdeg(const scl3300_t *dev);
 
-double scl3300_get_accel_x(scl3300_t *dev);
-double scl3300_get_accel_y(scl3300_t *dev);
-double scl3300_get_accel_z(scl3300_t *dev);
+int32_t scl3300_get_accel_x_ug(const scl3300_t *dev);      // micro-g, mode-aware
+int32_t scl3300_get_accel_y_ug(const scl3300_t *dev);
+int32_t scl3300_get_accel_z_ug(const scl3300_t *dev);
 
-double scl3300_get_temp_c(scl3300_t *dev);
-double scl3300_get_temp_f(scl3300_t *dev);
+int32_t scl3300_get_temp_mc(const scl3300_t *dev);         // milli-degrees Celsius
+int32_t scl3300_get_temp_mf(const scl3300_t *dev);         // milli-degrees Fahrenheit
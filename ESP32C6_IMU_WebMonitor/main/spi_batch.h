@@ -0,0 +1,44 @@
+#ifndef SPI_BATCH_H
+#define SPI_BATCH_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stddef.h>
+#include "driver/spi_master.h"
+
+// Largest batch: one IIS3DWB burst plus the pipelined SCL3300 frames, with headroom
+#define SPI_BATCH_MAX_TRANS     16
+
+// One acquisition cycle worth of SPI transactions on the shared bus.
+// Transactions are queued back to back and collected in a single pass, so the
+// driver chains them from its ISR instead of waking the caller for every frame.
+typedef struct {
+    spi_transaction_t trans[SPI_BATCH_MAX_TRANS];
+    spi_device_handle_t dev[SPI_BATCH_MAX_TRANS];
+    uint32_t count;
+} spi_batch_t;
+
+// Bus occupancy of the batched cycles
+typedef struct {
+    uint32_t cycles;
+    uint32_t transactions;
+    uint32_t errors;
+    uint32_t last_transactions;
+    uint32_t last_busy_us;      // First queue to last result
+    uint32_t avg_busy_us;
+    uint32_t max_busy_us;
+    uint32_t last_wire_us;      // Time the clocked bits alone need at SCLK
+    uint64_t total_busy_us;
+    uint64_t total_wire_us;
+} spi_batch_stats_t;
+
+void spi_batch_begin(spi_batch_t *batch);
+// Reserves count zeroed transactions for dev; NULL if the batch is full
+spi_transaction_t *spi_batch_add(spi_batch_t *batch, spi_device_handle_t dev, size_t count);
+// Runs the batch. Callers serialise bus users themselves (manager SPI lock).
+esp_err_t spi_batch_run(spi_batch_t *batch);
+
+void spi_batch_get_stats(spi_batch_stats_t *stats);
+void spi_batch_reset_stats(void);
+
+#endif // SPI_BATCH_H
@@ -0,0 +1,480 @@
+#include "time_align.h"
+#include "sensor_stream.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <math.h>
+#include <string.h>
+
+static const char *TAG = "TIME_ALIGN";
+
+// Samples kept per stream: p0, p1 <= t < p2, p3 for the cubic case
+#define ALIGN_HISTORY       4
+// Samples copied out of a stream per sensor_stream_read() call
+#define ALIGN_READ_CHUNK    16
+#define ALIGN_MAX_CHANNELS  7
+
+typedef union {
+    imu_mag_sample_t mag;
+    imu_accel_sample_t accel;
+    imu_6axis_sample_t imu;
+    imu_incl_sample_t incl;
+} align_sample_t;
+
+// How one sensor's samples map to interpolation channels and back into a frame
+typedef struct {
+    uint8_t sensor_id;
+    size_t sample_size;
+    uint8_t channels;           // Values unpack() writes, at most ALIGN_MAX_CHANNELS
+    void (*unpack)(const align_sample_t *s, float *v);
+    void (*pack)(const float *v, const align_sample_t *nearest, imu_data_t *frame);
+} align_source_desc_t;
+
+typedef struct {
+    sensor_stream_t *stream;    // NULL while the sensor is disabled
+    uint32_t cursor;
+    align_sample_t hist[ALIGN_HISTORY];
+    uint32_t hist_count;
+    uint8_t stage[ALIGN_READ_CHUNK * sizeof(align_sample_t)];
+    uint32_t stage_len;
+    uint32_t stage_pos;
+} align_source_t;
+
+typedef enum {
+    ALIGN_READY,
+    ALIGN_WAIT,                 // Stream has not reached the frame time yet
+    ALIGN_MISSING,              // Gave up on the stream for this frame
+} align_state_t;
+
+static void mag_unpack(const align_sample_t *s, float *v)
+{
+    v[0] = s->mag.x_mg;
+    v[1] = s->mag.y_mg;
+    v[2] = s->mag.z_mg;
+    v[3] = s->mag.temperature_c;
+}
+
+static void mag_pack(const float *v, const align_sample_t *nearest, imu_data_t *frame)
+{
+    (void)nearest;
+    frame->magnetometer.x_mg = v[0];
+    frame->magnetometer.y_mg = v[1];
+    frame->magnetometer.z_mg = v[2];
+    frame->magnetometer.temperature_c = v[3];
+    frame->magnetometer.valid = true;
+}
+
+static void accel_unpack(const align_sample_t *s, float *v)
+{
+    v[0] = s->accel.x_g;
+    v[1] = s->accel.y_g;
+    v[2] = s->accel.z_g;
+}
+
+static void accel_pack(const float *v, const align_sample_t *nearest, imu_data_t *frame)
+{
+    (void)nearest;
+    frame->accelerometer.x_g = v[0];
+    frame->accelerometer.y_g = v[1];
+    frame->accelerometer.z_g = v[2];
+    frame->accelerometer.valid = true;
+}
+
+static void imu_unpack(const align_sample_t *s, float *v)
+{
+    v[0] = (float)s->imu.accel_x_ug;
+    v[1] = (float)s->imu.accel_y_ug;
+    v[2] = (float)s->imu.accel_z_ug;
+    v[3] = (float)s->imu.gyro_x_mdps;
+    v[4] = (float)s->imu.gyro_y_mdps;
+    v[5] = (float)s->imu.gyro_z_mdps;
+    v[6] = (float)s->imu.temperature_mc;
+}
+
+static void imu_pack(const float *v, const align_sample_t *nearest, imu_data_t *frame)
+{
+    frame->imu_6axis.accel_x_ug = (int32_t)lrintf(v[0]);
+    frame->imu_6axis.accel_y_ug = (int32_t)lrintf(v[1]);
+    frame->imu_6axis.accel_z_ug = (int32_t)lrintf(v[2]);
+    frame->imu_6axis.gyro_x_mdps = (int32_t)lrintf(v[3]);
+    frame->imu_6axis.gyro_y_mdps = (int32_t)lrintf(v[4]);
+    frame->imu_6axis.gyro_z_mdps = (int32_t)lrintf(v[5]);
+    frame->imu_6axis.temperature_mc = (int32_t)lrintf(v[6]);
+    frame->imu_6axis.hires = nearest->imu.hires;
+    frame->imu_6axis.valid = true;
+}
+
+static void incl_unpack(const align_sample_t *s, float *v)
+{
+    v[0] = s->incl.angle_x_deg;
+    v[1] = s->incl.angle_y_deg;
+    v[2] = s->incl.angle_z_deg;
+    v[3] = s->incl.accel_x_g;
+    v[4] = s->incl.accel_y_g;
+    v[5] = s->incl.accel_z_g;
+    v[6] = s->incl.temperature_c;
+}
+
+static void incl_pack(const float *v, const align_sample_t *nearest, imu_data_t *frame)
+{
+    (void)nearest;
+    frame->inclinometer.angle_x_deg = v[0];
+    frame->inclinometer.angle_y_deg = v[1];
+    frame->inclinometer.angle_z_deg = v[2];
+    frame->inclinometer.accel_x_g = v[3];
+    frame->inclinometer.accel_y_g = v[4];
+    frame->inclinometer.accel_z_g = v[5];
+    frame->inclinometer.temperature_c = v[6];
+    frame->inclinometer.valid = true;
+}
+
+static const align_source_desc_t source_desc[] = {
+    { SENSOR_MAGNETOMETER,  sizeof(imu_mag_sample_t),   4, mag_unpack,   mag_pack },
+    { SENSOR_ACCELEROMETER, sizeof(imu_accel_sample_t), 3, accel_unpack, accel_pack },
+    { SENSOR_IMU_6AXIS,     sizeof(imu_6axis_sample_t), 7, imu_unpack,   imu_pack },
+    { SENSOR_INCLINOMETER,  sizeof(imu_incl_sample_t),  7, incl_unpack,  incl_pack },
+};
+#define ALIGN_SOURCE_COUNT (sizeof(source_desc) / sizeof(source_desc[0]))
+
+// State below is only touched by the task calling time_align_process()
+static align_source_t sources[ALIGN_SOURCE_COUNT];
+static bool initialized = false;
+static bool started = false;
+static uint32_t output_rate_hz;
+static time_align_interp_t interp;
+static uint32_t max_latency_us;
+static uint64_t frame_t0_us;    // Time of frame 0 at the current rate
+static uint64_t frame_index;
+static time_align_stats_t work_stats;
+
+// Shared with the setters and getters
+static portMUX_TYPE align_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t pending_rate_hz;
+static time_align_interp_t pending_interp;
+static time_align_stats_t published_stats;
+
+// Every sample type starts with its timestamp
+static inline uint64_t sample_ts(const align_sample_t *s)
+{
+    return s->mag.timestamp_us;
+}
+
+static inline uint64_t frame_time(void)
+{
+    return frame_t0_us + frame_index * 1000000ULL / output_rate_hz;
+}
+
+esp_err_t time_align_init(const time_align_config_t *config)
+{
+    if (config == NULL || config->output_rate_hz == 0 ||
+        config->output_rate_hz > TIME_ALIGN_MAX_RATE_HZ) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(sources, 0, sizeof(sources));
+    memset(&work_stats, 0, sizeof(work_stats));
+    output_rate_hz = config->output_rate_hz;
+    interp = config->interp;
+    max_latency_us = config->max_latency_us ? config->max_latency_us : TIME_ALIGN_DEFAULT_LATENCY_US;
+    if (max_latency_us >= TIME_ALIGN_MAX_BACKLOG_US) {
+        max_latency_us = TIME_ALIGN_MAX_BACKLOG_US / 2;
+    }
+    started = false;
+
+    portENTER_CRITICAL(&align_lock);
+    pending_rate_hz = output_rate_hz;
+    pending_interp = interp;
+    memset(&published_stats, 0, sizeof(published_stats));
+    published_stats.output_rate_hz = output_rate_hz;
+    published_stats.interp = interp;
+    portEXIT_CRITICAL(&align_lock);
+
+    initialized = true;
+    ESP_LOGI(TAG, "Common timeline at %lu Hz, %s interpolation, max latency %lu us",
+             output_rate_hz, interp == TIME_ALIGN_CUBIC ? "cubic" : "linear", max_latency_us);
+    return ESP_OK;
+}
+
+// Follows sensors being enabled, disabled or brought up late
+static void source_sync(align_source_t *src, const align_source_desc_t *desc)
+{
+    sensor_stream_t *stream = NULL;
+    if (imu_manager_get_enabled_sensors() & desc->sensor_id) {
+        stream = imu_manager_get_stream(desc->sensor_id);
+    }
+    if (stream == src->stream) {
+        return;
+    }
+
+    src->stream = stream;
+    src->hist_count = 0;
+    src->stage_len = 0;
+    src->stage_pos = 0;
+    if (stream != NULL) {
+        // Start a little before now so the first frames have a sample to their left
+        uint32_t seq = sensor_stream_get_seq(stream);
+        src->cursor = seq - (seq < ALIGN_READ_CHUNK ? seq : ALIGN_READ_CHUNK);
+    }
+}
+
+// Moves the next stream sample into the history; false when the stream is drained
+static bool source_pull(align_source_t *src, const align_source_desc_t *desc)
+{
+    for (;;) {
+        if (src->stage_pos >= src->stage_len) {
+            src->stage_len = sensor_stream_read(src->stream, &src->cursor, src->stage, ALIGN_READ_CHUNK);
+            src->stage_pos = 0;
+            if (src->stage_len == 0) {
+                return false;
+            }
+        }
+
+        align_sample_t s;
+        memcpy(&s, src->stage + src->stage_pos * desc->sample_size, desc->sample_size);
+        src->stage_pos++;
+
+        if (src->hist_count > 0 && sample_ts(&s) <= sample_ts(&src->hist[src->hist_count - 1])) {
+            work_stats.out_of_order++;
+            continue;
+        }
+        if (src->hist_count == ALIGN_HISTORY) {
+            memmove(&src->hist[0], &src->hist[1], (ALIGN_HISTORY - 1) * sizeof(src->hist[0]));
+            src->hist_count--;
+        }
+        src->hist[src->hist_count++] = s;
+        work_stats.samples_in++;
+        return true;
+    }
+}
+
+static uint32_t source_count_after(const align_source_t *src, uint64_t t)
+{
+    uint32_t n = 0;
+    for (uint32_t i = src->hist_count; i > 0 && sample_ts(&src->hist[i - 1]) > t; i--) {
+        n++;
+    }
+    return n;
+}
+
+static align_state_t source_fill(align_source_t *src, const align_source_desc_t *desc,
+                                 uint64_t t, uint64_t now, uint32_t need_after)
+{
+    uint32_t after;
+    while ((after = source_count_after(src, t)) < need_after) {
+        if (source_pull(src, desc)) {
+            continue;
+        }
+        if (now - t < max_latency_us) {
+            return ALIGN_WAIT;
+        }
+        // Waited long enough: go with what is there (cubic falls back to fewer points)
+        break;
+    }
+
+    // Needs a sample on each side of t
+    if (after == 0 || after == src->hist_count) {
+        return ALIGN_MISSING;
+    }
+    return ALIGN_READY;
+}
+
+static void source_interp(const align_source_t *src, const align_source_desc_t *desc,
+                          uint64_t t, bool cubic, imu_data_t *frame)
+{
+    uint32_t i = 0;
+    while (i + 2 < src->hist_count && sample_ts(&src->hist[i + 1]) <= t) {
+        i++;
+    }
+    // hist[i] is the last sample at or before t, hist[i + 1] the first one after it
+    const align_sample_t *s1 = &src->hist[i];
+    const align_sample_t *s2 = &src->hist[i + 1];
+    uint64_t t1 = sample_ts(s1);
+    uint64_t t2 = sample_ts(s2);
+    float dt = (float)(t2 - t1);
+    float u = (float)(t - t1) / dt;
+
+    float v1[ALIGN_MAX_CHANNELS], v2[ALIGN_MAX_CHANNELS], out[ALIGN_MAX_CHANNELS] = {0};
+    desc->unpack(s1, v1);
+    desc->unpack(s2, v2);
+
+    if (!cubic) {
+        for (int c = 0; c < desc->channels; c++) {
+            out[c] = v1[c] + (v2[c] - v1[c]) * u;
+        }
+    } else {
+        // Hermite on [t1, t2]; tangents from the neighbours, scaled to the real spacing
+        const align_sample_t *s0 = (i > 0) ? &src->hist[i - 1] : s1;
+        const align_sample_t *s3 = (i + 2 < src->hist_count) ? &src->hist[i + 2] : s2;
+        float v0[ALIGN_MAX_CHANNELS], v3[ALIGN_MAX_CHANNELS];
+        desc->unpack(s0, v0);
+        desc->unpack(s3, v3);
+        float k1 = dt / (float)(t2 - sample_ts(s0));
+        float k2 = dt / (float)(sample_ts(s3) - t1);
+
+        float u2 = u * u;
+        float u3 = u2 * u;
+        float h00 = 2.0f * u3 - 3.0f * u2 + 1.0f;
+        float h10 = u3 - 2.0f * u2 + u;
+        float h01 = -2.0f * u3 + 3.0f * u2;
+        float h11 = u3 - u2;
+        for (int c = 0; c < desc->channels; c++) {
+            float m1 = (v2[c] - v0[c]) * k1;
+            float m2 = (v3[c] - v1[c]) * k2;
+            out[c] = h00 * v1[c] + h10 * m1 + h01 * v2[c] + h11 * m2;
+        }
+    }
+
+    desc->pack(out, (u < 0.5f) ? s1 : s2, frame);
+}
+
+static void apply_pending_config(void)
+{
+    portENTER_CRITICAL(&align_lock);
+    uint32_t rate = pending_rate_hz;
+    interp = pending_interp;
+    portEXIT_CRITICAL(&align_lock);
+
+    if (rate != output_rate_hz) {
+        // Continue from the next unsent frame at the new spacing
+        if (started) {
+            frame_t0_us = frame_time();
+            frame_index = 0;
+        }
+        output_rate_hz = rate;
+    }
+}
+
+uint32_t time_align_process(time_align_emit_cb_t emit, void *ctx, uint32_t max_frames)
+{
+    if (!initialized || emit == NULL) {
+        return 0;
+    }
+
+    int64_t start = esp_timer_get_time();
+    uint64_t now = (uint64_t)start;
+
+    apply_pending_config();
+    if (!started) {
+        frame_t0_us = now;
+        frame_index = 0;
+        started = true;
+    }
+    for (size_t s = 0; s < ALIGN_SOURCE_COUNT; s++) {
+        source_sync(&sources[s], &source_desc[s]);
+    }
+
+    // Bounded backlog: far-behind frames are skipped rather than replayed
+    uint64_t t = frame_time();
+    if (now > t + TIME_ALIGN_MAX_BACKLOG_US) {
+        uint64_t skip = (now - max_latency_us - t) * output_rate_hz / 1000000ULL;
+        frame_index += skip;
+        work_stats.skipped_frames += (uint32_t)skip;
+    }
+
+    bool cubic = (interp == TIME_ALIGN_CUBIC);
+    uint32_t need_after = cubic ? 2 : 1;
+    uint32_t emitted = 0;
+    imu_data_t frame;
+
+    while (emitted < max_frames) {
+        t = frame_time();
+        if (t > now) {
+            break;
+        }
+
+        align_state_t state[ALIGN_SOURCE_COUNT];
+        bool wait = false;
+        for (size_t s = 0; s < ALIGN_SOURCE_COUNT && !wait; s++) {
+            state[s] = ALIGN_MISSING;
+            if (sources[s].stream != NULL) {
+                state[s] = source_fill(&sources[s], &source_desc[s], t, now, need_after);
+                wait = (state[s] == ALIGN_WAIT);
+            }
+        }
+        if (wait) {
+            break;
+        }
+
+        memset(&frame, 0, sizeof(frame));
+        frame.timestamp_us = t;
+        bool partial = false;
+        for (size_t s = 0; s < ALIGN_SOURCE_COUNT; s++) {
+            if (sources[s].stream == NULL) {
+                continue;
+            }
+            if (state[s] == ALIGN_READY) {
+                source_interp(&sources[s], &source_desc[s], t, cubic, &frame);
+            } else {
+                partial = true;
+            }
+        }
+
+        emit(&frame, ctx);
+
+        work_stats.frames++;
+        if (partial) {
+            work_stats.partial_frames++;
+        }
+        work_stats.last_lag_us = (uint32_t)(now - t);
+        if (work_stats.last_lag_us > work_stats.max_lag_us) {
+            work_stats.max_lag_us = work_stats.last_lag_us;
+        }
+        frame_index++;
+        emitted++;
+    }
+
+    work_stats.output_rate_hz = output_rate_hz;
+    work_stats.interp = interp;
+    work_stats.last_process_us = (uint32_t)(esp_timer_get_time() - start);
+
+    portENTER_CRITICAL(&align_lock);
+    published_stats = work_stats;
+    portEXIT_CRITICAL(&align_lock);
+
+    return emitted;
+}
+
+esp_err_t time_align_set_output_rate(uint32_t rate_hz)
+{
+    if (rate_hz == 0 || rate_hz > TIME_ALIGN_MAX_RATE_HZ) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&align_lock);
+    pending_rate_hz = rate_hz;
+    portEXIT_CRITICAL(&align_lock);
+    ESP_LOGI(TAG, "Output rate set to %lu Hz", rate_hz);
+    return ESP_OK;
+}
+
+void time_align_set_interp(time_align_interp_t mode)
+{
+    portENTER_CRITICAL(&align_lock);
+    pending_interp = (mode == TIME_ALIGN_CUBIC) ? TIME_ALIGN_CUBIC : TIME_ALIGN_LINEAR;
+    portEXIT_CRITICAL(&align_lock);
+}
+
+uint32_t time_align_get_output_rate(void)
+{
+    portENTER_CRITICAL(&align_lock);
+    uint32_t rate = pending_rate_hz;
+    portEXIT_CRITICAL(&align_lock);
+    return rate;
+}
+
+time_align_interp_t time_align_get_interp(void)
+{
+    portENTER_CRITICAL(&align_lock);
+    time_align_interp_t mode = pending_interp;
+    portEXIT_CRITICAL(&align_lock);
+    return mode;
+}
+
+void time_align_get_stats(time_align_stats_t *stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&align_lock);
+    *stats = published_stats;
+    portEXIT_CRITICAL(&align_lock);
+}
@@ -0,0 +1,63 @@
+#ifndef TIME_ALIGN_H
+#define TIME_ALIGN_H
+
+#include "esp_err.h"
+#include "imu_manager.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Resamples the per-sensor streams onto one common timeline.
+// Each sensor keeps its own rate and timestamps; fused imu_data_t frames are
+// produced at t = t0 + k / output_rate by interpolating every stream at t.
+// Streams are consumed incrementally through their cursors and only the few
+// samples around t are kept, so memory does not grow with rate or backlog.
+
+#define TIME_ALIGN_DEFAULT_RATE_HZ      20
+#define TIME_ALIGN_MAX_RATE_HZ          400
+// How long a frame waits for a slow stream before it is emitted without it.
+// Covers the ICM45686 FIFO watermark, which delivers samples in batches.
+#define TIME_ALIGN_DEFAULT_LATENCY_US   250000
+// Frames older than this behind real time are skipped instead of emitted
+#define TIME_ALIGN_MAX_BACKLOG_US       1000000
+
+typedef enum {
+    TIME_ALIGN_LINEAR = 0,
+    TIME_ALIGN_CUBIC,           // Cubic Hermite with Catmull-Rom tangents, non-uniform spacing
+} time_align_interp_t;
+
+typedef struct {
+    uint32_t output_rate_hz;
+    time_align_interp_t interp;
+    uint32_t max_latency_us;
+} time_align_config_t;
+
+typedef struct {
+    uint32_t output_rate_hz;
+    time_align_interp_t interp;
+    uint32_t frames;
+    uint32_t partial_frames;    // Emitted with at least one enabled stream missing
+    uint32_t skipped_frames;    // Dropped to catch up with real time
+    uint32_t samples_in;        // Samples consumed from the streams
+    uint32_t out_of_order;      // Samples ignored for a non-increasing timestamp
+    uint32_t last_lag_us;       // Real time minus frame time at emission
+    uint32_t max_lag_us;
+    uint32_t last_process_us;   // Cost of the last time_align_process() call
+} time_align_stats_t;
+
+typedef void (*time_align_emit_cb_t)(const imu_data_t *frame, void *ctx);
+
+esp_err_t time_align_init(const time_align_config_t *config);
+
+// Emits, oldest first, every frame that all streams have covered (or given up
+// on after max_latency_us). Called periodically from a single task.
+uint32_t time_align_process(time_align_emit_cb_t emit, void *ctx, uint32_t max_frames);
+
+// Take effect on the next time_align_process() call
+esp_err_t time_align_set_output_rate(uint32_t output_rate_hz);
+void time_align_set_interp(time_align_interp_t interp);
+uint32_t time_align_get_output_rate(void);
+time_align_interp_t time_align_get_interp(void);
+
+void time_align_get_stats(time_align_stats_t *stats);
+
+#endif // TIME_ALIGN_H
@@ -1,10 +1,14 @@
 #include "web_server.h"
 #include "data_buffer.h"
 #include "imu_manager.h"
+#include "ahrs.h"
+#include "time_align.h"
 #include "led_status.h"
 #include "esp_log.h"
 #include "esp_spiffs.h"
 #include "esp_netif.h"
+#include "esp_system.h"
+#include "json_writer.h"
 #include "cJSON.h"
 #include <string.h>
 #include <stdio.h>
@@ -13,6 +17,11 @@
 
 static const char *TAG = "WEB_SERVER";
 
+static const char *ahrs_source_key(ahrs_source_t source)
+{
+    return (source == AHRS_SOURCE_EDMP_GAF) ? "edmp_gaf" : "host";
+}
+
 static httpd_handle_t server = NULL;
 static httpd_handle_t ws_server = NULL;
 
@@ -25,6 +34,34 @@ typedef struct {
 static ws_connection_t ws_connections[WEBSOCKET_MAX_CONNECTIONS];
 static SemaphoreHandle_t ws_mutex = NULL;
 
+// Cost of building and sending one JSON response, per endpoint
+typedef enum {
+    API_TIMING_DATA = 0,
+    API_TIMING_STATS,
+    API_TIMING_CONFIG,
+    API_TIMING_COUNT,
+} api_timing_id_t;
+
+typedef struct {
+    uint32_t requests;
+    uint32_t last_us;
+    uint32_t max_us;
+    uint32_t last_bytes;
+} api_timing_t;
+
+static api_timing_t api_timing[API_TIMING_COUNT];
+
+// Sensor keys used by the config and stats endpoints
+static const struct {
+    const char *key;
+    uint8_t id;
+} sensor_map[] = {
+    {"magnetometer", SENSOR_MAGNETOMETER},
+    {"accelerometer", SENSOR_ACCELEROMETER},
+    {"imu_6axis", SENSOR_IMU_6AXIS},
+    {"inclinometer", SENSOR_INCLINOMETER},
+};
+
 // Forward declarations
 static esp_err_t api_data_handler(httpd_req_t *req);
 static esp_err_t api_stats_handler(httpd_req_t *req);
@@ -60,11 +97,233 @@ static esp_err_t api_ip_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
-// API Data endpoint - returns latest sensor data
+// JSON responses are written through a stack buffer: sent in one piece when
+// the document fits, chunked as the buffer fills otherwise
+typedef struct {
+    httpd_req_t *req;
+    api_timing_t *timing;
+    int64_t start_us;
+    bool chunked;
+} json_resp_t;
+
+static esp_err_t json_resp_flush(const char *data, size_t len, void *ctx)
+{
+    json_resp_t *resp = (json_resp_t *)ctx;
+    resp->chunked = true;
+    return httpd_resp_send_chunk(resp->req, data, len);
+}
+
+static void json_resp_begin(json_resp_t *resp, json_writer_t *w, char *buf, size_t size,
+                            httpd_req_t *req, api_timing_t *timing)
+{
+    resp->req = req;
+    resp->timing = timing;
+    resp->start_us = esp_timer_get_time();
+    resp->chunked = false;
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    json_writer_init(w, buf, size, json_resp_flush, resp);
+}
+
+static esp_err_t json_resp_end(json_resp_t *resp, json_writer_t *w)
+{
+    esp_err_t ret;
+    if (!resp->chunked && w->err == ESP_OK && w->depth == 0) {
+        ret = httpd_resp_send(resp->req, w->buf, w->len);
+    } else {
+        ret = json_writer_finish(w);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "JSON response cut short: %s", esp_err_to_name(ret));
+        }
+        httpd_resp_send_chunk(resp->req, NULL, 0);
+    }
+    
+    api_timing_t *t = resp->timing;
+    uint32_t us = (uint32_t)(esp_timer_get_time() - resp->start_us);
+    t->requests++;
+    t->last_us = us;
+    if (us > t->max_us) {
+        t->max_us = us;
+    }
+    t->last_bytes = w->total;
+    return ret;
+}
+
+static void write_string_array(json_writer_t *w, const char *key, const char *const *items, size_t count)
+{
+    json_writer_begin_array(w, key);
+    for (size_t i = 0; i < count; i++) {
+        json_writer_string(w, NULL, items[i]);
+    }
+    json_writer_end_array(w);
+}
+
+// One record of a delta query: [t, mag|null, acc|null, imu|null, incl|null]
+static void write_delta_row(json_writer_t *w, const imu_data_t *d)
+{
+    json_writer_begin_array(w, NULL);
+    json_writer_uint(w, NULL, d->timestamp_us);
+    if (d->magnetometer.valid) {
+        json_writer_begin_array(w, NULL);
+        json_writer_float(w, NULL, d->magnetometer.x_mg, 2);
+        json_writer_float(w, NULL, d->magnetometer.y_mg, 2);
+        json_writer_float(w, NULL, d->magnetometer.z_mg, 2);
+        json_writer_float(w, NULL, d->magnetometer.temperature_c, 2);
+        json_writer_end_array(w);
+    } else {
+        json_writer_null(w, NULL);
+    }
+    if (d->accelerometer.valid) {
+        json_writer_begin_array(w, NULL);
+        json_writer_float(w, NULL, d->accelerometer.x_g, 5);
+        json_writer_float(w, NULL, d->accelerometer.y_g, 5);
+        json_writer_float(w, NULL, d->accelerometer.z_g, 5);
+        json_writer_end_array(w);
+    } else {
+        json_writer_null(w, NULL);
+    }
+    if (d->imu_6axis.valid) {
+        json_writer_begin_array(w, NULL);
+        json_writer_int(w, NULL, d->imu_6axis.accel_x_ug);
+        json_writer_int(w, NULL, d->imu_6axis.accel_y_ug);
+        json_writer_int(w, NULL, d->imu_6axis.accel_z_ug);
+        json_writer_int(w, NULL, d->imu_6axis.gyro_x_mdps);
+        json_writer_int(w, NULL, d->imu_6axis.gyro_y_mdps);
+        json_writer_int(w, NULL, d->imu_6axis.gyro_z_mdps);
+        json_writer_int(w, NULL, d->imu_6axis.temperature_mc);
+        json_writer_end_array(w);
+    } else {
+        json_writer_null(w, NULL);
+    }
+    if (d->inclinometer.valid) {
+        json_writer_begin_array(w, NULL);
+        json_writer_float(w, NULL, d->inclinometer.angle_x_deg, 3);
+        json_writer_float(w, NULL, d->inclinometer.angle_y_deg, 3);
+        json_writer_float(w, NULL, d->inclinometer.angle_z_deg, 3);
+        json_writer_float(w, NULL, d->inclinometer.accel_x_g, 4);
+        json_writer_float(w, NULL, d->inclinometer.accel_y_g, 4);
+        json_writer_float(w, NULL, d->inclinometer.accel_z_g, 4);
+        json_writer_float(w, NULL, d->inclinometer.temperature_c, 2);
+        json_writer_end_array(w);
+    } else {
+        json_writer_null(w, NULL);
+    }
+    json_writer_end_array(w);
+}
+
+// GET /api/data?since=<seq>&max=<n>: every buffered record after seq, as compact
+// JSON arrays sent in chunks. "next" is the since of the following poll; "gap"
+// reports records that left the ring before this client fetched them.
+static esp_err_t api_data_delta(httpd_req_t *req, uint32_t since, uint32_t max_records)
+{
+    static const char *const mag_fields[] = { "x_mg", "y_mg", "z_mg", "temp_c" };
+    static const char *const acc_fields[] = { "x_g", "y_g", "z_g" };
+    static const char *const imu_fields[] = { "ax_ug", "ay_ug", "az_ug", "gx_mdps", "gy_mdps", "gz_mdps", "temp_mc" };
+    static const char *const incl_fields[] = { "x_deg", "y_deg", "z_deg", "ax_g", "ay_g", "az_g", "temp_c" };
+    
+    imu_data_t *batch = malloc(API_DATA_CHUNK_RECORDS * sizeof(imu_data_t));
+    char *out = malloc(API_DATA_OUT_SIZE);
+    if (batch == NULL || out == NULL) {
+        free(batch);
+        free(out);
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_send(req, "Out of memory", HTTPD_RESP_USE_STRLEN);
+        return ESP_FAIL;
+    }
+    
+    data_buffer_cursor_t cursor = { .seq = since, .overruns = 0 };
+    json_resp_t resp;
+    json_writer_t w;
+    uint32_t sent = 0;
+    uint32_t lost = 0;
+    uint32_t lag = 0;
+    bool started = false;
+    
+    while (sent < max_records) {
+        uint32_t want = max_records - sent;
+        if (want > API_DATA_CHUNK_RECORDS) {
+            want = API_DATA_CHUNK_RECORDS;
+        }
+        
+        // Copy a chunk out so the layout lock is not held while the socket sends
+        data_buffer_read_t rd;
+        if (data_buffer_read_begin(&cursor, want, &rd) != ESP_OK) {
+            break;
+        }
+        uint32_t n = 0;
+        for (int s = 0; s < 2; s++) {
+            for (uint32_t i = 0; i < rd.span[s].len; i++) {
+                data_buffer_load(rd.span[s].pos + i, &batch[n++]);
+            }
+        }
+        uint32_t overwritten = data_buffer_read_end(&cursor, &rd);
+        lost += rd.lost + overwritten;
+        lag = rd.lag;
+        
+        if (!started) {
+            json_resp_begin(&resp, &w, out, API_DATA_OUT_SIZE, req, &api_timing[API_TIMING_DATA]);
+            json_writer_begin_object(&w, NULL);
+            json_writer_uint(&w, "since", since);
+            json_writer_uint(&w, "first", rd.first_seq + overwritten);
+            json_writer_begin_array(&w, "fields");
+            json_writer_string(&w, NULL, "t_us");
+            write_string_array(&w, NULL, mag_fields, sizeof(mag_fields) / sizeof(mag_fields[0]));
+            write_string_array(&w, NULL, acc_fields, sizeof(acc_fields) / sizeof(acc_fields[0]));
+            write_string_array(&w, NULL, imu_fields, sizeof(imu_fields) / sizeof(imu_fields[0]));
+            write_string_array(&w, NULL, incl_fields, sizeof(incl_fields) / sizeof(incl_fields[0]));
+            json_writer_end_array(&w);
+            json_writer_begin_array(&w, "records");
+            started = true;
+        }
+        for (uint32_t i = overwritten; i < n; i++) {
+            write_delta_row(&w, &batch[i]);
+            sent++;
+        }
+        if (w.err != ESP_OK || rd.count < want) {
+            break;
+        }
+    }
+    
+    esp_err_t ret = ESP_OK;
+    if (!started) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_send(req, "Buffer busy", HTTPD_RESP_USE_STRLEN);
+    } else {
+        json_writer_end_array(&w);
+        json_writer_uint(&w, "count", sent);
+        json_writer_uint(&w, "next", cursor.seq);
+        json_writer_uint(&w, "lag", lag);
+        json_writer_bool(&w, "gap", lost != 0);
+        json_writer_uint(&w, "lost", lost);
+        json_writer_end_object(&w);
+        ret = json_resp_end(&resp, &w);
+    }
+    
+    free(batch);
+    free(out);
+    return ret;
+}
+
+// API Data endpoint - returns latest sensor data, or the records after ?since=
 static esp_err_t api_data_handler(httpd_req_t *req)
 {
     ESP_LOGI(TAG, "API Data request");
     
+    char query[64];
+    char value[16];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "since", value, sizeof(value)) == ESP_OK) {
+        uint32_t since = strtoul(value, NULL, 10);
+        uint32_t max_records = API_DATA_DEFAULT_RECORDS;
+        if (httpd_query_key_value(query, "max", value, sizeof(value)) == ESP_OK) {
+            max_records = strtoul(value, NULL, 10);
+        }
+        if (max_records == 0 || max_records > API_DATA_MAX_RECORDS) {
+            max_records = API_DATA_MAX_RECORDS;
+        }
+        return api_data_delta(req, since, max_records);
+    }
+    
     imu_data_t data;
     esp_err_t ret = data_buffer_get_latest(&data);
     
@@ -74,80 +333,81 @@ static esp_err_t api_data_handler(httpd_req_t *req)
         return ESP_FAIL;
     }
     
-    // Convert to JSON
-    cJSON *json = cJSON_CreateObject();
-    cJSON_AddNumberToObject(json, "timestamp_us", data.timestamp_us);
+    // "next" starts a ?since= poll after this record
+    char buf[API_JSON_CHUNK_SIZE];
+    json_resp_t resp;
+    json_writer_t w;
+    json_resp_begin(&resp, &w, buf, sizeof(buf), req, &api_timing[API_TIMING_DATA]);
+    json_writer_begin_object(&w, NULL);
+    json_writer_uint(&w, "timestamp_us", data.timestamp_us);
+    json_writer_uint(&w, "next", data_buffer_get_head_seq());
     
     // Magnetometer
     if (data.magnetometer.valid) {
-        cJSON *mag = cJSON_CreateObject();
-        cJSON_AddNumberToObject(mag, "x_mg", data.magnetometer.x_mg);
-        cJSON_AddNumberToObject(mag, "y_mg", data.magnetometer.y_mg);
-        cJSON_AddNumberToObject(mag, "z_mg", data.magnetometer.z_mg);
-        cJSON_AddNumberToObject(mag, "temperature_c", data.magnetometer.temperature_c);
-        cJSON_AddItemToObject(json, "magnetometer", mag);
+        json_writer_begin_object(&w, "magnetometer");
+        json_writer_float(&w, "x_mg", data.magnetometer.x_mg, 3);
+        json_writer_float(&w, "y_mg", data.magnetometer.y_mg, 3);
+        json_writer_float(&w, "z_mg", data.magnetometer.z_mg, 3);
+        json_writer_float(&w, "temperature_c", data.magnetometer.temperature_c, 2);
+        json_writer_end_object(&w);
     }
     
     // Accelerometer
     if (data.accelerometer.valid) {
-        cJSON *accel = cJSON_CreateObject();
-        cJSON_AddNumberToObject(accel, "x_g", data.accelerometer.x_g);
-        cJSON_AddNumberToObject(accel, "y_g", data.accelerometer.y_g);
-        cJSON_AddNumberToObject(accel, "z_g", data.accelerometer.z_g);
-        cJSON_AddItemToObject(json, "accelerometer", accel);
+        json_writer_begin_object(&w, "accelerometer");
+        json_writer_float(&w, "x_g", data.accelerometer.x_g, 5);
+        json_writer_float(&w, "y_g", data.accelerometer.y_g, 5);
+        json_writer_float(&w, "z_g", data.accelerometer.z_g, 5);
+        json_writer_end_object(&w);
     }
     
-    // IMU 6-axis
+    // IMU 6-axis: fixed point written at full resolution (µg, mdps, m°C)
     if (data.imu_6axis.valid) {
-        cJSON *imu = cJSON_CreateObject();
-        cJSON *accel = cJSON_CreateObject();
-        cJSON *gyro = cJSON_CreateObject();
-        
-        cJSON_AddNumberToObject(accel, "x_g", data.imu_6axis.accel_x_g);
-        cJSON_AddNumberToObject(accel, "y_g", data.imu_6axis.accel_y_g);
-        cJSON_AddNumberToObject(accel, "z_g", data.imu_6axis.accel_z_g);
-        cJSON_AddNumberToObject(gyro, "x_dps", data.imu_6axis.gyro_x_dps);
-        cJSON_AddNumberToObject(gyro, "y_dps", data.imu_6axis.gyro_y_dps);
-        cJSON_AddNumberToObject(gyro, "z_dps", data.imu_6axis.gyro_z_dps);
-        cJSON_AddNumberToObject(imu, "temperature_c", data.imu_6axis.temperature_c);
-        
-        cJSON_AddItemToObject(imu, "accelerometer", accel);
-        cJSON_AddItemToObject(imu, "gyroscope", gyro);
-        cJSON_AddItemToObject(json, "imu_6axis", imu);
+        json_writer_begin_object(&w, "imu_6axis");
+        json_writer_begin_object(&w, "accelerometer");
+        json_writer_fixed(&w, "x_g", data.imu_6axis.accel_x_ug, 6);
+        json_writer_fixed(&w, "y_g", data.imu_6axis.accel_y_ug, 6);
+        json_writer_fixed(&w, "z_g", data.imu_6axis.accel_z_ug, 6);
+        json_writer_end_object(&w);
+        json_writer_begin_object(&w, "gyroscope");
+        json_writer_fixed(&w, "x_dps", data.imu_6axis.gyro_x_mdps, 3);
+        json_writer_fixed(&w, "y_dps", data.imu_6axis.gyro_y_mdps, 3);
+        json_writer_fixed(&w, "z_dps", data.imu_6axis.gyro_z_mdps, 3);
+        json_writer_end_object(&w);
+        json_writer_fixed(&w, "temperature_c", data.imu_6axis.temperature_mc, 3);
+        json_writer_bool(&w, "hires", data.imu_6axis.hires);
+        json_writer_end_object(&w);
     }
     
     // Inclinometer
     if (data.inclinometer.valid) {
-        cJSON *incl = cJSON_CreateObject();
-        cJSON *angles = cJSON_CreateObject();
-        cJSON *accel = cJSON_CreateObject();
-        
-        cJSON_AddNumberToObject(angles, "x_deg", data.inclinometer.angle_x_deg);
-        cJSON_AddNumberToObject(angles, "y_deg", data.inclinometer.angle_y_deg);
-        cJSON_AddNumberToObject(angles, "z_deg", data.inclinometer.angle_z_deg);
-        cJSON_AddNumberToObject(accel, "x_g", data.inclinometer.accel_x_g);
-        cJSON_AddNumberToObject(accel, "y_g", data.inclinometer.accel_y_g);
-        cJSON_AddNumberToObject(accel, "z_g", data.inclinometer.accel_z_g);
-        cJSON_AddNumberToObject(incl, "temperature_c", data.inclinometer.temperature_c);
-        
-        cJSON_AddItemToObject(incl, "angles", angles);
-        cJSON_AddItemToObject(incl, "accelerometer", accel);
-        cJSON_AddItemToObject(json, "inclinometer", incl);
+        json_writer_begin_object(&w, "inclinometer");
+        json_writer_begin_object(&w, "angles");
+        json_writer_float(&w, "x_deg", data.inclinometer.angle_x_deg, 3);
+        json_writer_float(&w, "y_deg", data.inclinometer.angle_y_deg, 3);
+        json_writer_float(&w, "z_deg", data.inclinometer.angle_z_deg, 3);
+        json_writer_end_object(&w);
+        json_writer_begin_object(&w, "accelerometer");
+        json_writer_float(&w, "x_g", data.inclinometer.accel_x_g, 4);
+        json_writer_float(&w, "y_g", data.inclinometer.accel_y_g, 4);
+        json_writer_float(&w, "z_g", data.inclinometer.accel_z_g, 4);
+        json_writer_end_object(&w);
+        json_writer_float(&w, "temperature_c", data.inclinometer.temperature_c, 2);
+        json_writer_end_object(&w);
     }
     
-    char *json_string = cJSON_Print(json);
-    if (json_string != NULL) {
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-        httpd_resp_send(req, json_string, strlen(json_string));
-        free(json_string);
-    } else {
-        httpd_resp_set_status(req, "500 Internal Server Error");
-        httpd_resp_send(req, "JSON generation failed", HTTPD_RESP_USE_STRLEN);
-    }
-    
-    cJSON_Delete(json);
-    return ESP_OK;
+    json_writer_end_object(&w);
+    return json_resp_end(&resp, &w);
+}
+
+static void write_api_timing(json_writer_t *w, const char *key, const api_timing_t *t)
+{
+    json_writer_begin_object(w, key);
+    json_writer_uint(w, "requests", t->requests);
+    json_writer_uint(w, "last_us", t->last_us);
+    json_writer_uint(w, "max_us", t->max_us);
+    json_writer_uint(w, "last_bytes", t->last_bytes);
+    json_writer_end_object(w);
 }
 
 // API Stats endpoint - returns buffer statistics
@@ -164,29 +424,135 @@ static esp_err_t api_stats_handler(httpd_req_t *req)
         return ESP_FAIL;
     }
     
-    cJSON *json = cJSON_CreateObject();
-    cJSON_AddNumberToObject(json, "total_samples", stats.total_samples);
-    cJSON_AddNumberToObject(json, "dropped_samples", stats.dropped_samples);
-    cJSON_AddNumberToObject(json, "buffer_overflows", stats.buffer_overflows);
-    cJSON_AddNumberToObject(json, "last_timestamp_us", stats.last_timestamp_us);
-    cJSON_AddNumberToObject(json, "avg_processing_time_us", stats.avg_processing_time_us);
-    cJSON_AddNumberToObject(json, "buffer_count", data_buffer_get_count());
-    cJSON_AddBoolToObject(json, "buffer_full", data_buffer_is_full());
-    cJSON_AddBoolToObject(json, "buffer_empty", data_buffer_is_empty());
+    char buf[API_JSON_CHUNK_SIZE];
+    json_resp_t resp;
+    json_writer_t w;
+    json_resp_begin(&resp, &w, buf, sizeof(buf), req, &api_timing[API_TIMING_STATS]);
+    json_writer_begin_object(&w, NULL);
+    json_writer_uint(&w, "total_samples", stats.total_samples);
+    json_writer_uint(&w, "dropped_samples", stats.dropped_samples);
+    json_writer_uint(&w, "buffer_overflows", stats.buffer_overflows);
+    json_writer_uint(&w, "last_timestamp_us", stats.last_timestamp_us);
+    json_writer_float(&w, "avg_processing_time_us", stats.avg_processing_time_us, 2);
+    json_writer_uint(&w, "buffer_count", data_buffer_get_count());
+    json_writer_bool(&w, "buffer_full", data_buffer_is_full());
+    json_writer_bool(&w, "buffer_empty", data_buffer_is_empty());
+    json_writer_uint(&w, "buffer_capacity", stats.capacity);
+    json_writer_uint(&w, "buffer_bytes_per_record", stats.bytes_per_record);
+    json_writer_uint(&w, "buffer_memory_bytes", stats.memory_bytes);
     
-    char *json_string = cJSON_Print(json);
-    if (json_string != NULL) {
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-        httpd_resp_send(req, json_string, strlen(json_string));
-        free(json_string);
-    } else {
-        httpd_resp_set_status(req, "500 Internal Server Error");
-        httpd_resp_send(req, "JSON generation failed", HTTPD_RESP_USE_STRLEN);
+    json_writer_begin_object(&w, "rate_groups");
+    for (size_t i = 0; i < sizeof(sensor_map)/sizeof(sensor_map[0]); ++i) {
+        imu_rate_group_stats_t rg;
+        if (imu_manager_get_rate_group_stats(sensor_map[i].id, &rg) != ESP_OK) {
+            continue;
+        }
+        json_writer_begin_object(&w, sensor_map[i].key);
+        json_writer_uint(&w, "rate_hz", rg.rate_hz);
+        json_writer_uint(&w, "completed", rg.completed);
+        json_writer_uint(&w, "read_errors", rg.read_errors);
+        json_writer_uint(&w, "stale_reads", rg.stale_reads);
+        json_writer_uint(&w, "deadline_misses", rg.deadline_misses);
+        json_writer_uint(&w, "overruns", rg.overruns);
+        json_writer_uint(&w, "max_exec_us", rg.max_exec_us);
+        json_writer_uint(&w, "max_latency_us", rg.max_latency_us);
+        if (rg.converts > 0) {
+            json_writer_uint(&w, "last_convert_cycles", rg.last_convert_cycles);
+            json_writer_uint(&w, "avg_convert_cycles", rg.avg_convert_cycles);
+            json_writer_uint(&w, "max_convert_cycles", rg.max_convert_cycles);
+        }
+        json_writer_end_object(&w);
     }
+    json_writer_end_object(&w);
     
-    cJSON_Delete(json);
-    return ESP_OK;
+    // Shared SPI bus: time per batched cycle vs. the bits actually clocked
+    spi_batch_stats_t bus;
+    imu_manager_get_spi_bus_stats(&bus);
+    json_writer_begin_object(&w, "spi_bus");
+    json_writer_uint(&w, "cycles", bus.cycles);
+    json_writer_uint(&w, "transactions", bus.transactions);
+    json_writer_uint(&w, "errors", bus.errors);
+    json_writer_uint(&w, "last_transactions", bus.last_transactions);
+    json_writer_uint(&w, "last_busy_us", bus.last_busy_us);
+    json_writer_uint(&w, "last_wire_us", bus.last_wire_us);
+    json_writer_uint(&w, "avg_busy_us", bus.avg_busy_us);
+    json_writer_uint(&w, "max_busy_us", bus.max_busy_us);
+    // Percentages in hundredths, integer math only
+    json_writer_fixed(&w, "wire_efficiency_pct",
+                      bus.total_busy_us ? (int64_t)(bus.total_wire_us * 10000 / bus.total_busy_us) : 0, 2);
+    int64_t uptime_us = esp_timer_get_time();
+    json_writer_fixed(&w, "occupancy_pct",
+                      uptime_us > 0 ? (int64_t)(bus.total_busy_us * 10000 / uptime_us) : 0, 2);
+    json_writer_end_object(&w);
+    
+    // Host CPU cost of the orientation, per source (host AHRS vs. eDMP GAF forwarding)
+    bool ahrs_open = false;
+    for (int src = 0; src < AHRS_SOURCE_COUNT; src++) {
+        ahrs_stats_t ahrs;
+        ahrs_get_source_stats((ahrs_source_t)src, &ahrs);
+        if (ahrs.updates == 0) {
+            continue;
+        }
+        if (!ahrs_open) {
+            json_writer_begin_object(&w, "ahrs");
+            json_writer_string(&w, "source", ahrs_source_key(ahrs_get_source()));
+            ahrs_open = true;
+        }
+        json_writer_begin_object(&w, ahrs_source_key((ahrs_source_t)src));
+        json_writer_uint(&w, "sample_rate_hz", ahrs.sample_rate_hz);
+        json_writer_uint(&w, "updates", ahrs.updates);
+        json_writer_uint(&w, "mag_updates", ahrs.mag_updates);
+        json_writer_uint(&w, "last_cycles", ahrs.last_cycles);
+        json_writer_uint(&w, "avg_cycles", ahrs.avg_cycles);
+        json_writer_uint(&w, "max_cycles", ahrs.max_cycles);
+        json_writer_uint(&w, "avg_ns", ahrs.avg_ns);
+        json_writer_fixed(&w, "cpu_load_pct", ahrs.cpu_load_permille, 1);
+        json_writer_end_object(&w);
+    }
+    if (ahrs_open) {
+        json_writer_end_object(&w);
+    }
+    
+    // Fused frames on the common timeline
+    time_align_stats_t align;
+    time_align_get_stats(&align);
+    json_writer_begin_object(&w, "time_align");
+    json_writer_uint(&w, "output_rate_hz", align.output_rate_hz);
+    json_writer_string(&w, "interp", align.interp == TIME_ALIGN_CUBIC ? "cubic" : "linear");
+    json_writer_uint(&w, "frames", align.frames);
+    json_writer_uint(&w, "partial_frames", align.partial_frames);
+    json_writer_uint(&w, "skipped_frames", align.skipped_frames);
+    json_writer_uint(&w, "samples_in", align.samples_in);
+    json_writer_uint(&w, "out_of_order", align.out_of_order);
+    json_writer_uint(&w, "last_lag_us", align.last_lag_us);
+    json_writer_uint(&w, "max_lag_us", align.max_lag_us);
+    json_writer_uint(&w, "last_process_us", align.last_process_us);
+    json_writer_end_object(&w);
+    
+    // ICM45686 data format and its bus cost
+    imu_6axis_format_t fmt;
+    if (imu_manager_get_imu_format(&fmt) == ESP_OK) {
+        json_writer_begin_object(&w, "imu_format");
+        json_writer_bool(&w, "hires", fmt.hires);
+        json_writer_bool(&w, "fifo", fmt.fifo);
+        json_writer_uint(&w, "fifo_frame_bytes", fmt.fifo_frame_bytes);
+        json_writer_uint(&w, "fifo_bytes_per_s", fmt.fifo_bytes_per_s);
+        json_writer_uint(&w, "accel_lsb_ug", fmt.accel_lsb_ug);
+        json_writer_uint(&w, "gyro_lsb_udps", fmt.gyro_lsb_udps);
+        json_writer_end_object(&w);
+    }
+    
+    // Cost of the JSON endpoints themselves, socket send included
+    json_writer_begin_object(&w, "http");
+    write_api_timing(&w, "data", &api_timing[API_TIMING_DATA]);
+    write_api_timing(&w, "stats", &api_timing[API_TIMING_STATS]);
+    write_api_timing(&w, "config", &api_timing[API_TIMING_CONFIG]);
+    json_writer_uint(&w, "free_heap", esp_get_free_heap_size());
+    json_writer_uint(&w, "min_free_heap", esp_get_minimum_free_heap_size());
+    json_writer_end_object(&w);
+    
+    json_writer_end_object(&w);
+    return json_resp_end(&resp, &w);
 }
 
 // API Config endpoint - handles configuration changes
@@ -243,15 +609,6 @@ static esp_err_t api_config_handler(httpd_req_t *req)
 
         cJSON *sensors = cJSON_GetObjectItem(json, "sensors");
         if (cJSON_IsObject(sensors)) {
-            struct {
-                const char *key;
-                uint8_t id;
-            } sensor_map[] = {
-                {"magnetometer", SENSOR_MAGNETOMETER},
-                {"accelerometer", SENSOR_ACCELEROMETER},
-                {"imu_6axis", SENSOR_IMU_6AXIS},
-                {"inclinometer", SENSOR_INCLINOMETER},
-            };
             for (size_t i = 0; i < sizeof(sensor_map)/sizeof(sensor_map[0]); ++i) {
                 cJSON *item = cJSON_GetObjectItem(sensors, sensor_map[i].key);
                 if (cJSON_IsBool(item)) {
@@ -259,6 +616,50 @@ static esp_err_t api_config_handler(httpd_req_t *req)
                 }
             }
         }
+
+        // Per-sensor rate groups, e.g. {"rates": {"imu_6axis": 800}}
+        cJSON *rates = cJSON_GetObjectItem(json, "rates");
+        if (cJSON_IsObject(rates)) {
+            for (size_t i = 0; i < sizeof(sensor_map)/sizeof(sensor_map[0]); ++i) {
+                cJSON *item = cJSON_GetObjectItem(rates, sensor_map[i].key);
+                if (cJSON_IsNumber(item) && item->valueint > 0) {
+                    if (imu_manager_set_sensor_rate(sensor_map[i].id, item->valueint) != ESP_OK) {
+                        ESP_LOGW(TAG, "Rejected rate %d Hz for %s", item->valueint, sensor_map[i].key);
+                    }
+                }
+            }
+        }
+        
+        // ICM45686 20-bit FIFO packets, e.g. {"imu_hires": true}
+        cJSON *hires = cJSON_GetObjectItem(json, "imu_hires");
+        if (cJSON_IsBool(hires)) {
+            esp_err_t ret = imu_manager_set_imu_hires(cJSON_IsTrue(hires));
+            if (ret != ESP_OK) {
+                ESP_LOGW(TAG, "ICM45686 hires switch failed: %s", esp_err_to_name(ret));
+            }
+        }
+        
+        // Orientation from the host AHRS or the ICM45686 eDMP, e.g. {"orientation_source": "edmp_gaf"}
+        cJSON *ori_source = cJSON_GetObjectItem(json, "orientation_source");
+        if (cJSON_IsString(ori_source)) {
+            ahrs_source_t source = (strcmp(ori_source->valuestring, "edmp_gaf") == 0) ?
+                                   AHRS_SOURCE_EDMP_GAF : AHRS_SOURCE_HOST;
+            esp_err_t ret = imu_manager_set_orientation_source(source);
+            if (ret != ESP_OK) {
+                ESP_LOGW(TAG, "Orientation source switch failed: %s", esp_err_to_name(ret));
+            }
+        }
+        
+        // Common timeline of the fused frames, e.g. {"align_rate_hz": 100, "align_interp": "cubic"}
+        cJSON *align_rate = cJSON_GetObjectItem(json, "align_rate_hz");
+        if (cJSON_IsNumber(align_rate) && time_align_set_output_rate(align_rate->valueint) != ESP_OK) {
+            ESP_LOGW(TAG, "Rejected aligned output rate %d Hz", align_rate->valueint);
+        }
+        cJSON *align_interp = cJSON_GetObjectItem(json, "align_interp");
+        if (cJSON_IsString(align_interp)) {
+            time_align_set_interp(strcmp(align_interp->valuestring, "cubic") == 0 ?
+                                  TIME_ALIGN_CUBIC : TIME_ALIGN_LINEAR);
+        }
         
         cJSON_Delete(json);
         
@@ -267,32 +668,43 @@ static esp_err_t api_config_handler(httpd_req_t *req)
         httpd_resp_send(req, "{\"status\":\"ok\"}", HTTPD_RESP_USE_STRLEN);
     } else {
         // Handle GET request - return current configuration
-        cJSON *json = cJSON_CreateObject();
-        cJSON_AddNumberToObject(json, "sampling_rate", imu_manager_get_sampling_rate());
-        cJSON_AddNumberToObject(json, "fifo_watermark", imu_manager_get_fifo_watermark());
+        char buf[API_JSON_CHUNK_SIZE];
+        json_resp_t resp;
+        json_writer_t w;
+        json_resp_begin(&resp, &w, buf, sizeof(buf), req, &api_timing[API_TIMING_CONFIG]);
+        json_writer_begin_object(&w, NULL);
+        json_writer_uint(&w, "sampling_rate", imu_manager_get_sampling_rate());
+        json_writer_uint(&w, "fifo_watermark", imu_manager_get_fifo_watermark());
         uint8_t enabled = imu_manager_get_enabled_sensors();
-        cJSON *sensors = cJSON_CreateObject();
-        cJSON_AddBoolToObject(sensors, "magnetometer", (enabled & SENSOR_MAGNETOMETER) != 0);
-        cJSON_AddBoolToObject(sensors, "accelerometer", (enabled & SENSOR_ACCELEROMETER) != 0);
-        cJSON_AddBoolToObject(sensors, "imu_6axis", (enabled & SENSOR_IMU_6AXIS) != 0);
-        cJSON_AddBoolToObject(sensors, "inclinometer", (enabled & SENSOR_INCLINOMETER) != 0);
-        cJSON_AddItemToObject(json, "sensors", sensors);
-        
-        char *json_string = cJSON_Print(json);
-        if (json_string != NULL) {
-            httpd_resp_set_type(req, "application/json");
-            httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-            httpd_resp_send(req, json_string, strlen(json_string));
-            free(json_string);
+        json_writer_begin_object(&w, "sensors");
+        json_writer_bool(&w, "magnetometer", (enabled & SENSOR_MAGNETOMETER) != 0);
+        json_writer_bool(&w, "accelerometer", (enabled & SENSOR_ACCELEROMETER) != 0);
+        json_writer_bool(&w, "imu_6axis", (enabled & SENSOR_IMU_6AXIS) != 0);
+        json_writer_bool(&w, "inclinometer", (enabled & SENSOR_INCLINOMETER) != 0);
+        json_writer_end_object(&w);
+        json_writer_begin_object(&w, "rates");
+        for (size_t i = 0; i < sizeof(sensor_map)/sizeof(sensor_map[0]); ++i) {
+            json_writer_uint(&w, sensor_map[i].key, imu_manager_get_sensor_rate(sensor_map[i].id));
         }
-        
-        cJSON_Delete(json);
+        json_writer_end_object(&w);
+        json_writer_bool(&w, "imu_hires", imu_manager_get_imu_hires());
+        json_writer_string(&w, "orientation_source", ahrs_source_key(imu_manager_get_orientation_source()));
+        json_writer_uint(&w, "align_rate_hz", time_align_get_output_rate());
+        json_writer_string(&w, "align_interp",
+                           time_align_get_interp() == TIME_ALIGN_CUBIC ? "cubic" : "linear");
+        json_writer_end_object(&w);
+        return json_resp_end(&resp, &w);
     }
     
     return ESP_OK;
 }
 
-// API Download endpoint - returns data in various formats
+static esp_err_t download_send_chunk(const char *data, size_t len, void *ctx)
+{
+    return httpd_resp_send_chunk((httpd_req_t *)ctx, data, len);
+}
+
+// API Download endpoint - streams the whole buffer (or ?max=N oldest records) in chunks
 static esp_err_t api_download_handler(httpd_req_t *req)
 {
     ESP_LOGI(TAG, "API Download request");
@@ -303,38 +715,37 @@ static esp_err_t api_download_handler(httpd_req_t *req)
         char *buf = malloc(buf_len);
         if (httpd_req_get_url_query_str(req, buf, buf_len) == ESP_OK) {
             char format[16];
+            char param[16];
+            uint32_t max_samples = 0;
+            if (httpd_query_key_value(buf, "max", param, sizeof(param)) == ESP_OK) {
+                max_samples = strtoul(param, NULL, 10);
+            }
             if (httpd_query_key_value(buf, "format", format, sizeof(format)) == ESP_OK) {
+                data_buffer_export_format_t fmt = DATA_BUFFER_EXPORT_CSV;
                 if (strcmp(format, "csv") == 0) {
-                    char *csv_buffer = NULL;
-                    size_t csv_len = 0;
-                    esp_err_t ret = data_buffer_export_csv_dynamic(&csv_buffer, &csv_len, 100);
-                    if (ret == ESP_OK && csv_buffer != NULL) {
-                        httpd_resp_set_type(req, "text/csv");
-                        httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=imu_data.csv");
-                        httpd_resp_send(req, csv_buffer, csv_len);
-                        free(csv_buffer);
-                    } else {
-                        if (csv_buffer) free(csv_buffer);
-                        httpd_resp_set_status(req, "500 Internal Server Error");
-                        httpd_resp_send(req, "Failed to export CSV", HTTPD_RESP_USE_STRLEN);
-                    }
+                    httpd_resp_set_type(req, "text/csv");
+                    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=imu_data.csv");
                 } else if (strcmp(format, "json") == 0) {
-                    char *json_buffer = NULL;
-                    size_t json_len = 0;
-                    esp_err_t ret = data_buffer_export_json_dynamic(&json_buffer, &json_len, 100);
-                    if (ret == ESP_OK && json_buffer != NULL) {
-                        httpd_resp_set_type(req, "application/json");
-                        httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=imu_data.json");
-                        httpd_resp_send(req, json_buffer, json_len);
-                        free(json_buffer);
-                    } else {
-                        if (json_buffer) free(json_buffer);
-                        httpd_resp_set_status(req, "500 Internal Server Error");
-                        httpd_resp_send(req, "Failed to export JSON", HTTPD_RESP_USE_STRLEN);
-                    }
+                    fmt = DATA_BUFFER_EXPORT_JSON;
+                    httpd_resp_set_type(req, "application/json");
+                    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=imu_data.json");
                 } else {
                     httpd_resp_set_status(req, "400 Bad Request");
                     httpd_resp_send(req, "Unsupported format", HTTPD_RESP_USE_STRLEN);
+                    free(buf);
+                    return ESP_OK;
+                }
+                // Headers go out with the first chunk; a failure after that can
+                // only end the response early
+                esp_err_t ret = data_buffer_export_stream(fmt, max_samples, download_send_chunk, req);
+                if (ret == ESP_ERR_NO_MEM) {
+                    httpd_resp_set_status(req, "503 Service Unavailable");
+                    httpd_resp_send(req, "Out of memory", HTTPD_RESP_USE_STRLEN);
+                } else {
+                    if (ret != ESP_OK) {
+                        ESP_LOGW(TAG, "Download aborted: %s", esp_err_to_name(ret));
+                    }
+                    httpd_resp_send_chunk(req, NULL, 0);
                 }
             } else {
                 httpd_resp_set_status(req, "400 Bad Request");
@@ -692,18 +1103,34 @@ esp_err_t web_server_enable_sensor(uint8_t sensor_id, bool enable)
 static void ws_broadcast_task(void *arg)
 {
     (void)arg;
-    char json[768];
+    char json[1024];
     uint32_t send_count = 0;
     uint32_t no_data_count = 0;
     uint64_t rate_window_start_us = 0;
     uint32_t rate_window_msgs = 0;
     float last_msg_rate = 0.0f;
+    uint32_t encode_us_total = 0;
+    uint32_t encode_errors = 0;
     
     ESP_LOGI(TAG, "WebSocket broadcast task started");
     
+    // Own cursor: each frame is sent at most once, the newest when several arrived
+    data_buffer_cursor_t cursor;
+    data_buffer_cursor_init(&cursor, false);
+    
     for (;;) {
         imu_data_t d;
-        if (data_buffer_get_latest(&d) == ESP_OK) {
+        bool fresh = false;
+        data_buffer_read_t rd;
+        if (data_buffer_read_begin(&cursor, 0, &rd) == ESP_OK) {
+            if (rd.count > 0) {
+                const int last = rd.span[1].len ? 1 : 0;
+                data_buffer_load(rd.span[last].pos + rd.span[last].len - 1, &d);
+                fresh = true;
+            }
+            data_buffer_read_end(&cursor, &rd);
+        }
+        if (fresh) {
             // LED ON - bắt đầu gửi dữ liệu
             led_status_data_pulse_start();
             
@@ -725,52 +1152,100 @@ static void ws_broadcast_task(void *arg)
             } else if (current_rate > 0.0f) {
                 last_msg_rate = current_rate;
             }
-            // Build compact JSON manually to reduce overhead
-            int n = 0;
-            n += snprintf(json + n, sizeof(json) - n, "{\"t\":%llu", (unsigned long long)d.timestamp_us);
+            // Compact JSON straight into the message buffer
+            int64_t encode_start_us = esp_timer_get_time();
+            json_writer_t w;
+            json_writer_init(&w, json, sizeof(json), NULL, NULL);
+            json_writer_begin_object(&w, NULL);
+            json_writer_uint(&w, "t", d.timestamp_us);
             if (d.magnetometer.valid) {
-                n += snprintf(json + n, sizeof(json) - n,
-                              ",\"mag_iis2\":{\"name\":\"IIS2MDC Magnetometer\",\"unit\":\"mG\",\"x\":%.2f,\"y\":%.2f,\"z\":%.2f,\"temperature\":%.2f}",
-                              d.magnetometer.x_mg, d.magnetometer.y_mg, d.magnetometer.z_mg,
-                              d.magnetometer.temperature_c);
+                json_writer_begin_object(&w, "mag_iis2");
+                json_writer_string(&w, "name", "IIS2MDC Magnetometer");
+                json_writer_string(&w, "unit", "mG");
+                json_writer_float(&w, "x", d.magnetometer.x_mg, 2);
+                json_writer_float(&w, "y", d.magnetometer.y_mg, 2);
+                json_writer_float(&w, "z", d.magnetometer.z_mg, 2);
+                json_writer_float(&w, "temperature", d.magnetometer.temperature_c, 2);
+                json_writer_end_object(&w);
             }
             if (d.accelerometer.valid) {
                 const float ax_g = d.accelerometer.x_g;
                 const float ay_g = d.accelerometer.y_g;
                 const float az_g = d.accelerometer.z_g;
                 const float g_to_ms2 = 9.80665f;
-                n += snprintf(json + n, sizeof(json) - n,
-                              ",\"acc_iis3_g\":{\"name\":\"IIS3DWB Accelerometer\",\"unit\":\"g\",\"x\":%.5f,\"y\":%.5f,\"z\":%.5f}",
-                              ax_g, ay_g, az_g);
-                n += snprintf(json + n, sizeof(json) - n,
-                              ",\"acc_iis3_ms2\":{\"name\":\"IIS3DWB Accelerometer\",\"unit\":\"m/s^2\",\"x\":%.5f,\"y\":%.5f,\"z\":%.5f}",
-                              ax_g * g_to_ms2, ay_g * g_to_ms2, az_g * g_to_ms2);
+                json_writer_begin_object(&w, "acc_iis3_g");
+                json_writer_string(&w, "name", "IIS3DWB Accelerometer");
+                json_writer_string(&w, "unit", "g");
+                json_writer_float(&w, "x", ax_g, 5);
+                json_writer_float(&w, "y", ay_g, 5);
+                json_writer_float(&w, "z", az_g, 5);
+                json_writer_end_object(&w);
+                json_writer_begin_object(&w, "acc_iis3_ms2");
+                json_writer_string(&w, "name", "IIS3DWB Accelerometer");
+                json_writer_string(&w, "unit", "m/s^2");
+                json_writer_float(&w, "x", ax_g * g_to_ms2, 5);
+                json_writer_float(&w, "y", ay_g * g_to_ms2, 5);
+                json_writer_float(&w, "z", az_g * g_to_ms2, 5);
+                json_writer_end_object(&w);
             }
             if (d.imu_6axis.valid) {
-                n += snprintf(json + n, sizeof(json) - n,
-                              ",\"gyr_icm\":{\"name\":\"ICM45686 Gyroscope\",\"unit\":\"deg/s\",\"x\":%.4f,\"y\":%.4f,\"z\":%.4f}",
-                              d.imu_6axis.gyro_x_dps, d.imu_6axis.gyro_y_dps, d.imu_6axis.gyro_z_dps);
+                json_writer_begin_object(&w, "gyr_icm");
+                json_writer_string(&w, "name", "ICM45686 Gyroscope");
+                json_writer_string(&w, "unit", "deg/s");
+                json_writer_fixed(&w, "x", d.imu_6axis.gyro_x_mdps, 3);
+                json_writer_fixed(&w, "y", d.imu_6axis.gyro_y_mdps, 3);
+                json_writer_fixed(&w, "z", d.imu_6axis.gyro_z_mdps, 3);
+                json_writer_end_object(&w);
             }
             if (d.inclinometer.valid) {
-                n += snprintf(json + n, sizeof(json) - n,
-                              ",\"inc_scl\":{\"name\":\"SCL3300 Inclinometer\",\"unit\":\"deg\",\"angle_x\":%.2f,\"angle_y\":%.2f,\"angle_z\":%.2f,\"temperature\":%.2f}",
-                              d.inclinometer.angle_x_deg, d.inclinometer.angle_y_deg, d.inclinometer.angle_z_deg,
-                              d.inclinometer.temperature_c);
+                json_writer_begin_object(&w, "inc_scl");
+                json_writer_string(&w, "name", "SCL3300 Inclinometer");
+                json_writer_string(&w, "unit", "deg");
+                json_writer_float(&w, "angle_x", d.inclinometer.angle_x_deg, 2);
+                json_writer_float(&w, "angle_y", d.inclinometer.angle_y_deg, 2);
+                json_writer_float(&w, "angle_z", d.inclinometer.angle_z_deg, 2);
+                json_writer_float(&w, "temperature", d.inclinometer.temperature_c, 2);
+                json_writer_end_object(&w);
+            }
+            ahrs_output_t ori;
+            if (ahrs_get_output(&ori) == ESP_OK) {
+                json_writer_begin_object(&w, "ori_ahrs");
+                json_writer_string(&w, "name", "AHRS Orientation");
+                json_writer_string(&w, "unit", "deg");
+                json_writer_float(&w, "roll", ori.roll_deg, 2);
+                json_writer_float(&w, "pitch", ori.pitch_deg, 2);
+                json_writer_float(&w, "yaw", ori.yaw_deg, 2);
+                json_writer_begin_array(&w, "q");
+                for (int i = 0; i < 4; i++) {
+                    json_writer_float(&w, NULL, ori.q[i], 5);
+                }
+                json_writer_end_array(&w);
+                json_writer_bool(&w, "mag", ori.mag_used);
+                json_writer_end_object(&w);
+            }
+            json_writer_begin_object(&w, "statistics");
+            json_writer_float(&w, "msg_per_second", last_msg_rate, 2);
+            json_writer_end_object(&w);
+            json_writer_end_object(&w);
+            encode_us_total += (uint32_t)(esp_timer_get_time() - encode_start_us);
+            
+            if (json_writer_finish(&w) == ESP_OK) {
+                ws_send_to_all(json, w.len);
+            } else {
+                encode_errors++;
             }
-            n += snprintf(json + n, sizeof(json) - n,
-                          ",\"statistics\":{\"msg_per_second\":%.2f}}",
-                          last_msg_rate);
-            ws_send_to_all(json, n);
             send_count++;
             
             // LED OFF - gửi xong dữ liệu
             led_status_data_pulse_end();
             
-            // Log every 100 sends
+            // Log every 100 sends, with the average cost of encoding one message
             if (send_count % 100 == 0) {
-                ESP_LOGI(TAG, "Sent %lu WebSocket messages (no_data: %lu)", send_count, no_data_count);
+                ESP_LOGI(TAG, "Sent %lu WebSocket messages (no_data: %lu, encode %lu us avg, %lu too large)",
+                         send_count, no_data_count, encode_us_total / 100, encode_errors);
+                encode_us_total = 0;
             }
-        } else {
+        } else if (data_buffer_is_empty()) {
             no_data_count++;
             if (no_data_count % 100 == 0) {
                 ESP_LOGW(TAG, "No data available in buffer (count: %lu)", no_data_count);
@@ -859,7 +1334,8 @@ static esp_err_t root_handler(httpd_req_t *req)
         "    acc_iis3_g:{title:'IIS3DWB Accelerometer (g)',labels:['X','Y','Z'],colors:['#b91c1c','#047857','#7c3aed']},"
         "    acc_iis3_ms2:{title:'IIS3DWB Accelerometer (m/s²)',labels:['X','Y','Z'],colors:['#d97706','#22c55e','#2563eb']},"
         "    gyr_icm:{title:'ICM45686 Gyroscope (deg/s)',labels:['X','Y','Z'],colors:['#f59e0b','#8b5cf6','#0ea5e9']},"
-        "    inc_scl:{title:'SCL3300 Inclinometer (deg)',labels:['Angle X','Angle Y','Angle Z'],colors:['#e67e22','#3b82f6','#1e293b']}"
+        "    inc_scl:{title:'SCL3300 Inclinometer (deg)',labels:['Angle X','Angle Y','Angle Z'],colors:['#e67e22','#3b82f6','#1e293b']},"
+        "    ori_ahrs:{title:'AHRS Orientation (deg)',labels:['Roll','Pitch','Yaw'],colors:['#be123c','#15803d','#4338ca']}"
         "  };"
         "  const charts={};"
         "  const maxPoints=100;"
@@ -907,6 +1383,7 @@ static esp_err_t root_handler(httpd_req_t *req)
         "      if(payload.acc_iis3_ms2){pushValues('acc_iis3_ms2',{values:[payload.acc_iis3_ms2.x,payload.acc_iis3_ms2.y,payload.acc_iis3_ms2.z],name:payload.acc_iis3_ms2.name,unit:payload.acc_iis3_ms2.unit});}"
         "      if(payload.gyr_icm){pushValues('gyr_icm',{values:[payload.gyr_icm.x,payload.gyr_icm.y,payload.gyr_icm.z],name:payload.gyr_icm.name,unit:payload.gyr_icm.unit});}"
         "      if(payload.inc_scl){pushValues('inc_scl',{values:[payload.inc_scl.angle_x,payload.inc_scl.angle_y,payload.inc_scl.angle_z],name:payload.inc_scl.name,unit:payload.inc_scl.unit,labels:['Angle X','Angle Y','Angle Z']});}"
+        "      if(payload.ori_ahrs){pushValues('ori_ahrs',{values:[payload.ori_ahrs.roll,payload.ori_ahrs.pitch,payload.ori_ahrs.yaw],name:payload.ori_ahrs.name,unit:payload.ori_ahrs.unit,labels:['Roll','Pitch','Yaw']});}"
         "      if(msgCount%25===0){addLog('Received '+msgCount+' messages');}"
         "    }catch(err){addLog('Parse error: '+err.message);}"
         "  };"
@@ -22,6 +22,15 @@
 #define API_DOWNLOAD_PATH "/api/download"
 #define API_IP_PATH "/api/ip"
 
+// /api/data?since= delta queries
+#define API_DATA_DEFAULT_RECORDS 100
+#define API_DATA_MAX_RECORDS 1000
+#define API_DATA_CHUNK_RECORDS 16   // Records copied out of the ring per lock
+#define API_DATA_OUT_SIZE 2048      // Chunked response buffer
+
+// Stack buffer of the other JSON responses; larger documents go out chunked
+#define API_JSON_CHUNK_SIZE 1024
+
 // WebSocket endpoints
 #define WS_DATA_PATH "/ws/data"
 #define WS_CONTROL_PATH "/ws/control"
@@ -0,0 +1,290 @@
+"""
+Decoder benchmark per MTU / data length setting
+
+Encodes synthetic sensor streams (noise around a slow drift, plus an optional
+vibration on the accelerometers) into version 2 frames the way the firmware
+does (frame size from MTU and LL data length, fragments below 100 bytes per
+notification, plain or delta-packed blocks), then times ESP32FrameParser on
+them. Prints per setting the frame size, LL packets per frame, wire bytes per
+sample, the size against plain blocks and the decode rate.
+
+    python bench_decoder.py [seconds] [vibration g]
+"""
+import math
+import random
+import struct
+import sys
+import time
+
+from core.esp32_parser import (BLOCK_AHRS, BLOCK_ICM_6AXIS, BLOCK_PACKED, BLOCK_SCL_INCL,
+                               FLAG_KEYFRAME, FRAGMENT_LAST, FRAGMENT_MARKER, TLV_ICM_TEMP,
+                               TLV_IIS3DWB_ACCEL, TLV_MAG, TLV_MAG_TEMP, TLV_SCL_TEMP,
+                               ESP32FrameParser)
+
+# Firmware constants (ble_stream.c / imu_ble.c)
+FRAME_MAX = 244
+FRAME_MIN = 100
+HEADER = 14
+ATT_HEADER = 3
+L2CAP_HEADER = 4
+BLOCK_HEADER = 3
+VARINT_MAX = 5
+BATCH_MAX_RECORDS = 64
+KEYFRAME_INTERVAL = 16
+
+# (block type, rate Hz, record bytes, temperature block)
+STREAMS = [
+    (TLV_IIS3DWB_ACCEL, 800, 6, None),
+    (BLOCK_ICM_6AXIS, 400, 12, TLV_ICM_TEMP),
+    (TLV_MAG, 100, 6, TLV_MAG_TEMP),
+    (BLOCK_SCL_INCL, 50, 12, TLV_SCL_TEMP),
+]
+AHRS_RECORD = 14
+
+# (label, MTU, LL TX octets)
+SETTINGS = [
+    ("MTU 23, no DLE", 23, 27),
+    ("MTU 65, no DLE", 65, 27),
+    ("MTU 185, no DLE", 185, 27),
+    ("MTU 185, DLE 251", 185, 251),
+    ("MTU 247, no DLE", 247, 27),
+    ("MTU 247, DLE 251", 247, 251),
+]
+
+
+def notify_payload(mtu: int, ll_octets: int) -> int:
+    """compute_notify_payload() of ble_stream.c: whole LL packets per notification"""
+    payload = mtu - ATT_HEADER
+    packets = (payload + ATT_HEADER + L2CAP_HEADER) // ll_octets
+    return payload if packets == 0 else packets * ll_octets - ATT_HEADER - L2CAP_HEADER
+
+
+def frame_size(mtu: int, ll_octets: int) -> int:
+    """update_frame_size() of ble_stream.c"""
+    payload = notify_payload(mtu, ll_octets)
+    if payload >= FRAME_MIN:
+        return min(payload, FRAME_MAX)
+    piece = payload - 2
+    return math.ceil(FRAME_MIN / piece) * piece
+
+
+def varint(v: int) -> bytes:
+    out = bytearray()
+    while v >= 0x80:
+        out.append((v & 0x7F) | 0x80)
+        v >>= 7
+    out.append(v)
+    return bytes(out)
+
+
+def zigzag(d: int) -> int:
+    d = ((d + (1 << 31)) & 0xFFFFFFFF) - (1 << 31)
+    return ((d << 1) ^ (d >> 31)) & 0xFFFFFFFF
+
+
+class PackedBlock:
+    """ble_codec_block_t of the firmware: plain and packed size of a block as records are added"""
+
+    def __init__(self, record_len: int, ref):
+        self.record_len = record_len
+        self.ref = list(ref)
+        self.dts = []
+        self.values = []
+        self.raw = 0
+        self.head = 0
+        self.dt_max = 0
+        self.zz_max = [0] * len(ref)
+
+    def copy(self):
+        other = PackedBlock(self.record_len, self.ref)
+        other.dts, other.values = self.dts[:], self.values[:]
+        other.raw, other.head, other.dt_max, other.zz_max = self.raw, self.head, self.dt_max, self.zz_max[:]
+        return other
+
+    def add(self, dt: int, values):
+        n = len(self.dts)
+        last = self.values[-1] if n else self.ref
+        self.raw += len(varint(dt)) + self.record_len
+        if n <= 1:
+            self.head += len(varint(dt))
+        else:
+            self.dt_max = max(self.dt_max, zigzag(dt - self.dts[-1]))
+        for c, v in enumerate(values):
+            zz = zigzag(v - last[c])
+            if n == 0:
+                self.head += len(varint(zz))
+            else:
+                self.zz_max[c] = max(self.zz_max[c], zz)
+        self.dts.append(dt)
+        self.values.append(values)
+
+    def packed_size(self) -> int:
+        n = len(self.dts)
+        bits = sum(w.bit_length() for w in self.zz_max) * (n - 1)
+        bits += self.dt_max.bit_length() * max(n - 2, 0)
+        return self.head + 1 + len(self.zz_max) + (bits + 7) // 8
+
+    def size(self, codec: bool) -> int:
+        return BLOCK_HEADER + (min(self.raw, self.packed_size()) if codec else self.raw)
+
+    def write(self, block_type: int, codec: bool) -> bytes:
+        n = len(self.dts)
+        out = bytearray()
+        if not codec or self.packed_size() >= self.raw:
+            out += bytes((block_type, n, self.record_len))
+            for dt, values in zip(self.dts, self.values):
+                out += varint(dt) + struct.pack(f'<{len(values)}h', *values)
+            return bytes(out)
+        out += bytes((block_type | BLOCK_PACKED, n, self.record_len))
+        for dt in self.dts[:2]:
+            out += varint(dt)
+        for c, v in enumerate(self.values[0]):
+            out += varint(zigzag(v - self.ref[c]))
+        widths = [self.dt_max.bit_length()] + [zz.bit_length() for zz in self.zz_max]
+        out += bytes(widths)
+        acc = bits = 0
+        runs = [(widths[0], [zigzag(self.dts[i] - self.dts[i - 1]) for i in range(2, n)])]
+        runs += [(widths[c + 1], [zigzag(self.values[i][c] - self.values[i - 1][c]) for i in range(1, n)])
+                 for c in range(len(self.ref))]
+        for width, run in runs:
+            for zz in run if width else ():
+                acc |= zz << bits
+                bits += width
+        out += acc.to_bytes((bits + 7) // 8, 'little')
+        return bytes(out)
+
+
+def make_streams(seconds: float, vibration: float):
+    """Sample timestamps (us) and channel values per stream"""
+    rng = random.Random(1)
+    # Per stream: noise (LSB rms) and offset per channel, vibrating channels
+    shapes = {
+        TLV_IIS3DWB_ACCEL: ([16, 16, 16], [330, -160, 16384], (0, 1)),
+        BLOCK_ICM_6AXIS: ([16, 16, 16, 8, 8, 8], [330, -160, 16384, 0, 0, 26], (0,)),
+        TLV_MAG: ([2, 2, 2], [200, -50, 400], ()),
+        BLOCK_SCL_INCL: ([1, 1, 1, 8, 8, 8], [115, -60, 8890, 330, -160, 16384], ()),
+    }
+    streams = []
+    for block_type, rate, record_len, _ in STREAMS:
+        noise, offset, vibrating = shapes[block_type]
+        period = 1e6 / rate
+        count = int(seconds * rate)
+        records = []
+        for i in range(count):
+            t = i / rate
+            values = []
+            for c in range(record_len // 2):
+                v = offset[c] + rng.gauss(0, noise[c]) + 2 * t
+                if c in vibrating:
+                    v += vibration * 16384 * math.sin(2 * math.pi * 50 * t)
+                values.append(max(-32768, min(32767, round(v))))
+            records.append(values)
+        streams.append(([int(1000 + i * period) for i in range(count)], records))
+    return streams
+
+
+def build_frames(streams, max_len: int, codec: bool):
+    """build_frame() of imu_ble.c, repeated until every sample is sent"""
+    cursors = [0] * len(streams)
+    refs = [None] * len(streams)
+    frames = []
+    reserve = sum(BLOCK_HEADER + VARINT_MAX + 2 for s in STREAMS if s[3] is not None)
+    reserve += BLOCK_HEADER + VARINT_MAX + AHRS_RECORD
+    while True:
+        pending = [min(len(ts) - c, BATCH_MAX_RECORDS) for (ts, _), c in zip(streams, cursors)]
+        if not any(pending):
+            return frames
+        keyframe = codec and len(frames) % KEYFRAME_INTERVAL == 0
+        base = min(streams[i][0][cursors[i]] for i in range(len(streams)) if pending[i])
+        blocks = [PackedBlock(STREAMS[i][2], [0] * (STREAMS[i][2] // 2) if keyframe or refs[i] is None else refs[i])
+                  for i in range(len(streams))]
+        last = [base] * len(streams)
+        size = HEADER
+        while True:
+            best = None
+            for i, (ts, _) in enumerate(streams):
+                n = len(blocks[i].dts)
+                if n < pending[i] and (best is None or ts[cursors[i] + n] < ts_best):
+                    best, ts_best = i, ts[cursors[i] + n]
+            if best is None:
+                break
+            block = blocks[best]
+            grown = block.copy()
+            grown.add(max(ts_best - last[best], 0), streams[best][1][cursors[best] + len(block.dts)])
+            cost = grown.size(codec) - (block.size(codec) if block.dts else 0)
+            if size + cost + reserve > max_len:
+                break
+            size += cost
+            blocks[best] = grown
+            last[best] = max(ts_best, last[best])
+
+        body = bytearray()
+        for i, block in enumerate(blocks):
+            if not block.dts:
+                continue
+            block_type, _, _, temp_type = STREAMS[i]
+            body += block.write(block_type, codec)
+            if temp_type is not None:
+                body += bytes((temp_type, 1, 2)) + varint(last[i] - base) + struct.pack('<h', 2500)
+            cursors[i] += len(block.dts)
+            refs[i] = block.values[-1]
+        body += bytes((BLOCK_AHRS, 1, AHRS_RECORD)) + varint(0) + struct.pack('<7h', 16384, 0, 0, 0, 0, 0, 0)
+        flags = FLAG_KEYFRAME if keyframe else 0
+        header = struct.pack('<HBBHII', HEADER + len(body), 2, flags, 0x03FF, base & 0xFFFFFFFF, len(frames))
+        frames.append(header + body)
+
+
+def notifications(frames, mtu: int, ll_octets: int):
+    """ble_stream_tx_pump(): frames longer than the notification payload go out in fragments"""
+    payload = notify_payload(mtu, ll_octets)
+    out = []
+    for frame in frames:
+        if len(frame) <= payload:
+            out.append(frame)
+            continue
+        piece = payload - 2
+        count = math.ceil(len(frame) / piece)
+        for index in range(count):
+            flags = index | (FRAGMENT_LAST if index == count - 1 else 0)
+            out.append(bytes((flags, FRAGMENT_MARKER)) + frame[index * piece:(index + 1) * piece])
+    return out
+
+
+def main():
+    seconds = float(sys.argv[1]) if len(sys.argv) > 1 else 10.0
+    vibration = float(sys.argv[2]) if len(sys.argv) > 2 else 0.0
+    streams = make_streams(seconds, vibration)
+    total = sum(len(ts) for ts, _ in streams)
+    print(f"{total} samples in {seconds:g} s of data "
+          f"({', '.join(f'0x{s[0]:02X} @ {s[1]} Hz' for s in STREAMS)}), vibration {vibration:g} g\n")
+    print(f"{'setting':<18} {'codec':>5} {'frame':>5} {'notif/frame':>11} {'LL pkt/frame':>12} "
+          f"{'B/sample':>8} {'vs plain':>8} {'LL B/s':>8} {'decode samples/s':>16} {'decode MB/s':>11}")
+
+    for (label, mtu, ll_octets), codec in ((s, c) for s in SETTINGS for c in (False, True)):
+        size = frame_size(mtu, ll_octets)
+        frames = build_frames(streams, size, codec)
+        plain = sum(len(f) for f in build_frames(streams, size, False)) if codec else sum(len(f) for f in frames)
+        notifs = notifications(frames, mtu, ll_octets)
+        wire = sum(len(n) for n in notifs)
+        ll_packets = sum(math.ceil((len(n) + ATT_HEADER + L2CAP_HEADER) / ll_octets) for n in notifs)
+        ll_bytes = sum(len(n) + ATT_HEADER + L2CAP_HEADER for n in notifs)
+
+        parser = ESP32FrameParser()
+        decoded = 0
+        start = time.perf_counter()
+        for n in notifs:
+            result = parser.parse(n)
+            if result is not None:
+                decoded += sum(1 for s in result[1] if s.sensor_mask & 0x00D7)
+        elapsed = time.perf_counter() - start
+        if decoded != total or parser.error_count:
+            print(f"{label}: decoded {decoded} of {total} samples, {parser.error_count} errors")
+
+        print(f"{label:<18} {'on' if codec else 'off':>5} {size:>5} {len(notifs) / len(frames):>11.2f} "
+              f"{ll_packets / len(frames):>12.2f} {wire / total:>8.2f} "
+              f"{sum(len(f) for f in frames) / plain:>8.1%} {ll_bytes / seconds:>8.0f} "
+              f"{decoded / elapsed:>16.0f} {wire / elapsed / 1e6:>11.2f}")
+
+
+if __name__ == "__main__":
+    main()
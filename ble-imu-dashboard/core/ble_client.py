@@ -23,7 +23,7 @@ class BLEHandler:
         self.on_data = on_data
         self.client: Optional[BleakClient] = None
         self.preferred_services = [s.lower() for s in (preferred_services or [])]
-        self.notify_char: Optional[BleakGATTCharacteristic] = None
+        self.notify_chars: List[BleakGATTCharacteristic] = []
 
     async def scan(self, timeout: float = 4.0) -> List[DeviceInfo]:
         devices = await BleakScanner.discover(timeout=timeout, return_adv=True)
@@ -43,11 +43,11 @@ class BLEHandler:
 
     async def disconnect(self):
         if self.client and self.client.is_connected:
-            if self.notify_char:
-                await self.client.stop_notify(self.notify_char)
+            for ch in self.notify_chars:
+                await self.client.stop_notify(ch)
             await self.client.disconnect()
         self.client = None
-        self.notify_char = None
+        self.notify_chars = []
         print("[BLE] Disconnected.")
 
     async def discover_notify_chars(self) -> List[CharInfo]:
@@ -67,11 +67,13 @@ class BLEHandler:
             chars.sort(key=key_fn)
         return chars
 
-    async def start_notify(self, uuid: str):
+    async def start_notify(self, uuid: str, on_data: Optional[Callable[[bytes], None]] = None):
+        """Subscribe to one more characteristic; its data goes to on_data, default the handler's"""
         if not (self.client and self.client.is_connected):
             raise BleakError("Not connected.")
+        handler = on_data or self.on_data
         def callback(_: int, data: bytearray):
-            self.on_data(bytes(data))
+            handler(bytes(data))
         ch = next(
             (c for svc in self.client.services for c in svc.characteristics if c.uuid.lower() == uuid.lower()),
             None
@@ -79,11 +81,22 @@ class BLEHandler:
         if not ch:
             raise BleakError(f"Characteristic {uuid} not found.")
         await self.client.start_notify(ch, callback)
-        self.notify_char = ch
+        self.notify_chars.append(ch)
         print(f"[BLE] Start notify {uuid}")
 
+    def has_characteristic(self, uuid: str) -> bool:
+        if not (self.client and self.client.is_connected):
+            return False
+        return any(c.uuid.lower() == uuid.lower() for svc in self.client.services for c in svc.characteristics)
+
+    async def write(self, uuid: str, data: bytes, response: bool = False):
+        if not (self.client and self.client.is_connected):
+            raise BleakError("Not connected.")
+        await self.client.write_gatt_char(uuid, data, response=response)
+
     async def stop_notify(self):
-        if self.client and self.notify_char:
-            await self.client.stop_notify(self.notify_char)
+        if self.client and self.notify_chars:
+            for ch in self.notify_chars:
+                await self.client.stop_notify(ch)
             print("[BLE] Stop notify")
-            self.notify_char = None
+            self.notify_chars = []
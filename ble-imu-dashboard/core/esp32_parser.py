@@ -1,10 +1,42 @@
 """
 ESP32-C6 IMU BLE Frame Parser
 Parses data according to ESP32_EXAMPLE.md specification
+
+Version 1 frames carry one TLV per sensor (one sample set per notification).
+Version 2 frames batch samples: after the header come blocks
+    [type:1][count:1][record_len:1] + count x (dt_us: LEB128 varint, record)
+dt_us of a block's first record is relative to the header timestamp, each
+further dt_us to the previous record of the block.
+
+A block type with bit 7 set (0x80) is bit-packed by the firmware's delta
+codec (ble_codec.h): per channel the first value as a zigzag varint against the
+stream's last record of the previous frame (0 in a keyframe, flag 0x02), then
+every further value as a zigzag delta at a per-block bit width. Packed blocks
+decode only from a keyframe on, without a lost frame in between.
+
+When the negotiated MTU / data length leave less than 100 bytes per
+notification, a frame is split over several notifications, each starting with
+[index | 0x80 on the last][0xFF]; a whole frame never has 0xFF in its second
+byte (the high byte of frame_len).
+
+The device keeps its last 128 frames. With a send_control callback the parser
+asks for the frames missing at a sequence gap through the control
+characteristic (0x2A5A) and holds the frames after the gap until they are back
+(flag 0x04) or RESEND_TIMEOUT_S passed, so samples come out complete and in order.
+The *_command() helpers build the other control values, which change the stream
+configuration at the next frame; the status (version 5) reports the one in effect.
+
+Besides the multiplexed data characteristic (0x2A58, channel 0) every sensor
+stream has its own (0x2A5B-0x2A5E, channels 1-4) with its own frame sequence.
+A stream goes out on its own characteristic while that is subscribed, on 0x2A58
+otherwise; use one parser per subscribed characteristic, each with its channel.
 """
 import struct
+import time
 from dataclasses import dataclass
-from typing import Dict, Optional
+from typing import Callable, Dict, Iterable, List, Optional, Tuple
+
+import numpy as np
 
 @dataclass
 class FrameHeader:
@@ -34,6 +66,9 @@ class SensorData:
     gyro_y: float = 0.0
     gyro_z: float = 0.0
     
+    # ICM45686 data came from 20-bit FIFO packets
+    icm_hires: bool = False
+    
     # IIS2MDC Magnetometer
     mag_x: float = 0.0
     mag_y: float = 0.0
@@ -53,17 +88,53 @@ class SensorData:
     icm_temperature: float = 0.0
     mag_temperature: float = 0.0
     scl_temperature: float = 0.0
+    
+    # On-device AHRS orientation (ICM45686 + IIS2MDC)
+    quat_w: float = 1.0
+    quat_x: float = 0.0
+    quat_y: float = 0.0
+    quat_z: float = 0.0
+    roll: float = 0.0
+    pitch: float = 0.0
+    yaw: float = 0.0
+    
+    # Sample time (device clock, low 32 bits) and the BLE_SENSOR_* bits
+    # of the fields set in this record
+    timestamp_us: int = 0
+    sensor_mask: int = 0
 
 # TLV Type codes
 TLV_IIS3DWB_ACCEL = 0x01
 TLV_ICM_ACCEL = 0x10
 TLV_ICM_GYRO = 0x11
 TLV_ICM_TEMP = 0x12
+TLV_ICM_ACCEL_HIRES = 0x13   # 3 x int32, ug
+TLV_ICM_GYRO_HIRES = 0x14    # 3 x int32, mdps
 TLV_MAG = 0x20
 TLV_MAG_TEMP = 0x21
 TLV_SCL_ANGLE = 0x30
 TLV_SCL_ACCEL = 0x31
 TLV_SCL_TEMP = 0x32
+TLV_AHRS_QUAT = 0x40         # 4 x int16, Q14 (w, x, y, z)
+TLV_AHRS_EULER = 0x41        # 3 x int16, 0.01 deg (roll, pitch, yaw)
+
+# Version 2 block types (0x01, 0x12, 0x20, 0x21 and 0x32 keep the TLV layout)
+BLOCK_ICM_6AXIS = 0x15       # accel 3 x int16 + gyro 3 x int16
+BLOCK_ICM_6AXIS_HIRES = 0x16 # accel 3 x int32 ug + gyro 3 x int32 mdps
+BLOCK_SCL_INCL = 0x33        # angle 3 x int16 + accel 3 x int16
+BLOCK_AHRS = 0x42            # quaternion 4 x int16 Q14 + euler 3 x int16
+
+# Sensor mask bits
+SENSOR_IIS3_ACCEL = 1 << 0
+SENSOR_ICM_ACCEL = 1 << 1
+SENSOR_ICM_GYRO = 1 << 2
+SENSOR_ICM_TEMP = 1 << 3
+SENSOR_IIS2_MAG = 1 << 4
+SENSOR_IIS2_TEMP = 1 << 5
+SENSOR_SCL_ANGLE = 1 << 6
+SENSOR_SCL_ACCEL = 1 << 7
+SENSOR_SCL_TEMP = 1 << 8
+SENSOR_AHRS = 1 << 9
 
 # Scaling factors
 SCALE_ACCEL = 16384.0      # int16 -> g
@@ -71,20 +142,251 @@ SCALE_GYRO = 131.072       # int16 -> dps
 SCALE_MAG = 1.0            # int16 -> mG
 SCALE_TEMP = 100.0         # int16 -> °C
 SCALE_ANGLE = 100.0        # int16 -> degrees
+SCALE_ACCEL_HIRES = 1e6    # int32 ug -> g
+SCALE_GYRO_HIRES = 1e3     # int32 mdps -> dps
+SCALE_QUAT = 16384.0       # int16 Q14 -> unit quaternion
+
+# Header flags
+FLAG_ICM_HIRES = 0x01
+FLAG_KEYFRAME = 0x02
+FLAG_RESENT = 0x04
+
+# Control characteristic commands
+CONTROL_RESEND = 0x01        # first sequence: uint32, count: uint16, channel: uint8 (0: may be left out)
+CONTROL_SET_STREAMS = 0x02   # mask: uint8, STREAM_* bits
+CONTROL_SET_RATE = 0x03      # stream: uint8, rate_hz: uint16
+CONTROL_SET_BATCH = 0x04     # records per stream and frame: uint8 (1-64), [stream: uint8]
+CONTROL_SET_CODEC = 0x05     # delta: uint8, keyframe interval: uint8 (0: default)
+CONTROL_SET_INTERVAL = 0x06  # packet interval ms: uint16 (>= 10), [stream: uint8]
+
+# Streams of the configuration commands, in frame order
+STREAM_IIS3DWB = 0
+STREAM_ICM45686 = 1
+STREAM_IIS2MDC = 2
+STREAM_SCL3300 = 3
+STREAM_AHRS = 4              # Mask bit only
+
+# Data characteristics: channel 0 multiplexes the streams not subscribed on
+# their own one, channel stream + 1
+CHANNEL_MUX = 0
+CHANNEL_NONE = 0xFF          # Status: stream not sent
+
+# Frames after a gap wait this long for the missing ones (twice, with a second
+# request), at most HOLD_MAX of them
+RESEND_TIMEOUT_S = 0.5
+HOLD_MAX = 256
+
+# Block type flag of the delta codec
+BLOCK_PACKED = 0x80
+
+@dataclass
+class StreamStatus:
+    """Status characteristic (0x2A59): sender state of the streamer"""
+    version: int
+    congested: bool
+    queue_depth: int
+    queue_max_depth: int
+    frames_per_event: int
+    notifies_per_interval: float
+    throughput_bps: int
+    conn_interval_us: int
+    frames_sent: int
+    frames_dropped: int
+    samples_lost: int
+    congestion_events: int
+    # Version 2: negotiated link sizes
+    mtu: int = 0
+    ll_tx_octets: int = 0
+    frame_size: int = 0
+    # Version 3: resend requests
+    frames_resent: int = 0
+    resend_missed: int = 0
+    # Version 4: configuration in effect
+    streams: int = 0
+    batch_records: int = 0
+    delta_codec: bool = False
+    keyframe_interval: int = 0
+    packet_interval_ms: int = 0
+    rate_hz: Tuple[int, ...] = ()
+    # Version 5: data characteristics and per-stream send policy
+    channels: int = 0
+    stream_channel: Tuple[int, ...] = ()
+    stream_batch_records: Tuple[int, ...] = ()
+    stream_interval_ms: Tuple[int, ...] = ()
+
+
+STATUS_FORMAT = '<BBBBBBHIIIIII'
+STATUS_FORMAT_V2 = STATUS_FORMAT + 'HHH'
+STATUS_FORMAT_V3 = STATUS_FORMAT_V2 + 'II'
+STATUS_FORMAT_V4 = STATUS_FORMAT_V3 + 'BBBBH4H'
+STATUS_FORMAT_V5 = STATUS_FORMAT_V4 + 'B4B4B4H'
+STATUS_FLAG_CONGESTED = 0x01
+
+# Fragmented frames (small MTU)
+FRAGMENT_MARKER = 0xFF
+FRAGMENT_LAST = 0x80
+
+
+def parse_status(data: bytes) -> Optional[StreamStatus]:
+    """Decode a status characteristic value, None if too short"""
+    if len(data) < struct.calcsize(STATUS_FORMAT):
+        return None
+    (version, flags, depth, max_depth, per_event, _, per_interval, bps, interval_us,
+     sent, dropped, lost, congestion) = struct.unpack_from(STATUS_FORMAT, data)
+    status = StreamStatus(version, bool(flags & STATUS_FLAG_CONGESTED), depth, max_depth, per_event,
+                          per_interval / 100.0, bps, interval_us, sent, dropped, lost, congestion)
+    if version >= 2 and len(data) >= struct.calcsize(STATUS_FORMAT_V2):
+        status.mtu, status.ll_tx_octets, status.frame_size = struct.unpack_from(
+            '<HHH', data, struct.calcsize(STATUS_FORMAT))
+    if version >= 3 and len(data) >= struct.calcsize(STATUS_FORMAT_V3):
+        status.frames_resent, status.resend_missed = struct.unpack_from(
+            '<II', data, struct.calcsize(STATUS_FORMAT_V2))
+    if version >= 4 and len(data) >= struct.calcsize(STATUS_FORMAT_V4):
+        (status.streams, status.batch_records, codec, status.keyframe_interval,
+         status.packet_interval_ms, *rates) = struct.unpack_from('<BBBBH4H', data, struct.calcsize(STATUS_FORMAT_V3))
+        status.delta_codec = bool(codec & 0x01)
+        status.rate_hz = tuple(rates)
+    if version >= 5 and len(data) >= struct.calcsize(STATUS_FORMAT_V5):
+        fields = struct.unpack_from('<B4B4B4H', data, struct.calcsize(STATUS_FORMAT_V4))
+        status.channels = fields[0]
+        status.stream_channel = tuple(fields[1:5])
+        status.stream_batch_records = tuple(fields[5:9])
+        status.stream_interval_ms = tuple(fields[9:13])
+    return status
+
+
+class StatusAssembler:
+    """Status notifications: below 80 bytes of notify payload (MTU 23) the firmware
+    cuts the value into [index | last][FRAGMENT_MARKER] pieces like the frames"""
+
+    def __init__(self):
+        self._fragments = None
+        self._next_fragment = 0
+
+    def feed(self, data: bytes) -> Optional[StreamStatus]:
+        """Decode a whole status or collect a piece; None until a status is complete"""
+        if len(data) >= 2 and data[1] == FRAGMENT_MARKER:
+            index = data[0] & 0x7F
+            if index == 0:
+                self._fragments = bytearray()
+                self._next_fragment = 0
+            if self._fragments is None or index != self._next_fragment:
+                # A piece was lost: wait for the next status
+                self._fragments = None
+                return None
+            self._fragments += data[2:]
+            self._next_fragment += 1
+            if not data[0] & FRAGMENT_LAST:
+                return None
+            data = bytes(self._fragments)
+            self._fragments = None
+        return parse_status(data)
+
+
+def resend_command(first_sequence: int, count: int, channel: int = CHANNEL_MUX) -> bytes:
+    """Control characteristic value asking for count frames from first_sequence of a channel"""
+    command = struct.pack('<BIH', CONTROL_RESEND, first_sequence & 0xFFFFFFFF, count)
+    if channel != CHANNEL_MUX:
+        command += struct.pack('<B', channel)
+    return command
+
+
+def streams_command(streams: Iterable[int]) -> bytes:
+    """Control characteristic value streaming only the given STREAM_* streams"""
+    mask = 0
+    for stream in streams:
+        mask |= 1 << stream
+    return struct.pack('<BB', CONTROL_SET_STREAMS, mask)
+
+
+def rate_command(stream: int, rate_hz: int) -> bytes:
+    """Control characteristic value setting the sensor rate of a stream"""
+    return struct.pack('<BBH', CONTROL_SET_RATE, stream, rate_hz)
+
+
+def batch_command(records: int, stream: Optional[int] = None) -> bytes:
+    """Control characteristic value limiting the records of a stream (default all) in a frame"""
+    if stream is None:
+        return struct.pack('<BB', CONTROL_SET_BATCH, records)
+    return struct.pack('<BBB', CONTROL_SET_BATCH, records, stream)
+
+
+def codec_command(delta: bool, keyframe_interval: int = 0) -> bytes:
+    """Control characteristic value switching the delta codec"""
+    return struct.pack('<BBB', CONTROL_SET_CODEC, int(delta), keyframe_interval)
+
+
+def interval_command(packet_interval_ms: int, stream: Optional[int] = None) -> bytes:
+    """Control characteristic value setting the latency bound of a stream's (default all) partial frames"""
+    if stream is None:
+        return struct.pack('<BH', CONTROL_SET_INTERVAL, packet_interval_ms)
+    return struct.pack('<BHB', CONTROL_SET_INTERVAL, packet_interval_ms, stream)
+
+
+def _seq_distance(to: int, frm: int) -> int:
+    """Frames from sequence frm forward to sequence to, modulo 2^32"""
+    return (to - frm) & 0xFFFFFFFF
+
 
 class ESP32FrameParser:
     """Parse ESP32-C6 IMU BLE frames"""
     
-    def __init__(self):
+    def __init__(self, send_control: Optional[Callable[[bytes], None]] = None, channel: int = CHANNEL_MUX):
+        """send_control writes the control characteristic; without it lost frames are not requested.
+        channel is the data characteristic the frames come from, for the resend requests."""
+        self.channel = channel
         self.last_sequence = -1
         self.frame_count = 0
         self.error_count = 0
+        self._fragments = None
+        self._next_fragment = 0
+        # Last record per sample stream for packed blocks: {source: (block type, values)};
+        # None until a keyframe and after a lost frame
+        self._refs = None
+        self.skipped_blocks = 0
+        # Resend requests: frames after a gap by sequence, newest sequence requested
+        self.send_control = send_control
+        self._held: Dict[int, tuple[FrameHeader, bytes]] = {}
+        self._requested_to: Optional[int] = None
+        self._wait_since = 0.0
+        self._retried = False
+        self.frames_lost = 0
+        self.frames_recovered = 0
+        
+    def _reassemble(self, data: bytes) -> Optional[bytes]:
+        """Collect the fragments of a frame; returns the frame once complete"""
+        index = data[0] & 0x7F
+        if index == 0:
+            self._fragments = bytearray()
+            self._next_fragment = 0
+        if self._fragments is None or index != self._next_fragment:
+            self.error_count += 1
+            print(f"⚠️ Lost fragment: expected {self._next_fragment}, got {index}")
+            self._fragments = None
+            return None
         
-    def parse(self, data: bytes) -> Optional[tuple[FrameHeader, SensorData]]:
+        self._fragments += data[2:]
+        self._next_fragment += 1
+        if not data[0] & FRAGMENT_LAST:
+            return None
+        frame = bytes(self._fragments)
+        self._fragments = None
+        return frame
+    
+    def parse(self, data: bytes) -> Optional[tuple[FrameHeader, List[SensorData]]]:
         """
         Parse BLE notification data
-        Returns (header, sensor_data) or None if invalid
+        Returns (header, samples) or None if invalid or a frame is still
+        incomplete or waiting for a resent one. Samples are in time order; a
+        version 1 frame gives a single sample with all sensors. When frames
+        held at a gap are released, the samples of all of them come at once
+        with the header of the newest.
         """
+        if len(data) >= 2 and data[1] == FRAGMENT_MARKER:
+            data = self._reassemble(data)
+            if data is None:
+                return None
+        
         if len(data) < 14:
             self.error_count += 1
             print(f"⚠️ Frame too short: {len(data)} bytes")
@@ -103,7 +405,7 @@ class ESP32FrameParser:
             )
             
             # Validate header
-            if header.version != 1:
+            if header.version not in (1, 2):
                 self.error_count += 1
                 print(f"⚠️ Unknown version: {header.version}")
                 return None
@@ -113,26 +415,106 @@ class ESP32FrameParser:
                 print(f"⚠️ Length mismatch: header={header.frame_len}, actual={len(data)}")
                 # Don't return None, continue parsing
             
+            header.sequence &= 0xFFFFFFFF
+            if self.send_control is not None and self.last_sequence >= 0 and header.version == 2:
+                return self._reorder(header, data)
+            
             # Detect lost frames
             if self.last_sequence >= 0:
                 expected = (self.last_sequence + 1) & 0xFFFFFFFF
                 if header.sequence != expected:
                     lost = (header.sequence - expected) & 0xFFFFFFFF
                     print(f"⚠️ Lost {lost} frame(s). Expected seq={expected}, got={header.sequence}")
+                    self._refs = None
             
             self.last_sequence = header.sequence
-            self.frame_count += 1
-            
-            # Parse TLV payload
-            sensor_data = self._parse_tlv_payload(data[14:])
-            
-            return (header, sensor_data)
+            return (header, self._decode_frame(header, data))
             
         except Exception as e:
             self.error_count += 1
+            self._refs = None
             print(f"❌ Parse error: {e}")
             return None
     
+    def _decode_frame(self, header: FrameHeader, data: bytes) -> List[SensorData]:
+        self.frame_count += 1
+        if header.version == 1:
+            sensor_data = self._parse_tlv_payload(data[14:])
+            sensor_data.timestamp_us = header.timestamp_us
+            sensor_data.sensor_mask = header.sensor_mask
+            return [sensor_data]
+        return self._parse_blocks(header, data[14:])
+    
+    def _reorder(self, header: FrameHeader, data: bytes) -> Optional[tuple[FrameHeader, List[SensorData]]]:
+        """Decodes frames in sequence order, asking the device for the ones missing"""
+        seq = header.sequence
+        ahead = _seq_distance(seq, self.last_sequence)
+        if ahead == 0 or ahead >= 1 << 31:
+            # Behind: a duplicate or a resend that came too late, unless the device
+            # started over (a keyframe that was not resent)
+            if not header.flags & FLAG_KEYFRAME or header.flags & FLAG_RESENT:
+                return None
+            print(f"⚠️ Stream restarted at seq={seq}")
+            self._held.clear()
+            self._requested_to = None
+            self.last_sequence = (seq - 1) & 0xFFFFFFFF
+            ahead = 1
+        
+        if not self._held:
+            self._wait_since = time.monotonic()
+        self._held[seq] = (header, data)
+        if ahead > 1:
+            self._request_missing(seq)
+        return self._release()
+    
+    def _request_missing(self, seq: int):
+        """Asks for the frames between the last decoded one and seq not requested yet"""
+        first = (self.last_sequence + 1) & 0xFFFFFFFF
+        if self._requested_to is not None and _seq_distance(self._requested_to, first) < _seq_distance(seq, first):
+            first = (self._requested_to + 1) & 0xFFFFFFFF
+        while first in self._held and first != seq:
+            first = (first + 1) & 0xFFFFFFFF
+        count = _seq_distance(seq, first)
+        if count == 0:
+            return
+        self._requested_to = (seq - 1) & 0xFFFFFFFF
+        print(f"⚠️ Missing {count} frame(s) from seq={first}, requesting resend")
+        self.send_control(resend_command(first, min(count, 0xFFFF), self.channel))
+    
+    def _release(self) -> Optional[tuple[FrameHeader, List[SensorData]]]:
+        """Decodes the held frames that are next in sequence, giving up on missing ones after the timeout"""
+        header = None
+        samples = []
+        while self._held:
+            seq = (self.last_sequence + 1) & 0xFFFFFFFF
+            if seq not in self._held:
+                full = len(self._held) >= HOLD_MAX
+                if time.monotonic() - self._wait_since < RESEND_TIMEOUT_S and not full:
+                    break
+                nearest = min(self._held, key=lambda s: _seq_distance(s, seq))
+                lost = _seq_distance(nearest, seq)
+                if not self._retried and not full:
+                    # The request or the resent frames may have been lost as well
+                    self._retried = True
+                    self._wait_since = time.monotonic()
+                    self.send_control(resend_command(seq, min(lost, 0xFFFF), self.channel))
+                    break
+                print(f"⚠️ Lost {lost} frame(s) from seq={seq}, not resent in time")
+                self.frames_lost += lost
+                self._refs = None
+                seq = nearest
+            frame_header, data = self._held.pop(seq)
+            if frame_header.flags & FLAG_RESENT:
+                self.frames_recovered += 1
+            self.last_sequence = seq
+            self._wait_since = time.monotonic()
+            self._retried = False
+            header = frame_header
+            samples += self._decode_frame(frame_header, data)
+        if header is None:
+            return None
+        return (header, samples)
+    
     def _parse_tlv_payload(self, payload: bytes) -> SensorData:
         """Parse TLV blocks in payload"""
         data = SensorData()
@@ -179,6 +561,24 @@ class ESP32FrameParser:
                         data.gyro_y = y / SCALE_GYRO
                         data.gyro_z = z / SCALE_GYRO
                 
+                elif tlv_type == TLV_ICM_ACCEL_HIRES:
+                    # ICM45686 Accelerometer, 20-bit mode (12 bytes: 3 x int32 ug)
+                    if tlv_len == 12:
+                        x, y, z = struct.unpack('<iii', tlv_data)
+                        data.icm_accel_x = x / SCALE_ACCEL_HIRES
+                        data.icm_accel_y = y / SCALE_ACCEL_HIRES
+                        data.icm_accel_z = z / SCALE_ACCEL_HIRES
+                        data.icm_hires = True
+                
+                elif tlv_type == TLV_ICM_GYRO_HIRES:
+                    # ICM45686 Gyroscope, 20-bit mode (12 bytes: 3 x int32 mdps)
+                    if tlv_len == 12:
+                        x, y, z = struct.unpack('<iii', tlv_data)
+                        data.gyro_x = x / SCALE_GYRO_HIRES
+                        data.gyro_y = y / SCALE_GYRO_HIRES
+                        data.gyro_z = z / SCALE_GYRO_HIRES
+                        data.icm_hires = True
+                
                 elif tlv_type == TLV_ICM_TEMP:
                     # ICM45686 Temperature (2 bytes: int16)
                     if tlv_len == 2:
@@ -221,6 +621,23 @@ class ESP32FrameParser:
                         temp_raw = struct.unpack('<h', tlv_data)[0]
                         data.scl_temperature = temp_raw / SCALE_TEMP
                 
+                elif tlv_type == TLV_AHRS_QUAT:
+                    # AHRS quaternion (8 bytes: 4 x int16, Q14)
+                    if tlv_len == 8:
+                        w, x, y, z = struct.unpack('<hhhh', tlv_data)
+                        data.quat_w = w / SCALE_QUAT
+                        data.quat_x = x / SCALE_QUAT
+                        data.quat_y = y / SCALE_QUAT
+                        data.quat_z = z / SCALE_QUAT
+                
+                elif tlv_type == TLV_AHRS_EULER:
+                    # AHRS Euler angles (6 bytes: 3 x int16, 0.01 deg)
+                    if tlv_len == 6:
+                        r, p, y = struct.unpack('<hhh', tlv_data)
+                        data.roll = r / SCALE_ANGLE
+                        data.pitch = p / SCALE_ANGLE
+                        data.yaw = y / SCALE_ANGLE
+                
                 else:
                     print(f"⚠️ Unknown TLV type: 0x{tlv_type:02X}")
             
@@ -229,6 +646,85 @@ class ESP32FrameParser:
         
         return data
     
+    def _parse_blocks(self, header: FrameHeader, payload: bytes) -> List[SensorData]:
+        """Parse the sample blocks of a version 2 frame"""
+        samples = []
+        offset = 0
+        if header.flags & FLAG_KEYFRAME:
+            self._refs = {}
+        
+        while offset + 3 <= len(payload):
+            block_type, count, record_len = payload[offset:offset + 3]
+            offset += 3
+            packed = block_type & BLOCK_PACKED
+            block_type &= ~BLOCK_PACKED
+            decoder = BLOCK_DECODERS.get(block_type)
+            if decoder is None:
+                print(f"⚠️ Unknown block type: 0x{block_type:02X}")
+            
+            if packed:
+                offset = self._parse_packed_block(header, payload, offset, block_type, count,
+                                                  record_len, samples)
+                if offset is None:
+                    print(f"⚠️ Block overflow: type=0x{block_type:02X}, count={count}")
+                    return sorted(samples, key=lambda s: s.timestamp_us)
+                continue
+            
+            timestamp = header.timestamp_us
+            for _ in range(count):
+                dt, offset = _read_varint(payload, offset)
+                if dt is None or offset + record_len > len(payload):
+                    print(f"⚠️ Block overflow: type=0x{block_type:02X}, count={count}")
+                    return sorted(samples, key=lambda s: s.timestamp_us)
+                timestamp = (timestamp + dt) & 0xFFFFFFFF
+                record = payload[offset:offset + record_len]
+                offset += record_len
+                
+                if decoder is None or record_len != decoder[1]:
+                    continue
+                sample = SensorData(timestamp_us=timestamp, sensor_mask=decoder[0])
+                decoder[2](sample, record)
+                samples.append(sample)
+            
+            source = BLOCK_SOURCES.get(block_type)
+            if source is not None and count and self._refs is not None:
+                dtype = _channel_dtype(block_type)
+                self._refs[source] = (block_type, np.frombuffer(record, dtype=dtype).astype(np.int64))
+        
+        return sorted(samples, key=lambda s: s.timestamp_us)
+    
+    def _parse_packed_block(self, header: FrameHeader, payload: bytes, offset: int, block_type: int,
+                            count: int, record_len: int, samples: List[SensorData]) -> Optional[int]:
+        """Decode a bit-packed block into samples; returns the offset past it, None if truncated"""
+        source = BLOCK_SOURCES.get(block_type)
+        dtype = _channel_dtype(block_type)
+        channels = record_len // dtype.itemsize
+        ref = np.zeros(channels, dtype=np.int64)
+        synced = self._refs is not None
+        if synced and not header.flags & FLAG_KEYFRAME:
+            last = self._refs.get(source)
+            if last is not None and last[0] == block_type:
+                ref = last[1]
+        
+        block = _unpack_block(payload, offset, count, channels, ref)
+        if block is None:
+            return None
+        dts, values, offset = block
+        
+        decoder = BLOCK_DECODERS.get(block_type)
+        if not synced or source is None or decoder is None or record_len != decoder[1]:
+            self.skipped_blocks += 1
+            return offset
+        
+        self._refs[source] = (block_type, values[-1])
+        timestamps = (header.timestamp_us + np.cumsum(dts)) & 0xFFFFFFFF
+        records = values.astype(dtype).tobytes()
+        for i in range(count):
+            sample = SensorData(timestamp_us=int(timestamps[i]), sensor_mask=decoder[0])
+            decoder[2](sample, records[i * record_len:(i + 1) * record_len])
+            samples.append(sample)
+        return offset
+    
     def get_stats(self) -> Dict[str, int]:
         """Get parser statistics"""
         return {
@@ -242,6 +738,178 @@ class ESP32FrameParser:
         self.last_sequence = -1
         self.frame_count = 0
         self.error_count = 0
+        self.skipped_blocks = 0
+        self._fragments = None
+        self._refs = None
+        self._held.clear()
+        self._requested_to = None
+        self.frames_lost = 0
+        self.frames_recovered = 0
+
+
+def _read_varint(data: bytes, offset: int) -> tuple[Optional[int], int]:
+    """LEB128 unsigned varint; returns (value, new offset), value None if truncated"""
+    value = 0
+    shift = 0
+    while offset < len(data):
+        byte = data[offset]
+        offset += 1
+        value |= (byte & 0x7F) << shift
+        if not byte & 0x80:
+            return value, offset
+        shift += 7
+    return None, offset
+
+
+def _unzigzag(z: np.ndarray) -> np.ndarray:
+    return (z >> 1) ^ -(z & 1)
+
+
+def _wrap_i32(v: np.ndarray) -> np.ndarray:
+    """Values modulo 2^32 as signed 32-bit (the encoder's differences wrap)"""
+    return ((v + (1 << 31)) & 0xFFFFFFFF) - (1 << 31)
+
+
+def _unpack_block(data: bytes, offset: int, count: int, channels: int, ref: np.ndarray):
+    """
+    Packed block body (ble_codec.h) -> (dt_us[count], values[count, channels], offset),
+    or None if truncated. The bit runs are decoded with numpy, one run at a time.
+    """
+    if count == 0:
+        return np.zeros(0, dtype=np.int64), np.zeros((0, channels), dtype=np.int64), offset
+    head = []
+    for _ in range(2 if count > 1 else 1):
+        dt, offset = _read_varint(data, offset)
+        if dt is None:
+            return None
+        head.append(dt)
+    first = []
+    for _ in range(channels):
+        zz, offset = _read_varint(data, offset)
+        if zz is None:
+            return None
+        first.append(zz)
+    if offset + 1 + channels > len(data):
+        return None
+    widths = list(data[offset:offset + 1 + channels])
+    offset += 1 + channels
+    
+    runs = [(widths[0], max(count - 2, 0))] + [(w, count - 1) for w in widths[1:]]
+    nbytes = (sum(w * n for w, n in runs) + 7) // 8
+    if offset + nbytes > len(data):
+        return None
+    bits = np.unpackbits(np.frombuffer(data, dtype=np.uint8, count=nbytes, offset=offset), bitorder='little')
+    offset += nbytes
+    
+    deltas = []
+    pos = 0
+    for width, n in runs:
+        if width == 0 or n == 0:
+            deltas.append(np.zeros(n, dtype=np.int64))
+            continue
+        run = bits[pos:pos + width * n].reshape(n, width).astype(np.int64)
+        deltas.append(_unzigzag(run @ (np.int64(1) << np.arange(width, dtype=np.int64))))
+        pos += width * n
+    
+    dts = np.empty(count, dtype=np.int64)
+    dts[0] = head[0]
+    if count > 1:
+        dts[1:] = (head[1] + np.concatenate(([0], np.cumsum(deltas[0])))) & 0xFFFFFFFF
+    
+    v0 = _wrap_i32(ref + _unzigzag(np.array(first, dtype=np.int64)))
+    steps = np.stack(deltas[1:], axis=1) if channels else np.zeros((count - 1, 0), dtype=np.int64)
+    values = _wrap_i32(v0 + np.vstack((np.zeros((1, channels), dtype=np.int64), np.cumsum(steps, axis=0))))
+    return dts, values, offset
+
+
+def _channel_dtype(block_type: int) -> np.dtype:
+    return np.dtype('<i4') if block_type == BLOCK_ICM_6AXIS_HIRES else np.dtype('<i2')
+
+
+def _decode_iis3dwb(sample: SensorData, record: bytes):
+    x, y, z = struct.unpack('<hhh', record)
+    sample.iis3dwb_accel_x = x / SCALE_ACCEL
+    sample.iis3dwb_accel_y = y / SCALE_ACCEL
+    sample.iis3dwb_accel_z = z / SCALE_ACCEL
+
+
+def _decode_icm(sample: SensorData, record: bytes):
+    ax, ay, az, gx, gy, gz = struct.unpack('<hhhhhh', record)
+    sample.icm_accel_x = ax / SCALE_ACCEL
+    sample.icm_accel_y = ay / SCALE_ACCEL
+    sample.icm_accel_z = az / SCALE_ACCEL
+    sample.gyro_x = gx / SCALE_GYRO
+    sample.gyro_y = gy / SCALE_GYRO
+    sample.gyro_z = gz / SCALE_GYRO
+
+
+def _decode_icm_hires(sample: SensorData, record: bytes):
+    ax, ay, az, gx, gy, gz = struct.unpack('<iiiiii', record)
+    sample.icm_accel_x = ax / SCALE_ACCEL_HIRES
+    sample.icm_accel_y = ay / SCALE_ACCEL_HIRES
+    sample.icm_accel_z = az / SCALE_ACCEL_HIRES
+    sample.gyro_x = gx / SCALE_GYRO_HIRES
+    sample.gyro_y = gy / SCALE_GYRO_HIRES
+    sample.gyro_z = gz / SCALE_GYRO_HIRES
+    sample.icm_hires = True
+
+
+def _decode_mag(sample: SensorData, record: bytes):
+    x, y, z = struct.unpack('<hhh', record)
+    sample.mag_x = x / SCALE_MAG
+    sample.mag_y = y / SCALE_MAG
+    sample.mag_z = z / SCALE_MAG
+
+
+def _decode_scl(sample: SensorData, record: bytes):
+    angle_x, angle_y, angle_z, x, y, z = struct.unpack('<hhhhhh', record)
+    sample.angle_x = angle_x / SCALE_ANGLE
+    sample.angle_y = angle_y / SCALE_ANGLE
+    sample.angle_z = angle_z / SCALE_ANGLE
+    sample.scl_accel_x = x / SCALE_ACCEL
+    sample.scl_accel_y = y / SCALE_ACCEL
+    sample.scl_accel_z = z / SCALE_ACCEL
+
+
+def _decode_ahrs(sample: SensorData, record: bytes):
+    w, x, y, z, roll, pitch, yaw = struct.unpack('<hhhhhhh', record)
+    sample.quat_w = w / SCALE_QUAT
+    sample.quat_x = x / SCALE_QUAT
+    sample.quat_y = y / SCALE_QUAT
+    sample.quat_z = z / SCALE_QUAT
+    sample.roll = roll / SCALE_ANGLE
+    sample.pitch = pitch / SCALE_ANGLE
+    sample.yaw = yaw / SCALE_ANGLE
+
+
+def _decode_temp(field: str):
+    def decode(sample: SensorData, record: bytes):
+        setattr(sample, field, struct.unpack('<h', record)[0] / SCALE_TEMP)
+    return decode
+
+
+# Block type -> (sensor mask bits, record length, decoder)
+BLOCK_DECODERS = {
+    TLV_IIS3DWB_ACCEL: (SENSOR_IIS3_ACCEL, 6, _decode_iis3dwb),
+    BLOCK_ICM_6AXIS: (SENSOR_ICM_ACCEL | SENSOR_ICM_GYRO, 12, _decode_icm),
+    BLOCK_ICM_6AXIS_HIRES: (SENSOR_ICM_ACCEL | SENSOR_ICM_GYRO, 24, _decode_icm_hires),
+    TLV_ICM_TEMP: (SENSOR_ICM_TEMP, 2, _decode_temp('icm_temperature')),
+    TLV_MAG: (SENSOR_IIS2_MAG, 6, _decode_mag),
+    TLV_MAG_TEMP: (SENSOR_IIS2_TEMP, 2, _decode_temp('mag_temperature')),
+    BLOCK_SCL_INCL: (SENSOR_SCL_ANGLE | SENSOR_SCL_ACCEL, 12, _decode_scl),
+    TLV_SCL_TEMP: (SENSOR_SCL_TEMP, 2, _decode_temp('scl_temperature')),
+    BLOCK_AHRS: (SENSOR_AHRS, 14, _decode_ahrs),
+}
+
+# Sample stream of the blocks that the delta codec packs; the two ICM45686
+# formats share a stream, a format change restarts packing from 0
+BLOCK_SOURCES = {
+    TLV_IIS3DWB_ACCEL: 'iis3dwb',
+    BLOCK_ICM_6AXIS: 'icm45686',
+    BLOCK_ICM_6AXIS_HIRES: 'icm45686',
+    TLV_MAG: 'iis2mdc',
+    BLOCK_SCL_INCL: 'scl3300',
+}
 
 
 def parse_frame_simple(data: bytes) -> Optional[tuple[int, float, float, float]]:
@@ -254,7 +922,18 @@ def parse_frame_simple(data: bytes) -> Optional[tuple[int, float, float, float]]
     
     try:
         # Parse header
-        _, _, _, _, _, sequence = struct.unpack('<HBBHIi', data[0:14])
+        _, version, _, _, _, sequence = struct.unpack('<HBBHIi', data[0:14])
+        
+        if version == 2:
+            header = FrameHeader(*struct.unpack('<HBBHIi', data[0:14]))
+            for sample in ESP32FrameParser()._parse_blocks(header, data[14:]):
+                if sample.sensor_mask & SENSOR_IIS3_ACCEL:
+                    return (sequence, sample.iis3dwb_accel_x, sample.iis3dwb_accel_y, sample.iis3dwb_accel_z)
+                if sample.sensor_mask & SENSOR_ICM_ACCEL:
+                    return (sequence, sample.icm_accel_x, sample.icm_accel_y, sample.icm_accel_z)
+                if sample.sensor_mask & SENSOR_SCL_ACCEL:
+                    return (sequence, sample.scl_accel_x, sample.scl_accel_y, sample.scl_accel_z)
+            return None
         
         # Parse TLV to find first accel data
         offset = 14
@@ -273,6 +952,9 @@ def parse_frame_simple(data: bytes) -> Optional[tuple[int, float, float, float]]
                 y_g = y / SCALE_ACCEL
                 z_g = z / SCALE_ACCEL
                 return (sequence, x_g, y_g, z_g)
+            if tlv_type == TLV_ICM_ACCEL_HIRES and tlv_len == 12:
+                x, y, z = struct.unpack('<iii', data[offset:offset+12])
+                return (sequence, x / SCALE_ACCEL_HIRES, y / SCALE_ACCEL_HIRES, z / SCALE_ACCEL_HIRES)
             
             offset += tlv_len
         
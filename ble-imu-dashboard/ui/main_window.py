@@ -1,16 +1,35 @@
 from PyQt6.QtWidgets import (
     QMainWindow, QWidget, QVBoxLayout, QHBoxLayout, QGridLayout,
     QPushButton, QLabel, QListWidget, QListWidgetItem,
-    QMessageBox, QGroupBox, QRadioButton
+    QMessageBox, QGroupBox, QRadioButton, QComboBox
 )
 from PyQt6.QtCore import QTimer, Qt
 from PyQt6.QtGui import QFont, QPixmap
 from core.ble_client import BLEHandler, DeviceInfo
-from core.esp32_parser import ESP32FrameParser
+from core.esp32_parser import ESP32FrameParser, StatusAssembler, CHANNEL_MUX, batch_command, interval_command
 from .plot_widget import PlotWidget
 import asyncio
 from pathlib import Path
 
+DATA_UUID = "00002a58-0000-1000-8000-00805f9b34fb"
+STATUS_UUID = "00002a59-0000-1000-8000-00805f9b34fb"
+CONTROL_UUID = "00002a5a-0000-1000-8000-00805f9b34fb"
+# One data characteristic per sensor stream, by channel (firmware 0x2A5B-0x2A5E)
+SENSOR_UUIDS = {
+    1: "00002a5b-0000-1000-8000-00805f9b34fb",  # IIS3DWB
+    2: "00002a5c-0000-1000-8000-00805f9b34fb",  # ICM45686
+    3: "00002a5d-0000-1000-8000-00805f9b34fb",  # IIS2MDC
+    4: "00002a5e-0000-1000-8000-00805f9b34fb",  # SCL3300
+}
+
+# Stream presets: records per sensor and frame, latency bound of partial frames (ms)
+STREAM_MODES = {
+    "⚡ Low latency": (4, 10),
+    "⚖ Balanced": (64, 20),
+    "📦 Throughput": (64, 100),
+}
+
+
 class IMUDashboard(QMainWindow):
     def __init__(self, loop: asyncio.AbstractEventLoop):
         super().__init__()
@@ -21,6 +40,11 @@ class IMUDashboard(QMainWindow):
         # --- BLE core
         self.ble = BLEHandler(self.on_ble_data, preferred_services=["1815"])
         self.esp32_parser = ESP32FrameParser()
+        # One parser per subscribed data characteristic (sequences are per channel)
+        self.parsers = [self.esp32_parser]
+        # Sender state from the status characteristic (0x2A59), None until one arrives
+        self.status_assembler = StatusAssembler()
+        self.stream_status = None
         
         # Theme management
         self.current_theme = "Dark"
@@ -47,6 +71,14 @@ class IMUDashboard(QMainWindow):
         self.btn_start = QPushButton("▶ Start")
         self.btn_stop = QPushButton("⏹ Stop")
         self.btn_ClearPlot = QPushButton("Clear Plot")
+        self.combo_mode = QComboBox()
+        self.combo_mode.addItems(STREAM_MODES.keys())
+        self.combo_mode.setCurrentText("⚖ Balanced")
+        self.combo_mode.setToolTip("Latency / throughput trade-off, applied by the device at the next frame")
+        self.combo_link = QComboBox()
+        self.combo_link.addItems(["🔀 Multiplexed", "🧩 Per sensor"])
+        self.combo_link.setToolTip("One data characteristic for all sensors, or one per sensor "
+                                   "(each with its own frames, scheduled fairly by the device); applied at Start")
         
         # Status & Stats
         self.lbl_status = QLabel("Status: Idle")
@@ -89,6 +121,8 @@ class IMUDashboard(QMainWindow):
         top_layout.addWidget(self.btn_start)
         top_layout.addWidget(self.btn_stop)
         top_layout.addWidget(self.btn_ClearPlot)
+        top_layout.addWidget(self.combo_mode)
+        top_layout.addWidget(self.combo_link)
         top_layout.addStretch(1)
         top_layout.addWidget(self.lbl_status)
         top_layout.addWidget(self.lbl_stats)
@@ -155,6 +189,7 @@ class IMUDashboard(QMainWindow):
         self.btn_start.clicked.connect(lambda: asyncio.ensure_future(self.do_start()))
         self.btn_stop.clicked.connect(lambda: asyncio.ensure_future(self.ble.stop_notify()))
         self.btn_ClearPlot.clicked.connect(self.clear_all_plots)
+        self.combo_mode.currentTextChanged.connect(lambda _: self.apply_stream_mode())
         
         # Theme signals
         self.radio_light.toggled.connect(lambda checked: self.apply_theme("light") if checked else None)
@@ -208,12 +243,50 @@ class IMUDashboard(QMainWindow):
             return
         
         try:
-            # ESP32-C6 uses characteristic UUID 0x2A58 in service 0x1815
-            await self.ble.start_notify("00002a58-0000-1000-8000-00805f9b34fb")
-            self.set_status("📡 Streaming...", "streaming")
+            # ESP32-C6 uses characteristic UUID 0x2A58 in service 0x1815; lost
+            # frames are requested again through 0x2A5A where the firmware has it
+            send_control = self.send_control if self.ble.has_characteristic(CONTROL_UUID) else None
+            await self.ble.stop_notify()
+            self.apply_stream_mode()
+            channels = [CHANNEL_MUX]
+            if self.combo_link.currentIndex() == 1:
+                # Streams of sensors without their own characteristic stay on 0x2A58
+                channels = [ch for ch, uuid in SENSOR_UUIDS.items() if self.ble.has_characteristic(uuid)]
+                if len(channels) < len(SENSOR_UUIDS):
+                    channels.insert(0, CHANNEL_MUX)
+            self.esp32_parser = ESP32FrameParser(send_control)
+            self.parsers = []
+            for channel in channels:
+                parser = self.esp32_parser if channel == CHANNEL_MUX else ESP32FrameParser(send_control, channel)
+                self.parsers.append(parser)
+                uuid = DATA_UUID if channel == CHANNEL_MUX else SENSOR_UUIDS[channel]
+                await self.ble.start_notify(uuid, lambda data, parser=parser: self.on_frame_data(parser, data))
+            if self.ble.has_characteristic(STATUS_UUID):
+                self.status_assembler = StatusAssembler()
+                self.stream_status = None
+                await self.ble.start_notify(STATUS_UUID, self.on_status)
+            self.set_status(f"📡 Streaming ({len(self.parsers)} characteristic(s))...", "streaming")
         except Exception as e:
             self.error(f"Start notify failed: {e}")
 
+    def send_control(self, command: bytes):
+        """Write a command to the control characteristic (0x2A5A), e.g. a resend request"""
+        asyncio.ensure_future(self.write_control(command))
+
+    def apply_stream_mode(self):
+        """Send the selected latency / throughput preset to the device"""
+        if not self.ble.has_characteristic(CONTROL_UUID):
+            return
+        records, interval_ms = STREAM_MODES[self.combo_mode.currentText()]
+        self.send_control(batch_command(records))
+        self.send_control(interval_command(interval_ms))
+
+    async def write_control(self, command: bytes):
+        try:
+            await self.ble.write(CONTROL_UUID, command)
+        except Exception as e:
+            print(f"❌ Control write failed: {e}")
+
     # ========== UI Management ==========
     def apply_theme(self, theme: str):
         """Apply light or dark theme"""
@@ -297,45 +370,61 @@ class IMUDashboard(QMainWindow):
         self.set_status("🧹 Plots cleared", "normal")
 
     def update_stats(self):
-        """Update statistics display"""
-        frame_count = self.esp32_parser.frame_count
-        error_count = self.esp32_parser.error_count
-        self.lbl_stats.setText(f"📈 {frame_count} frames, {error_count} errors")
+        """Update statistics display, summed over the data characteristics"""
+        frame_count = sum(p.frame_count for p in self.parsers)
+        error_count = sum(p.error_count for p in self.parsers)
+        recovered = sum(p.frames_recovered for p in self.parsers)
+        lost = sum(p.frames_lost for p in self.parsers)
+        text = f"📈 {frame_count} frames, {error_count} errors, {recovered} resent, {lost} lost"
+        if self.stream_status is not None:
+            text += f", MTU {self.stream_status.mtu}, {self.stream_status.throughput_bps / 1000:.1f} kB/s"
+        self.lbl_stats.setText(text)
 
     # ========== Data path ==========
     def on_ble_data(self, data: bytes):
         """Parse ESP32-C6 IMU BLE frame and extract sensor data"""
-        result = self.esp32_parser.parse(data)
+        self.on_frame_data(self.esp32_parser, data)
+
+    def on_status(self, data: bytes):
+        """Status notification, possibly one fragment of it at a small MTU"""
+        status = self.status_assembler.feed(data)
+        if status is not None:
+            self.stream_status = status
+
+    def on_frame_data(self, parser: ESP32FrameParser, data: bytes):
+        """Parse a frame of one data characteristic and plot its samples"""
+        result = parser.parse(data)
         
         if result is None:
             return  # Parse error
         
-        header, sensor_data = result
-        
-        # Plot all available sensors in this frame
-        # IIS3DWB Accelerometer - bit 0 (0x0001)
-        if header.sensor_mask & 0x0001:
-            self.plot_iis3dwb_x.append(sensor_data.iis3dwb_accel_x)
-            self.plot_iis3dwb_y.append(sensor_data.iis3dwb_accel_y)
-            self.plot_iis3dwb_z.append(sensor_data.iis3dwb_accel_z)
-        
-        # ICM Gyroscope - bit 2 (0x0004)
-        if header.sensor_mask & 0x0004:
-            self.plot_gyro_x.append(sensor_data.gyro_x)
-            self.plot_gyro_y.append(sensor_data.gyro_y)
-            self.plot_gyro_z.append(sensor_data.gyro_z)
-        
-        # Magnetometer - bit 4 (0x0010)
-        if header.sensor_mask & 0x0010:
-            self.plot_mag_x.append(sensor_data.mag_x)
-            self.plot_mag_y.append(sensor_data.mag_y)
-            self.plot_mag_z.append(sensor_data.mag_z)
-        
-        # SCL3300 Inclinometer - bit 6 (0x0040)
-        if header.sensor_mask & 0x0040:
-            self.plot_angle_x.append(sensor_data.angle_x)
-            self.plot_angle_y.append(sensor_data.angle_y)
-            self.plot_angle_z.append(sensor_data.angle_z)
+        header, samples = result
+        
+        # Plot every sample of the frame, in time order
+        for sensor_data in samples:
+            # IIS3DWB Accelerometer - bit 0 (0x0001)
+            if sensor_data.sensor_mask & 0x0001:
+                self.plot_iis3dwb_x.append(sensor_data.iis3dwb_accel_x)
+                self.plot_iis3dwb_y.append(sensor_data.iis3dwb_accel_y)
+                self.plot_iis3dwb_z.append(sensor_data.iis3dwb_accel_z)
+            
+            # ICM Gyroscope - bit 2 (0x0004)
+            if sensor_data.sensor_mask & 0x0004:
+                self.plot_gyro_x.append(sensor_data.gyro_x)
+                self.plot_gyro_y.append(sensor_data.gyro_y)
+                self.plot_gyro_z.append(sensor_data.gyro_z)
+            
+            # Magnetometer - bit 4 (0x0010)
+            if sensor_data.sensor_mask & 0x0010:
+                self.plot_mag_x.append(sensor_data.mag_x)
+                self.plot_mag_y.append(sensor_data.mag_y)
+                self.plot_mag_z.append(sensor_data.mag_z)
+            
+            # SCL3300 Inclinometer - bit 6 (0x0040)
+            if sensor_data.sensor_mask & 0x0040:
+                self.plot_angle_x.append(sensor_data.angle_x)
+                self.plot_angle_y.append(sensor_data.angle_y)
+                self.plot_angle_z.append(sensor_data.angle_z)
         
         # Debug: Print detailed info every 50 frames
         if header.sequence % 50 == 0:
@@ -347,5 +436,5 @@ class IMUDashboard(QMainWindow):
             if header.sensor_mask & 0x0040: available_sensors.append("SCL_Angle")
             if header.sensor_mask & 0x0080: available_sensors.append("SCL_Accel")
             
-            print(f"📊 Frame #{header.sequence}: Mask=0x{header.sensor_mask:04X}")
+            print(f"📊 Frame #{header.sequence}: Mask=0x{header.sensor_mask:04X}, {len(samples)} samples")
             print(f"   Available: {', '.join(available_sensors) if available_sensors else 'NONE'}")